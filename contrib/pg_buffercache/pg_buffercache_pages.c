@@ -115,7 +115,7 @@ pg_buffercache_pages(PG_FUNCTION_ARGS)
 		 * for concurrency.  Must grab locks in increasing order to avoid
 		 * possible deadlocks.
 		 */
-		for (i = 0; i < NUM_BUFFER_PARTITIONS; i++)
+		for (i = 0; i < NumBufferPartitions; i++)
 			LWLockAcquire(FirstBufMappingLock + i, LW_SHARED);
 
 		/*
@@ -133,15 +133,15 @@ pg_buffercache_pages(PG_FUNCTION_ARGS)
 			fctx->record[i].reldatabase = bufHdr->tag.rnode.dbNode;
 			fctx->record[i].forknum = bufHdr->tag.forkNum;
 			fctx->record[i].blocknum = bufHdr->tag.blockNum;
-			fctx->record[i].usagecount = bufHdr->usage_count;
+			fctx->record[i].usagecount = BUF_STATE_GET_USAGECOUNT(bufHdr->state);
 
-			if (bufHdr->flags & BM_DIRTY)
+			if (bufHdr->state & BM_DIRTY)
 				fctx->record[i].isdirty = true;
 			else
 				fctx->record[i].isdirty = false;
 
 			/* Note if the buffer is valid, and has storage created */
-			if ((bufHdr->flags & BM_VALID) && (bufHdr->flags & BM_TAG_VALID))
+			if ((bufHdr->state & BM_VALID) && (bufHdr->state & BM_TAG_VALID))
 				fctx->record[i].isvalid = true;
 			else
 				fctx->record[i].isvalid = false;
@@ -156,7 +156,7 @@ pg_buffercache_pages(PG_FUNCTION_ARGS)
 		 * other process until it can get all the locks it needs. (2) This
 		 * avoids O(N^2) behavior inside LWLockRelease.
 		 */
-		for (i = NUM_BUFFER_PARTITIONS; --i >= 0;)
+		for (i = NumBufferPartitions; --i >= 0;)
 			LWLockRelease(FirstBufMappingLock + i);
 	}
 
@@ -48,6 +48,7 @@
 #include "access/hash.h"
 #include "executor/instrument.h"
 #include "funcapi.h"
+#include "jit/jit.h"
 #include "mb/pg_wchar.h"
 #include "miscadmin.h"
 #include "parser/analyze.h"
@@ -67,7 +68,7 @@ PG_MODULE_MAGIC;
 #define PGSS_DUMP_FILE	"global/pg_stat_statements.stat"
 
 /* This constant defines the magic number in the stats file header */
-static const uint32 PGSS_FILE_HEADER = 0x20120328;
+static const uint32 PGSS_FILE_HEADER = 0x20130214;
 
 /* XXX: Should USAGE_EXEC reflect execution time and/or buffer usage? */
 #define USAGE_EXEC(duration)	(1.0)
@@ -115,6 +116,10 @@ typedef struct Counters
 	int64		temp_blks_written;		/* # of temp blocks written */
 	double		blk_read_time;	/* time spent reading, in msec */
 	double		blk_write_time; /* time spent writing, in msec */
+	int64		jit_functions;	/* # of functions JIT compiled */
+	double		jit_generation_time;	/* time spent generating code, in msec */
+	double		jit_optimization_time;	/* time spent optimizing code, in msec */
+	double		jit_emission_time;	/* time spent emitting code, in msec */
 	double		usage;			/* usage factor */
 } Counters;
 
@@ -249,6 +254,7 @@ static uint32 pgss_hash_string(const char *str);
 static void pgss_store(const char *query, uint32 queryId,
 		   double total_time, uint64 rows,
 		   const BufferUsage *bufusage,
+		   const JitInstrumentation *jitusage,
 		   pgssJumbleState *jstate);
 static Size pgss_memsize(void);
 static pgssEntry *entry_alloc(pgssHashKey *key, const char *query,
@@ -668,6 +674,7 @@ pgss_post_parse_analyze(ParseState *pstate, Query *query)
 				   0,
 				   0,
 				   NULL,
+				   NULL,
 				   &jstate);
 }
 
@@ -772,6 +779,8 @@ pgss_ExecutorEnd(QueryDesc *queryDesc)
 				   queryDesc->totaltime->total * 1000.0,		/* convert to msec */
 				   queryDesc->estate->es_processed,
 				   &queryDesc->totaltime->bufusage,
+				   queryDesc->estate->es_jit_context ?
+				   &queryDesc->estate->es_jit_context->instr : NULL,
 				   NULL);
 	}
 
@@ -875,6 +884,7 @@ pgss_ProcessUtility(Node *parsetree, const char *queryString,
 				   INSTR_TIME_GET_MILLISEC(duration),
 				   rows,
 				   &bufusage,
+				   NULL,
 				   NULL);
 	}
 	else
@@ -942,6 +952,7 @@ static void
 pgss_store(const char *query, uint32 queryId,
 		   double total_time, uint64 rows,
 		   const BufferUsage *bufusage,
+		   const JitInstrumentation *jitusage,
 		   pgssJumbleState *jstate)
 {
 	pgssHashKey key;
@@ -1039,6 +1050,13 @@ pgss_store(const char *query, uint32 queryId,
 		e->counters.temp_blks_written += bufusage->temp_blks_written;
 		e->counters.blk_read_time += INSTR_TIME_GET_MILLISEC(bufusage->blk_read_time);
 		e->counters.blk_write_time += INSTR_TIME_GET_MILLISEC(bufusage->blk_write_time);
+		if (jitusage)
+		{
+			e->counters.jit_functions += jitusage->created_functions;
+			e->counters.jit_generation_time += INSTR_TIME_GET_MILLISEC(jitusage->generation_counter);
+			e->counters.jit_optimization_time += INSTR_TIME_GET_MILLISEC(jitusage->optimization_counter);
+			e->counters.jit_emission_time += INSTR_TIME_GET_MILLISEC(jitusage->emission_counter);
+		}
 		e->counters.usage += USAGE_EXEC(total_time);
 
 		SpinLockRelease(&e->mutex);
@@ -1066,7 +1084,8 @@ pg_stat_statements_reset(PG_FUNCTION_ARGS)
 }
 
 #define PG_STAT_STATEMENTS_COLS_V1_0	14
-#define PG_STAT_STATEMENTS_COLS			18
+#define PG_STAT_STATEMENTS_COLS_V1_1	18
+#define PG_STAT_STATEMENTS_COLS			22
 
 /*
  * Retrieve statement statistics.
@@ -1084,6 +1103,7 @@ pg_stat_statements(PG_FUNCTION_ARGS)
 	HASH_SEQ_STATUS hash_seq;
 	pgssEntry  *entry;
 	bool		sql_supports_v1_1_counters = true;
+	bool		sql_supports_v1_2_counters = true;
 
 	if (!pgss || !pgss_hash)
 		ereport(ERROR,
@@ -1106,6 +1126,8 @@ pg_stat_statements(PG_FUNCTION_ARGS)
 		elog(ERROR, "return type must be a row type");
 	if (tupdesc->natts == PG_STAT_STATEMENTS_COLS_V1_0)
 		sql_supports_v1_1_counters = false;
+	if (tupdesc->natts != PG_STAT_STATEMENTS_COLS)
+		sql_supports_v1_2_counters = false;
 
 	per_query_ctx = rsinfo->econtext->ecxt_per_query_memory;
 	oldcontext = MemoryContextSwitchTo(per_query_ctx);
@@ -1182,9 +1204,17 @@ pg_stat_statements(PG_FUNCTION_ARGS)
 			values[i++] = Float8GetDatumFast(tmp.blk_read_time);
 			values[i++] = Float8GetDatumFast(tmp.blk_write_time);
 		}
+		if (sql_supports_v1_2_counters)
+		{
+			values[i++] = Int64GetDatumFast(tmp.jit_functions);
+			values[i++] = Float8GetDatumFast(tmp.jit_generation_time);
+			values[i++] = Float8GetDatumFast(tmp.jit_optimization_time);
+			values[i++] = Float8GetDatumFast(tmp.jit_emission_time);
+		}
 
-		Assert(i == (sql_supports_v1_1_counters ?
-					 PG_STAT_STATEMENTS_COLS : PG_STAT_STATEMENTS_COLS_V1_0));
+		Assert(i == (sql_supports_v1_2_counters ? PG_STAT_STATEMENTS_COLS :
+					 sql_supports_v1_1_counters ? PG_STAT_STATEMENTS_COLS_V1_1 :
+					 PG_STAT_STATEMENTS_COLS_V1_0));
 
 		tuplestore_putvalues(tupstore, tupdesc, values, nulls);
 	}
@@ -75,6 +75,17 @@
  * ----------------------------------------------------------------
  */
 
+/*
+ * varsize_any
+ *		Out-of-line version of VARSIZE_ANY, for generated code that can't
+ *		use the macro.
+ */
+Size
+varsize_any(void *p)
+{
+	return VARSIZE_ANY(p);
+}
+
 
 /*
  * heap_compute_data_size
@@ -1039,6 +1050,13 @@ slot_deform_tuple(TupleTableSlot *slot, int natts)
 	bits8	   *bp = tup->t_bits;		/* ptr to null bitmap in tuple */
 	bool		slow;			/* can we use/set attcacheoff? */
 
+	/* Use the routine specialized for the descriptor, if there is one */
+	if (slot->tts_deform != NULL)
+	{
+		slot->tts_deform(slot, natts);
+		return;
+	}
+
 	/*
 	 * Check whether the first call for this tuple, and initialize or restore
 	 * loop state.
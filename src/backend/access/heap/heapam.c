@@ -79,8 +79,13 @@ bool		synchronize_seqscans = true;
 static HeapScanDesc heap_beginscan_internal(Relation relation,
 						Snapshot snapshot,
 						int nkeys, ScanKey key,
+						ParallelHeapScanDesc parallel_scan,
 						bool allow_strat, bool allow_sync,
 						bool is_bitmapscan);
+static BlockNumber heap_parallelscan_nextpage(HeapScanDesc scan);
+#ifdef USE_PREFETCH
+static void heapprefetch(HeapScanDesc scan, BlockNumber page);
+#endif
 static HeapTuple heap_prepare_insert(Relation relation, HeapTuple tup,
 					TransactionId xid, CommandId cid, int options);
 static XLogRecPtr log_heap_update(Relation reln, Buffer oldbuf,
@@ -208,8 +213,14 @@ initscan(HeapScanDesc scan, ScanKey key, bool is_rescan)
 	 * might go into pages we already scanned.	To guarantee consistent
 	 * results for a non-MVCC snapshot, the caller must hold some higher-level
 	 * lock that ensures the interesting tuple(s) won't change.)
+	 *
+	 * In a parallel scan, all participants must agree on the number of
+	 * blocks, so it was determined once when the shared state was set up.
 	 */
-	scan->rs_nblocks = RelationGetNumberOfBlocks(scan->rs_rd);
+	if (scan->rs_parallel != NULL)
+		scan->rs_nblocks = scan->rs_parallel->phs_nblocks;
+	else
+		scan->rs_nblocks = RelationGetNumberOfBlocks(scan->rs_rd);
 
 	/*
 	 * If the table is large relative to NBuffers, use a bulk-read access
@@ -268,6 +279,10 @@ initscan(HeapScanDesc scan, ScanKey key, bool is_rescan)
 	ItemPointerSetInvalid(&scan->rs_ctup.t_self);
 	scan->rs_cbuf = InvalidBuffer;
 	scan->rs_cblock = InvalidBlockNumber;
+	scan->rs_pnextblock = InvalidBlockNumber;
+	scan->rs_pendblock = InvalidBlockNumber;
+	scan->rs_prefetch_pos = 0;
+	scan->rs_prefetch_target = 0;
 
 	/* we don't have a marked position... */
 	ItemPointerSetInvalid(&(scan->rs_mctid));
@@ -323,6 +338,12 @@ heapgetpage(HeapScanDesc scan, BlockNumber page)
 	 */
 	CHECK_FOR_INTERRUPTS();
 
+#ifdef USE_PREFETCH
+	/* get the kernel started on the pages after this one */
+	if (target_prefetch_pages > 0)
+		heapprefetch(scan, page);
+#endif
+
 	/* read page using selected strategy */
 	scan->rs_cbuf = ReadBufferExtended(scan->rs_rd, MAIN_FORKNUM, page,
 									   RBM_NORMAL, scan->rs_strategy);
@@ -405,6 +426,104 @@ heapgetpage(HeapScanDesc scan, BlockNumber page)
 	scan->rs_ntuples = ntup;
 }
 
+/*
+ * Number of pages a participant of a parallel scan claims at a time.  Large
+ * enough to keep the shared counter uncontended and the reads sequential,
+ * small enough that the participants finish at about the same time.
+ */
+#define PARALLEL_SCAN_CHUNK_PAGES	16
+
+/*
+ * heap_parallelscan_nextpage - get the next page to scan in a parallel scan
+ *
+ * Returns InvalidBlockNumber when all pages have been handed out.
+ */
+static BlockNumber
+heap_parallelscan_nextpage(HeapScanDesc scan)
+{
+	/* use volatile pointer to prevent code rearrangement */
+	volatile ParallelHeapScanDescData *parallel_scan = scan->rs_parallel;
+
+	if (scan->rs_pnextblock == scan->rs_pendblock)
+	{
+		BlockNumber start;
+		BlockNumber nblocks;
+
+		SpinLockAcquire(&parallel_scan->phs_mutex);
+		start = parallel_scan->phs_cblock;
+		nblocks = Min(parallel_scan->phs_nblocks - start,
+					  PARALLEL_SCAN_CHUNK_PAGES);
+		parallel_scan->phs_cblock = start + nblocks;
+		SpinLockRelease(&parallel_scan->phs_mutex);
+
+		if (nblocks == 0)
+			return InvalidBlockNumber;
+
+		scan->rs_pnextblock = start;
+		scan->rs_pendblock = start + nblocks;
+	}
+
+	return scan->rs_pnextblock++;
+}
+
+#ifdef USE_PREFETCH
+/*
+ * heapprefetch - subroutine for heapgetpage()
+ *
+ * Issue prefetch requests for the pages a forward scan is going to read
+ * after "page", so that by the time we get to them the reads are already
+ * done.  Pages are counted from rs_startblock, so that a synchronized scan
+ * that wraps around the end of the relation prefetches across the wrap and
+ * stops where the scan stops; a parallel scan only prefetches within the
+ * chunk it has claimed.  As in BitmapHeapNext, the prefetch distance starts
+ * small and grows up to target_prefetch_pages as the scan proceeds, so that
+ * a scan stopped early by a LIMIT doesn't read much that it didn't need.
+ *
+ * A backward scan never gets ahead of rs_prefetch_pos, so it prefetches
+ * nothing, which is fine since the kernel doesn't expect it either.
+ */
+static void
+heapprefetch(HeapScanDesc scan, BlockNumber page)
+{
+	BlockNumber pos;
+	BlockNumber endpos;
+
+	if (page >= scan->rs_startblock)
+		pos = page - scan->rs_startblock;
+	else
+		pos = page + scan->rs_nblocks - scan->rs_startblock;
+
+	if (scan->rs_parallel != NULL)
+		endpos = scan->rs_pendblock - scan->rs_startblock;
+	else
+		endpos = scan->rs_nblocks;
+
+	/* if we've jumped past the pages prefetched so far, start afresh */
+	if (scan->rs_prefetch_pos <= pos)
+		scan->rs_prefetch_pos = pos + 1;
+
+	if (scan->rs_prefetch_target >= target_prefetch_pages)
+		 /* don't increase any further */ ;
+	else if (scan->rs_prefetch_target >= target_prefetch_pages / 2)
+		scan->rs_prefetch_target = target_prefetch_pages;
+	else if (scan->rs_prefetch_target > 0)
+		scan->rs_prefetch_target *= 2;
+	else
+		scan->rs_prefetch_target++;
+
+	while (scan->rs_prefetch_pos < endpos &&
+		   scan->rs_prefetch_pos <= pos + scan->rs_prefetch_target)
+	{
+		BlockNumber block = scan->rs_startblock + scan->rs_prefetch_pos;
+
+		if (block >= scan->rs_nblocks)
+			block -= scan->rs_nblocks;
+		PrefetchBuffer(scan->rs_rd, MAIN_FORKNUM, block);
+		scan->rs_prefetch_pos++;
+	}
+}
+#endif   /* USE_PREFETCH */
+
 /* ----------------
  *		heapgettup - fetch next heap tuple
  *
@@ -461,7 +580,20 @@ heapgettup(HeapScanDesc scan,
 				tuple->t_data = NULL;
 				return;
 			}
-			page = scan->rs_startblock; /* first page */
+			if (scan->rs_parallel != NULL)
+			{
+				page = heap_parallelscan_nextpage(scan);
+
+				/* the other participants may have taken all the pages */
+				if (page == InvalidBlockNumber)
+				{
+					Assert(!BufferIsValid(scan->rs_cbuf));
+					tuple->t_data = NULL;
+					return;
+				}
+			}
+			else
+				page = scan->rs_startblock;		/* first page */
 			heapgetpage(scan, page);
 			lineoff = FirstOffsetNumber;		/* first offnum */
 			scan->rs_inited = true;
@@ -633,6 +765,11 @@ heapgettup(HeapScanDesc scan,
 				page = scan->rs_nblocks;
 			page--;
 		}
+		else if (scan->rs_parallel != NULL)
+		{
+			page = heap_parallelscan_nextpage(scan);
+			finished = (page == InvalidBlockNumber);
+		}
 		else
 		{
 			page++;
@@ -736,7 +873,20 @@ heapgettup_pagemode(HeapScanDesc scan,
 				tuple->t_data = NULL;
 				return;
 			}
-			page = scan->rs_startblock; /* first page */
+			if (scan->rs_parallel != NULL)
+			{
+				page = heap_parallelscan_nextpage(scan);
+
+				/* the other participants may have taken all the pages */
+				if (page == InvalidBlockNumber)
+				{
+					Assert(!BufferIsValid(scan->rs_cbuf));
+					tuple->t_data = NULL;
+					return;
+				}
+			}
+			else
+				page = scan->rs_startblock;		/* first page */
 			heapgetpage(scan, page);
 			lineindex = 0;
 			scan->rs_inited = true;
@@ -894,6 +1044,11 @@ heapgettup_pagemode(HeapScanDesc scan,
 				page = scan->rs_nblocks;
 			page--;
 		}
+		else if (scan->rs_parallel != NULL)
+		{
+			page = heap_parallelscan_nextpage(scan);
+			finished = (page == InvalidBlockNumber);
+		}
 		else
 		{
 			page++;
@@ -1280,7 +1435,7 @@ HeapScanDesc
 heap_beginscan(Relation relation, Snapshot snapshot,
 			   int nkeys, ScanKey key)
 {
-	return heap_beginscan_internal(relation, snapshot, nkeys, key,
+	return heap_beginscan_internal(relation, snapshot, nkeys, key, NULL,
 								   true, true, false);
 }
 
@@ -1289,7 +1444,7 @@ heap_beginscan_strat(Relation relation, Snapshot snapshot,
 					 int nkeys, ScanKey key,
 					 bool allow_strat, bool allow_sync)
 {
-	return heap_beginscan_internal(relation, snapshot, nkeys, key,
+	return heap_beginscan_internal(relation, snapshot, nkeys, key, NULL,
 								   allow_strat, allow_sync, false);
 }
 
@@ -1297,13 +1452,43 @@ HeapScanDesc
 heap_beginscan_bm(Relation relation, Snapshot snapshot,
 				  int nkeys, ScanKey key)
 {
-	return heap_beginscan_internal(relation, snapshot, nkeys, key,
+	return heap_beginscan_internal(relation, snapshot, nkeys, key, NULL,
 								   false, false, true);
 }
 
+/* ----------------
+ *		heap_parallelscan_initialize - set up shared state for a parallel scan
+ *
+ * 'target' points to shared memory that all participants of the scan can
+ * see.  Each participant then calls heap_beginscan_parallel with it, and the
+ * pages of the relation are handed out among them in chunks, so that every
+ * page is scanned by exactly one participant.  Only forward scans are
+ * possible, and a parallel scan can't be rescanned.
+ * ----------------
+ */
+void
+heap_parallelscan_initialize(ParallelHeapScanDesc target, Relation relation)
+{
+	target->phs_relid = RelationGetRelid(relation);
+	target->phs_nblocks = RelationGetNumberOfBlocks(relation);
+	SpinLockInit(&target->phs_mutex);
+	target->phs_cblock = 0;
+}
+
+HeapScanDesc
+heap_beginscan_parallel(Relation relation, Snapshot snapshot,
+						ParallelHeapScanDesc parallel_scan)
+{
+	Assert(RelationGetRelid(relation) == parallel_scan->phs_relid);
+
+	return heap_beginscan_internal(relation, snapshot, 0, NULL, parallel_scan,
+								   true, false, false);
+}
+
 static HeapScanDesc
 heap_beginscan_internal(Relation relation, Snapshot snapshot,
 						int nkeys, ScanKey key,
+						ParallelHeapScanDesc parallel_scan,
 						bool allow_strat, bool allow_sync,
 						bool is_bitmapscan)
 {
@@ -1330,6 +1515,7 @@ heap_beginscan_internal(Relation relation, Snapshot snapshot,
 	scan->rs_strategy = NULL;	/* set in initscan */
 	scan->rs_allow_strat = allow_strat;
 	scan->rs_allow_sync = allow_sync;
+	scan->rs_parallel = parallel_scan;
 
 	/*
 	 * we can use page-at-a-time mode if it's an MVCC-safe snapshot
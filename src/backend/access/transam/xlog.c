@@ -8235,10 +8235,18 @@ static int
 get_sync_bit(int method)
 {
 	int			o_direct_flag = 0;
+	int			direct_io_flag = 0;
+
+	/*
+	 * If direct_io says so, bypass the kernel cache whatever the sync method.
+	 * Not in walreceiver, though; see below.
+	 */
+	if ((direct_io & DIRECT_IO_WAL) && !AmWalReceiverProcess())
+		direct_io_flag = PG_O_DIRECT;
 
 	/* If fsync is disabled, never open in sync mode */
 	if (!enableFsync)
-		return 0;
+		return direct_io_flag;
 
 	/*
 	 * Optimize writes by bypassing kernel cache with O_DIRECT when using
@@ -8268,14 +8276,14 @@ get_sync_bit(int method)
 		case SYNC_METHOD_FSYNC:
 		case SYNC_METHOD_FSYNC_WRITETHROUGH:
 		case SYNC_METHOD_FDATASYNC:
-			return 0;
+			return direct_io_flag;
 #ifdef OPEN_SYNC_FLAG
 		case SYNC_METHOD_OPEN:
-			return OPEN_SYNC_FLAG | o_direct_flag;
+			return OPEN_SYNC_FLAG | o_direct_flag | direct_io_flag;
 #endif
 #ifdef OPEN_DATASYNC_FLAG
 		case SYNC_METHOD_OPEN_DSYNC:
-			return OPEN_DATASYNC_FLAG | o_direct_flag;
+			return OPEN_DATASYNC_FLAG | o_direct_flag | direct_io_flag;
 #endif
 		default:
 			/* can't happen (unless we are out of sync with option array) */
@@ -49,6 +49,7 @@ AggregateCreate(const char *aggName,
 				int numArgs,
 				List *aggtransfnName,
 				List *aggfinalfnName,
+				List *aggcombinefnName,
 				List *aggsortopName,
 				Oid aggTransType,
 				const char *agginitval)
@@ -60,6 +61,7 @@ AggregateCreate(const char *aggName,
 	Form_pg_proc proc;
 	Oid			transfn;
 	Oid			finalfn = InvalidOid;	/* can be omitted */
+	Oid			combinefn = InvalidOid; /* can be omitted */
 	Oid			sortop = InvalidOid;	/* can be omitted */
 	bool		hasPolyArg;
 	bool		hasInternalArg;
@@ -104,7 +106,8 @@ AggregateCreate(const char *aggName,
 
 	/* find the transfn */
 	nargs_transfn = numArgs + 1;
-	fnArgs = (Oid *) palloc(nargs_transfn * sizeof(Oid));
+	/* room for the combinefn's two arguments, too */
+	fnArgs = (Oid *) palloc(Max(nargs_transfn, 2) * sizeof(Oid));
 	fnArgs[0] = aggTransType;
 	memcpy(fnArgs + 1, aggArgTypes, numArgs * sizeof(Oid));
 	transfn = lookup_agg_function(aggtransfnName, nargs_transfn, fnArgs,
@@ -190,6 +193,34 @@ AggregateCreate(const char *aggName,
 				 errmsg("unsafe use of pseudo-type \"internal\""),
 				 errdetail("A function returning \"internal\" must have at least one \"internal\" argument.")));
 
+	/*
+	 * handle combinefn, if supplied.  It combines two transition states of
+	 * separately aggregated parts of the input, which rules out "internal"
+	 * states: those are pointers, which aren't meaningful outside of the
+	 * process that created them.
+	 */
+	if (aggcombinefnName)
+	{
+		Oid			combinetype;
+
+		if (aggTransType == INTERNALOID)
+			ereport(ERROR,
+					(errcode(ERRCODE_INVALID_FUNCTION_DEFINITION),
+					 errmsg("aggregate combine function cannot be used with transition type %s",
+							format_type_be(aggTransType))));
+
+		fnArgs[0] = aggTransType;
+		fnArgs[1] = aggTransType;
+		combinefn = lookup_agg_function(aggcombinefnName, 2, fnArgs,
+										&combinetype);
+		if (combinetype != aggTransType)
+			ereport(ERROR,
+					(errcode(ERRCODE_DATATYPE_MISMATCH),
+					 errmsg("return type of combine function %s is not %s",
+							NameListToString(aggcombinefnName),
+							format_type_be(aggTransType))));
+	}
+
 	/* handle sortop, if supplied */
 	if (aggsortopName)
 	{
@@ -267,6 +298,7 @@ AggregateCreate(const char *aggName,
 	values[Anum_pg_aggregate_aggfnoid - 1] = ObjectIdGetDatum(procOid);
 	values[Anum_pg_aggregate_aggtransfn - 1] = ObjectIdGetDatum(transfn);
 	values[Anum_pg_aggregate_aggfinalfn - 1] = ObjectIdGetDatum(finalfn);
+	values[Anum_pg_aggregate_aggcombinefn - 1] = ObjectIdGetDatum(combinefn);
 	values[Anum_pg_aggregate_aggsortop - 1] = ObjectIdGetDatum(sortop);
 	values[Anum_pg_aggregate_aggtranstype - 1] = ObjectIdGetDatum(aggTransType);
 	if (agginitval)
@@ -308,6 +340,15 @@ AggregateCreate(const char *aggName,
 		recordDependencyOn(&myself, &referenced, DEPENDENCY_NORMAL);
 	}
 
+	/* Depends on combine function, if any */
+	if (OidIsValid(combinefn))
+	{
+		referenced.classId = ProcedureRelationId;
+		referenced.objectId = combinefn;
+		referenced.objectSubId = 0;
+		recordDependencyOn(&myself, &referenced, DEPENDENCY_NORMAL);
+	}
+
 	/* Depends on sort operator, if any */
 	if (OidIsValid(sortop))
 	{
@@ -321,7 +362,7 @@ AggregateCreate(const char *aggName,
 }
 
 /*
- * lookup_agg_function -- common code for finding both transfn and finalfn
+ * lookup_agg_function -- common code for finding transfn, finalfn and combinefn
  */
 static Oid
 lookup_agg_function(List *fnName,
@@ -20,6 +20,7 @@
 #include "commands/prepare.h"
 #include "executor/hashjoin.h"
 #include "foreign/fdwapi.h"
+#include "jit/jit.h"
 #include "optimizer/clauses.h"
 #include "parser/parsetree.h"
 #include "rewrite/rewriteHandler.h"
@@ -74,13 +75,22 @@ static void show_upper_qual(List *qual, const char *qlabel,
 				ExplainState *es);
 static void show_sort_keys(SortState *sortstate, List *ancestors,
 			   ExplainState *es);
+static void show_incremental_sort_keys(IncrementalSortState *sortstate,
+						   List *ancestors, ExplainState *es);
 static void show_merge_append_keys(MergeAppendState *mstate, List *ancestors,
 					   ExplainState *es);
-static void show_sort_keys_common(PlanState *planstate,
+static void show_sort_keys_common(PlanState *planstate, const char *qlabel,
 					  int nkeys, AttrNumber *keycols,
 					  List *ancestors, ExplainState *es);
 static void show_sort_info(SortState *sortstate, ExplainState *es);
+static void show_incremental_sort_info(IncrementalSortState *sortstate,
+						   ExplainState *es);
 static void show_hash_info(HashState *hashstate, ExplainState *es);
+static void show_memoize_info(MemoizeState *mstate, List *ancestors,
+				  ExplainState *es);
+static void show_hashagg_info(AggState *aggstate, ExplainState *es);
+static void show_jit_node_info(PlanState *planstate, ExplainState *es);
+static void show_jit_info(JitContext *context, ExplainState *es);
 static void show_instrumentation_count(const char *qlabel, int which,
 						   PlanState *planstate, ExplainState *es);
 static void show_foreignscan_info(ForeignScanState *fsstate, ExplainState *es);
@@ -140,6 +150,8 @@ ExplainQuery(ExplainStmt *stmt, const char *queryString,
 			es.costs = defGetBoolean(opt);
 		else if (strcmp(opt->defname, "buffers") == 0)
 			es.buffers = defGetBoolean(opt);
+		else if (strcmp(opt->defname, "jit") == 0)
+			es.jit = defGetBoolean(opt);
 		else if (strcmp(opt->defname, "timing") == 0)
 		{
 			timing_set = true;
@@ -175,6 +187,11 @@ ExplainQuery(ExplainStmt *stmt, const char *queryString,
 				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
 				 errmsg("EXPLAIN option BUFFERS requires ANALYZE")));
 
+	if (es.jit && !es.analyze)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("EXPLAIN option JIT requires ANALYZE")));
+
 	/* if the timing was not set explicitly, set default value */
 	es.timing = (timing_set) ? es.timing : es.analyze;
 
@@ -414,6 +431,9 @@ ExplainOnePlan(PlannedStmt *plannedstmt, IntoClause *into, ExplainState *es,
 	if (es->buffers)
 		instrument_option |= INSTRUMENT_BUFFERS;
 
+	if (es->jit)
+		instrument_option |= INSTRUMENT_JIT;
+
 	INSTR_TIME_SET_CURRENT(starttime);
 
 	/*
@@ -500,6 +520,10 @@ ExplainOnePlan(PlannedStmt *plannedstmt, IntoClause *into, ExplainState *es,
 		ExplainCloseGroup("Triggers", "Triggers", false, es);
 	}
 
+	/* Print info about JIT compilation, which goes away with the executor */
+	if (es->jit)
+		show_jit_info(queryDesc->estate->es_jit_context, es);
+
 	/*
 	 * Close down the query and free resources.  Include time for this in the
 	 * total runtime (although it should be pretty minimal).
@@ -896,9 +920,15 @@ ExplainNode(PlanState *planstate, List *ancestors,
 		case T_Material:
 			pname = sname = "Materialize";
 			break;
+		case T_Memoize:
+			pname = sname = "Memoize";
+			break;
 		case T_Sort:
 			pname = sname = "Sort";
 			break;
+		case T_IncrementalSort:
+			pname = sname = "Incremental Sort";
+			break;
 		case T_Group:
 			pname = sname = "Group";
 			break;
@@ -1325,6 +1355,12 @@ ExplainNode(PlanState *planstate, List *ancestors,
 										   planstate, es);
 			break;
 		case T_Agg:
+			show_upper_qual(plan->qual, "Filter", planstate, ancestors, es);
+			if (plan->qual)
+				show_instrumentation_count("Rows Removed by Filter", 1,
+										   planstate, es);
+			show_hashagg_info((AggState *) planstate, es);
+			break;
 		case T_Group:
 			show_upper_qual(plan->qual, "Filter", planstate, ancestors, es);
 			if (plan->qual)
@@ -1335,6 +1371,12 @@ ExplainNode(PlanState *planstate, List *ancestors,
 			show_sort_keys((SortState *) planstate, ancestors, es);
 			show_sort_info((SortState *) planstate, es);
 			break;
+		case T_IncrementalSort:
+			show_incremental_sort_keys((IncrementalSortState *) planstate,
+									   ancestors, es);
+			show_incremental_sort_info((IncrementalSortState *) planstate,
+									   es);
+			break;
 		case T_MergeAppend:
 			show_merge_append_keys((MergeAppendState *) planstate,
 								   ancestors, es);
@@ -1353,6 +1395,9 @@ ExplainNode(PlanState *planstate, List *ancestors,
 		case T_Hash:
 			show_hash_info((HashState *) planstate, es);
 			break;
+		case T_Memoize:
+			show_memoize_info((MemoizeState *) planstate, ancestors, es);
+			break;
 		default:
 			break;
 	}
@@ -1463,6 +1508,10 @@ ExplainNode(PlanState *planstate, List *ancestors,
 		}
 	}
 
+	/* Show what was JIT compiled for this node */
+	if (es->jit && planstate->jit_instrument)
+		show_jit_node_info(planstate, es);
+
 	/* Get ready to display the child plans */
 	haschildren = planstate->initPlan ||
 		outerPlanState(planstate) ||
@@ -1677,11 +1726,29 @@ show_sort_keys(SortState *sortstate, List *ancestors, ExplainState *es)
 {
 	Sort	   *plan = (Sort *) sortstate->ss.ps.plan;
 
-	show_sort_keys_common((PlanState *) sortstate,
+	show_sort_keys_common((PlanState *) sortstate, "Sort Key",
 						  plan->numCols, plan->sortColIdx,
 						  ancestors, es);
 }
 
+/*
+ * Likewise, for an IncrementalSort node, showing which of the keys the
+ * input is already sorted by.
+ */
+static void
+show_incremental_sort_keys(IncrementalSortState *sortstate, List *ancestors,
+						   ExplainState *es)
+{
+	IncrementalSort *plan = (IncrementalSort *) sortstate->ss.ps.plan;
+
+	show_sort_keys_common((PlanState *) sortstate, "Sort Key",
+						  plan->sort.numCols, plan->sort.sortColIdx,
+						  ancestors, es);
+	show_sort_keys_common((PlanState *) sortstate, "Presorted Key",
+						  plan->presortedCols, plan->sort.sortColIdx,
+						  ancestors, es);
+}
+
 /*
  * Likewise, for a MergeAppend node.
  */
@@ -1691,13 +1758,14 @@ show_merge_append_keys(MergeAppendState *mstate, List *ancestors,
 {
 	MergeAppend *plan = (MergeAppend *) mstate->ps.plan;
 
-	show_sort_keys_common((PlanState *) mstate,
+	show_sort_keys_common((PlanState *) mstate, "Sort Key",
 						  plan->numCols, plan->sortColIdx,
 						  ancestors, es);
 }
 
 static void
-show_sort_keys_common(PlanState *planstate, int nkeys, AttrNumber *keycols,
+show_sort_keys_common(PlanState *planstate, const char *qlabel,
+					  int nkeys, AttrNumber *keycols,
 					  List *ancestors, ExplainState *es)
 {
 	Plan	   *plan = planstate->plan;
@@ -1732,7 +1800,7 @@ show_sort_keys_common(PlanState *planstate, int nkeys, AttrNumber *keycols,
 		result = lappend(result, exprstr);
 	}
 
-	ExplainPropertyList("Sort Key", result, es);
+	ExplainPropertyList(qlabel, result, es);
 }
 
 /*
@@ -1767,6 +1835,104 @@ show_sort_info(SortState *sortstate, ExplainState *es)
 	}
 }
 
+/*
+ * If it's EXPLAIN ANALYZE, show how many batches an incremental sort node
+ * sorted, and the space the largest one took
+ */
+static void
+show_incremental_sort_info(IncrementalSortState *sortstate, ExplainState *es)
+{
+	long		maxSpace = sortstate->maxSpace;
+	const char *maxSpaceType = sortstate->maxSpaceType;
+
+	Assert(IsA(sortstate, IncrementalSortState));
+	if (!es->analyze || sortstate->nbatches == 0)
+		return;
+
+	/* the current batch hasn't been counted yet */
+	if (sortstate->tuplesortstate != NULL)
+	{
+		const char *sortMethod;
+		const char *spaceType;
+		long		spaceUsed;
+
+		tuplesort_get_stats((Tuplesortstate *) sortstate->tuplesortstate,
+							&sortMethod, &spaceType, &spaceUsed);
+		if (spaceUsed > maxSpace || maxSpaceType == NULL)
+		{
+			maxSpace = spaceUsed;
+			maxSpaceType = spaceType;
+		}
+	}
+	if (maxSpaceType == NULL)
+		maxSpaceType = "Memory";
+
+	if (es->format == EXPLAIN_FORMAT_TEXT)
+	{
+		appendStringInfoSpaces(es->str, es->indent * 2);
+		appendStringInfo(es->str, "Sort Batches: %ld  Peak %s: %ldkB\n",
+						 sortstate->nbatches, maxSpaceType, maxSpace);
+	}
+	else
+	{
+		ExplainPropertyLong("Sort Batches", sortstate->nbatches, es);
+		ExplainPropertyLong("Peak Sort Space Used", maxSpace, es);
+		ExplainPropertyText("Peak Sort Space Type", maxSpaceType, es);
+	}
+}
+
+/*
+ * Show the cache keys of a Memoize node, and for EXPLAIN ANALYZE, how well
+ * the cache did
+ */
+static void
+show_memoize_info(MemoizeState *mstate, List *ancestors, ExplainState *es)
+{
+	Memoize    *plan = (Memoize *) mstate->ss.ps.plan;
+	List	   *context;
+	List	   *result = NIL;
+	bool		useprefix;
+	ListCell   *lc;
+
+	/* Set up deparsing context */
+	context = deparse_context_for_planstate((Node *) mstate,
+											ancestors,
+											es->rtable,
+											es->rtable_names);
+	useprefix = (list_length(es->rtable) > 1 || es->verbose);
+
+	foreach(lc, plan->param_exprs)
+	{
+		Node	   *expr = (Node *) lfirst(lc);
+
+		result = lappend(result,
+						 deparse_expression(expr, context, useprefix, true));
+	}
+	ExplainPropertyList("Cache Key", result, es);
+
+	if (!es->analyze || mstate->cache_hits + mstate->cache_misses == 0)
+		return;
+
+	if (es->format != EXPLAIN_FORMAT_TEXT)
+	{
+		ExplainPropertyLong("Cache Hits", mstate->cache_hits, es);
+		ExplainPropertyLong("Cache Misses", mstate->cache_misses, es);
+		ExplainPropertyLong("Cache Evictions", mstate->cache_evictions, es);
+		ExplainPropertyLong("Cache Overflows", mstate->cache_overflows, es);
+		ExplainPropertyLong("Peak Memory Usage",
+							(long) ((mstate->mem_peak + 1023) / 1024), es);
+	}
+	else
+	{
+		appendStringInfoSpaces(es->str, es->indent * 2);
+		appendStringInfo(es->str,
+						 "Hits: %ld  Misses: %ld  Evictions: %ld  Overflows: %ld  Memory Usage: %ldkB\n",
+						 mstate->cache_hits, mstate->cache_misses,
+						 mstate->cache_evictions, mstate->cache_overflows,
+						 (long) ((mstate->mem_peak + 1023) / 1024));
+	}
+}
+
 /*
  * Show information on hash buckets/batches.
  */
@@ -1806,6 +1972,198 @@ show_hash_info(HashState *hashstate, ExplainState *es)
 							 hashtable->nbuckets, hashtable->nbatch,
 							 spacePeakKb);
 		}
+
+		if (hashtable->bloomChecked > 0)
+		{
+			long		bloomKb;
+
+			bloomKb = (UINT64CONST(8) << (32 - hashtable->bloomShift)) / 1024;
+
+			if (es->format != EXPLAIN_FORMAT_TEXT)
+			{
+				ExplainPropertyLong("Bloom Filter Size", bloomKb, es);
+				ExplainPropertyFloat("Bloom Filter Checks",
+									 hashtable->bloomChecked, 0, es);
+				ExplainPropertyFloat("Bloom Filter Rejections",
+									 hashtable->bloomRejected, 0, es);
+			}
+			else
+			{
+				appendStringInfoSpaces(es->str, es->indent * 2);
+				appendStringInfo(es->str,
+						 "Bloom Filter: %ldkB  Checked: %.0f  Rejected: %.0f\n",
+								 bloomKb, hashtable->bloomChecked,
+								 hashtable->bloomRejected);
+			}
+		}
+
+		if (hashtable->nchunkedBatches > 0)
+		{
+			if (es->format != EXPLAIN_FORMAT_TEXT)
+				ExplainPropertyInteger("Chunked Hash Batches",
+									   hashtable->nchunkedBatches, es);
+			else
+			{
+				appendStringInfoSpaces(es->str, es->indent * 2);
+				appendStringInfo(es->str, "Batches Processed in Chunks: %d\n",
+								 hashtable->nchunkedBatches);
+			}
+		}
+
+		if (hashtable->workerTuples > 0)
+		{
+			if (es->format != EXPLAIN_FORMAT_TEXT)
+				ExplainPropertyFloat("Tuples Hashed by Scan Workers",
+									 hashtable->workerTuples, 0, es);
+			else
+			{
+				appendStringInfoSpaces(es->str, es->indent * 2);
+				appendStringInfo(es->str, "Hashed by Scan Workers: %.0f\n",
+								 hashtable->workerTuples);
+			}
+		}
+	}
+}
+
+/*
+ * If it's EXPLAIN ANALYZE, show memory usage and batches of a hashed Agg node
+ */
+static void
+show_hashagg_info(AggState *aggstate, ExplainState *es)
+{
+	Agg		   *plan = (Agg *) aggstate->ss.ps.plan;
+	long		spacePeakKb;
+	int			nbatch;
+
+	if (!es->analyze || plan->aggstrategy != AGG_HASHED ||
+		!aggstate->table_filled)
+		return;
+
+	spacePeakKb = (aggstate->hash_mem_peak + 1023) / 1024;
+	nbatch = aggstate->hash_nbatches + 1;
+
+	if (es->format != EXPLAIN_FORMAT_TEXT)
+	{
+		ExplainPropertyLong("Hash Batches", nbatch, es);
+		ExplainPropertyLong("Peak Memory Usage", spacePeakKb, es);
+	}
+	else
+	{
+		appendStringInfoSpaces(es->str, es->indent * 2);
+		appendStringInfo(es->str, "Batches: %d  Memory Usage: %ldkB\n",
+						 nbatch, spacePeakKb);
+	}
+}
+
+/*
+ * Show which parts of a node were JIT compiled, and how often the generated
+ * code and the interpreter were called from it
+ */
+static void
+show_jit_node_info(PlanState *planstate, ExplainState *es)
+{
+	JitNodeInstrumentation *instr = planstate->jit_instrument;
+	List	   *compiled = NIL;
+
+	if (instr->compiled & JIT_NODE_FILTER)
+		compiled = lappend(compiled, "Filter");
+	if (instr->compiled & JIT_NODE_JOIN_FILTER)
+		compiled = lappend(compiled, "Join Filter");
+	if (instr->compiled & JIT_NODE_OUTPUT)
+		compiled = lappend(compiled, "Output");
+	if (instr->compiled & JIT_NODE_DEFORM)
+		compiled = lappend(compiled, "Deform");
+	if (instr->compiled & JIT_NODE_AGGREGATE)
+		compiled = lappend(compiled, "Aggregation");
+	if (instr->compiled & JIT_NODE_HASH)
+		compiled = lappend(compiled, "Hash");
+	if (instr->compiled & JIT_NODE_SORT)
+		compiled = lappend(compiled, "Sort");
+
+	/* in text format, don't clutter nodes nothing was tried for */
+	if (es->format == EXPLAIN_FORMAT_TEXT && compiled == NIL &&
+		instr->nexprs == 0)
+		return;
+
+	ExplainPropertyList("JIT Compiled", compiled, es);
+
+	if (es->format == EXPLAIN_FORMAT_TEXT)
+	{
+		appendStringInfoSpaces(es->str, es->indent * 2);
+		appendStringInfo(es->str, "JIT Expressions: compiled=%d total=%d\n",
+						 instr->ncompiled_exprs, instr->nexprs);
+		appendStringInfoSpaces(es->str, es->indent * 2);
+		appendStringInfo(es->str,
+						 "JIT Calls: compiled=" UINT64_FORMAT
+						 " interpreted=" UINT64_FORMAT "\n",
+						 instr->compiled_calls, instr->interpreted_calls);
+	}
+	else
+	{
+		ExplainPropertyInteger("JIT Compiled Expressions",
+							   instr->ncompiled_exprs, es);
+		ExplainPropertyInteger("JIT Expressions", instr->nexprs, es);
+		ExplainPropertyLong("JIT Compiled Calls",
+							(long) instr->compiled_calls, es);
+		ExplainPropertyLong("JIT Interpreted Calls",
+							(long) instr->interpreted_calls, es);
+	}
+
+	list_free(compiled);
+}
+
+/*
+ * Show a summary of the query's JIT compilation: the number of functions
+ * generated and, if timing, the time spent generating, optimizing and
+ * emitting them.  Nothing is shown if nothing was JIT compiled.
+ */
+static void
+show_jit_info(JitContext *context, ExplainState *es)
+{
+	JitInstrumentation *instr;
+	instr_time	total;
+
+	if (context == NULL)
+		return;
+	instr = &context->instr;
+
+	INSTR_TIME_SET_ZERO(total);
+	INSTR_TIME_ADD(total, instr->generation_counter);
+	INSTR_TIME_ADD(total, instr->optimization_counter);
+	INSTR_TIME_ADD(total, instr->emission_counter);
+
+	if (es->format == EXPLAIN_FORMAT_TEXT)
+	{
+		appendStringInfoString(es->str, "JIT:\n");
+		appendStringInfo(es->str, "  Functions: %d\n",
+						 instr->created_functions);
+		if (es->timing)
+			appendStringInfo(es->str,
+							 "  Timing: Generation %.3f ms, Optimization %.3f ms, Emission %.3f ms, Total %.3f ms\n",
+							 INSTR_TIME_GET_MILLISEC(instr->generation_counter),
+							 INSTR_TIME_GET_MILLISEC(instr->optimization_counter),
+							 INSTR_TIME_GET_MILLISEC(instr->emission_counter),
+							 INSTR_TIME_GET_MILLISEC(total));
+	}
+	else
+	{
+		ExplainOpenGroup("JIT", "JIT", true, es);
+		ExplainPropertyInteger("Functions", instr->created_functions, es);
+		if (es->timing)
+		{
+			ExplainPropertyFloat("Generation Time",
+						 INSTR_TIME_GET_MILLISEC(instr->generation_counter),
+								 3, es);
+			ExplainPropertyFloat("Optimization Time",
+					   INSTR_TIME_GET_MILLISEC(instr->optimization_counter),
+								 3, es);
+			ExplainPropertyFloat("Emission Time",
+						   INSTR_TIME_GET_MILLISEC(instr->emission_counter),
+								 3, es);
+			ExplainPropertyFloat("Total Time",
+								 INSTR_TIME_GET_MILLISEC(total), 3, es);
+		}
+		ExplainCloseGroup("JIT", "JIT", true, es);
 	}
 }
 
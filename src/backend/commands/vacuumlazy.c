@@ -410,6 +410,9 @@ lazy_scan_heap(Relation onerel, LVRelStats *vacrelstats,
 	Buffer		vmbuffer = InvalidBuffer;
 	BlockNumber next_not_all_visible_block;
 	bool		skipping_all_visible_blocks;
+#ifdef USE_PREFETCH
+	BlockNumber prefetch_blkno = 0;
+#endif
 
 	pg_rusage_init(&ru0);
 
@@ -577,6 +580,31 @@ lazy_scan_heap(Relation onerel, LVRelStats *vacrelstats,
 		 */
 		visibilitymap_pin(onerel, blkno, &vmbuffer);
 
+#ifdef USE_PREFETCH
+
+		/*
+		 * Issue prefetch requests for the next target_prefetch_pages pages
+		 * we expect to read, so that we don't have to wait for each of them
+		 * in turn.  Pages we know we're going to skip are passed over; we
+		 * don't know yet whether we'll skip the pages beyond
+		 * next_not_all_visible_block, so those are prefetched regardless.
+		 */
+		if (prefetch_blkno <= blkno)
+			prefetch_blkno = blkno + 1;
+		while (prefetch_blkno < nblocks &&
+			   prefetch_blkno <= blkno + target_prefetch_pages)
+		{
+			if (skipping_all_visible_blocks && !scan_all &&
+				prefetch_blkno < next_not_all_visible_block)
+			{
+				prefetch_blkno = next_not_all_visible_block;
+				continue;
+			}
+			PrefetchBuffer(onerel, MAIN_FORKNUM, prefetch_blkno);
+			prefetch_blkno++;
+		}
+#endif   /* USE_PREFETCH */
+
 		buf = ReadBufferExtended(onerel, MAIN_FORKNUM, blkno,
 								 RBM_NORMAL, vac_strategy);
 
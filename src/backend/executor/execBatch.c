@@ -0,0 +1,438 @@
+/*-------------------------------------------------------------------------
+ *
+ * execBatch.c
+ *	  Support for passing rows from a scan to its parent in batches
+ *
+ * Normally every row travels through ExecProcNode, ExecScan and ExecQual on
+ * its own, and the parent node does its per-row work before asking for the
+ * next one.  For aggregation without GROUP BY directly over a sequential
+ * scan, the most common shape of analytical queries, the executor can
+ * instead run in batch mode: the scan deforms up to BATCH_SIZE rows into a
+ * TupleBatch holding only the columns needed above it, stored column-wise,
+ * and the parent processes the whole batch at once (see nodeSeqscan.c and
+ * nodeAgg.c).
+ *
+ * Quals of the form "column op constant", comparing integer, float or date
+ * columns, are evaluated over the whole batch, in tight loops narrowing a
+ * selection vector listing the rows that still qualify.  These are
+ * BatchQuals.  Other quals are evaluated for each row while the batch is
+ * filled, before the BatchQuals.  To keep the usual left-to-right evaluation
+ * order of quals, and so not raise errors in quals that the normal execution
+ * wouldn't evaluate, only quals following the last qual that can't be a
+ * BatchQual become BatchQuals.  Since the planner puts cheap quals first,
+ * that's usually either all of them or none.
+ *
+ * Portions Copyright (c) 1996-2013, PostgreSQL Global Development Group
+ *
+ *
+ * IDENTIFICATION
+ *	  src/backend/executor/execBatch.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include <math.h>
+
+#include "catalog/objectaccess.h"
+#include "catalog/pg_type.h"
+#include "executor/executor.h"
+#include "miscadmin.h"
+#include "pgstat.h"
+#include "utils/acl.h"
+#include "utils/date.h"
+#include "utils/fmgroids.h"
+#include "utils/lsyscache.h"
+
+
+/* GUC parameter */
+bool		batch_execution = true;
+
+/* number of rows in a batch */
+#define BATCH_SIZE		1024
+
+/* comparisons a BatchQual can make */
+typedef enum BatchCmp
+{
+	BATCH_CMP_LT,
+	BATCH_CMP_LE,
+	BATCH_CMP_EQ,
+	BATCH_CMP_NE,
+	BATCH_CMP_GE,
+	BATCH_CMP_GT
+} BatchCmp;
+
+/* a qual "column op constant" evaluated over whole batches */
+struct BatchQual
+{
+	AttrNumber	attno;			/* scan attribute compared */
+	Oid			typid;			/* its type, one of those in batch_ops */
+	BatchCmp	cmp;			/* comparison, with the column on the left */
+	Datum		constvalue;		/* non-null constant compared with */
+};
+
+/* operators evaluated by BatchQuals */
+typedef struct BatchOp
+{
+	Oid			opfuncid;
+	Oid			typid;			/* type of both inputs */
+	BatchCmp	cmp;
+} BatchOp;
+
+static const BatchOp batch_ops[] = {
+	{F_INT2LT, INT2OID, BATCH_CMP_LT},
+	{F_INT2LE, INT2OID, BATCH_CMP_LE},
+	{F_INT2EQ, INT2OID, BATCH_CMP_EQ},
+	{F_INT2NE, INT2OID, BATCH_CMP_NE},
+	{F_INT2GE, INT2OID, BATCH_CMP_GE},
+	{F_INT2GT, INT2OID, BATCH_CMP_GT},
+	{F_INT4LT, INT4OID, BATCH_CMP_LT},
+	{F_INT4LE, INT4OID, BATCH_CMP_LE},
+	{F_INT4EQ, INT4OID, BATCH_CMP_EQ},
+	{F_INT4NE, INT4OID, BATCH_CMP_NE},
+	{F_INT4GE, INT4OID, BATCH_CMP_GE},
+	{F_INT4GT, INT4OID, BATCH_CMP_GT},
+	{F_INT8LT, INT8OID, BATCH_CMP_LT},
+	{F_INT8LE, INT8OID, BATCH_CMP_LE},
+	{F_INT8EQ, INT8OID, BATCH_CMP_EQ},
+	{F_INT8NE, INT8OID, BATCH_CMP_NE},
+	{F_INT8GE, INT8OID, BATCH_CMP_GE},
+	{F_INT8GT, INT8OID, BATCH_CMP_GT},
+	{F_FLOAT4LT, FLOAT4OID, BATCH_CMP_LT},
+	{F_FLOAT4LE, FLOAT4OID, BATCH_CMP_LE},
+	{F_FLOAT4EQ, FLOAT4OID, BATCH_CMP_EQ},
+	{F_FLOAT4NE, FLOAT4OID, BATCH_CMP_NE},
+	{F_FLOAT4GE, FLOAT4OID, BATCH_CMP_GE},
+	{F_FLOAT4GT, FLOAT4OID, BATCH_CMP_GT},
+	{F_FLOAT8LT, FLOAT8OID, BATCH_CMP_LT},
+	{F_FLOAT8LE, FLOAT8OID, BATCH_CMP_LE},
+	{F_FLOAT8EQ, FLOAT8OID, BATCH_CMP_EQ},
+	{F_FLOAT8NE, FLOAT8OID, BATCH_CMP_NE},
+	{F_FLOAT8GE, FLOAT8OID, BATCH_CMP_GE},
+	{F_FLOAT8GT, FLOAT8OID, BATCH_CMP_GT},
+	{F_DATE_LT, DATEOID, BATCH_CMP_LT},
+	{F_DATE_LE, DATEOID, BATCH_CMP_LE},
+	{F_DATE_EQ, DATEOID, BATCH_CMP_EQ},
+	{F_DATE_NE, DATEOID, BATCH_CMP_NE},
+	{F_DATE_GE, DATEOID, BATCH_CMP_GE},
+	{F_DATE_GT, DATEOID, BATCH_CMP_GT}
+};
+
+static int batch_filter(BatchQual *bqual, Datum *values, bool *isnull,
+			 int *sel, int nsel);
+
+
+/*
+ * Create a batch holding the given scan attributes, in the current memory
+ * context.
+ */
+TupleBatch *
+ExecCreateTupleBatch(Bitmapset *attnos)
+{
+	TupleBatch *batch = (TupleBatch *) palloc0(sizeof(TupleBatch));
+	Bitmapset  *tmpset;
+	int			attno;
+	int			col;
+
+	batch->ncols = bms_num_members(attnos);
+	batch->attnos = (AttrNumber *) palloc(batch->ncols * sizeof(AttrNumber));
+	batch->values = (Datum **) palloc(batch->ncols * sizeof(Datum *));
+	batch->isnull = (bool **) palloc(batch->ncols * sizeof(bool *));
+	batch->maxrows = BATCH_SIZE;
+	batch->sel = (int *) palloc(BATCH_SIZE * sizeof(int));
+
+	col = 0;
+	tmpset = bms_copy(attnos);
+	while ((attno = bms_first_member(tmpset)) >= 0)
+	{
+		Assert(attno > 0);
+		batch->attnos[col] = attno;
+		batch->maxattno = Max(batch->maxattno, attno);
+		batch->values[col] = (Datum *) palloc(BATCH_SIZE * sizeof(Datum));
+		batch->isnull[col] = (bool *) palloc(BATCH_SIZE * sizeof(bool));
+		col++;
+	}
+	bms_free(tmpset);
+
+	return batch;
+}
+
+/*
+ * Return the column of a batch holding the given scan attribute.
+ */
+int
+ExecTupleBatchColumn(TupleBatch *batch, AttrNumber attno)
+{
+	int			col;
+
+	for (col = 0; col < batch->ncols; col++)
+	{
+		if (batch->attnos[col] == attno)
+			return col;
+	}
+
+	elog(ERROR, "attribute %d is not part of the batch", attno);
+	return -1;					/* keep compiler quiet */
+}
+
+/*
+ * Append the row stored in a scan slot to a batch.  The caller must make
+ * sure there is room.
+ */
+void
+ExecTupleBatchAddRow(TupleBatch *batch, TupleTableSlot *slot)
+{
+	int			row = batch->nrows++;
+	int			col;
+
+	Assert(row < batch->maxrows);
+
+	slot_getsomeattrs(slot, batch->maxattno);
+
+	for (col = 0; col < batch->ncols; col++)
+	{
+		int			attoff = batch->attnos[col] - 1;
+
+		batch->values[col][row] = slot->tts_values[attoff];
+		batch->isnull[col][row] = slot->tts_isnull[attoff];
+	}
+}
+
+/*
+ * Prepare a qual of a scan of relation 'scanrelid' for evaluation over
+ * batches.  Returns NULL if it can't be evaluated that way; otherwise the
+ * attribute it needs is added to *attnos.
+ */
+BatchQual *
+ExecInitBatchQual(ExprState *clause, Index scanrelid, Bitmapset **attnos)
+{
+	OpExpr	   *op = (OpExpr *) clause->expr;
+	Node	   *leftop;
+	Node	   *rightop;
+	Var		   *var;
+	Const	   *con;
+	bool		commuted;
+	const BatchOp *bop = NULL;
+	BatchQual  *bqual;
+	int			i;
+
+	if (!IsA(op, OpExpr) || list_length(op->args) != 2)
+		return NULL;
+
+	leftop = (Node *) linitial(op->args);
+	rightop = (Node *) lsecond(op->args);
+	if (IsA(leftop, Var) && IsA(rightop, Const))
+	{
+		var = (Var *) leftop;
+		con = (Const *) rightop;
+		commuted = false;
+	}
+	else if (IsA(leftop, Const) && IsA(rightop, Var))
+	{
+		var = (Var *) rightop;
+		con = (Const *) leftop;
+		commuted = true;
+	}
+	else
+		return NULL;
+
+	if (var->varno != scanrelid || var->varattno <= 0 || con->constisnull)
+		return NULL;
+
+	for (i = 0; i < lengthof(batch_ops); i++)
+	{
+		if (batch_ops[i].opfuncid == op->opfuncid)
+		{
+			bop = &batch_ops[i];
+			break;
+		}
+	}
+	if (bop == NULL || var->vartype != bop->typid ||
+		con->consttype != bop->typid || !get_typbyval(bop->typid))
+		return NULL;
+
+	/*
+	 * The operator's function isn't called, so make the checks init_fcache
+	 * would make on its first call here.  If the call would be refused or
+	 * has to be seen by someone, leave it to ExecQual.
+	 */
+	if (object_access_hook != NULL ||
+		pgstat_track_functions == TRACK_FUNC_ALL ||
+		pg_proc_aclcheck(op->opfuncid, GetUserId(), ACL_EXECUTE) != ACLCHECK_OK)
+		return NULL;
+
+	bqual = (BatchQual *) palloc(sizeof(BatchQual));
+	bqual->attno = var->varattno;
+	bqual->typid = bop->typid;
+	bqual->cmp = bop->cmp;
+	if (commuted)
+	{
+		switch (bop->cmp)
+		{
+			case BATCH_CMP_LT:
+				bqual->cmp = BATCH_CMP_GT;
+				break;
+			case BATCH_CMP_LE:
+				bqual->cmp = BATCH_CMP_GE;
+				break;
+			case BATCH_CMP_GE:
+				bqual->cmp = BATCH_CMP_LE;
+				break;
+			case BATCH_CMP_GT:
+				bqual->cmp = BATCH_CMP_LT;
+				break;
+			default:
+				break;
+		}
+	}
+	bqual->constvalue = con->constvalue;
+
+	*attnos = bms_add_member(*attnos, var->varattno);
+
+	return bqual;
+}
+
+/*
+ * Evaluate BatchQuals over all rows of a batch, setting up its selection
+ * vector.
+ */
+void
+ExecBatchQual(List *batchquals, TupleBatch *batch)
+{
+	ListCell   *lc;
+	int			row;
+
+	for (row = 0; row < batch->nrows; row++)
+		batch->sel[row] = row;
+	batch->nsel = batch->nrows;
+
+	foreach(lc, batchquals)
+	{
+		BatchQual  *bqual = (BatchQual *) lfirst(lc);
+		int			col = ExecTupleBatchColumn(batch, bqual->attno);
+
+		if (batch->nsel == 0)
+			break;
+
+		batch->nsel = batch_filter(bqual, batch->values[col],
+								   batch->isnull[col], batch->sel,
+								   batch->nsel);
+	}
+}
+
+/*
+ * Float comparisons treating NaN as equal to itself and larger than any
+ * other value, as float4_cmp_internal and float8_cmp_internal do.
+ */
+#define FLOAT_LT(a, b)	((a) < (b) || (isnan(b) && !isnan(a)))
+#define FLOAT_LE(a, b)	((a) <= (b) || isnan(b))
+#define FLOAT_EQ(a, b)	((a) == (b) || (isnan(a) && isnan(b)))
+
+/*
+ * Keep the selected rows for which 'test' holds, testing the row's value
+ * 'v'.  This is written without branches, so that it compiles to a tight
+ * loop.
+ */
+#define BATCH_FILTER(ctype, getter, test) \
+	do { \
+		for (i = 0; i < nsel; i++) \
+		{ \
+			int			row = sel[i]; \
+			ctype		v = getter(values[row]); \
+			\
+			sel[n] = row; \
+			n += (!isnull[row] & (test)); \
+		} \
+	} while (0)
+
+#define BATCH_FILTER_INT(ctype, getter) \
+	do { \
+		ctype		c = getter(bqual->constvalue); \
+		\
+		switch (bqual->cmp) \
+		{ \
+			case BATCH_CMP_LT: \
+				BATCH_FILTER(ctype, getter, v < c); \
+				break; \
+			case BATCH_CMP_LE: \
+				BATCH_FILTER(ctype, getter, v <= c); \
+				break; \
+			case BATCH_CMP_EQ: \
+				BATCH_FILTER(ctype, getter, v == c); \
+				break; \
+			case BATCH_CMP_NE: \
+				BATCH_FILTER(ctype, getter, v != c); \
+				break; \
+			case BATCH_CMP_GE: \
+				BATCH_FILTER(ctype, getter, v >= c); \
+				break; \
+			case BATCH_CMP_GT: \
+				BATCH_FILTER(ctype, getter, v > c); \
+				break; \
+		} \
+	} while (0)
+
+#define BATCH_FILTER_FLOAT(ctype, getter) \
+	do { \
+		ctype		c = getter(bqual->constvalue); \
+		\
+		switch (bqual->cmp) \
+		{ \
+			case BATCH_CMP_LT: \
+				BATCH_FILTER(ctype, getter, FLOAT_LT(v, c)); \
+				break; \
+			case BATCH_CMP_LE: \
+				BATCH_FILTER(ctype, getter, FLOAT_LE(v, c)); \
+				break; \
+			case BATCH_CMP_EQ: \
+				BATCH_FILTER(ctype, getter, FLOAT_EQ(v, c)); \
+				break; \
+			case BATCH_CMP_NE: \
+				BATCH_FILTER(ctype, getter, !FLOAT_EQ(v, c)); \
+				break; \
+			case BATCH_CMP_GE: \
+				BATCH_FILTER(ctype, getter, FLOAT_LE(c, v)); \
+				break; \
+			case BATCH_CMP_GT: \
+				BATCH_FILTER(ctype, getter, FLOAT_LT(c, v)); \
+				break; \
+		} \
+	} while (0)
+
+/*
+ * Narrow down the 'nsel' selected rows listed in 'sel' to those satisfying
+ * a BatchQual, given the values and null flags of the column it tests.
+ * Returns the number of rows left.
+ */
+static int
+batch_filter(BatchQual *bqual, Datum *values, bool *isnull, int *sel, int nsel)
+{
+	int			n = 0;
+	int			i;
+
+	switch (bqual->typid)
+	{
+		case INT2OID:
+			BATCH_FILTER_INT(int16, DatumGetInt16);
+			break;
+		case INT4OID:
+			BATCH_FILTER_INT(int32, DatumGetInt32);
+			break;
+		case INT8OID:
+			BATCH_FILTER_INT(int64, DatumGetInt64);
+			break;
+		case DATEOID:
+			BATCH_FILTER_INT(DateADT, DatumGetDateADT);
+			break;
+		case FLOAT4OID:
+			BATCH_FILTER_FLOAT(float4, DatumGetFloat4);
+			break;
+		case FLOAT8OID:
+			BATCH_FILTER_FLOAT(float8, DatumGetFloat8);
+			break;
+		default:
+			elog(ERROR, "unexpected type %u in batch qual", bqual->typid);
+	}
+
+	return n;
+}
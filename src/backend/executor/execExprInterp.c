@@ -0,0 +1,888 @@
+/*-------------------------------------------------------------------------
+ *
+ * execExprInterp.c
+ *	  Flat, non-recursive evaluation of expressions
+ *
+ * Evaluating an ExprState tree through the evalfunc of each node costs an
+ * indirect call, and usually a check for one-time work, per node and row.
+ * For the most common kinds of expressions --- comparisons and arithmetic
+ * on Vars and Consts, combined with AND, OR, NOT and NULL tests --- the tree
+ * is therefore additionally lowered into a linear array of steps.  Each step
+ * reads its input from, and writes its result to, fixed locations: the
+ * argument arrays of the FunctionCallInfoData of the function it feeds, or
+ * the result of the program.  Evaluation runs the steps one after another,
+ * with AND and OR short-circuiting by jumping ahead.
+ *
+ * Node types that have no step of their own are evaluated by handing their
+ * ExprState to the tree evaluator (EEOP_EVAL_CHILD), so that only the root of
+ * an expression decides whether a program is built at all.  The ExprState
+ * tree remains intact and usable; only the evalfunc of its root is replaced.
+ *
+ * Steps that have one-time work to do on their first execution (checking a
+ * Var's type, looking up a function) replace their own opcode by a cheaper
+ * one afterwards, just like evalfuncs in execQual.c replace themselves.
+ *
+ * With GCC-compatible compilers, steps are dispatched using computed gotos,
+ * which is noticeably faster than a switch because every opcode gets its own
+ * indirect branch, improving branch prediction.
+ *
+ * Portions Copyright (c) 1996-2013, PostgreSQL Global Development Group
+ *
+ *
+ * IDENTIFICATION
+ *	  src/backend/executor/execExprInterp.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "executor/executor.h"
+#include "miscadmin.h"
+#include "nodes/nodeFuncs.h"
+#include "pgstat.h"
+
+
+#if defined(__GNUC__)
+#define EEO_USE_COMPUTED_GOTO
+#endif
+
+/*
+ * Opcodes of expression steps.  When changing this list, also change the
+ * dispatch table in ExecInterpExpr.
+ */
+typedef enum ExprEvalOp
+{
+	/* return the program's result */
+	EEOP_DONE,
+
+	/* do nothing; left behind by EEOP_FUNCEXPR_PREPARE */
+	EEOP_NOOP,
+
+	/* fetch a user attribute, after making one-time checks */
+	EEOP_VAR_FIRST,
+	EEOP_INNER_VAR,
+	EEOP_OUTER_VAR,
+	EEOP_SCAN_VAR,
+
+	/* return a constant */
+	EEOP_CONST,
+
+	/* look up a function, before evaluating its arguments */
+	EEOP_FUNCEXPR_PREPARE,
+
+	/* call a function, looking it up first if necessary */
+	EEOP_FUNCEXPR_INIT,
+	EEOP_FUNCEXPR,
+	EEOP_FUNCEXPR_STRICT,
+	EEOP_FUNCEXPR_FUSAGE,
+
+	/* check the result of one argument of AND */
+	EEOP_BOOL_AND_STEP_FIRST,
+	EEOP_BOOL_AND_STEP,
+	EEOP_BOOL_AND_STEP_LAST,
+
+	/* check the result of one argument of OR */
+	EEOP_BOOL_OR_STEP_FIRST,
+	EEOP_BOOL_OR_STEP,
+	EEOP_BOOL_OR_STEP_LAST,
+
+	/* negate the result of NOT's argument */
+	EEOP_BOOL_NOT,
+
+	/* turn a result into the result of IS [NOT] NULL */
+	EEOP_NULLTEST_ISNULL,
+	EEOP_NULLTEST_ISNOTNULL,
+
+	/* evaluate a subexpression using the tree evaluator */
+	EEOP_EVAL_CHILD,
+
+	EEOP_LAST
+} ExprEvalOp;
+
+typedef struct ExprEvalStep
+{
+	int			opcode;			/* an ExprEvalOp */
+
+	/* where to store the result of the step */
+	Datum	   *resvalue;
+	bool	   *resnull;
+
+	union
+	{
+		/* for EEOP_*VAR* */
+		struct
+		{
+			ExprState  *state;
+			int			attnum;		/* zero-based attribute number */
+		}			var;
+
+		/* for EEOP_CONST */
+		struct
+		{
+			Datum		value;
+			bool		isnull;
+		}			constval;
+
+		/* for EEOP_FUNCEXPR* */
+		struct
+		{
+			FuncExprState *fcache;
+			FunctionCallInfo fcinfo;
+			int			nargs;
+			int			callstep;	/* index of the step calling it */
+		}			func;
+
+		/* for EEOP_BOOL_*_STEP* */
+		struct
+		{
+			bool	   *anynull;	/* did any argument yield NULL? */
+			int			jumpdone;	/* index of step following the expr */
+		}			boolexpr;
+
+		/* for EEOP_EVAL_CHILD */
+		struct
+		{
+			ExprState  *state;
+		}			child;
+	}			d;
+} ExprEvalStep;
+
+typedef struct ExprProgram
+{
+	ExprEvalStep *steps;
+	int			nsteps;
+	int			maxsteps;
+
+	/* the result of the whole expression, returned by EEOP_DONE */
+	Datum		resvalue;
+	bool		resnull;
+} ExprProgram;
+
+
+static bool ExecProgramIsWorthwhile(ExprState *state);
+static void ExecLowerExpr(ExprProgram *prog, ExprState *state,
+			  Datum *resvalue, bool *resnull);
+static void ExecLowerFunc(ExprProgram *prog, FuncExprState *fcache,
+			  Datum *resvalue, bool *resnull);
+static void ExecLowerBool(ExprProgram *prog, BoolExprState *bstate,
+			  Datum *resvalue, bool *resnull);
+static bool ExecIsSimpleArg(ExprState *state);
+static int	ExecPushStep(ExprProgram *prog, ExprEvalOp opcode,
+			 Datum *resvalue, bool *resnull);
+static ExprEvalOp ExecInterpInitFunc(ExprEvalStep *op, ExprContext *econtext);
+
+
+/*
+ * ExecBuildExprProgram
+ *
+ * Lower the ExprState tree rooted at 'state' into a program, and arrange for
+ * ExecEvalExpr to run that program, if the expression is of a kind that
+ * benefits from it.  Otherwise the state is left alone.
+ *
+ * Must be called in the memory context the ExprState tree lives in.
+ */
+void
+ExecBuildExprProgram(ExprState *state)
+{
+	ExprProgram *prog;
+
+	if (state == NULL || state->program != NULL)
+		return;
+
+	if (!ExecProgramIsWorthwhile(state))
+		return;
+
+	prog = (ExprProgram *) palloc(sizeof(ExprProgram));
+	prog->nsteps = 0;
+	prog->maxsteps = 16;
+	prog->steps = (ExprEvalStep *) palloc(prog->maxsteps * sizeof(ExprEvalStep));
+	prog->resvalue = (Datum) 0;
+	prog->resnull = true;
+
+	ExecLowerExpr(prog, state, &prog->resvalue, &prog->resnull);
+	ExecPushStep(prog, EEOP_DONE, NULL, NULL);
+
+	state->program = prog;
+	state->evalfunc = ExecInterpExpr;
+}
+
+/*
+ * Decide whether building a program for an expression is worth it.
+ *
+ * The root of the expression has to be a node that has a step of its own,
+ * otherwise the program would just call the tree evaluator.  Set-returning
+ * expressions are left to the tree evaluator, too: steps evaluate exactly
+ * one result.
+ */
+static bool
+ExecProgramIsWorthwhile(ExprState *state)
+{
+	switch (nodeTag(state->expr))
+	{
+		case T_FuncExpr:
+		case T_OpExpr:
+			if (!IsA(state, FuncExprState) ||
+				list_length(((FuncExprState *) state)->args) > FUNC_MAX_ARGS)
+				return false;
+			break;
+		case T_BoolExpr:
+			break;
+		case T_NullTest:
+			if (((NullTest *) state->expr)->argisrow)
+				return false;
+			break;
+		default:
+			return false;
+	}
+
+	return !expression_returns_set((Node *) state->expr);
+}
+
+/*
+ * Append the steps computing the value of 'state' into *resvalue and
+ * *resnull to the program.
+ */
+static void
+ExecLowerExpr(ExprProgram *prog, ExprState *state,
+			  Datum *resvalue, bool *resnull)
+{
+	ExprEvalStep *op;
+	int			stepno;
+
+	/* Guard against stack overflow due to overly complex expressions */
+	check_stack_depth();
+
+	switch (nodeTag(state->expr))
+	{
+		case T_Var:
+			{
+				Var		   *variable = (Var *) state->expr;
+
+				/* whole-row and system attributes are left to execQual.c */
+				if (nodeTag(state) != T_ExprState || variable->varattno <= 0)
+					break;
+
+				stepno = ExecPushStep(prog, EEOP_VAR_FIRST, resvalue, resnull);
+				op = &prog->steps[stepno];
+				op->d.var.state = state;
+				op->d.var.attnum = variable->varattno - 1;
+				return;
+			}
+
+		case T_Const:
+			{
+				Const	   *con = (Const *) state->expr;
+
+				stepno = ExecPushStep(prog, EEOP_CONST, resvalue, resnull);
+				op = &prog->steps[stepno];
+				op->d.constval.value = con->constvalue;
+				op->d.constval.isnull = con->constisnull;
+				return;
+			}
+
+		case T_FuncExpr:
+		case T_OpExpr:
+			if (!IsA(state, FuncExprState) ||
+				list_length(((FuncExprState *) state)->args) > FUNC_MAX_ARGS)
+				break;
+			ExecLowerFunc(prog, (FuncExprState *) state, resvalue, resnull);
+			return;
+
+		case T_BoolExpr:
+			ExecLowerBool(prog, (BoolExprState *) state, resvalue, resnull);
+			return;
+
+		case T_NullTest:
+			{
+				NullTest   *ntest = (NullTest *) state->expr;
+
+				if (ntest->argisrow)
+					break;
+
+				ExecLowerExpr(prog, ((NullTestState *) state)->arg,
+							  resvalue, resnull);
+				ExecPushStep(prog,
+							 ntest->nulltesttype == IS_NULL ?
+							 EEOP_NULLTEST_ISNULL : EEOP_NULLTEST_ISNOTNULL,
+							 resvalue, resnull);
+				return;
+			}
+
+		case T_RelabelType:
+			/* a no-op at runtime, so just compute the argument */
+			ExecLowerExpr(prog, ((GenericExprState *) state)->arg,
+						  resvalue, resnull);
+			return;
+
+		default:
+			break;
+	}
+
+	/* no step for this kind of node; use the tree evaluator */
+	stepno = ExecPushStep(prog, EEOP_EVAL_CHILD, resvalue, resnull);
+	prog->steps[stepno].d.child.state = state;
+}
+
+/*
+ * Append the steps calling a FuncExpr or OpExpr.
+ *
+ * The arguments are computed directly into the function's call info.  The
+ * fcache is set up the first time the function is called, as in the tree
+ * evaluator.  If computing the arguments might fail or have side effects,
+ * a separate step doing that precedes them, so that e.g. a permission
+ * failure is reported before anything else happens.
+ */
+static void
+ExecLowerFunc(ExprProgram *prog, FuncExprState *fcache,
+			  Datum *resvalue, bool *resnull)
+{
+	FunctionCallInfo fcinfo = &fcache->fcinfo_data;
+	int			nargs = list_length(fcache->args);
+	bool		simple = true;
+	int			preparestep = -1;
+	int			callstep;
+	int			argno;
+	ListCell   *lc;
+	ExprEvalStep *op;
+
+	foreach(lc, fcache->args)
+	{
+		if (!ExecIsSimpleArg((ExprState *) lfirst(lc)))
+		{
+			simple = false;
+			break;
+		}
+	}
+
+	if (!simple)
+		preparestep = ExecPushStep(prog, EEOP_FUNCEXPR_PREPARE, NULL, NULL);
+
+	argno = 0;
+	foreach(lc, fcache->args)
+	{
+		ExecLowerExpr(prog, (ExprState *) lfirst(lc),
+					  &fcinfo->arg[argno], &fcinfo->argnull[argno]);
+		argno++;
+	}
+
+	callstep = ExecPushStep(prog, EEOP_FUNCEXPR_INIT, resvalue, resnull);
+	op = &prog->steps[callstep];
+	op->d.func.fcache = fcache;
+	op->d.func.fcinfo = fcinfo;
+	op->d.func.nargs = nargs;
+	op->d.func.callstep = callstep;
+
+	if (preparestep >= 0)
+		prog->steps[preparestep].d.func = op->d.func;
+}
+
+/*
+ * Append the steps evaluating an AND, OR or NOT.
+ *
+ * All arguments of an AND or OR are computed into the expression's own
+ * result, each followed by a step checking it and, where that decides the
+ * result, jumping past the remaining arguments.
+ */
+static void
+ExecLowerBool(ExprProgram *prog, BoolExprState *bstate,
+			  Datum *resvalue, bool *resnull)
+{
+	BoolExpr   *boolexpr = (BoolExpr *) bstate->xprstate.expr;
+	int			nargs = list_length(bstate->args);
+	int		   *checksteps;
+	bool	   *anynull;
+	int			argno;
+	ListCell   *lc;
+
+	if (boolexpr->boolop == NOT_EXPR)
+	{
+		ExecLowerExpr(prog, (ExprState *) linitial(bstate->args),
+					  resvalue, resnull);
+		ExecPushStep(prog, EEOP_BOOL_NOT, resvalue, resnull);
+		return;
+	}
+
+	/* AND or OR of a single argument is that argument */
+	if (nargs == 1)
+	{
+		ExecLowerExpr(prog, (ExprState *) linitial(bstate->args),
+					  resvalue, resnull);
+		return;
+	}
+
+	checksteps = (int *) palloc(nargs * sizeof(int));
+	anynull = (bool *) palloc(sizeof(bool));
+
+	argno = 0;
+	foreach(lc, bstate->args)
+	{
+		ExprEvalOp	opcode;
+
+		ExecLowerExpr(prog, (ExprState *) lfirst(lc), resvalue, resnull);
+
+		if (boolexpr->boolop == AND_EXPR)
+		{
+			if (argno == 0)
+				opcode = EEOP_BOOL_AND_STEP_FIRST;
+			else if (argno == nargs - 1)
+				opcode = EEOP_BOOL_AND_STEP_LAST;
+			else
+				opcode = EEOP_BOOL_AND_STEP;
+		}
+		else
+		{
+			Assert(boolexpr->boolop == OR_EXPR);
+			if (argno == 0)
+				opcode = EEOP_BOOL_OR_STEP_FIRST;
+			else if (argno == nargs - 1)
+				opcode = EEOP_BOOL_OR_STEP_LAST;
+			else
+				opcode = EEOP_BOOL_OR_STEP;
+		}
+
+		checksteps[argno] = ExecPushStep(prog, opcode, resvalue, resnull);
+		prog->steps[checksteps[argno]].d.boolexpr.anynull = anynull;
+		argno++;
+	}
+
+	/* now that the end of the expression is known, fill in the jumps */
+	for (argno = 0; argno < nargs; argno++)
+		prog->steps[checksteps[argno]].d.boolexpr.jumpdone = prog->nsteps;
+
+	pfree(checksteps);
+}
+
+/*
+ * Is computing this argument of a function free of errors and side effects,
+ * save for the one-time checks on Vars?
+ */
+static bool
+ExecIsSimpleArg(ExprState *state)
+{
+	while (IsA(state->expr, RelabelType))
+		state = ((GenericExprState *) state)->arg;
+
+	if (IsA(state->expr, Const))
+		return true;
+	if (IsA(state->expr, Var) && nodeTag(state) == T_ExprState &&
+		((Var *) state->expr)->varattno > 0)
+		return true;
+	return false;
+}
+
+/*
+ * Append a step to the program and return its index.  The step array may
+ * move while the program is built, so steps are referred to by index.
+ */
+static int
+ExecPushStep(ExprProgram *prog, ExprEvalOp opcode,
+			 Datum *resvalue, bool *resnull)
+{
+	ExprEvalStep *op;
+
+	if (prog->nsteps >= prog->maxsteps)
+	{
+		prog->maxsteps *= 2;
+		prog->steps = (ExprEvalStep *)
+			repalloc(prog->steps, prog->maxsteps * sizeof(ExprEvalStep));
+	}
+
+	op = &prog->steps[prog->nsteps];
+	memset(op, 0, sizeof(ExprEvalStep));
+	op->opcode = opcode;
+	op->resvalue = resvalue;
+	op->resnull = resnull;
+
+	return prog->nsteps++;
+}
+
+
+/*
+ * Macros for opcode dispatch.
+ *
+ * EEO_SWITCH - just hides the switch if not in use.
+ * EEO_CASE - labels the implementation of a named opcode.
+ * EEO_DISPATCH - jump to the implementation of the step 'op'.
+ * EEO_NEXT - advance to the next step and dispatch it.
+ * EEO_JUMP - jump to the step with the given index and dispatch it.
+ */
+#if defined(EEO_USE_COMPUTED_GOTO)
+#define EEO_SWITCH()
+#define EEO_CASE(name)		CASE_##name:
+#define EEO_DISPATCH()		goto *dispatch_table[op->opcode]
+#else
+#define EEO_SWITCH()		starteval: switch ((ExprEvalOp) op->opcode)
+#define EEO_CASE(name)		case name:
+#define EEO_DISPATCH()		goto starteval
+#endif
+
+#define EEO_NEXT() \
+	do { \
+		op++; \
+		EEO_DISPATCH(); \
+	} while (0)
+
+#define EEO_JUMP(stepno) \
+	do { \
+		op = &prog->steps[stepno]; \
+		EEO_DISPATCH(); \
+	} while (0)
+
+/*
+ * ExecInterpExpr
+ *
+ * evalfunc of expressions that have been lowered into a program: run the
+ * program's steps.
+ */
+Datum
+ExecInterpExpr(ExprState *state, ExprContext *econtext,
+			   bool *isNull, ExprDoneCond *isDone)
+{
+	ExprProgram *prog = state->program;
+	ExprEvalStep *op;
+	TupleTableSlot *innerslot;
+	TupleTableSlot *outerslot;
+	TupleTableSlot *scanslot;
+
+#if defined(EEO_USE_COMPUTED_GOTO)
+	static const void *const dispatch_table[] = {
+		&&CASE_EEOP_DONE,
+		&&CASE_EEOP_NOOP,
+		&&CASE_EEOP_VAR_FIRST,
+		&&CASE_EEOP_INNER_VAR,
+		&&CASE_EEOP_OUTER_VAR,
+		&&CASE_EEOP_SCAN_VAR,
+		&&CASE_EEOP_CONST,
+		&&CASE_EEOP_FUNCEXPR_PREPARE,
+		&&CASE_EEOP_FUNCEXPR_INIT,
+		&&CASE_EEOP_FUNCEXPR,
+		&&CASE_EEOP_FUNCEXPR_STRICT,
+		&&CASE_EEOP_FUNCEXPR_FUSAGE,
+		&&CASE_EEOP_BOOL_AND_STEP_FIRST,
+		&&CASE_EEOP_BOOL_AND_STEP,
+		&&CASE_EEOP_BOOL_AND_STEP_LAST,
+		&&CASE_EEOP_BOOL_OR_STEP_FIRST,
+		&&CASE_EEOP_BOOL_OR_STEP,
+		&&CASE_EEOP_BOOL_OR_STEP_LAST,
+		&&CASE_EEOP_BOOL_NOT,
+		&&CASE_EEOP_NULLTEST_ISNULL,
+		&&CASE_EEOP_NULLTEST_ISNOTNULL,
+		&&CASE_EEOP_EVAL_CHILD
+	};
+
+	StaticAssertStmt(lengthof(dispatch_table) == EEOP_LAST,
+					 "dispatch_table out of whack with ExprEvalOp");
+#endif
+
+	if (isDone)
+		*isDone = ExprSingleResult;
+
+	innerslot = econtext->ecxt_innertuple;
+	outerslot = econtext->ecxt_outertuple;
+	scanslot = econtext->ecxt_scantuple;
+
+	op = prog->steps;
+	EEO_DISPATCH();
+
+	EEO_SWITCH()
+	{
+		EEO_CASE(EEOP_DONE)
+		{
+			*isNull = prog->resnull;
+			return prog->resvalue;
+		}
+
+		EEO_CASE(EEOP_NOOP)
+		{
+			EEO_NEXT();
+		}
+
+		EEO_CASE(EEOP_VAR_FIRST)
+		{
+			ExprState  *vstate = op->d.var.state;
+
+			/* let the tree evaluator check the Var and fetch its value */
+			*op->resvalue = ExecEvalExpr(vstate, econtext, op->resnull, NULL);
+
+			switch (((Var *) vstate->expr)->varno)
+			{
+				case INNER_VAR:
+					op->opcode = EEOP_INNER_VAR;
+					break;
+				case OUTER_VAR:
+					op->opcode = EEOP_OUTER_VAR;
+					break;
+				default:
+					op->opcode = EEOP_SCAN_VAR;
+					break;
+			}
+
+			EEO_NEXT();
+		}
+
+		EEO_CASE(EEOP_INNER_VAR)
+		{
+			int			attnum = op->d.var.attnum;
+
+			if (attnum < innerslot->tts_nvalid)
+			{
+				*op->resvalue = innerslot->tts_values[attnum];
+				*op->resnull = innerslot->tts_isnull[attnum];
+			}
+			else
+				*op->resvalue = slot_getattr(innerslot, attnum + 1,
+											 op->resnull);
+
+			EEO_NEXT();
+		}
+
+		EEO_CASE(EEOP_OUTER_VAR)
+		{
+			int			attnum = op->d.var.attnum;
+
+			if (attnum < outerslot->tts_nvalid)
+			{
+				*op->resvalue = outerslot->tts_values[attnum];
+				*op->resnull = outerslot->tts_isnull[attnum];
+			}
+			else
+				*op->resvalue = slot_getattr(outerslot, attnum + 1,
+											 op->resnull);
+
+			EEO_NEXT();
+		}
+
+		EEO_CASE(EEOP_SCAN_VAR)
+		{
+			int			attnum = op->d.var.attnum;
+
+			if (attnum < scanslot->tts_nvalid)
+			{
+				*op->resvalue = scanslot->tts_values[attnum];
+				*op->resnull = scanslot->tts_isnull[attnum];
+			}
+			else
+				*op->resvalue = slot_getattr(scanslot, attnum + 1,
+											 op->resnull);
+
+			EEO_NEXT();
+		}
+
+		EEO_CASE(EEOP_CONST)
+		{
+			*op->resvalue = op->d.constval.value;
+			*op->resnull = op->d.constval.isnull;
+
+			EEO_NEXT();
+		}
+
+		EEO_CASE(EEOP_FUNCEXPR_PREPARE)
+		{
+			ExprEvalStep *call = &prog->steps[op->d.func.callstep];
+
+			call->opcode = ExecInterpInitFunc(call, econtext);
+			op->opcode = EEOP_NOOP;
+
+			EEO_NEXT();
+		}
+
+		EEO_CASE(EEOP_FUNCEXPR_INIT)
+		{
+			/* set up the fcache, then dispatch to the actual call */
+			op->opcode = ExecInterpInitFunc(op, econtext);
+
+			EEO_DISPATCH();
+		}
+
+		EEO_CASE(EEOP_FUNCEXPR)
+		{
+			FunctionCallInfo fcinfo = op->d.func.fcinfo;
+
+			fcinfo->isnull = false;
+			*op->resvalue = FunctionCallInvoke(fcinfo);
+			*op->resnull = fcinfo->isnull;
+
+			EEO_NEXT();
+		}
+
+		EEO_CASE(EEOP_FUNCEXPR_STRICT)
+		{
+			FunctionCallInfo fcinfo = op->d.func.fcinfo;
+			int			argno;
+
+			/* a strict function returns NULL if any argument is NULL */
+			for (argno = 0; argno < op->d.func.nargs; argno++)
+			{
+				if (fcinfo->argnull[argno])
+				{
+					*op->resvalue = (Datum) 0;
+					*op->resnull = true;
+					EEO_NEXT();
+				}
+			}
+
+			fcinfo->isnull = false;
+			*op->resvalue = FunctionCallInvoke(fcinfo);
+			*op->resnull = fcinfo->isnull;
+
+			EEO_NEXT();
+		}
+
+		EEO_CASE(EEOP_FUNCEXPR_FUSAGE)
+		{
+			FunctionCallInfo fcinfo = op->d.func.fcinfo;
+			PgStat_FunctionCallUsage fcusage;
+			int			argno;
+
+			if (fcinfo->flinfo->fn_strict)
+			{
+				for (argno = 0; argno < op->d.func.nargs; argno++)
+				{
+					if (fcinfo->argnull[argno])
+					{
+						*op->resvalue = (Datum) 0;
+						*op->resnull = true;
+						EEO_NEXT();
+					}
+				}
+			}
+
+			pgstat_init_function_usage(fcinfo, &fcusage);
+
+			fcinfo->isnull = false;
+			*op->resvalue = FunctionCallInvoke(fcinfo);
+			*op->resnull = fcinfo->isnull;
+
+			pgstat_end_function_usage(&fcusage, true);
+
+			EEO_NEXT();
+		}
+
+		EEO_CASE(EEOP_BOOL_AND_STEP_FIRST)
+		{
+			*op->d.boolexpr.anynull = false;
+
+			/* FALL THRU to check the first argument like the others */
+		}
+
+		EEO_CASE(EEOP_BOOL_AND_STEP)
+		{
+			if (*op->resnull)
+				*op->d.boolexpr.anynull = true;
+			else if (!DatumGetBool(*op->resvalue))
+			{
+				/* result is already FALSE, skip the remaining arguments */
+				EEO_JUMP(op->d.boolexpr.jumpdone);
+			}
+
+			EEO_NEXT();
+		}
+
+		EEO_CASE(EEOP_BOOL_AND_STEP_LAST)
+		{
+			/*
+			 * A FALSE or NULL last argument is the result as is; if it is
+			 * TRUE, the result is NULL if any of the others was NULL.
+			 */
+			if (!*op->resnull && DatumGetBool(*op->resvalue) &&
+				*op->d.boolexpr.anynull)
+			{
+				*op->resvalue = (Datum) 0;
+				*op->resnull = true;
+			}
+
+			EEO_NEXT();
+		}
+
+		EEO_CASE(EEOP_BOOL_OR_STEP_FIRST)
+		{
+			*op->d.boolexpr.anynull = false;
+
+			/* FALL THRU to check the first argument like the others */
+		}
+
+		EEO_CASE(EEOP_BOOL_OR_STEP)
+		{
+			if (*op->resnull)
+				*op->d.boolexpr.anynull = true;
+			else if (DatumGetBool(*op->resvalue))
+			{
+				/* result is already TRUE, skip the remaining arguments */
+				EEO_JUMP(op->d.boolexpr.jumpdone);
+			}
+
+			EEO_NEXT();
+		}
+
+		EEO_CASE(EEOP_BOOL_OR_STEP_LAST)
+		{
+			/*
+			 * A TRUE or NULL last argument is the result as is; if it is
+			 * FALSE, the result is NULL if any of the others was NULL.
+			 */
+			if (!*op->resnull && !DatumGetBool(*op->resvalue) &&
+				*op->d.boolexpr.anynull)
+			{
+				*op->resvalue = (Datum) 0;
+				*op->resnull = true;
+			}
+
+			EEO_NEXT();
+		}
+
+		EEO_CASE(EEOP_BOOL_NOT)
+		{
+			/* NOT NULL is NULL */
+			if (!*op->resnull)
+				*op->resvalue = BoolGetDatum(!DatumGetBool(*op->resvalue));
+
+			EEO_NEXT();
+		}
+
+		EEO_CASE(EEOP_NULLTEST_ISNULL)
+		{
+			*op->resvalue = BoolGetDatum(*op->resnull);
+			*op->resnull = false;
+
+			EEO_NEXT();
+		}
+
+		EEO_CASE(EEOP_NULLTEST_ISNOTNULL)
+		{
+			*op->resvalue = BoolGetDatum(!*op->resnull);
+			*op->resnull = false;
+
+			EEO_NEXT();
+		}
+
+		EEO_CASE(EEOP_EVAL_CHILD)
+		{
+			*op->resvalue = ExecEvalExpr(op->d.child.state, econtext,
+										 op->resnull, NULL);
+
+			EEO_NEXT();
+		}
+	}
+
+	/* only reached with an unknown opcode if not using computed gotos */
+	elog(ERROR, "unrecognized expression step opcode: %d", op->opcode);
+	return (Datum) 0;			/* keep compiler quiet */
+}
+
+/*
+ * Set up the fcache of the function called by step 'op', and return the
+ * opcode to call it with from now on.
+ */
+static ExprEvalOp
+ExecInterpInitFunc(ExprEvalStep *op, ExprContext *econtext)
+{
+	FuncExprState *fcache = op->d.func.fcache;
+
+	ExecInitFuncCache(fcache, econtext);
+
+	if (pgstat_track_functions > fcache->func.fn_stats)
+		return EEOP_FUNCEXPR_FUSAGE;
+	if (fcache->func.fn_strict && op->d.func.nargs > 0)
+		return EEOP_FUNCEXPR_STRICT;
+	return EEOP_FUNCEXPR;
+}
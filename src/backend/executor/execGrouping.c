@@ -24,11 +24,16 @@
 #include "utils/memutils.h"
 
 
-static TupleHashTable CurTupleHashTable = NULL;
+/* initial and minimum number of buckets of a TupleHashTable */
+#define TUPLEHASH_MIN_BUCKETS	16
 
-static uint32 TupleHashTableHash(const void *key, Size keysize);
-static int TupleHashTableMatch(const void *key1, const void *key2,
-					Size keysize);
+/* amount of space to allocate for new TupleHashTable entries at a time */
+#define TUPLEHASH_ENTRY_ALLOC	8192
+
+static TupleHashBucketData *TupleHashTableProbe(TupleHashTable hashtable,
+					TupleTableSlot *slot, uint32 hash,
+					FmgrInfo *eqfunctions);
+static void TupleHashTableGrow(TupleHashTable hashtable);
 
 
 /*****************************************************************************
@@ -251,6 +256,12 @@ execTuplesHashPrepare(int numCols,
  * These routines build hash tables for grouping tuples together (eg, for
  * hash aggregation).  There is one entry for each not-distinct set of tuples
  * presented.
+ *
+ * Rather than dynahash, the tables use open addressing with linear probing:
+ * lookups are the hot spot of hash aggregation and the like, and walking a
+ * bucket array that has the hash values inline costs far fewer cache misses
+ * than following dynahash's chains, which have to be compared through
+ * callbacks.  The table is doubled in size once it is three quarters full.
  *****************************************************************************/
 
 /*
@@ -279,7 +290,7 @@ BuildTupleHashTable(int numCols, AttrNumber *keyColIdx,
 					MemoryContext tablecxt, MemoryContext tempcxt)
 {
 	TupleHashTable hashtable;
-	HASHCTL		hash_ctl;
+	uint32		size;
 
 	Assert(nbuckets > 0);
 	Assert(entrysize >= sizeof(TupleHashEntryData));
@@ -287,30 +298,31 @@ BuildTupleHashTable(int numCols, AttrNumber *keyColIdx,
 	/* Limit initial table size request to not more than work_mem */
 	nbuckets = Min(nbuckets, (long) ((work_mem * 1024L) / entrysize));
 
+	/* Make the table big enough to hold that many entries */
+	size = TUPLEHASH_MIN_BUCKETS;
+	while (size - size / 4 < nbuckets &&
+		   (Size) size * 2 * sizeof(TupleHashBucketData) <= MaxAllocSize)
+		size *= 2;
+
 	hashtable = (TupleHashTable) MemoryContextAlloc(tablecxt,
 												 sizeof(TupleHashTableData));
 
+	hashtable->buckets = (TupleHashBucketData *)
+		MemoryContextAllocZero(tablecxt, size * sizeof(TupleHashBucketData));
+	hashtable->nbuckets = size;
+	hashtable->nentries = 0;
+	hashtable->growthreshold = size - size / 4;
 	hashtable->numCols = numCols;
 	hashtable->keyColIdx = keyColIdx;
 	hashtable->tab_hash_funcs = hashfunctions;
 	hashtable->tab_eq_funcs = eqfunctions;
 	hashtable->tablecxt = tablecxt;
 	hashtable->tempcxt = tempcxt;
-	hashtable->entrysize = entrysize;
+	hashtable->entrysize = MAXALIGN(entrysize);
+	hashtable->freeentries = NULL;
+	hashtable->nfreeentries = 0;
+	hashtable->freelist = NULL;
 	hashtable->tableslot = NULL;	/* will be made on first lookup */
-	hashtable->inputslot = NULL;
-	hashtable->in_hash_funcs = NULL;
-	hashtable->cur_eq_funcs = NULL;
-
-	MemSet(&hash_ctl, 0, sizeof(hash_ctl));
-	hash_ctl.keysize = sizeof(TupleHashEntryData);
-	hash_ctl.entrysize = entrysize;
-	hash_ctl.hash = TupleHashTableHash;
-	hash_ctl.match = TupleHashTableMatch;
-	hash_ctl.hcxt = tablecxt;
-	hashtable->hashtab = hash_create("TupleHashTable", nbuckets,
-									 &hash_ctl,
-					HASH_ELEM | HASH_FUNCTION | HASH_COMPARE | HASH_CONTEXT);
 
 	return hashtable;
 }
@@ -331,11 +343,10 @@ TupleHashEntry
 LookupTupleHashEntry(TupleHashTable hashtable, TupleTableSlot *slot,
 					 bool *isnew)
 {
+	TupleHashBucketData *bucket;
 	TupleHashEntry entry;
 	MemoryContext oldContext;
-	TupleHashTable saveCurHT;
-	TupleHashEntryData dummy;
-	bool		found;
+	uint32		hash;
 
 	/* If first time through, clone the input slot to make table slot */
 	if (hashtable->tableslot == NULL)
@@ -356,54 +367,63 @@ LookupTupleHashEntry(TupleHashTable hashtable, TupleTableSlot *slot,
 	/* Need to run the hash functions in short-lived context */
 	oldContext = MemoryContextSwitchTo(hashtable->tempcxt);
 
-	/*
-	 * Set up data needed by hash and match functions
-	 *
-	 * We save and restore CurTupleHashTable just in case someone manages to
-	 * invoke this code re-entrantly.
-	 */
-	hashtable->inputslot = slot;
-	hashtable->in_hash_funcs = hashtable->tab_hash_funcs;
-	hashtable->cur_eq_funcs = hashtable->tab_eq_funcs;
-
-	saveCurHT = CurTupleHashTable;
-	CurTupleHashTable = hashtable;
-
-	/* Search the hash table */
-	dummy.firstTuple = NULL;	/* flag to reference inputslot */
-	entry = (TupleHashEntry) hash_search(hashtable->hashtab,
-										 &dummy,
-										 isnew ? HASH_ENTER : HASH_FIND,
-										 &found);
+	hash = TupleHashTableHash(hashtable, slot, hashtable->tab_hash_funcs);
+	bucket = TupleHashTableProbe(hashtable, slot, hash,
+								 hashtable->tab_eq_funcs);
+	entry = bucket->entry;
 
 	if (isnew)
 	{
-		if (found)
+		if (entry != NULL)
 		{
 			/* found pre-existing entry */
 			*isnew = false;
 		}
 		else
 		{
-			/*
-			 * created new entry
-			 *
-			 * Zero any caller-requested space in the entry.  (This zaps the
-			 * "key data" dynahash.c copied into the new entry, but we don't
-			 * care since we're about to overwrite it anyway.)
-			 */
+			/* make room first if the table is getting too full */
+			if (hashtable->nentries >= hashtable->growthreshold)
+			{
+				TupleHashTableGrow(hashtable);
+				bucket = TupleHashTableProbe(hashtable, slot, hash, NULL);
+			}
+
+			MemoryContextSwitchTo(hashtable->tablecxt);
+
+			if (hashtable->freelist != NULL)
+			{
+				/* reuse the space of a removed entry */
+				entry = hashtable->freelist;
+				hashtable->freelist = (TupleHashEntry) entry->firstTuple;
+			}
+			else
+			{
+				if (hashtable->nfreeentries == 0)
+				{
+					hashtable->nfreeentries =
+						Max(TUPLEHASH_ENTRY_ALLOC / hashtable->entrysize, 1);
+					hashtable->freeentries =
+						palloc(hashtable->nfreeentries * hashtable->entrysize);
+				}
+				entry = (TupleHashEntry) hashtable->freeentries;
+				hashtable->freeentries += hashtable->entrysize;
+				hashtable->nfreeentries--;
+			}
+
+			/* Zero any caller-requested space in the entry */
 			MemSet(entry, 0, hashtable->entrysize);
 
 			/* Copy the first tuple into the table context */
-			MemoryContextSwitchTo(hashtable->tablecxt);
 			entry->firstTuple = ExecCopySlotMinimalTuple(slot);
 
+			bucket->hash = hash;
+			bucket->entry = entry;
+			hashtable->nentries++;
+
 			*isnew = true;
 		}
 	}
 
-	CurTupleHashTable = saveCurHT;
-
 	MemoryContextSwitchTo(oldContext);
 
 	return entry;
@@ -425,82 +445,112 @@ FindTupleHashEntry(TupleHashTable hashtable, TupleTableSlot *slot,
 {
 	TupleHashEntry entry;
 	MemoryContext oldContext;
-	TupleHashTable saveCurHT;
-	TupleHashEntryData dummy;
+	uint32		hash;
 
 	/* Need to run the hash functions in short-lived context */
 	oldContext = MemoryContextSwitchTo(hashtable->tempcxt);
 
+	hash = TupleHashTableHash(hashtable, slot, hashfunctions);
+	entry = TupleHashTableProbe(hashtable, slot, hash, eqfunctions)->entry;
+
+	MemoryContextSwitchTo(oldContext);
+
+	return entry;
+}
+
+/*
+ * Remove an entry from a hashtable.
+ *
+ * The entry's copy of its first tuple is freed, and the entry's space is
+ * kept for reuse by the next entry created; any additional data the caller
+ * keeps in the entry must be freed by the caller beforehand.  No scan may be
+ * in progress.
+ */
+void
+RemoveTupleHashEntry(TupleHashTable hashtable, TupleHashEntry entry)
+{
+	TupleHashBucketData *buckets = hashtable->buckets;
+	uint32		mask = hashtable->nbuckets - 1;
+	MemoryContext oldContext;
+	uint32		hash;
+	uint32		i;
+	uint32		j;
+
+	/* Find the entry's bucket by searching from where its hash value maps */
+	oldContext = MemoryContextSwitchTo(hashtable->tempcxt);
+	ExecStoreMinimalTuple(entry->firstTuple, hashtable->tableslot, false);
+	hash = TupleHashTableHash(hashtable, hashtable->tableslot,
+							  hashtable->tab_hash_funcs);
+	ExecClearTuple(hashtable->tableslot);
+	MemoryContextSwitchTo(oldContext);
+
+	for (i = hash & mask; buckets[i].entry != entry; i = (i + 1) & mask)
+		Assert(buckets[i].entry != NULL);
+
 	/*
-	 * Set up data needed by hash and match functions
-	 *
-	 * We save and restore CurTupleHashTable just in case someone manages to
-	 * invoke this code re-entrantly.
+	 * Emptying the bucket would cut short the search for entries placed
+	 * beyond it, so move such entries back into the hole, as long as that
+	 * doesn't put them before their own hash value's bucket.  Then the hole
+	 * is where the last entry moved back came from.
 	 */
-	hashtable->inputslot = slot;
-	hashtable->in_hash_funcs = hashfunctions;
-	hashtable->cur_eq_funcs = eqfunctions;
+	for (j = (i + 1) & mask; buckets[j].entry != NULL; j = (j + 1) & mask)
+	{
+		uint32		home = buckets[j].hash & mask;
 
-	saveCurHT = CurTupleHashTable;
-	CurTupleHashTable = hashtable;
+		if (((j - home) & mask) >= ((j - i) & mask))
+		{
+			buckets[i] = buckets[j];
+			i = j;
+		}
+	}
+	buckets[i].entry = NULL;
+	hashtable->nentries--;
 
-	/* Search the hash table */
-	dummy.firstTuple = NULL;	/* flag to reference inputslot */
-	entry = (TupleHashEntry) hash_search(hashtable->hashtab,
-										 &dummy,
-										 HASH_FIND,
-										 NULL);
+	/* The free list is linked through the entries' firstTuple fields */
+	pfree(entry->firstTuple);
+	entry->firstTuple = (MinimalTuple) hashtable->freelist;
+	hashtable->freelist = entry;
+}
 
-	CurTupleHashTable = saveCurHT;
+/*
+ * Return the next entry of a scan of a hashtable, or NULL at the end.
+ */
+TupleHashEntry
+ScanTupleHashTable(TupleHashIterator *iter)
+{
+	TupleHashTable hashtable = iter->hashtable;
 
-	MemoryContextSwitchTo(oldContext);
+	while (iter->curbucket < hashtable->nbuckets)
+	{
+		TupleHashEntry entry = hashtable->buckets[iter->curbucket++].entry;
 
-	return entry;
+		if (entry != NULL)
+			return entry;
+	}
+
+	return NULL;
 }
 
 /*
  * Compute the hash value for a tuple
  *
- * The passed-in key is a pointer to TupleHashEntryData.  In an actual hash
- * table entry, the firstTuple field points to a tuple (in MinimalTuple
- * format).  LookupTupleHashEntry sets up a dummy TupleHashEntryData with a
- * NULL firstTuple field --- that cues us to look at the inputslot instead.
- * This convention avoids the need to materialize virtual input tuples unless
- * they actually need to get copied into the table.
+ * The key columns of the table are hashed using the given hash functions,
+ * which are the table's own ones unless the tuple is of a different type
+ * (see FindTupleHashEntry).  This is exported so that callers distributing
+ * tuples to several hash tables can agree with the tables on the hashing.
  *
- * CurTupleHashTable must be set before calling this, since dynahash.c
- * doesn't provide any API that would let us get at the hashtable otherwise.
- *
- * Also, the caller must select an appropriate memory context for running
- * the hash functions. (dynahash.c doesn't change CurrentMemoryContext.)
+ * The caller must select an appropriate memory context for running the
+ * hash functions.
  */
-static uint32
-TupleHashTableHash(const void *key, Size keysize)
+uint32
+TupleHashTableHash(TupleHashTable hashtable, TupleTableSlot *slot,
+				   FmgrInfo *hashfunctions)
 {
-	MinimalTuple tuple = ((const TupleHashEntryData *) key)->firstTuple;
-	TupleTableSlot *slot;
-	TupleHashTable hashtable = CurTupleHashTable;
 	int			numCols = hashtable->numCols;
 	AttrNumber *keyColIdx = hashtable->keyColIdx;
-	FmgrInfo   *hashfunctions;
 	uint32		hashkey = 0;
 	int			i;
 
-	if (tuple == NULL)
-	{
-		/* Process the current input tuple for the table */
-		slot = hashtable->inputslot;
-		hashfunctions = hashtable->in_hash_funcs;
-	}
-	else
-	{
-		/* Process a tuple already stored in the table */
-		/* (this case never actually occurs in current dynahash.c code) */
-		slot = hashtable->tableslot;
-		ExecStoreMinimalTuple(tuple, slot, false);
-		hashfunctions = hashtable->tab_hash_funcs;
-	}
-
 	for (i = 0; i < numCols; i++)
 	{
 		AttrNumber	att = keyColIdx[i];
@@ -526,48 +576,98 @@ TupleHashTableHash(const void *key, Size keysize)
 }
 
 /*
- * See whether two tuples (presumably of the same hash value) match
+ * Find the bucket holding the entry the given tuple belongs to, or if
+ * there's none, the empty bucket where such an entry is to be put.
  *
- * As above, the passed pointers are pointers to TupleHashEntryData.
+ * Only entries with the same hash value are compared to the tuple, using
+ * the given equality functions.  If eqfunctions is NULL, the tuple is known
+ * not to be in the table, and the first free bucket is returned.
  *
- * CurTupleHashTable must be set before calling this, since dynahash.c
- * doesn't provide any API that would let us get at the hashtable otherwise.
+ * The caller must select an appropriate memory context for running the
+ * compare functions.
+ */
+static TupleHashBucketData *
+TupleHashTableProbe(TupleHashTable hashtable, TupleTableSlot *slot,
+					uint32 hash, FmgrInfo *eqfunctions)
+{
+	TupleHashBucketData *buckets = hashtable->buckets;
+	uint32		mask = hashtable->nbuckets - 1;
+	uint32		i;
+
+	/* there's always at least one empty bucket, which ends the search */
+	for (i = hash & mask;; i = (i + 1) & mask)
+	{
+		TupleHashBucketData *bucket = &buckets[i];
+
+		if (bucket->entry == NULL)
+			return bucket;
+
+		if (bucket->hash == hash && eqfunctions != NULL)
+		{
+			TupleTableSlot *tableslot = hashtable->tableslot;
+
+			ExecStoreMinimalTuple(bucket->entry->firstTuple, tableslot, false);
+
+			/* For crosstype comparisons, the inputslot must be first */
+			if (execTuplesMatch(slot,
+								tableslot,
+								hashtable->numCols,
+								hashtable->keyColIdx,
+								eqfunctions,
+								hashtable->tempcxt))
+				return bucket;
+		}
+	}
+}
+
+/*
+ * Double the number of buckets of a hashtable that got too full.
  *
- * Also, the caller must select an appropriate memory context for running
- * the compare functions.  (dynahash.c doesn't change CurrentMemoryContext.)
+ * If the bucket array can't get any larger, the table is allowed to fill up
+ * until only one bucket is left empty.
  */
-static int
-TupleHashTableMatch(const void *key1, const void *key2, Size keysize)
+static void
+TupleHashTableGrow(TupleHashTable hashtable)
 {
-	MinimalTuple tuple1 = ((const TupleHashEntryData *) key1)->firstTuple;
+	TupleHashBucketData *oldbuckets = hashtable->buckets;
+	TupleHashBucketData *newbuckets;
+	uint32		oldsize = hashtable->nbuckets;
+	uint32		newsize = oldsize * 2;
+	uint32		mask = newsize - 1;
+	uint32		i;
+
+	if ((Size) newsize * sizeof(TupleHashBucketData) > MaxAllocSize)
+	{
+		if (hashtable->nentries >= oldsize - 1)
+			ereport(ERROR,
+					(errcode(ERRCODE_PROGRAM_LIMIT_EXCEEDED),
+					 errmsg("hash table cannot hold more than %u entries",
+							oldsize - 1)));
+		hashtable->growthreshold = oldsize - 1;
+		return;
+	}
 
-#ifdef USE_ASSERT_CHECKING
-	MinimalTuple tuple2 = ((const TupleHashEntryData *) key2)->firstTuple;
-#endif
-	TupleTableSlot *slot1;
-	TupleTableSlot *slot2;
-	TupleHashTable hashtable = CurTupleHashTable;
+	newbuckets = (TupleHashBucketData *)
+		MemoryContextAllocZero(hashtable->tablecxt,
+							   newsize * sizeof(TupleHashBucketData));
 
-	/*
-	 * We assume that dynahash.c will only ever call us with the first
-	 * argument being an actual table entry, and the second argument being
-	 * LookupTupleHashEntry's dummy TupleHashEntryData.  The other direction
-	 * could be supported too, but is not currently used by dynahash.c.
-	 */
-	Assert(tuple1 != NULL);
-	slot1 = hashtable->tableslot;
-	ExecStoreMinimalTuple(tuple1, slot1, false);
-	Assert(tuple2 == NULL);
-	slot2 = hashtable->inputslot;
-
-	/* For crosstype comparisons, the inputslot must be first */
-	if (execTuplesMatch(slot2,
-						slot1,
-						hashtable->numCols,
-						hashtable->keyColIdx,
-						hashtable->cur_eq_funcs,
-						hashtable->tempcxt))
-		return 0;
-	else
-		return 1;
+	for (i = 0; i < oldsize; i++)
+	{
+		uint32		j;
+
+		if (oldbuckets[i].entry == NULL)
+			continue;
+
+		for (j = oldbuckets[i].hash & mask;
+			 newbuckets[j].entry != NULL;
+			 j = (j + 1) & mask)
+			;
+		newbuckets[j] = oldbuckets[i];
+	}
+
+	pfree(oldbuckets);
+
+	hashtable->buckets = newbuckets;
+	hashtable->nbuckets = newsize;
+	hashtable->growthreshold = newsize - newsize / 4;
 }
@@ -45,6 +45,7 @@
 #include "commands/trigger.h"
 #include "executor/execdebug.h"
 #include "foreign/fdwapi.h"
+#include "jit/jit.h"
 #include "mb/pg_wchar.h"
 #include "miscadmin.h"
 #include "optimizer/clauses.h"
@@ -790,6 +791,7 @@ InitPlan(QueryDesc *queryDesc, int eflags)
 	 */
 	estate->es_range_table = rangeTable;
 	estate->es_plannedstmt = plannedstmt;
+	estate->es_jit_flags = jit_flags_for_plan(plannedstmt);
 
 	/*
 	 * initialize result relation stuff, and open/lock the result rels.
@@ -2381,6 +2383,7 @@ EvalPlanQualStart(EPQState *epqstate, EState *parentestate, Plan *planTree)
 	/* es_trig_target_relations must NOT be copied */
 	estate->es_rowMarks = parentestate->es_rowMarks;
 	estate->es_top_eflags = parentestate->es_top_eflags;
+	estate->es_jit_flags = parentestate->es_jit_flags;
 	estate->es_instrument = parentestate->es_instrument;
 	/* es_auxmodifytables must NOT be copied */
 
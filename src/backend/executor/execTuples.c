@@ -129,6 +129,8 @@ MakeTupleTableSlot(void)
 	slot->tts_values = NULL;
 	slot->tts_isnull = NULL;
 	slot->tts_mintuple = NULL;
+	slot->tts_deform = NULL;
+	slot->tts_deform_arg = NULL;
 
 	return slot;
 }
@@ -277,6 +279,10 @@ ExecSetSlotDescriptor(TupleTableSlot *slot,		/* slot to change */
 	slot->tts_tupleDescriptor = tupdesc;
 	PinTupleDesc(tupdesc);
 
+	/* a deforming routine generated for the old descriptor is of no use */
+	slot->tts_deform = NULL;
+	slot->tts_deform_arg = NULL;
+
 	/*
 	 * Allocate Datum/isnull arrays of the appropriate size.  These must have
 	 * the same lifetime as the slot, so allocate in the slot's own context.
@@ -46,6 +46,7 @@
 #include "access/transam.h"
 #include "catalog/index.h"
 #include "executor/execdebug.h"
+#include "jit/jit.h"
 #include "nodes/nodeFuncs.h"
 #include "parser/parsetree.h"
 #include "storage/lmgr.h"
@@ -151,6 +152,9 @@ CreateExecutorState(void)
 	estate->es_epqTupleSet = NULL;
 	estate->es_epqScanDone = NULL;
 
+	estate->es_jit_flags = 0;
+	estate->es_jit_context = NULL;
+
 	/*
 	 * Return the executor state structure
 	 */
@@ -194,6 +198,13 @@ FreeExecutorState(EState *estate)
 		/* FreeExprContext removed the list link for us */
 	}
 
+	/* release the JIT context, if any, along with its generated code */
+	if (estate->es_jit_context != NULL)
+	{
+		jit_release_context(estate->es_jit_context);
+		estate->es_jit_context = NULL;
+	}
+
 	/*
 	 * Free the per-query memory context, thereby releasing all working
 	 * memory, including the EState node itself.
@@ -62,6 +62,34 @@
  *	  nominal transition value; they can use the memory context returned by
  *	  AggCheckCallContext() to do that.
  *
+ *	  Plain aggregation directly over a sequential scan can run in batch
+ *	  mode (see executor/execBatch.c), if all aggregates are simple ones over
+ *	  columns of the scanned relation, like count(), and sum(), min() and
+ *	  max() of integers and floats.  The scan then returns batches of rows,
+ *	  and instead of calling the transition functions, agg_retrieve_batch
+ *	  advances the transition values over the rows of a batch in tight
+ *	  loops, with the same results.
+ *
+ *	  In AGG_HASHED mode, we stop adding groups to the hash table once its
+ *	  estimated size exceeds work_mem.  Input tuples of groups that are in
+ *	  the table already are still aggregated right away, but the others are
+ *	  partitioned by hash value into temporary files (batches).  Once the
+ *	  input is exhausted and the groups in the table have been returned, the
+ *	  table is emptied and each batch is aggregated in turn in the same way,
+ *	  spilling into new batches again if necessary.  Each pass completes at
+ *	  least one group, and the partitioning uses different hash bits at
+ *	  each level, so this always finishes.  Transition values are never
+ *	  spilled, just input tuples.
+ *
+ *	  Aggregates that have a combine function in pg_aggregate, which merges
+ *	  two transition values into one, can also be computed in two phases:
+ *	  if plain aggregation directly over a sequential scan gets help from
+ *	  scan workers (see postmaster/scanworker.c), each worker advances its
+ *	  own transition values over the tuples it scans, and sends them to us
+ *	  at the end instead of the tuples.  We then combine them into ours
+ *	  before running the final functions.  A worker's aggregation is run by
+ *	  an Agg node without an outer plan (see ExecInitPartialAgg).
+ *
  *	  Note: AggCheckCallContext() is available as of PostgreSQL 9.0.  The
  *	  AggState is available as context in earlier releases (back to 8.1),
  *	  but direct examination of the node is needed to use it before 9.0.
@@ -78,6 +106,9 @@
 
 #include "postgres.h"
 
+#include <math.h>
+
+#include "access/hash.h"
 #include "access/htup_details.h"
 #include "catalog/objectaccess.h"
 #include "catalog/pg_aggregate.h"
@@ -85,14 +116,20 @@
 #include "catalog/pg_type.h"
 #include "executor/executor.h"
 #include "executor/nodeAgg.h"
+#include "executor/nodeSeqscan.h"
 #include "miscadmin.h"
+#include "nodes/makefuncs.h"
 #include "nodes/nodeFuncs.h"
 #include "optimizer/clauses.h"
 #include "optimizer/tlist.h"
 #include "parser/parse_agg.h"
 #include "parser/parse_coerce.h"
+#include "parser/parsetree.h"
+#include "postmaster/scanworker.h"
+#include "storage/buffile.h"
 #include "utils/acl.h"
 #include "utils/builtins.h"
+#include "utils/fmgroids.h"
 #include "utils/lsyscache.h"
 #include "utils/memutils.h"
 #include "utils/syscache.h"
@@ -100,144 +137,6 @@
 #include "utils/datum.h"
 
 
-/*
- * AggStatePerAggData - per-aggregate working state for the Agg scan
- */
-typedef struct AggStatePerAggData
-{
-	/*
-	 * These values are set up during ExecInitAgg() and do not change
-	 * thereafter:
-	 */
-
-	/* Links to Aggref expr and state nodes this working state is for */
-	AggrefExprState *aggrefstate;
-	Aggref	   *aggref;
-
-	/* number of input arguments for aggregate function proper */
-	int			numArguments;
-
-	/* number of inputs including ORDER BY expressions */
-	int			numInputs;
-
-	/* Oids of transfer functions */
-	Oid			transfn_oid;
-	Oid			finalfn_oid;	/* may be InvalidOid */
-
-	/*
-	 * fmgr lookup data for transfer functions --- only valid when
-	 * corresponding oid is not InvalidOid.  Note in particular that fn_strict
-	 * flags are kept here.
-	 */
-	FmgrInfo	transfn;
-	FmgrInfo	finalfn;
-
-	/* Input collation derived for aggregate */
-	Oid			aggCollation;
-
-	/* number of sorting columns */
-	int			numSortCols;
-
-	/* number of sorting columns to consider in DISTINCT comparisons */
-	/* (this is either zero or the same as numSortCols) */
-	int			numDistinctCols;
-
-	/* deconstructed sorting information (arrays of length numSortCols) */
-	AttrNumber *sortColIdx;
-	Oid		   *sortOperators;
-	Oid		   *sortCollations;
-	bool	   *sortNullsFirst;
-
-	/*
-	 * fmgr lookup data for input columns' equality operators --- only
-	 * set/used when aggregate has DISTINCT flag.  Note that these are in
-	 * order of sort column index, not parameter index.
-	 */
-	FmgrInfo   *equalfns;		/* array of length numDistinctCols */
-
-	/*
-	 * initial value from pg_aggregate entry
-	 */
-	Datum		initValue;
-	bool		initValueIsNull;
-
-	/*
-	 * We need the len and byval info for the agg's input, result, and
-	 * transition data types in order to know how to copy/delete values.
-	 *
-	 * Note that the info for the input type is used only when handling
-	 * DISTINCT aggs with just one argument, so there is only one input type.
-	 */
-	int16		inputtypeLen,
-				resulttypeLen,
-				transtypeLen;
-	bool		inputtypeByVal,
-				resulttypeByVal,
-				transtypeByVal;
-
-	/*
-	 * Stuff for evaluation of inputs.	We used to just use ExecEvalExpr, but
-	 * with the addition of ORDER BY we now need at least a slot for passing
-	 * data to the sort object, which requires a tupledesc, so we might as
-	 * well go whole hog and use ExecProject too.
-	 */
-	TupleDesc	evaldesc;		/* descriptor of input tuples */
-	ProjectionInfo *evalproj;	/* projection machinery */
-
-	/*
-	 * Slots for holding the evaluated input arguments.  These are set up
-	 * during ExecInitAgg() and then used for each input row.
-	 */
-	TupleTableSlot *evalslot;	/* current input tuple */
-	TupleTableSlot *uniqslot;	/* used for multi-column DISTINCT */
-
-	/*
-	 * These values are working state that is initialized at the start of an
-	 * input tuple group and updated for each input tuple.
-	 *
-	 * For a simple (non DISTINCT/ORDER BY) aggregate, we just feed the input
-	 * values straight to the transition function.	If it's DISTINCT or
-	 * requires ORDER BY, we pass the input values into a Tuplesort object;
-	 * then at completion of the input tuple group, we scan the sorted values,
-	 * eliminate duplicates if needed, and run the transition function on the
-	 * rest.
-	 */
-
-	Tuplesortstate *sortstate;	/* sort object, if DISTINCT or ORDER BY */
-}	AggStatePerAggData;
-
-/*
- * AggStatePerGroupData - per-aggregate-per-group working state
- *
- * These values are working state that is initialized at the start of
- * an input tuple group and updated for each input tuple.
- *
- * In AGG_PLAIN and AGG_SORTED modes, we have a single array of these
- * structs (pointed to by aggstate->pergroup); we re-use the array for
- * each input group, if it's AGG_SORTED mode.  In AGG_HASHED mode, the
- * hash table contains an array of these structs for each tuple group.
- *
- * Logically, the sortstate field belongs in this struct, but we do not
- * keep it here for space reasons: we don't support DISTINCT aggregates
- * in AGG_HASHED mode, so there's no reason to use up a pointer field
- * in every entry of the hashtable.
- */
-typedef struct AggStatePerGroupData
-{
-	Datum		transValue;		/* current transition value */
-	bool		transValueIsNull;
-
-	bool		noTransValue;	/* true if transValue not set yet */
-
-	/*
-	 * Note: noTransValue initially has the same value as transValueIsNull,
-	 * and if true both are cleared to false at the same time.	They are not
-	 * the same though: if transfn later returns a NULL, we want to keep that
-	 * NULL and not auto-replace it with a later input value. Only the first
-	 * non-NULL input will be auto-substituted.
-	 */
-} AggStatePerGroupData;
-
 /*
  * To implement hashed aggregation, we need a hashtable that stores a
  * representative tuple and an array of AggStatePerGroup structs for each
@@ -253,14 +152,54 @@ typedef struct AggHashEntryData
 	AggStatePerGroupData pergroup[1];	/* VARIABLE LENGTH ARRAY */
 }	AggHashEntryData;	/* VARIABLE LENGTH STRUCT */
 
+/*
+ * A batch of spilled input tuples of a hashed aggregation, and the number of
+ * times its tuples have been partitioned.
+ */
+typedef struct AggHashBatch
+{
+	BufFile    *file;
+	int			depth;
+} AggHashBatch;
+
+/*
+ * Limits on the number of spill files each pass of a hashed aggregation
+ * partitions its overflowing tuples into.  Their buffers take up space, too.
+ */
+#define HASHAGG_MIN_PARTITIONS		4
+#define HASHAGG_MAX_PARTITIONS		32
+
+/*
+ * Transition functions that can be advanced over batches of input rows, and
+ * the type of their input, if any.
+ */
+typedef struct AggBatchTransInfo
+{
+	Oid			transfn;
+	AggBatchTrans batchtrans;
+	Oid			inputtype;
+} AggBatchTransInfo;
+
+static const AggBatchTransInfo agg_batch_trans[] = {
+	{F_INT8INC, AGG_BATCH_COUNT_STAR, InvalidOid},
+	{F_INT8INC_ANY, AGG_BATCH_COUNT, InvalidOid},
+	{F_INT2_SUM, AGG_BATCH_INT2_SUM, INT2OID},
+	{F_INT4_SUM, AGG_BATCH_INT4_SUM, INT4OID},
+	{F_FLOAT8PL, AGG_BATCH_FLOAT8_SUM, FLOAT8OID},
+	{F_INT2SMALLER, AGG_BATCH_INT2_MIN, INT2OID},
+	{F_INT2LARGER, AGG_BATCH_INT2_MAX, INT2OID},
+	{F_INT4SMALLER, AGG_BATCH_INT4_MIN, INT4OID},
+	{F_INT4LARGER, AGG_BATCH_INT4_MAX, INT4OID},
+	{F_INT8SMALLER, AGG_BATCH_INT8_MIN, INT8OID},
+	{F_INT8LARGER, AGG_BATCH_INT8_MAX, INT8OID},
+	{F_FLOAT8SMALLER, AGG_BATCH_FLOAT8_MIN, FLOAT8OID},
+	{F_FLOAT8LARGER, AGG_BATCH_FLOAT8_MAX, FLOAT8OID}
+};
+
 
 static void initialize_aggregates(AggState *aggstate,
 					  AggStatePerAgg peragg,
 					  AggStatePerGroup pergroup);
-static void advance_transition_function(AggState *aggstate,
-							AggStatePerAgg peraggstate,
-							AggStatePerGroup pergroupstate,
-							FunctionCallInfoData *fcinfo);
 static void advance_aggregates(AggState *aggstate, AggStatePerGroup pergroup);
 static void process_ordered_aggregate_single(AggState *aggstate,
 								 AggStatePerAgg peraggstate,
@@ -277,9 +216,28 @@ static bool find_unaggregated_cols_walker(Node *node, Bitmapset **colnos);
 static void build_hash_table(AggState *aggstate);
 static AggHashEntry lookup_hash_entry(AggState *aggstate,
 				  TupleTableSlot *inputslot);
+static void spill_hash_tuple(AggState *aggstate, TupleTableSlot *inputslot);
+static void hash_agg_end_pass(AggState *aggstate);
+static bool hash_agg_next_batch(AggState *aggstate);
+static void hash_agg_reset_spill(AggState *aggstate);
 static TupleTableSlot *agg_retrieve_direct(AggState *aggstate);
+static bool agg_batch_init(AggState *aggstate);
+static TupleTableSlot *agg_retrieve_batch(AggState *aggstate);
+static void advance_aggregate_batch(AggStatePerAgg peraggstate,
+						AggStatePerGroup pergroupstate,
+						TupleBatch *batch);
 static void agg_fill_hash_table(AggState *aggstate);
 static TupleTableSlot *agg_retrieve_hash_table(AggState *aggstate);
+static bool agg_parallel_init(AggState *aggstate);
+static Node *agg_parallel_mutator(Node *node, List *scantlist);
+static bool agg_wholerow_walker(Node *node, void *context);
+static TupleDesc agg_partial_desc(AggState *aggstate, int numaggs, int *aggnos);
+static void advance_combine_function(AggState *aggstate,
+						 AggStatePerAgg peraggstate,
+						 AggStatePerGroup pergroupstate,
+						 Datum value, bool isnull);
+static void combine_partial_aggregates(AggState *aggstate,
+						   AggStatePerGroup pergroup);
 static Datum GetAggInitVal(Datum textInitVal, Oid transtype);
 
 
@@ -372,8 +330,11 @@ initialize_aggregates(AggState *aggstate,
  * transition function.  No other fields of fcinfo are assumed valid.
  *
  * It doesn't matter which memory context this is called in.
+ *
+ * This is exported for the benefit of JIT compiled code, which calls it for
+ * transition functions it does not evaluate inline.
  */
-static void
+void
 advance_transition_function(AggState *aggstate,
 							AggStatePerAgg peraggstate,
 							AggStatePerGroup pergroupstate,
@@ -467,6 +428,119 @@ advance_transition_function(AggState *aggstate,
 	MemoryContextSwitchTo(oldContext);
 }
 
+/*
+ * Merge a transition value computed elsewhere (by a scan worker) into the
+ * transition value of an aggregate, using its combine function.
+ *
+ * The value needn't outlive this call; it's copied if it is kept.  Like
+ * advance_transition_function, this can be called in any memory context.
+ */
+static void
+advance_combine_function(AggState *aggstate,
+						 AggStatePerAgg peraggstate,
+						 AggStatePerGroup pergroupstate,
+						 Datum value, bool isnull)
+{
+	FunctionCallInfoData fcinfo;
+	MemoryContext oldContext;
+	Datum		newVal;
+
+	if (peraggstate->combinefn.fn_strict)
+	{
+		/*
+		 * For a strict combinefn, a NULL value on either side stands for "no
+		 * input rows": the other one is the result.  Note that we look at
+		 * transValueIsNull rather than noTransValue here, since a non-strict
+		 * transfn might have left us with a NULL transValue, too.
+		 */
+		if (isnull)
+			return;
+		if (pergroupstate->transValueIsNull)
+		{
+			oldContext = MemoryContextSwitchTo(aggstate->aggcontext);
+			pergroupstate->transValue = datumCopy(value,
+												  peraggstate->transtypeByVal,
+												  peraggstate->transtypeLen);
+			pergroupstate->transValueIsNull = false;
+			pergroupstate->noTransValue = false;
+			MemoryContextSwitchTo(oldContext);
+			return;
+		}
+	}
+
+	/* We run the combine functions in per-input-tuple memory context */
+	oldContext = MemoryContextSwitchTo(aggstate->tmpcontext->ecxt_per_tuple_memory);
+
+	InitFunctionCallInfoData(fcinfo, &(peraggstate->combinefn), 2,
+							 peraggstate->aggCollation,
+							 (void *) aggstate, NULL);
+	fcinfo.arg[0] = pergroupstate->transValue;
+	fcinfo.argnull[0] = pergroupstate->transValueIsNull;
+	fcinfo.arg[1] = value;
+	fcinfo.argnull[1] = isnull;
+
+	newVal = FunctionCallInvoke(&fcinfo);
+
+	/*
+	 * As in advance_transition_function, keep a pass-by-ref result in
+	 * aggcontext.  It might point to the value being merged, too.
+	 */
+	if (!peraggstate->transtypeByVal &&
+		DatumGetPointer(newVal) != DatumGetPointer(pergroupstate->transValue))
+	{
+		if (!fcinfo.isnull)
+		{
+			MemoryContextSwitchTo(aggstate->aggcontext);
+			newVal = datumCopy(newVal,
+							   peraggstate->transtypeByVal,
+							   peraggstate->transtypeLen);
+		}
+		if (!pergroupstate->transValueIsNull)
+			pfree(DatumGetPointer(pergroupstate->transValue));
+	}
+
+	pergroupstate->transValue = newVal;
+	pergroupstate->transValueIsNull = fcinfo.isnull;
+	pergroupstate->noTransValue = false;
+
+	MemoryContextSwitchTo(oldContext);
+}
+
+/*
+ * Merge the transition values the scan workers below us have computed into
+ * ours.  Called once our own input is exhausted, in plain aggregation.
+ */
+static void
+combine_partial_aggregates(AggState *aggstate, AggStatePerGroup pergroup)
+{
+	SeqScanState *outerstate = (SeqScanState *) outerPlanState(aggstate);
+	int			numaggs = aggstate->numaggs;
+	Datum	   *values;
+	bool	   *isnull;
+	HeapTuple	tuple;
+
+	values = (Datum *) palloc(numaggs * sizeof(Datum));
+	isnull = (bool *) palloc(numaggs * sizeof(bool));
+
+	/* each worker sends one tuple of transition values, if any */
+	while ((tuple = ExecSeqScanGetPartialAgg(outerstate)) != NULL)
+	{
+		int			aggno;
+
+		heap_deform_tuple(tuple, aggstate->partial_desc, values, isnull);
+
+		for (aggno = 0; aggno < numaggs; aggno++)
+			advance_combine_function(aggstate, &aggstate->peragg[aggno],
+									 &pergroup[aggno],
+									 values[aggno], isnull[aggno]);
+
+		ResetExprContext(aggstate->tmpcontext);
+	}
+
+	pfree(values);
+	pfree(isnull);
+}
+
 /*
  * Advance all the aggregates for one input tuple.	The input tuple
  * has been stored in tmpcontext->ecxt_outertuple, so that it is accessible
@@ -480,6 +554,13 @@ advance_aggregates(AggState *aggstate, AggStatePerGroup pergroup)
 {
 	int			aggno;
 
+	/* if the per-row work has been compiled, that's all there is to do */
+	if (aggstate->advance_func != NULL)
+	{
+		aggstate->advance_func(aggstate, pergroup);
+		return;
+	}
+
 	for (aggno = 0; aggno < aggstate->numaggs; aggno++)
 	{
 		AggStatePerAgg peraggstate = &aggstate->peragg[aggno];
@@ -910,14 +991,15 @@ hash_agg_entry_size(int numAggs)
 	entrysize = sizeof(AggHashEntryData) +
 		(numAggs - 1) * sizeof(AggStatePerGroupData);
 	entrysize = MAXALIGN(entrysize);
-	/* Account for hashtable overhead (assuming fill factor = 1) */
-	entrysize += 3 * sizeof(void *);
+	/* Account for hashtable overhead (assuming the table is half full) */
+	entrysize += 2 * sizeof(TupleHashBucketData);
 	return entrysize;
 }
 
 /*
  * Find or create a hashtable entry for the tuple group containing the
- * given tuple.
+ * given tuple.  Returns NULL if there's no entry and the table is full;
+ * the caller must spill the tuple then.
  *
  * When called, CurrentMemoryContext should be the per-query context.
  */
@@ -950,17 +1032,212 @@ lookup_hash_entry(AggState *aggstate, TupleTableSlot *inputslot)
 	/* find or create the hashtable entry using the filtered tuple */
 	entry = (AggHashEntry) LookupTupleHashEntry(aggstate->hashtable,
 												hashslot,
-												&isnew);
+												aggstate->hash_full ? NULL : &isnew);
 
-	if (isnew)
+	if (entry != NULL && !aggstate->hash_full && isnew)
 	{
 		/* initialize aggregates for new tuple group */
 		initialize_aggregates(aggstate, aggstate->peragg, entry->pergroup);
+
+		/* stop adding groups once we're out of memory */
+		aggstate->hash_mem += aggstate->hash_entrysize +
+			GetMemoryChunkSpace(entry->shared.firstTuple);
+		if (aggstate->hash_mem > aggstate->hash_mem_peak)
+			aggstate->hash_mem_peak = aggstate->hash_mem;
+		if (aggstate->hash_mem > work_mem * 1024L)
+			aggstate->hash_full = true;
 	}
 
 	return entry;
 }
 
+/*
+ * Write an input tuple whose group isn't in the full hash table to the spill
+ * file of its partition.  The partition is chosen by hash bits that weren't
+ * used on the way to the current pass, so that the tuples of a batch get
+ * spread over all partitions.
+ */
+static void
+spill_hash_tuple(AggState *aggstate, TupleTableSlot *inputslot)
+{
+	MinimalTuple tuple;
+	MemoryContext oldContext;
+	uint32		hashvalue;
+	int			partition;
+	BufFile   **fileptr;
+
+	if (aggstate->hash_spill == NULL)
+		aggstate->hash_spill = (BufFile **)
+			palloc0(aggstate->hash_npartitions * sizeof(BufFile *));
+
+	/* the hash functions might leak */
+	oldContext = MemoryContextSwitchTo(aggstate->tmpcontext->ecxt_per_tuple_memory);
+	hashvalue = TupleHashTableHash(aggstate->hashtable, aggstate->hashslot,
+								   aggstate->hashfunctions);
+	MemoryContextSwitchTo(oldContext);
+
+	partition = DatumGetUInt32(hash_uint32(hashvalue ^ aggstate->hash_depth)) %
+		aggstate->hash_npartitions;
+
+	fileptr = &aggstate->hash_spill[partition];
+	if (*fileptr == NULL)
+		*fileptr = BufFileCreateTemp(false);
+
+	tuple = ExecFetchSlotMinimalTuple(inputslot);
+	if (BufFileWrite(*fileptr, (void *) tuple, tuple->t_len) != tuple->t_len)
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not write to hash-aggregate temporary file: %m")));
+}
+
+/*
+ * At the end of the input of a pass, queue up the batches it has spilled.
+ * They are processed depth-first, which bounds the number of files open at
+ * once.
+ */
+static void
+hash_agg_end_pass(AggState *aggstate)
+{
+	int			i;
+
+	if (aggstate->hash_spill == NULL)
+		return;
+
+	for (i = aggstate->hash_npartitions - 1; i >= 0; i--)
+	{
+		AggHashBatch *batch;
+
+		if (aggstate->hash_spill[i] == NULL)
+			continue;
+
+		batch = (AggHashBatch *) palloc(sizeof(AggHashBatch));
+		batch->file = aggstate->hash_spill[i];
+		batch->depth = aggstate->hash_depth + 1;
+		aggstate->hash_batches = lcons(batch, aggstate->hash_batches);
+	}
+
+	pfree(aggstate->hash_spill);
+	aggstate->hash_spill = NULL;
+}
+
+/*
+ * Empty the hash table, and aggregate the next spilled batch into it.
+ * Returns false if there are no more batches.
+ *
+ * When called, CurrentMemoryContext should be the per-query context.
+ */
+static bool
+hash_agg_next_batch(AggState *aggstate)
+{
+	ExprContext *tmpcontext = aggstate->tmpcontext;
+	TupleTableSlot *slot = aggstate->hash_spillslot;
+	AggHashBatch *batch;
+	BufFile    *file;
+	uint32		t_len;
+	size_t		nread;
+
+	if (aggstate->hash_batches == NIL)
+		return false;
+
+	batch = (AggHashBatch *) linitial(aggstate->hash_batches);
+	aggstate->hash_batches = list_delete_first(aggstate->hash_batches);
+	file = batch->file;
+	aggstate->hash_depth = batch->depth;
+	pfree(batch);
+
+	/* the old table lives in aggcontext, along with the transition values */
+	ExecClearTuple(aggstate->ss.ss_ScanTupleSlot);
+	MemoryContextResetAndDeleteChildren(aggstate->aggcontext);
+	build_hash_table(aggstate);
+	aggstate->hash_mem = 0;
+	aggstate->hash_full = false;
+	aggstate->hash_nbatches++;
+
+	if (BufFileSeek(file, 0, 0L, SEEK_SET))
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not rewind hash-aggregate temporary file: %m")));
+
+	for (;;)
+	{
+		MinimalTuple tuple;
+		AggHashEntry entry;
+
+		CHECK_FOR_INTERRUPTS();
+
+		nread = BufFileRead(file, (void *) &t_len, sizeof(t_len));
+		if (nread == 0)
+			break;
+		if (nread != sizeof(t_len))
+			ereport(ERROR,
+					(errcode_for_file_access(),
+					 errmsg("could not read from hash-aggregate temporary file: %m")));
+
+		tuple = (MinimalTuple) palloc(t_len);
+		tuple->t_len = t_len;
+		nread = BufFileRead(file, (void *) ((char *) tuple + sizeof(uint32)),
+							t_len - sizeof(uint32));
+		if (nread != t_len - sizeof(uint32))
+			ereport(ERROR,
+					(errcode_for_file_access(),
+					 errmsg("could not read from hash-aggregate temporary file: %m")));
+		ExecStoreMinimalTuple(tuple, slot, true);
+
+		tmpcontext->ecxt_outertuple = slot;
+
+		entry = lookup_hash_entry(aggstate, slot);
+		if (entry != NULL)
+			advance_aggregates(aggstate, entry->pergroup);
+		else
+			spill_hash_tuple(aggstate, slot);
+
+		ResetExprContext(tmpcontext);
+	}
+
+	BufFileClose(file);
+	ExecClearTuple(slot);
+
+	hash_agg_end_pass(aggstate);
+
+	ResetTupleHashIterator(aggstate->hashtable, &aggstate->hashiter);
+
+	return true;
+}
+
+/*
+ * Close all spill files of a hashed aggregation
+ */
+static void
+hash_agg_reset_spill(AggState *aggstate)
+{
+	ListCell   *lc;
+	int			i;
+
+	if (aggstate->hash_spill != NULL)
+	{
+		for (i = 0; i < aggstate->hash_npartitions; i++)
+		{
+			if (aggstate->hash_spill[i] != NULL)
+				BufFileClose(aggstate->hash_spill[i]);
+		}
+		pfree(aggstate->hash_spill);
+		aggstate->hash_spill = NULL;
+	}
+
+	foreach(lc, aggstate->hash_batches)
+	{
+		AggHashBatch *batch = (AggHashBatch *) lfirst(lc);
+
+		BufFileClose(batch->file);
+	}
+	list_free_deep(aggstate->hash_batches);
+	aggstate->hash_batches = NIL;
+
+	aggstate->hash_mem = 0;
+	aggstate->hash_full = false;
+	aggstate->hash_depth = 0;
+}
+
 /*
  * ExecAgg -
  *
@@ -1009,6 +1286,8 @@ ExecAgg(AggState *node)
 			agg_fill_hash_table(node);
 		return agg_retrieve_hash_table(node);
 	}
+	else if (node->batch_mode)
+		return agg_retrieve_batch(node);
 	else
 		return agg_retrieve_direct(node);
 }
@@ -1150,6 +1429,10 @@ agg_retrieve_direct(AggState *aggstate)
 			}
 		}
 
+		/* Add in what scan workers have aggregated, if any */
+		if (aggstate->partial_desc != NULL)
+			combine_partial_aggregates(aggstate, pergroup);
+
 		/*
 		 * Done scanning input tuple group. Finalize each aggregate
 		 * calculation, and stash results in the per-output-tuple context.
@@ -1214,6 +1497,292 @@ agg_retrieve_direct(AggState *aggstate)
 	return NULL;
 }
 
+/*
+ * ExecAgg for plain aggregation in batch mode
+ *
+ * Like agg_retrieve_direct without grouping, except that input rows are
+ * fetched from the SeqScan below in batches, and the aggregates are advanced
+ * over each batch at once.
+ */
+static TupleTableSlot *
+agg_retrieve_batch(AggState *aggstate)
+{
+	SeqScanState *outerPlan;
+	ExprContext *econtext;
+	Datum	   *aggvalues;
+	bool	   *aggnulls;
+	AggStatePerAgg peragg;
+	AggStatePerGroup pergroup;
+	TupleBatch *batch;
+	int			aggno;
+
+	/*
+	 * get state info from node
+	 */
+	outerPlan = (SeqScanState *) outerPlanState(aggstate);
+	econtext = aggstate->ss.ps.ps_ExprContext;
+	aggvalues = econtext->ecxt_aggvalues;
+	aggnulls = econtext->ecxt_aggnulls;
+	peragg = aggstate->peragg;
+	pergroup = aggstate->pergroup;
+
+	ResetExprContext(econtext);
+	MemoryContextResetAndDeleteChildren(aggstate->aggcontext);
+	initialize_aggregates(aggstate, peragg, pergroup);
+
+	while ((batch = ExecSeqScanBatch(outerPlan)) != NULL)
+	{
+		if (batch->nsel == 0)
+			continue;
+
+		for (aggno = 0; aggno < aggstate->numaggs; aggno++)
+			advance_aggregate_batch(&peragg[aggno], &pergroup[aggno], batch);
+	}
+	aggstate->agg_done = true;
+
+	if (aggstate->partial_desc != NULL)
+		combine_partial_aggregates(aggstate, pergroup);
+
+	for (aggno = 0; aggno < aggstate->numaggs; aggno++)
+		finalize_aggregate(aggstate, &peragg[aggno], &pergroup[aggno],
+						   &aggvalues[aggno], &aggnulls[aggno]);
+
+	/*
+	 * There's no representative input tuple, but without grouping there
+	 * can't be any references to input columns outside of aggregates.
+	 */
+	econtext->ecxt_outertuple = aggstate->ss.ss_ScanTupleSlot;
+
+	if (ExecQual(aggstate->ss.ps.qual, econtext, false))
+	{
+		TupleTableSlot *result;
+		ExprDoneCond isDone;
+
+		result = ExecProject(aggstate->ss.ps.ps_ProjInfo, &isDone);
+
+		if (isDone != ExprEndResult)
+		{
+			aggstate->ss.ps.ps_TupFromTlist =
+				(isDone == ExprMultipleResult);
+			return result;
+		}
+	}
+	else
+		InstrCountFiltered1(aggstate, 1);
+
+	return NULL;
+}
+
+/*
+ * Loop over the rows of a batch selected by the scan's quals, setting 'row'
+ * to each of them.  If no row was filtered out, the selection vector is
+ * skipped, so that the compiler can vectorize the loop.
+ */
+#define FOREACH_SELECTED_ROW(batch, row, body) \
+	do { \
+		int			i_; \
+		\
+		if ((batch)->nsel == (batch)->nrows) \
+		{ \
+			for ((row) = 0; (row) < (batch)->nrows; (row)++) \
+			{ \
+				body; \
+			} \
+		} \
+		else \
+		{ \
+			for (i_ = 0; i_ < (batch)->nsel; i_++) \
+			{ \
+				(row) = (batch)->sel[i_]; \
+				body; \
+			} \
+		} \
+	} while (0)
+
+/*
+ * sum() of an integer column into an int8 transition value, like int2_sum
+ * and int4_sum.  These don't check for overflow.
+ */
+#define BATCH_INT_SUM(getter) \
+	do { \
+		int64		sum = 0; \
+		int			n = 0; \
+		\
+		FOREACH_SELECTED_ROW(batch, row, \
+							 sum += isnull[row] ? 0 : getter(values[row]); \
+							 n += !isnull[row]); \
+		if (n > 0) \
+		{ \
+			if (!pergroupstate->transValueIsNull) \
+				sum += DatumGetInt64(pergroupstate->transValue); \
+			pergroupstate->transValue = Int64GetDatum(sum); \
+			pergroupstate->transValueIsNull = false; \
+		} \
+	} while (0)
+
+/*
+ * min() or max() of a column by a strict transition function returning the
+ * input for which 'keep_new' is true, the state otherwise.
+ */
+#define BATCH_MINMAX(ctype, getter, maker, keep_new) \
+	do { \
+		ctype		m = 0; \
+		bool		have = !pergroupstate->noTransValue; \
+		\
+		if (pergroupstate->transValueIsNull && have) \
+			break; \
+		if (have) \
+			m = getter(pergroupstate->transValue); \
+		FOREACH_SELECTED_ROW(batch, row, \
+							 if (!isnull[row]) \
+							 { \
+								 ctype v = getter(values[row]); \
+								 \
+								 if (!have || (keep_new)) \
+									 m = v; \
+								 have = true; \
+							 }); \
+		if (have) \
+		{ \
+			pergroupstate->transValue = maker(m); \
+			pergroupstate->transValueIsNull = false; \
+			pergroupstate->noTransValue = false; \
+		} \
+	} while (0)
+
+/*
+ * Advance the transition value of an aggregate over the selected rows of a
+ * batch, with the same result advance_transition_function would have.
+ * The aggregate's batchtrans tells how.  All transition values handled are
+ * pass-by-value.
+ */
+static void
+advance_aggregate_batch(AggStatePerAgg peraggstate,
+						AggStatePerGroup pergroupstate,
+						TupleBatch *batch)
+{
+	Datum	   *values = NULL;
+	bool	   *isnull = NULL;
+	int			row;
+
+	if (peraggstate->batchcol >= 0)
+	{
+		values = batch->values[peraggstate->batchcol];
+		isnull = batch->isnull[peraggstate->batchcol];
+	}
+
+	switch (peraggstate->batchtrans)
+	{
+		case AGG_BATCH_COUNT_STAR:
+		case AGG_BATCH_COUNT:
+			{
+				int64		count = DatumGetInt64(pergroupstate->transValue);
+				int64		n = 0;
+
+				/* the initial value of count() is 0, so never null */
+				Assert(!pergroupstate->transValueIsNull);
+
+				if (peraggstate->batchtrans == AGG_BATCH_COUNT_STAR)
+					n = batch->nsel;
+				else
+					FOREACH_SELECTED_ROW(batch, row, n += !isnull[row]);
+
+				if (count + n < count)
+					ereport(ERROR,
+							(errcode(ERRCODE_NUMERIC_VALUE_OUT_OF_RANGE),
+							 errmsg("bigint out of range")));
+				pergroupstate->transValue = Int64GetDatum(count + n);
+				break;
+			}
+
+		case AGG_BATCH_INT2_SUM:
+			BATCH_INT_SUM(DatumGetInt16);
+			break;
+
+		case AGG_BATCH_INT4_SUM:
+			BATCH_INT_SUM(DatumGetInt32);
+			break;
+
+		case AGG_BATCH_FLOAT8_SUM:
+			{
+				/* like float8pl, including its overflow check */
+				float8		sum = 0;
+				bool		have = !pergroupstate->noTransValue;
+
+				if (pergroupstate->transValueIsNull && have)
+					break;
+				if (have)
+					sum = DatumGetFloat8(pergroupstate->transValue);
+				FOREACH_SELECTED_ROW(batch, row,
+									 if (!isnull[row])
+									 {
+										 float8 v = DatumGetFloat8(values[row]);
+										 float8 result = sum + v;
+
+										 if (!have)
+											 result = v;
+										 else if (isinf(result) &&
+												  !isinf(sum) && !isinf(v))
+											 ereport(ERROR,
+													 (errcode(ERRCODE_NUMERIC_VALUE_OUT_OF_RANGE),
+													  errmsg("value out of range: overflow")));
+										 sum = result;
+										 have = true;
+									 });
+				if (have)
+				{
+					pergroupstate->transValue = Float8GetDatum(sum);
+					pergroupstate->transValueIsNull = false;
+					pergroupstate->noTransValue = false;
+				}
+				break;
+			}
+
+		case AGG_BATCH_INT2_MIN:
+			BATCH_MINMAX(int16, DatumGetInt16, Int16GetDatum, v < m);
+			break;
+
+		case AGG_BATCH_INT2_MAX:
+			BATCH_MINMAX(int16, DatumGetInt16, Int16GetDatum, v > m);
+			break;
+
+		case AGG_BATCH_INT4_MIN:
+			BATCH_MINMAX(int32, DatumGetInt32, Int32GetDatum, v < m);
+			break;
+
+		case AGG_BATCH_INT4_MAX:
+			BATCH_MINMAX(int32, DatumGetInt32, Int32GetDatum, v > m);
+			break;
+
+		case AGG_BATCH_INT8_MIN:
+			BATCH_MINMAX(int64, DatumGetInt64, Int64GetDatum, v < m);
+			break;
+
+		case AGG_BATCH_INT8_MAX:
+			BATCH_MINMAX(int64, DatumGetInt64, Int64GetDatum, v > m);
+			break;
+
+			/*
+			 * float8smaller and float8larger keep the state only if it
+			 * compares smaller or larger, by float8_cmp_internal, which sorts
+			 * NaN above everything else.
+			 */
+		case AGG_BATCH_FLOAT8_MIN:
+			BATCH_MINMAX(float8, DatumGetFloat8, Float8GetDatum,
+						 !(m < v || (isnan(v) && !isnan(m))));
+			break;
+
+		case AGG_BATCH_FLOAT8_MAX:
+			BATCH_MINMAX(float8, DatumGetFloat8, Float8GetDatum,
+						 !(m > v || (isnan(m) && !isnan(v))));
+			break;
+
+		case AGG_BATCH_NONE:
+			elog(ERROR, "aggregate cannot be advanced over a batch");
+			break;
+	}
+}
+
 /*
  * ExecAgg for hashed case: phase 1, read input and build hash table
  */
@@ -1247,13 +1816,18 @@ agg_fill_hash_table(AggState *aggstate)
 		/* Find or build hashtable entry for this tuple's group */
 		entry = lookup_hash_entry(aggstate, outerslot);
 
-		/* Advance the aggregates */
-		advance_aggregates(aggstate, entry->pergroup);
+		/* Advance the aggregates, or leave the tuple for a later pass */
+		if (entry != NULL)
+			advance_aggregates(aggstate, entry->pergroup);
+		else
+			spill_hash_tuple(aggstate, outerslot);
 
 		/* Reset per-input-tuple context after each tuple */
 		ResetExprContext(tmpcontext);
 	}
 
+	hash_agg_end_pass(aggstate);
+
 	aggstate->table_filled = true;
 	/* Initialize to walk the hash table */
 	ResetTupleHashIterator(aggstate->hashtable, &aggstate->hashiter);
@@ -1296,7 +1870,11 @@ agg_retrieve_hash_table(AggState *aggstate)
 		entry = (AggHashEntry) ScanTupleHashTable(&aggstate->hashiter);
 		if (entry == NULL)
 		{
-			/* No more entries in hashtable, so done */
+			/* No more entries in hashtable; go on with a spilled batch */
+			if (hash_agg_next_batch(aggstate))
+				continue;
+
+			/* No more batches either, so done */
 			aggstate->agg_done = TRUE;
 			return NULL;
 		}
@@ -1403,6 +1981,12 @@ ExecInitAgg(Agg *node, EState *estate, int eflags)
 	aggstate->pergroup = NULL;
 	aggstate->grp_firstTuple = NULL;
 	aggstate->hashtable = NULL;
+	aggstate->hash_spill = NULL;
+	aggstate->hash_batches = NIL;
+	aggstate->advance_func = NULL;
+	aggstate->advance_arg = NULL;
+	aggstate->batch_mode = false;
+	aggstate->partial_desc = NULL;
 
 	/*
 	 * Create expression contexts.	We need two, one for per-input-tuple
@@ -1463,9 +2047,11 @@ ExecInitAgg(Agg *node, EState *estate, int eflags)
 	outerPlanState(aggstate) = ExecInitNode(outerPlan, estate, eflags);
 
 	/*
-	 * initialize source tuple type.
+	 * initialize source tuple type.  (The Agg node of a scan worker has no
+	 * outer plan; see ExecInitPartialAgg.)
 	 */
-	ExecAssignScanTypeFromOuterPlan(&aggstate->ss);
+	if (outerPlan != NULL)
+		ExecAssignScanTypeFromOuterPlan(&aggstate->ss);
 
 	/*
 	 * Initialize result tuple type and projection info.
@@ -1561,9 +2147,11 @@ ExecInitAgg(Agg *node, EState *estate, int eflags)
 		Oid			aggtranstype;
 		AclResult	aclresult;
 		Oid			transfn_oid,
-					finalfn_oid;
+					finalfn_oid,
+					combinefn_oid;
 		Expr	   *transfnexpr,
-				   *finalfnexpr;
+				   *finalfnexpr,
+				   *combinefnexpr;
 		Datum		textInitVal;
 		int			i;
 		ListCell   *lc;
@@ -1630,6 +2218,7 @@ ExecInitAgg(Agg *node, EState *estate, int eflags)
 
 		peraggstate->transfn_oid = transfn_oid = aggform->aggtransfn;
 		peraggstate->finalfn_oid = finalfn_oid = aggform->aggfinalfn;
+		peraggstate->combinefn_oid = combinefn_oid = aggform->aggcombinefn;
 
 		/* Check that aggregate owner has permission to call component fns */
 		{
@@ -1659,6 +2248,15 @@ ExecInitAgg(Agg *node, EState *estate, int eflags)
 								   get_func_name(finalfn_oid));
 				InvokeFunctionExecuteHook(finalfn_oid);
 			}
+			if (OidIsValid(combinefn_oid))
+			{
+				aclresult = pg_proc_aclcheck(combinefn_oid, aggOwner,
+											 ACL_EXECUTE);
+				if (aclresult != ACLCHECK_OK)
+					aclcheck_error(aclresult, ACL_KIND_PROC,
+								   get_func_name(combinefn_oid));
+				InvokeFunctionExecuteHook(combinefn_oid);
+			}
 		}
 
 		/* resolve actual type of transition state, if polymorphic */
@@ -1700,6 +2298,27 @@ ExecInitAgg(Agg *node, EState *estate, int eflags)
 			fmgr_info_set_expr((Node *) finalfnexpr, &peraggstate->finalfn);
 		}
 
+		/*
+		 * The combine function is called like a transition function with the
+		 * transition type as its only input type.
+		 */
+		if (OidIsValid(combinefn_oid))
+		{
+			build_aggregate_fnexprs(&aggtranstype,
+									1,
+									aggtranstype,
+									aggref->aggtype,
+									aggref->inputcollid,
+									combinefn_oid,
+									InvalidOid,
+									&combinefnexpr,
+									&finalfnexpr);
+			fmgr_info(combinefn_oid, &peraggstate->combinefn);
+			fmgr_info_set_expr((Node *) combinefnexpr, &peraggstate->combinefn);
+		}
+
+		peraggstate->transtype = aggtranstype;
+
 		peraggstate->aggCollation = aggref->inputcollid;
 
 		get_typlenbyval(aggref->aggtype,
@@ -1860,9 +2479,352 @@ ExecInitAgg(Agg *node, EState *estate, int eflags)
 	/* Update numaggs to match number of unique aggregates found */
 	aggstate->numaggs = aggno + 1;
 
+	/*
+	 * In the hashed case, estimate the space of a group (as the planner does)
+	 * to know when the table has outgrown work_mem, and get ready to spill.
+	 */
+	if (node->aggstrategy == AGG_HASHED)
+	{
+		long		npartitions;
+
+		aggstate->hash_entrysize = hash_agg_entry_size(aggstate->numaggs);
+		for (aggno = 0; aggno < aggstate->numaggs; aggno++)
+		{
+			AggStatePerAgg peraggstate = &peragg[aggno];
+
+			if (!peraggstate->transtypeByVal)
+				aggstate->hash_entrysize +=
+					MAXALIGN(get_typavgwidth(peraggstate->transtype, -1)) +
+					2 * sizeof(void *);
+		}
+
+		/* spend no more than a quarter of work_mem on file buffers */
+		npartitions = (work_mem * 1024L) / (4 * BLCKSZ);
+		aggstate->hash_npartitions = Max(HASHAGG_MIN_PARTITIONS,
+										 Min(npartitions,
+											 HASHAGG_MAX_PARTITIONS));
+
+		aggstate->hash_spillslot = ExecInitExtraTupleSlot(estate);
+		ExecSetSlotDescriptor(aggstate->hash_spillslot,
+							  ExecGetResultType(outerPlanState(aggstate)));
+	}
+
+	/* Read the input in batches, if possible */
+	if (batch_execution && outerPlan != NULL)
+		aggstate->batch_mode = agg_batch_init(aggstate);
+
+	/* Let scan workers aggregate part of the input, if possible */
+	if (parallel_scan_workers > 0 && outerPlan != NULL &&
+		agg_parallel_init(aggstate))
+		aggstate->partial_desc = agg_partial_desc(aggstate,
+												  aggstate->numaggs, NULL);
+
+	return aggstate;
+}
+
+/*
+ * Decide whether an Agg node can read its input in batch mode, and if so,
+ * switch its input to batch mode.  That's possible for plain aggregation
+ * directly over a SeqScan, if every aggregate has a transition function
+ * advance_aggregate_batch knows about, with a plain column of the scanned
+ * relation (or nothing, for count(*)) as argument.
+ */
+static bool
+agg_batch_init(AggState *aggstate)
+{
+	Agg		   *node = (Agg *) aggstate->ss.ps.plan;
+	PlanState  *outerstate = outerPlanState(aggstate);
+	Plan	   *outerplan = outerPlan(node);
+	AttrNumber *argattnos;
+	Bitmapset  *attnos = NULL;
+	TupleBatch *batch;
+	int			aggno;
+
+	if (node->aggstrategy != AGG_PLAIN || aggstate->numaggs == 0 ||
+		!IsA(outerstate, SeqScanState))
+		return false;
+
+	argattnos = (AttrNumber *) palloc0(aggstate->numaggs * sizeof(AttrNumber));
+
+	for (aggno = 0; aggno < aggstate->numaggs; aggno++)
+	{
+		AggStatePerAgg peraggstate = &aggstate->peragg[aggno];
+		const AggBatchTransInfo *info = NULL;
+		int			i;
+
+		if (peraggstate->numSortCols > 0 || !peraggstate->transtypeByVal)
+			return false;
+
+		for (i = 0; i < lengthof(agg_batch_trans); i++)
+		{
+			if (agg_batch_trans[i].transfn == peraggstate->transfn_oid)
+			{
+				info = &agg_batch_trans[i];
+				break;
+			}
+		}
+		if (info == NULL)
+			return false;
+
+		if (info->batchtrans == AGG_BATCH_COUNT_STAR)
+		{
+			if (peraggstate->numArguments != 0)
+				return false;
+		}
+		else
+		{
+			TargetEntry *tle;
+			Var		   *var;
+
+			if (peraggstate->numArguments != 1)
+				return false;
+
+			/* the argument must be an output column of the scan ... */
+			tle = (TargetEntry *) linitial(peraggstate->aggref->args);
+			var = (Var *) tle->expr;
+			if (!IsA(var, Var) || var->varno != OUTER_VAR)
+				return false;
+
+			/* ... that is a plain column of the scanned relation */
+			tle = get_tle_by_resno(outerplan->targetlist, var->varattno);
+			if (tle == NULL || !IsA(tle->expr, Var))
+				return false;
+			var = (Var *) tle->expr;
+			if (var->varno != ((Scan *) outerplan)->scanrelid ||
+				var->varattno <= 0)
+				return false;
+			if (OidIsValid(info->inputtype) && var->vartype != info->inputtype)
+				return false;
+
+			argattnos[aggno] = var->varattno;
+			attnos = bms_add_member(attnos, var->varattno);
+		}
+
+		peraggstate->batchtrans = info->batchtrans;
+	}
+
+	if (!ExecSeqScanInitBatch((SeqScanState *) outerstate, attnos))
+		return false;
+
+	batch = ((SeqScanState *) outerstate)->batch;
+	for (aggno = 0; aggno < aggstate->numaggs; aggno++)
+	{
+		AggStatePerAgg peraggstate = &aggstate->peragg[aggno];
+
+		if (argattnos[aggno] != InvalidAttrNumber)
+			peraggstate->batchcol = ExecTupleBatchColumn(batch,
+														 argattnos[aggno]);
+		else
+			peraggstate->batchcol = -1;
+	}
+
+	pfree(argattnos);
+	bms_free(attnos);
+
+	return true;
+}
+
+/*
+ * Decide whether scan workers can aggregate part of the input of an Agg node,
+ * and if so, tell the SeqScan below about it.  That's possible for plain
+ * aggregation directly over a SeqScan, if every aggregate has a combine
+ * function and no DISTINCT or ORDER BY.  The SeqScan decides at its start
+ * whether it is run in parallel after all.
+ */
+static bool
+agg_parallel_init(AggState *aggstate)
+{
+	Agg		   *node = (Agg *) aggstate->ss.ps.plan;
+	PlanState  *outerstate = outerPlanState(aggstate);
+	Plan	   *outerplan = outerPlan(node);
+	List	   *aggrefs = NIL;
+	int			aggno;
+
+	if (node->aggstrategy != AGG_PLAIN || aggstate->numaggs == 0 ||
+		!IsA(outerstate, SeqScanState) ||
+		!((SeqScanState *) outerstate)->parallelOK)
+		return false;
+
+	for (aggno = 0; aggno < aggstate->numaggs; aggno++)
+	{
+		AggStatePerAgg peraggstate = &aggstate->peragg[aggno];
+		Node	   *aggref;
+
+		if (!OidIsValid(peraggstate->combinefn_oid) ||
+			peraggstate->numSortCols > 0)
+			return false;
+
+		/*
+		 * The workers evaluate the arguments over the scanned relation's
+		 * tuples, so replace references to the scan's output columns by
+		 * their expressions.
+		 */
+		aggref = agg_parallel_mutator((Node *) peraggstate->aggref,
+									  outerplan->targetlist);
+		if (agg_wholerow_walker(aggref, NULL))
+			return false;
+		aggrefs = lappend(aggrefs, aggref);
+	}
+
+	ExecSeqScanInitPartialAgg((SeqScanState *) outerstate, aggrefs);
+
+	return true;
+}
+
+/*
+ * Expand references to the outer plan's targetlist in an Aggref
+ */
+static Node *
+agg_parallel_mutator(Node *node, List *scantlist)
+{
+	if (node == NULL)
+		return NULL;
+	if (IsA(node, Var))
+	{
+		Var		   *var = (Var *) node;
+		TargetEntry *tle;
+
+		Assert(var->varno == OUTER_VAR);
+		tle = get_tle_by_resno(scantlist, var->varattno);
+		if (tle == NULL)
+			elog(ERROR, "variable not found in subplan target list");
+		return (Node *) copyObject(tle->expr);
+	}
+	return expression_tree_mutator(node, agg_parallel_mutator,
+								   (void *) scantlist);
+}
+
+/*
+ * Check for whole-row references, which a worker can't evaluate without a
+ * plan of its own
+ */
+static bool
+agg_wholerow_walker(Node *node, void *context)
+{
+	if (node == NULL)
+		return false;
+	if (IsA(node, Var))
+		return ((Var *) node)->varattno == InvalidAttrNumber;
+	return expression_tree_walker(node, agg_wholerow_walker, context);
+}
+
+/*
+ * Build the descriptor of a tuple holding the transition values of the given
+ * aggregates, in order (all of them if aggnos is NULL).
+ */
+static TupleDesc
+agg_partial_desc(AggState *aggstate, int numaggs, int *aggnos)
+{
+	TupleDesc	tupdesc;
+	int			i;
+
+	tupdesc = CreateTemplateTupleDesc(numaggs, false);
+	for (i = 0; i < numaggs; i++)
+	{
+		AggStatePerAgg peraggstate;
+
+		peraggstate = &aggstate->peragg[aggnos ? aggnos[i] : i];
+		TupleDescInitEntry(tupdesc, (AttrNumber) (i + 1), NULL,
+						   peraggstate->transtype, -1, 0);
+	}
+
+	return tupdesc;
+}
+
+/* -----------------
+ * ExecInitPartialAgg
+ *
+ *	Sets up the aggregation done by a scan worker: advancing the given
+ *	aggregates (Aggrefs over the scanned relation) over the tuples fed
+ *	to ExecPartialAggAdvance, and passing the transition values on with
+ *	ExecPartialAggGetStates.
+ * -----------------
+ */
+AggState *
+ExecInitPartialAgg(List *aggrefs, EState *estate)
+{
+	Agg		   *node = makeNode(Agg);
+	AggState   *aggstate;
+	List	   *tlist = NIL;
+	ListCell   *lc;
+
+	foreach(lc, aggrefs)
+		tlist = lappend(tlist,
+						makeTargetEntry((Expr *) lfirst(lc),
+										(AttrNumber) (list_length(tlist) + 1),
+										NULL, false));
+
+	node->aggstrategy = AGG_PLAIN;
+	node->plan.targetlist = tlist;
+
+	aggstate = ExecInitAgg(node, estate, 0);
+	initialize_aggregates(aggstate, aggstate->peragg, aggstate->pergroup);
+
 	return aggstate;
 }
 
+/*
+ * ExecPartialAggAdvance
+ *		Advance the aggregates of a scan worker over a tuple
+ */
+void
+ExecPartialAggAdvance(AggState *aggstate, TupleTableSlot *slot)
+{
+	ExprContext *tmpcontext = aggstate->tmpcontext;
+
+	tmpcontext->ecxt_scantuple = slot;
+	advance_aggregates(aggstate, aggstate->pergroup);
+	ResetExprContext(tmpcontext);
+}
+
+/*
+ * ExecPartialAggGetStates
+ *		Form a tuple of the transition values of a scan worker's aggregates
+ *
+ * The columns are in the order the aggregates were given to
+ * ExecInitPartialAgg, even if some were merged as duplicates.
+ */
+HeapTuple
+ExecPartialAggGetStates(AggState *aggstate)
+{
+	int			natts = list_length(aggstate->ss.ps.targetlist);
+	int		   *aggnos;
+	Datum	   *values;
+	bool	   *isnull;
+	TupleDesc	tupdesc;
+	HeapTuple	tuple;
+	ListCell   *lc;
+	int			i = 0;
+
+	aggnos = (int *) palloc(natts * sizeof(int));
+	values = (Datum *) palloc(natts * sizeof(Datum));
+	isnull = (bool *) palloc(natts * sizeof(bool));
+
+	foreach(lc, aggstate->ss.ps.targetlist)
+	{
+		GenericExprState *gstate = (GenericExprState *) lfirst(lc);
+		AggrefExprState *aggrefstate = (AggrefExprState *) gstate->arg;
+		AggStatePerGroup pergroupstate;
+
+		Assert(IsA(aggrefstate, AggrefExprState));
+		aggnos[i] = aggrefstate->aggno;
+		pergroupstate = &aggstate->pergroup[aggnos[i]];
+		values[i] = pergroupstate->transValue;
+		isnull[i] = pergroupstate->transValueIsNull;
+		i++;
+	}
+
+	tupdesc = agg_partial_desc(aggstate, natts, aggnos);
+	tuple = heap_form_tuple(tupdesc, values, isnull);
+
+	FreeTupleDesc(tupdesc);
+	pfree(aggnos);
+	pfree(values);
+	pfree(isnull);
+
+	return tuple;
+}
+
 static Datum
 GetAggInitVal(Datum textInitVal, Oid transtype)
 {
@@ -1904,6 +2866,10 @@ ExecEndAgg(AggState *node)
 	/* clean up tuple table */
 	ExecClearTuple(node->ss.ss_ScanTupleSlot);
 
+	/* and temporary files */
+	if (((Agg *) node->ss.ps.plan)->aggstrategy == AGG_HASHED)
+		hash_agg_reset_spill(node);
+
 	MemoryContextDelete(node->aggcontext);
 
 	outerPlan = outerPlanState(node);
@@ -1934,13 +2900,18 @@ ExecReScanAgg(AggState *node)
 		/*
 		 * If we do have the hash table and the subplan does not have any
 		 * parameter changes, then we can just rescan the existing hash table;
-		 * no need to build it again.
+		 * no need to build it again.  That's not possible if it had to spill,
+		 * though, since then it holds only the groups of the last batch.
 		 */
-		if (node->ss.ps.lefttree->chgParam == NULL)
+		if (node->ss.ps.lefttree->chgParam == NULL &&
+			node->hash_nbatches == 0 && node->hash_batches == NIL)
 		{
 			ResetTupleHashIterator(node->hashtable, &node->hashiter);
 			return;
 		}
+
+		hash_agg_reset_spill(node);
+		node->hash_nbatches = 0;
 	}
 
 	/* Make sure we have closed any open tuplesorts */
@@ -17,6 +17,8 @@
  *		MultiExecHash	- generate an in-memory hash table of the relation
  *		ExecInitHash	- initialize node and subnodes
  *		ExecEndHash		- shutdown node and subnodes
+ *		ExecHashTableAttach	- let a scan worker insert into a shared table
+ *		ExecHashTableDetach	- done with that
  */
 
 #include "postgres.h"
@@ -31,7 +33,10 @@
 #include "executor/hashjoin.h"
 #include "executor/nodeHash.h"
 #include "executor/nodeHashjoin.h"
+#include "executor/nodeSeqscan.h"
 #include "miscadmin.h"
+#include "postmaster/scanworker.h"
+#include "storage/atomics.h"
 #include "utils/dynahash.h"
 #include "utils/memutils.h"
 #include "utils/lsyscache.h"
@@ -39,6 +44,12 @@
 
 
 static void ExecHashIncreaseNumBatches(HashJoinTable hashtable);
+static void ExecHashFinishSharedBuild(HashState *node);
+#ifdef HAVE_PG_ATOMICS
+static HashJoinTuple ExecHashSharedAlloc(HashJoinTable hashtable, Size size);
+#endif
+static void ExecHashTablePendInsert(HashJoinTable hashtable,
+						HashJoinTuple hashTuple, int bucketno);
 static void ExecHashBuildSkewHash(HashJoinTable hashtable, Hash *node,
 					  int mcvsToUse);
 static void ExecHashSkewTableInsert(HashJoinTable hashtable,
@@ -46,6 +57,18 @@ static void ExecHashSkewTableInsert(HashJoinTable hashtable,
 						uint32 hashvalue,
 						int bucketNumber);
 static void ExecHashRemoveNextSkewBucket(HashJoinTable hashtable);
+static void ExecHashBloomCreate(HashJoinTable hashtable, double ntuples);
+static uint64 ExecHashBloomBits(uint32 hashvalue);
+
+/* word of the bloom filter the bits of a hash value are in */
+#define BLOOM_WORD(hashtable, hashvalue) \
+	((uint32) ((hashvalue) * 0x9E3779B1U) >> (hashtable)->bloomShift)
+
+/* is the tuple in the shared memory arena, rather than palloc'd? */
+#define HJTUPLE_IS_SHARED(hashtable, hjtup) \
+	((hashtable)->shared != NULL && \
+	 (char *) (hjtup) >= (char *) (hashtable)->shared && \
+	 (char *) (hjtup) < (char *) (hashtable)->shared + (hashtable)->shared->size)
 
 
 /* ----------------------------------------------------------------
@@ -77,6 +100,7 @@ MultiExecHash(HashState *node)
 	TupleTableSlot *slot;
 	ExprContext *econtext;
 	uint32		hashvalue;
+	bool		hashed;
 
 	/* must provide our own instrumentation support */
 	if (node->ps.instrument)
@@ -94,6 +118,14 @@ MultiExecHash(HashState *node)
 	hashkeys = node->hashkeys;
 	econtext = node->ps.ps_ExprContext;
 
+	/*
+	 * If scan workers may help with scanning the inner relation, they may as
+	 * well build the hash table along with us.
+	 */
+	if (hashtable->nbatch == 1 && IsA(outerNode, SeqScanState))
+		ExecSeqScanInitSharedHash((SeqScanState *) outerNode, hashtable,
+								  hashkeys);
+
 	/*
 	 * get all inner tuples and insert into the hash table (or temp files)
 	 */
@@ -104,12 +136,20 @@ MultiExecHash(HashState *node)
 			break;
 		/* We have to compute the hash value */
 		econtext->ecxt_innertuple = slot;
-		if (ExecHashGetHashValue(hashtable, econtext, hashkeys,
-								 false, hashtable->keepNulls,
-								 &hashvalue))
+		if (node->hashvaluefunc != NULL)
+			hashed = node->hashvaluefunc(&node->ps, hashtable, econtext,
+										 hashtable->keepNulls, &hashvalue);
+		else
+			hashed = ExecHashGetHashValue(hashtable, econtext, hashkeys,
+										  false, hashtable->keepNulls,
+										  &hashvalue);
+		if (hashed)
 		{
 			int			bucketNumber;
 
+			hashtable->bloomFilter[BLOOM_WORD(hashtable, hashvalue)] |=
+				ExecHashBloomBits(hashvalue);
+
 			bucketNumber = ExecHashGetSkewBucket(hashtable, hashvalue);
 			if (bucketNumber != INVALID_SKEW_BUCKET_NO)
 			{
@@ -126,6 +166,19 @@ MultiExecHash(HashState *node)
 		}
 	}
 
+	if (hashtable->sharedBuild)
+		ExecHashFinishSharedBuild(node);
+
+	ExecHashTableFlushInserts(hashtable);
+
+	/*
+	 * A bloom filter with too few bits per inner tuple would let most outer
+	 * tuples through anyway.
+	 */
+	if (hashtable->totalTuples * (BLOOM_BITS_PER_TUPLE / 2) >
+		(double) (UINT64CONST(64) << (32 - hashtable->bloomShift)))
+		hashtable->bloomEnabled = false;
+
 	/* must provide our own instrumentation support */
 	if (node->ps.instrument)
 		InstrStopNode(node->ps.instrument, hashtable->totalTuples);
@@ -162,6 +215,8 @@ ExecInitHash(Hash *node, EState *estate, int eflags)
 	hashstate->ps.state = estate;
 	hashstate->hashtable = NULL;
 	hashstate->hashkeys = NIL;	/* will be set by parent HashJoin */
+	hashstate->hashvaluefunc = NULL;	/* may be set by parent HashJoin */
+	hashstate->hashvaluearg = NULL;
 
 	/*
 	 * Miscellaneous initialization
@@ -274,6 +329,14 @@ ExecHashTableCreate(Hash *node, List *hashOperators, bool keepNulls)
 	hashtable->log2_nbuckets = log2_nbuckets;
 	hashtable->buckets = NULL;
 	hashtable->keepNulls = keepNulls;
+	hashtable->shared = NULL;
+	hashtable->sharedBuild = false;
+	hashtable->sharedChunk = NULL;
+	hashtable->sharedChunkFree = 0;
+	hashtable->sharedOverflowFile = NULL;
+	hashtable->workerTuples = 0;
+	hashtable->nPendingInserts = 0;
+	hashtable->nextPendingInsert = 0;
 	hashtable->skewEnabled = false;
 	hashtable->skewBucket = NULL;
 	hashtable->skewBucketLen = 0;
@@ -287,12 +350,26 @@ ExecHashTableCreate(Hash *node, List *hashOperators, bool keepNulls)
 	hashtable->totalTuples = 0;
 	hashtable->innerBatchFile = NULL;
 	hashtable->outerBatchFile = NULL;
+	hashtable->curchunk = 0;
+	hashtable->nchunkedBatches = 0;
+	hashtable->chunkInnerFile = NULL;
+	hashtable->chunkInnerTuples = 0;
+	hashtable->chunkOuterFile = NULL;
+	hashtable->chunkOuterTuples = 0;
+	hashtable->chunkOuterRead = 0;
+	hashtable->chunkOuterMatched = NULL;
+	hashtable->chunkOuterMatchedSize = 0;
 	hashtable->spaceUsed = 0;
 	hashtable->spacePeak = 0;
 	hashtable->spaceAllowed = work_mem * 1024L;
 	hashtable->spaceUsedSkew = 0;
 	hashtable->spaceAllowedSkew =
 		hashtable->spaceAllowed * SKEW_WORK_MEM_PERCENT / 100;
+	hashtable->bloomFilter = NULL;
+	hashtable->bloomShift = 0;
+	hashtable->bloomEnabled = false;
+	hashtable->bloomChecked = 0;
+	hashtable->bloomRejected = 0;
 
 	/*
 	 * Get info about the hash functions to be used for each hash key. Also
@@ -354,6 +431,8 @@ ExecHashTableCreate(Hash *node, List *hashOperators, bool keepNulls)
 		PrepareTempTablespaces();
 	}
 
+	ExecHashBloomCreate(hashtable, outerNode->plan_rows);
+
 	/*
 	 * Prepare context for the first-scan space allocations; allocate the
 	 * hashbucket array therein, and set each bucket "empty".
@@ -537,6 +616,16 @@ ExecHashTableDestroy(HashJoinTable hashtable)
 		if (hashtable->outerBatchFile[i])
 			BufFileClose(hashtable->outerBatchFile[i]);
 	}
+	if (hashtable->chunkInnerFile)
+		BufFileClose(hashtable->chunkInnerFile);
+	if (hashtable->chunkOuterFile)
+		BufFileClose(hashtable->chunkOuterFile);
+	if (hashtable->sharedOverflowFile)
+		BufFileClose(hashtable->sharedOverflowFile);
+
+	/* The scan workers are done with the shared table, if any */
+	if (hashtable->shared)
+		ScanWorkersReleaseHashArena();
 
 	/* Release working memory (batchCxt is a child, so it goes away too) */
 	MemoryContextDelete(hashtable->hashCxt);
@@ -610,6 +699,7 @@ ExecHashIncreaseNumBatches(HashJoinTable hashtable)
 	 * Scan through the existing hash table entries and dump out any that are
 	 * no longer of the current batch.
 	 */
+	ExecHashTableFlushInserts(hashtable);
 	ninmemory = nfreed = 0;
 
 	for (i = 0; i < hashtable->nbuckets; i++)
@@ -651,7 +741,8 @@ ExecHashIncreaseNumBatches(HashJoinTable hashtable)
 				/* prevtuple doesn't change */
 				hashtable->spaceUsed -=
 					HJTUPLE_OVERHEAD + HJTUPLE_MINTUPLE(tuple)->t_len;
-				pfree(tuple);
+				if (!HJTUPLE_IS_SHARED(hashtable, tuple))
+					pfree(tuple);
 				nfreed++;
 			}
 
@@ -669,8 +760,8 @@ ExecHashIncreaseNumBatches(HashJoinTable hashtable)
 	 * further expansion of nbatch.  This situation implies that we have
 	 * enough tuples of identical hashvalues to overflow spaceAllowed.
 	 * Increasing nbatch will not fix it since there's no way to subdivide the
-	 * group any more finely. We have to just gut it out and hope the server
-	 * has enough RAM.
+	 * group any more finely.  Instead, ExecHashTableInsert will keep the
+	 * tuples that don't fit for later chunks of the batch.
 	 */
 	if (nfreed == 0 || nfreed == ninmemory)
 	{
@@ -701,13 +792,27 @@ ExecHashTableInsert(HashJoinTable hashtable,
 	int			bucketno;
 	int			batchno;
 
+	/*
+	 * If scan workers are inserting into the table as well, leave tuples
+	 * that don't fit in the arena until they are done.
+	 */
+	if (hashtable->sharedBuild)
+	{
+		if (!ExecHashTableInsertShared(hashtable, slot, hashvalue))
+			ExecHashJoinSaveTuple(tuple, hashvalue,
+								  &hashtable->sharedOverflowFile);
+		return;
+	}
+
 	ExecHashGetBucketAndBatch(hashtable, hashvalue,
 							  &bucketno, &batchno);
 
 	/*
 	 * decide whether to put the tuple in the hash table or a temp file
 	 */
-	if (batchno == hashtable->curbatch)
+	if (batchno == hashtable->curbatch &&
+		(hashtable->spaceUsed <= hashtable->spaceAllowed ||
+		 hashtable->growEnabled))
 	{
 		/*
 		 * put the tuple in hash table
@@ -730,9 +835,8 @@ ExecHashTableInsert(HashJoinTable hashtable,
 		 */
 		HeapTupleHeaderClearMatch(HJTUPLE_MINTUPLE(hashTuple));
 
-		/* Push it onto the front of the bucket's list */
-		hashTuple->next = hashtable->buckets[bucketno];
-		hashtable->buckets[bucketno] = hashTuple;
+		/* Push it onto the front of the bucket's list, in a little while */
+		ExecHashTablePendInsert(hashtable, hashTuple, bucketno);
 
 		/* Account for space used, and back off if we've used too much */
 		hashtable->spaceUsed += hashTupleSize;
@@ -741,6 +845,19 @@ ExecHashTableInsert(HashJoinTable hashtable,
 		if (hashtable->spaceUsed > hashtable->spaceAllowed)
 			ExecHashIncreaseNumBatches(hashtable);
 	}
+	else if (batchno == hashtable->curbatch)
+	{
+		/*
+		 * The table is full and the batch can't be split any further, so
+		 * keep the tuple for a later chunk of the batch.
+		 */
+		if (hashtable->chunkInnerFile == NULL)
+			hashtable->nchunkedBatches++;
+		ExecHashJoinSaveTuple(tuple,
+							  hashvalue,
+							  &hashtable->chunkInnerFile);
+		hashtable->chunkInnerTuples++;
+	}
 	else
 	{
 		/*
@@ -753,6 +870,338 @@ ExecHashTableInsert(HashJoinTable hashtable,
 	}
 }
 
+/*
+ * ExecHashTablePendInsert
+ *		push a new tuple onto the front of its bucket's list, eventually
+ *
+ * In a large table, the bucket header is unlikely to be in cache.  So we
+ * just prefetch it for now, and link in the tuple inserted
+ * HJ_PREFETCH_DISTANCE tuples earlier instead, whose bucket header has had
+ * time to arrive.  Whoever looks at the buckets next must call
+ * ExecHashTableFlushInserts first.
+ */
+static void
+ExecHashTablePendInsert(HashJoinTable hashtable, HashJoinTuple hashTuple,
+						int bucketno)
+{
+	int			pos = hashtable->nextPendingInsert;
+
+	if (hashtable->nPendingInserts == HJ_PREFETCH_DISTANCE)
+	{
+		HashJoinTuple oldTuple = hashtable->pendingInserts[pos];
+		int			oldbucketno;
+		int			oldbatchno;
+
+		ExecHashGetBucketAndBatch(hashtable, oldTuple->hashvalue,
+								  &oldbucketno, &oldbatchno);
+		oldTuple->next = hashtable->buckets[oldbucketno];
+		hashtable->buckets[oldbucketno] = oldTuple;
+	}
+	else
+		hashtable->nPendingInserts++;
+
+	pg_prefetch(&hashtable->buckets[bucketno]);
+	hashtable->pendingInserts[pos] = hashTuple;
+	hashtable->nextPendingInsert = (pos + 1) % HJ_PREFETCH_DISTANCE;
+}
+
+/*
+ * ExecHashTableFlushInserts
+ *		link all tuples still pending insertion into their buckets
+ */
+void
+ExecHashTableFlushInserts(HashJoinTable hashtable)
+{
+	int			i;
+
+	for (i = 0; i < hashtable->nPendingInserts; i++)
+	{
+		HashJoinTuple hashTuple = hashtable->pendingInserts[i];
+		int			bucketno;
+		int			batchno;
+
+		ExecHashGetBucketAndBatch(hashtable, hashTuple->hashvalue,
+								  &bucketno, &batchno);
+		hashTuple->next = hashtable->buckets[bucketno];
+		hashtable->buckets[bucketno] = hashTuple;
+	}
+
+	hashtable->nPendingInserts = 0;
+	hashtable->nextPendingInsert = 0;
+}
+
+/*
+ * ExecHashTableShare
+ *		move the (still empty) hash table into the scan workers' hash arena,
+ *		so that they can insert into it too
+ *
+ * Returns false if the arena is not available, in which case the table is
+ * left alone.  Otherwise, all tuples are inserted with
+ * ExecHashTableInsertShared until MultiExecHash is done.
+ */
+bool
+ExecHashTableShare(HashJoinTable hashtable, int nkeys)
+{
+#ifdef HAVE_PG_ATOMICS
+	SharedHashJoinTable shared;
+	Size		size;
+	Size		offset;
+	char	   *arena;
+	int			i;
+
+	Assert(hashtable->nbatch == 1 && hashtable->totalTuples == 0);
+
+	/* skew buckets are only used with several batches, but be sure */
+	if (hashtable->skewEnabled)
+		return false;
+
+	arena = (char *) ScanWorkersGetHashArena(&size);
+	if (arena == NULL)
+		return false;
+
+	/* lay out the control data, hash functions and buckets */
+	offset = MAXALIGN(sizeof(SharedHashJoinTableData));
+	offset += MAXALIGN(nkeys * sizeof(Oid));
+	offset += MAXALIGN(nkeys * sizeof(bool));
+	offset += MAXALIGN(hashtable->nbuckets * sizeof(HashJoinTuple));
+	if (offset + SHARED_HASH_CHUNK_SIZE > size)
+	{
+		ScanWorkersReleaseHashArena();
+		return false;
+	}
+
+	shared = (SharedHashJoinTable) arena;
+	shared->size = size;
+	shared->limit = Min(size, offset + hashtable->spaceAllowed);
+	shared->nbuckets = hashtable->nbuckets;
+	shared->log2_nbuckets = hashtable->log2_nbuckets;
+	shared->keepNulls = hashtable->keepNulls;
+	shared->nkeys = nkeys;
+	offset = MAXALIGN(sizeof(SharedHashJoinTableData));
+	shared->hashfuncs = (Oid *) (arena + offset);
+	offset += MAXALIGN(nkeys * sizeof(Oid));
+	shared->hashStrict = (bool *) (arena + offset);
+	offset += MAXALIGN(nkeys * sizeof(bool));
+	shared->buckets = (HashJoinTuple *) (arena + offset);
+	offset += MAXALIGN(hashtable->nbuckets * sizeof(HashJoinTuple));
+	for (i = 0; i < nkeys; i++)
+	{
+		shared->hashfuncs[i] = hashtable->inner_hashfunctions[i].fn_oid;
+		shared->hashStrict[i] = hashtable->hashStrict[i];
+	}
+	MemSet(shared->buckets, 0, hashtable->nbuckets * sizeof(HashJoinTuple));
+	shared->used = offset;
+	shared->full = false;
+	shared->workerTuples = 0;
+	shared->workerSpace = 0;
+
+	pfree(hashtable->buckets);
+	hashtable->buckets = shared->buckets;
+	hashtable->shared = shared;
+	hashtable->sharedBuild = true;
+
+	/* tuples that don't fit go to a temp file */
+	PrepareTempTablespaces();
+
+	return true;
+#else
+	return false;
+#endif
+}
+
+/*
+ * ExecHashTableInsertShared
+ *		insert a tuple into a hash table in the hash arena
+ *
+ * This is used by the leader as well as the scan workers.  Returns false,
+ * without inserting the tuple, if it doesn't fit in the arena.
+ */
+bool
+ExecHashTableInsertShared(HashJoinTable hashtable,
+						  TupleTableSlot *slot,
+						  uint32 hashvalue)
+{
+#ifdef HAVE_PG_ATOMICS
+	MinimalTuple tuple = ExecFetchSlotMinimalTuple(slot);
+	HashJoinTuple hashTuple;
+	HashJoinTuple *bucket;
+	Size		hashTupleSize;
+
+	hashTupleSize = MAXALIGN(HJTUPLE_OVERHEAD + tuple->t_len);
+	hashTuple = ExecHashSharedAlloc(hashtable, hashTupleSize);
+	if (hashTuple == NULL)
+		return false;
+
+	hashTuple->hashvalue = hashvalue;
+	memcpy(HJTUPLE_MINTUPLE(hashTuple), tuple, tuple->t_len);
+	HeapTupleHeaderClearMatch(HJTUPLE_MINTUPLE(hashTuple));
+
+	/* push it onto the front of its bucket's list */
+	bucket = &hashtable->buckets[hashvalue & (hashtable->nbuckets - 1)];
+	do
+	{
+		hashTuple->next = *((HashJoinTuple volatile *) bucket);
+	} while (!pg_atomic_compare_exchange(bucket, hashTuple->next, hashTuple));
+
+	hashtable->spaceUsed += hashTupleSize;
+	if (hashtable->spaceUsed > hashtable->spacePeak)
+		hashtable->spacePeak = hashtable->spaceUsed;
+
+	return true;
+#else
+	elog(ERROR, "shared hash tables are not supported on this platform");
+	return false;				/* keep compiler quiet */
+#endif
+}
+
+#ifdef HAVE_PG_ATOMICS
+/*
+ * ExecHashSharedAlloc
+ *		allocate space for a tuple in the hash arena
+ *
+ * Every process takes space from the arena SHARED_HASH_CHUNK_SIZE bytes at
+ * a time, so that it needn't touch the shared allocation pointer for every
+ * tuple.  Returns NULL, and marks the table full, if the arena is exhausted.
+ */
+static HashJoinTuple
+ExecHashSharedAlloc(HashJoinTable hashtable, Size size)
+{
+	SharedHashJoinTable shared = hashtable->shared;
+	char	   *result;
+
+	if (size > hashtable->sharedChunkFree)
+	{
+		Size		chunksize = Max(size, SHARED_HASH_CHUNK_SIZE);
+		Size		start;
+
+		if (shared->full)
+			return NULL;
+		start = pg_atomic_fetch_add(&shared->used, chunksize);
+		if (start + chunksize > shared->limit)
+		{
+			shared->full = true;
+			hashtable->sharedChunkFree = 0;
+			return NULL;
+		}
+		hashtable->sharedChunk = (char *) shared + start;
+		hashtable->sharedChunkFree = chunksize;
+	}
+
+	result = hashtable->sharedChunk;
+	hashtable->sharedChunk += size;
+	hashtable->sharedChunkFree -= size;
+
+	return (HashJoinTuple) result;
+}
+#endif
+
+/*
+ * ExecHashFinishSharedBuild
+ *		take over a hash table the scan workers helped to build
+ *
+ * Called once the inner relation has been scanned completely, so the
+ * workers are done with the table.  Account for the tuples they inserted
+ * and insert the tuples that didn't fit in the arena in the ordinary way,
+ * which might increase the number of batches.
+ */
+static void
+ExecHashFinishSharedBuild(HashState *node)
+{
+	HashJoinTable hashtable = node->hashtable;
+	SharedHashJoinTable shared = hashtable->shared;
+	BufFile    *file = hashtable->sharedOverflowFile;
+	int			i;
+
+	hashtable->sharedBuild = false;
+	hashtable->sharedChunk = NULL;
+	hashtable->sharedChunkFree = 0;
+
+	hashtable->workerTuples = shared->workerTuples;
+	hashtable->totalTuples += shared->workerTuples;
+	hashtable->spaceUsed += shared->workerSpace;
+	if (hashtable->spaceUsed > hashtable->spacePeak)
+		hashtable->spacePeak = hashtable->spaceUsed;
+
+	/* the workers' tuples aren't in the bloom filter yet */
+	if (hashtable->workerTuples > 0)
+	{
+		for (i = 0; i < hashtable->nbuckets; i++)
+		{
+			HashJoinTuple tuple;
+
+			for (tuple = hashtable->buckets[i]; tuple; tuple = tuple->next)
+				hashtable->bloomFilter[BLOOM_WORD(hashtable, tuple->hashvalue)] |=
+					ExecHashBloomBits(tuple->hashvalue);
+		}
+	}
+
+	if (file != NULL)
+	{
+		TupleTableSlot *slot;
+		uint32		hashvalue;
+
+		if (BufFileSeek(file, 0, 0L, SEEK_SET))
+			ereport(ERROR,
+					(errcode_for_file_access(),
+				   errmsg("could not rewind hash-join temporary file: %m")));
+
+		while ((slot = ExecHashJoinGetSavedTuple(file, &hashvalue,
+											node->ps.ps_ResultTupleSlot)))
+			ExecHashTableInsert(hashtable, slot, hashvalue);
+
+		BufFileClose(file);
+		hashtable->sharedOverflowFile = NULL;
+	}
+}
+
+/*
+ * ExecHashTableAttach
+ *		set up a scan worker to insert into a shared hash table
+ *
+ * The result is a minimal HashJoinTable, good for ExecHashGetHashValue and
+ * ExecHashTableInsertShared only.
+ */
+HashJoinTable
+ExecHashTableAttach(SharedHashJoinTable shared)
+{
+	HashJoinTable hashtable;
+	int			i;
+
+	hashtable = (HashJoinTable) palloc0(sizeof(HashJoinTableData));
+	hashtable->nbuckets = shared->nbuckets;
+	hashtable->log2_nbuckets = shared->log2_nbuckets;
+	hashtable->buckets = shared->buckets;
+	hashtable->nbatch = 1;
+	hashtable->nbatch_original = 1;
+	hashtable->keepNulls = shared->keepNulls;
+	hashtable->hashStrict = shared->hashStrict;
+	hashtable->shared = shared;
+	hashtable->sharedBuild = true;
+	hashtable->inner_hashfunctions = (FmgrInfo *)
+		palloc(shared->nkeys * sizeof(FmgrInfo));
+	for (i = 0; i < shared->nkeys; i++)
+		fmgr_info(shared->hashfuncs[i], &hashtable->inner_hashfunctions[i]);
+
+	return hashtable;
+}
+
+/*
+ * ExecHashTableDetach
+ *		a scan worker is done inserting into a shared hash table
+ */
+void
+ExecHashTableDetach(HashJoinTable hashtable)
+{
+#ifdef HAVE_PG_ATOMICS
+	pg_atomic_fetch_add(&hashtable->shared->workerTuples,
+						(Size) hashtable->totalTuples);
+	pg_atomic_fetch_add(&hashtable->shared->workerSpace,
+						hashtable->spaceUsed);
+#endif
+	pfree(hashtable->inner_hashfunctions);
+	pfree(hashtable);
+}
+
 /*
  * ExecHashGetHashValue
  *		Compute the hash value for a tuple
@@ -927,6 +1376,7 @@ ExecScanHashBucket(HashJoinState *hjstate,
 		if (hashTuple->hashvalue == hashvalue)
 		{
 			TupleTableSlot *inntuple;
+			bool		matched;
 
 			/* insert hashtable's tuple into exec slot so ExecQual sees it */
 			inntuple = ExecStoreMinimalTuple(HJTUPLE_MINTUPLE(hashTuple),
@@ -937,7 +1387,12 @@ ExecScanHashBucket(HashJoinState *hjstate,
 			/* reset temp memory each time to avoid leaks from qual expr */
 			ResetExprContext(econtext);
 
-			if (ExecQual(hjclauses, econtext, false))
+			if (hjstate->hj_MatchFunc != NULL)
+				matched = hjstate->hj_MatchFunc(hjstate, econtext);
+			else
+				matched = ExecQual(hjclauses, econtext, false);
+
+			if (matched)
 			{
 				hjstate->hj_CurTuple = hashTuple;
 				return true;
@@ -1058,6 +1513,11 @@ ExecHashTableReset(HashJoinTable hashtable)
 	 * Release all the hash buckets and tuples acquired in the prior pass, and
 	 * reinitialize the context for a new pass.
 	 */
+	if (hashtable->shared)
+	{
+		ScanWorkersReleaseHashArena();
+		hashtable->shared = NULL;
+	}
 	MemoryContextReset(hashtable->batchCxt);
 	oldcxt = MemoryContextSwitchTo(hashtable->batchCxt);
 
@@ -1066,6 +1526,8 @@ ExecHashTableReset(HashJoinTable hashtable)
 		palloc0(nbuckets * sizeof(HashJoinTuple));
 
 	hashtable->spaceUsed = 0;
+	hashtable->nPendingInserts = 0;
+	hashtable->nextPendingInsert = 0;
 
 	MemoryContextSwitchTo(oldcxt);
 }
@@ -1401,7 +1863,9 @@ ExecHashRemoveNextSkewBucket(HashJoinTable hashtable)
 		/*
 		 * This code must agree with ExecHashTableInsert.  We do not use
 		 * ExecHashTableInsert directly as ExecHashTableInsert expects a
-		 * TupleTableSlot while we already have HashJoinTuples.
+		 * TupleTableSlot while we already have HashJoinTuples.  (Unlike it,
+		 * we keep the tuples in memory even if the batch is being processed
+		 * in chunks; they're already there, and any chunk will do.)
 		 */
 		tuple = HJTUPLE_MINTUPLE(hashTuple);
 		tupleSize = HJTUPLE_OVERHEAD + tuple->t_len;
@@ -1462,3 +1926,86 @@ ExecHashRemoveNextSkewBucket(HashJoinTable hashtable)
 		hashtable->spaceUsedSkew = 0;
 	}
 }
+
+/*
+ * ExecHashBloomCreate
+ *
+ *		Allocate the bloom filter for the estimated number of inner
+ *		tuples, within BLOOM_WORK_MEM_PERCENT of work_mem.
+ *
+ * The filter lives in the hashCxt, as it covers all batches.
+ */
+static void
+ExecHashBloomCreate(HashJoinTable hashtable, double ntuples)
+{
+	long		maxwords;
+	long		nwords;
+
+	maxwords = work_mem * 1024L * BLOOM_WORK_MEM_PERCENT / 100 /
+		sizeof(uint64);
+
+	nwords = BLOOM_MIN_WORDS;
+	while (nwords * 64.0 < ntuples * BLOOM_BITS_PER_TUPLE &&
+		   nwords * 2 <= maxwords)
+		nwords *= 2;
+
+	hashtable->bloomFilter = (uint64 *)
+		MemoryContextAllocZero(hashtable->hashCxt, nwords * sizeof(uint64));
+	hashtable->bloomShift = 32 - my_log2(nwords);
+	hashtable->bloomEnabled = true;
+}
+
+/*
+ * ExecHashBloomBits
+ *
+ *		The bits a hash value sets in its word of the bloom filter.
+ */
+static uint64
+ExecHashBloomBits(uint32 hashvalue)
+{
+	uint64		bits = 0;
+	int			i;
+
+	for (i = 0; i < BLOOM_NUM_BITS; i++)
+	{
+		bits |= UINT64CONST(1) << (hashvalue & 63);
+		hashvalue >>= 6;
+	}
+
+	return bits;
+}
+
+/*
+ * ExecHashBloomCheck
+ *
+ *		Returns false if no inner tuple has the given hash value, so that
+ *		an outer tuple with that hash value can't have a match.  Returns
+ *		true if there may be one, or if the filter isn't in use.
+ *
+ * Once enough outer tuples have been checked, the filter is given up on if
+ * it rejects too few of them to be worth the trouble.
+ */
+bool
+ExecHashBloomCheck(HashJoinTable hashtable, uint32 hashvalue)
+{
+	uint64		bits;
+
+	if (!hashtable->bloomEnabled)
+		return true;
+
+	hashtable->bloomChecked += 1;
+
+	bits = ExecHashBloomBits(hashvalue);
+	if ((hashtable->bloomFilter[BLOOM_WORD(hashtable, hashvalue)] & bits) != bits)
+	{
+		hashtable->bloomRejected += 1;
+		return false;
+	}
+
+	if (hashtable->bloomChecked >= BLOOM_SAMPLE_TUPLES &&
+		hashtable->bloomRejected <
+		hashtable->bloomChecked * BLOOM_MIN_REJECT_FRACTION)
+		hashtable->bloomEnabled = false;
+
+	return true;
+}
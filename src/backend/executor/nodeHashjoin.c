@@ -20,7 +20,11 @@
 #include "executor/hashjoin.h"
 #include "executor/nodeHash.h"
 #include "executor/nodeHashjoin.h"
+#include "executor/nodeSeqscan.h"
 #include "miscadmin.h"
+#include "nodes/nodeFuncs.h"
+#include "optimizer/clauses.h"
+#include "parser/parsetree.h"
 #include "utils/memutils.h"
 
 
@@ -42,11 +46,17 @@
 static TupleTableSlot *ExecHashJoinOuterGetTuple(PlanState *outerNode,
 						  HashJoinState *hjstate,
 						  uint32 *hashvalue);
-static TupleTableSlot *ExecHashJoinGetSavedTuple(HashJoinState *hjstate,
-						  BufFile *file,
-						  uint32 *hashvalue,
-						  TupleTableSlot *tupleSlot);
+static TupleTableSlot *ExecHashJoinOuterNextTuple(PlanState *outerNode,
+						   HashJoinState *hjstate,
+						   uint32 *hashvalue);
+static void ExecHashJoinFillOuterGroup(PlanState *outerNode,
+						   HashJoinState *hjstate);
 static bool ExecHashJoinNewBatch(HashJoinState *hjstate);
+static void ExecHashJoinNewChunk(HashJoinState *hjstate);
+static void ExecHashJoinSetOuterMatched(HashJoinTable hashtable, long tupno);
+static bool ExecHashJoinOuterMatched(HashJoinTable hashtable, long tupno);
+static List *ExecHashJoinScanKeys(HashJoinState *hjstate, HashJoin *node);
+static Node *scan_key_mutator(Node *node, List *scantlist);
 
 
 /* ----------------------------------------------------------------
@@ -185,6 +195,18 @@ ExecHashJoin(HashJoinState *node)
 				if (hashtable->totalTuples == 0 && !HJ_FILL_OUTER(node))
 					return NULL;
 
+				/*
+				 * If the outer scan can check its tuples against the bloom
+				 * filter itself, let it.
+				 */
+				if (node->hj_OuterScanKeys != NIL && hashtable->bloomEnabled)
+				{
+					ExecSeqScanSetBloomFilter((SeqScanState *) outerNode,
+											  hashtable,
+											  node->hj_OuterScanKeys);
+					node->hj_BloomPushedDown = true;
+				}
+
 				/*
 				 * need to remember whether nbatch has increased since we
 				 * began scanning the outer relation
@@ -227,6 +249,22 @@ ExecHashJoin(HashJoinState *node)
 				econtext->ecxt_outertuple = outerTupleSlot;
 				node->hj_MatchedOuter = false;
 
+				/*
+				 * If the bloom filter says that no inner tuple has this hash
+				 * value, the tuple can't have a match, and we needn't look
+				 * for one or save it for a later batch.  Tuples read back
+				 * from batch files have passed the filter already, as have
+				 * those of an outer scan that checks it itself.
+				 */
+				if (hashtable->curbatch == 0 && hashtable->curchunk == 0 &&
+					!node->hj_BloomPushedDown &&
+					!ExecHashBloomCheck(hashtable, hashvalue))
+				{
+					if (HJ_FILL_OUTER(node))
+						node->hj_JoinState = HJ_FILL_OUTER_TUPLE;
+					continue;
+				}
+
 				/*
 				 * Find the corresponding bucket for this tuple in the main
 				 * hash table or skew hash table.
@@ -257,6 +295,20 @@ ExecHashJoin(HashJoinState *node)
 					continue;
 				}
 
+				/*
+				 * If the batch didn't fit in memory, the tuple must be
+				 * matched against the later chunks of it, too.
+				 */
+				if (hashtable->curchunk == 0 &&
+					hashtable->chunkInnerFile != NULL &&
+					node->hj_CurSkewBucketNo == INVALID_SKEW_BUCKET_NO)
+				{
+					ExecHashJoinSaveTuple(ExecFetchSlotMinimalTuple(outerTupleSlot),
+										  hashvalue,
+										  &hashtable->chunkOuterFile);
+					node->hj_CurOuterTupleNo = hashtable->chunkOuterTuples++;
+				}
+
 				/* OK, let's scan the bucket for matches */
 				node->hj_JoinState = HJ_SCAN_BUCKET;
 
@@ -297,6 +349,10 @@ ExecHashJoin(HashJoinState *node)
 				{
 					node->hj_MatchedOuter = true;
 					HeapTupleHeaderSetMatch(HJTUPLE_MINTUPLE(node->hj_CurTuple));
+					if (node->hj_CurOuterTupleNo >= 0 &&
+						(HJ_FILL_OUTER(node) || node->js.jointype == JOIN_SEMI))
+						ExecHashJoinSetOuterMatched(hashtable,
+													node->hj_CurOuterTupleNo);
 
 					/* In an antijoin, we never return a matched tuple */
 					if (node->js.jointype == JOIN_ANTI)
@@ -345,6 +401,17 @@ ExecHashJoin(HashJoinState *node)
 				if (!node->hj_MatchedOuter &&
 					HJ_FILL_OUTER(node))
 				{
+					/*
+					 * If the batch is processed in chunks, the tuple might
+					 * yet match in a later chunk, or have matched in an
+					 * earlier one.
+					 */
+					if (node->hj_CurOuterTupleNo >= 0 &&
+						(hashtable->chunkInnerFile != NULL ||
+						 ExecHashJoinOuterMatched(hashtable,
+												  node->hj_CurOuterTupleNo)))
+						break;
+
 					/*
 					 * Generate a fake join tuple with nulls for the inner
 					 * tuple, and return it if it passes the non-join quals.
@@ -411,9 +478,13 @@ ExecHashJoin(HashJoinState *node)
 			case HJ_NEED_NEW_BATCH:
 
 				/*
-				 * Try to advance to next batch.  Done if there are no more.
+				 * Load the next chunk of the current batch if it has more,
+				 * else try to advance to next batch.  Done if there are no
+				 * more.
 				 */
-				if (!ExecHashJoinNewBatch(node))
+				if (hashtable->chunkInnerFile != NULL)
+					ExecHashJoinNewChunk(node);
+				else if (!ExecHashJoinNewBatch(node))
 					return NULL;	/* end of join */
 				node->hj_JoinState = HJ_NEED_NEW_OUTER;
 				break;
@@ -558,6 +629,14 @@ ExecInitHashJoin(HashJoin *node, EState *estate, int eflags)
 	hjstate->hj_CurBucketNo = 0;
 	hjstate->hj_CurSkewBucketNo = INVALID_SKEW_BUCKET_NO;
 	hjstate->hj_CurTuple = NULL;
+	hjstate->hj_CurOuterTupleNo = -1;
+
+	hjstate->hj_OuterGroup = (MinimalTuple *)
+		palloc(HJ_PREFETCH_DISTANCE * sizeof(MinimalTuple));
+	hjstate->hj_OuterGroupHashValues = (uint32 *)
+		palloc(HJ_PREFETCH_DISTANCE * sizeof(uint32));
+	hjstate->hj_OuterGroupSize = 0;
+	hjstate->hj_OuterGroupNext = 0;
 
 	/*
 	 * Deconstruct the hash clauses into outer and inner argument values, so
@@ -586,10 +665,27 @@ ExecInitHashJoin(HashJoin *node, EState *estate, int eflags)
 	/* child Hash node needs to evaluate inner hash keys, too */
 	((HashState *) innerPlanState(hjstate))->hashkeys = rclauses;
 
+	/*
+	 * If the outer plan is a plain seqscan, and outer tuples without a match
+	 * needn't be returned, the scan can discard tuples the bloom filter
+	 * rejects before they're even returned to us.  For that, it needs the
+	 * outer hash keys in terms of its scan tuple.
+	 */
+	hjstate->hj_OuterScanKeys = NIL;
+	hjstate->hj_BloomPushedDown = false;
+	if ((node->join.jointype == JOIN_INNER ||
+		 node->join.jointype == JOIN_SEMI ||
+		 node->join.jointype == JOIN_RIGHT) &&
+		IsA(outerPlanState(hjstate), SeqScanState))
+		hjstate->hj_OuterScanKeys = ExecHashJoinScanKeys(hjstate, node);
+
 	hjstate->js.ps.ps_TupFromTlist = false;
 	hjstate->hj_JoinState = HJ_BUILD_HASHTABLE;
 	hjstate->hj_MatchedOuter = false;
 	hjstate->hj_OuterNotEmpty = false;
+	hjstate->hj_OuterHashValueFunc = NULL;
+	hjstate->hj_MatchFunc = NULL;
+	hjstate->hj_JitArg = NULL;
 
 	return hjstate;
 }
@@ -647,6 +743,73 @@ static TupleTableSlot *
 ExecHashJoinOuterGetTuple(PlanState *outerNode,
 						  HashJoinState *hjstate,
 						  uint32 *hashvalue)
+{
+	HashJoinTable hashtable = hjstate->hj_HashTable;
+	TupleTableSlot *slot;
+
+	if (hashtable->curchunk > 0)	/* if it is a later chunk of the batch */
+	{
+		BufFile    *file = hashtable->chunkOuterFile;
+
+		if (file == NULL)
+			return NULL;
+
+		while ((slot = ExecHashJoinGetSavedTuple(file,
+												 hashvalue,
+												 hjstate->hj_OuterTupleSlot)))
+		{
+			hjstate->hj_CurOuterTupleNo = hashtable->chunkOuterRead++;
+
+			/* semi- and antijoins are done with a tuple once it matched */
+			if ((hjstate->js.jointype == JOIN_SEMI ||
+				 hjstate->js.jointype == JOIN_ANTI) &&
+				ExecHashJoinOuterMatched(hashtable, hjstate->hj_CurOuterTupleNo))
+				continue;
+
+			return slot;
+		}
+
+		return NULL;
+	}
+
+	hjstate->hj_CurOuterTupleNo = -1;
+
+	/*
+	 * If the hash table is too big for the CPU caches, read the outer tuples
+	 * in groups, prefetching the buckets they'll probe (see hashjoin.h).
+	 */
+	if (hashtable->spaceUsed + hashtable->nbuckets * sizeof(HashJoinTuple) >=
+		HJ_PREFETCH_MIN_SPACE)
+	{
+		int			i;
+
+		if (hjstate->hj_OuterGroupNext == hjstate->hj_OuterGroupSize)
+		{
+			ExecHashJoinFillOuterGroup(outerNode, hjstate);
+			if (hjstate->hj_OuterGroupSize == 0)
+				return NULL;
+		}
+
+		i = hjstate->hj_OuterGroupNext++;
+		*hashvalue = hjstate->hj_OuterGroupHashValues[i];
+		return ExecStoreMinimalTuple(hjstate->hj_OuterGroup[i],
+									 hjstate->hj_OuterTupleSlot,
+									 true);
+	}
+
+	return ExecHashJoinOuterNextTuple(outerNode, hjstate, hashvalue);
+}
+
+/*
+ * ExecHashJoinOuterNextTuple
+ *
+ *		workhorse of ExecHashJoinOuterGetTuple: get the next outer tuple
+ *		of the current batch, outside any later chunk.
+ */
+static TupleTableSlot *
+ExecHashJoinOuterNextTuple(PlanState *outerNode,
+						   HashJoinState *hjstate,
+						   uint32 *hashvalue)
 {
 	HashJoinTable hashtable = hjstate->hj_HashTable;
 	int			curbatch = hashtable->curbatch;
@@ -670,13 +833,21 @@ ExecHashJoinOuterGetTuple(PlanState *outerNode,
 			 * We have to compute the tuple's hash value.
 			 */
 			ExprContext *econtext = hjstate->js.ps.ps_ExprContext;
+			bool		hashed;
 
 			econtext->ecxt_outertuple = slot;
-			if (ExecHashGetHashValue(hashtable, econtext,
-									 hjstate->hj_OuterHashKeys,
-									 true,		/* outer tuple */
-									 HJ_FILL_OUTER(hjstate),
-									 hashvalue))
+			if (hjstate->hj_OuterHashValueFunc != NULL)
+				hashed = hjstate->hj_OuterHashValueFunc(&hjstate->js.ps,
+														hashtable, econtext,
+														HJ_FILL_OUTER(hjstate),
+														hashvalue);
+			else
+				hashed = ExecHashGetHashValue(hashtable, econtext,
+											  hjstate->hj_OuterHashKeys,
+											  true,		/* outer tuple */
+											  HJ_FILL_OUTER(hjstate),
+											  hashvalue);
+			if (hashed)
 			{
 				/* remember outer relation is not empty for possible rescan */
 				hjstate->hj_OuterNotEmpty = true;
@@ -702,8 +873,7 @@ ExecHashJoinOuterGetTuple(PlanState *outerNode,
 		if (file == NULL)
 			return NULL;
 
-		slot = ExecHashJoinGetSavedTuple(hjstate,
-										 file,
+		slot = ExecHashJoinGetSavedTuple(file,
 										 hashvalue,
 										 hjstate->hj_OuterTupleSlot);
 		if (!TupIsNull(slot))
@@ -714,6 +884,104 @@ ExecHashJoinOuterGetTuple(PlanState *outerNode,
 	return NULL;
 }
 
+/*
+ * ExecHashJoinFillOuterGroup
+ *
+ *		read the next group of outer tuples into hj_OuterGroup
+ *
+ * The bucket headers of all the tuples in the group are prefetched first;
+ * once the first of them should have arrived, the first tuples of those
+ * buckets are prefetched too.  The tuples have to be copied, since the outer
+ * plan is free to overwrite its slot with each one.
+ */
+static void
+ExecHashJoinFillOuterGroup(PlanState *outerNode, HashJoinState *hjstate)
+{
+	HashJoinTable hashtable = hjstate->hj_HashTable;
+	int			bucketnos[HJ_PREFETCH_DISTANCE];
+	int			n;
+	int			i;
+
+	for (n = 0; n < HJ_PREFETCH_DISTANCE; n++)
+	{
+		TupleTableSlot *slot;
+		uint32		hashvalue;
+		int			batchno;
+
+		slot = ExecHashJoinOuterNextTuple(outerNode, hjstate, &hashvalue);
+		if (TupIsNull(slot))
+			break;
+
+		hjstate->hj_OuterGroup[n] = ExecCopySlotMinimalTuple(slot);
+		hjstate->hj_OuterGroupHashValues[n] = hashvalue;
+		ExecHashGetBucketAndBatch(hashtable, hashvalue,
+								  &bucketnos[n], &batchno);
+		pg_prefetch(&hashtable->buckets[bucketnos[n]]);
+	}
+
+	for (i = 0; i < n; i++)
+		pg_prefetch(hashtable->buckets[bucketnos[i]]);
+
+	hjstate->hj_OuterGroupSize = n;
+	hjstate->hj_OuterGroupNext = 0;
+}
+
+/*
+ * ExecHashJoinScanKeys
+ *		make the outer hash keys evaluable by the outer scan node
+ *
+ * The keys refer to the outer plan's targetlist; those references are
+ * replaced by the targetlist entries, and the result is initialized as
+ * expressions of the scan node.  Returns NIL if the keys aren't fit to be
+ * evaluated twice.
+ */
+static List *
+ExecHashJoinScanKeys(HashJoinState *hjstate, HashJoin *node)
+{
+	Plan	   *outerplan = outerPlan(node);
+	List	   *keys = NIL;
+	ListCell   *l;
+
+	foreach(l, node->hashclauses)
+	{
+		OpExpr	   *hclause = (OpExpr *) lfirst(l);
+
+		Assert(IsA(hclause, OpExpr));
+		keys = lappend(keys,
+					   scan_key_mutator((Node *) linitial(hclause->args),
+										outerplan->targetlist));
+	}
+
+	if (contain_volatile_functions((Node *) keys) ||
+		contain_subplans((Node *) keys))
+		return NIL;
+
+	return (List *) ExecInitExpr((Expr *) keys, outerPlanState(hjstate));
+}
+
+/*
+ * Expand references to the outer plan's targetlist in an outer hash key
+ */
+static Node *
+scan_key_mutator(Node *node, List *scantlist)
+{
+	if (node == NULL)
+		return NULL;
+	if (IsA(node, Var))
+	{
+		Var		   *var = (Var *) node;
+		TargetEntry *tle;
+
+		Assert(var->varno == OUTER_VAR);
+		tle = get_tle_by_resno(scantlist, var->varattno);
+		if (tle == NULL)
+			elog(ERROR, "variable not found in subplan target list");
+		return (Node *) copyObject(tle->expr);
+	}
+	return expression_tree_mutator(node, scan_key_mutator,
+								   (void *) scantlist);
+}
+
 /*
  * ExecHashJoinNewBatch
  *		switch to a new hashjoin batch
@@ -733,6 +1001,22 @@ ExecHashJoinNewBatch(HashJoinState *hjstate)
 	nbatch = hashtable->nbatch;
 	curbatch = hashtable->curbatch;
 
+	/*
+	 * If the previous batch was processed in chunks, we're done with its
+	 * outer tuples now.
+	 */
+	Assert(hashtable->chunkInnerFile == NULL);
+	if (hashtable->chunkOuterFile)
+		BufFileClose(hashtable->chunkOuterFile);
+	hashtable->chunkOuterFile = NULL;
+	if (hashtable->chunkOuterMatched)
+		pfree(hashtable->chunkOuterMatched);
+	hashtable->chunkOuterMatched = NULL;
+	hashtable->chunkOuterMatchedSize = 0;
+	hashtable->chunkOuterTuples = 0;
+	hashtable->chunkOuterRead = 0;
+	hashtable->curchunk = 0;
+
 	if (curbatch > 0)
 	{
 		/*
@@ -822,8 +1106,7 @@ ExecHashJoinNewBatch(HashJoinState *hjstate)
 					(errcode_for_file_access(),
 				   errmsg("could not rewind hash-join temporary file: %m")));
 
-		while ((slot = ExecHashJoinGetSavedTuple(hjstate,
-												 innerFile,
+		while ((slot = ExecHashJoinGetSavedTuple(innerFile,
 												 &hashvalue,
 												 hjstate->hj_HashTupleSlot)))
 		{
@@ -833,6 +1116,7 @@ ExecHashJoinNewBatch(HashJoinState *hjstate)
 			 */
 			ExecHashTableInsert(hashtable, slot, hashvalue);
 		}
+		ExecHashTableFlushInserts(hashtable);
 
 		/*
 		 * after we build the hash table, the inner batch file is no longer
@@ -856,6 +1140,132 @@ ExecHashJoinNewBatch(HashJoinState *hjstate)
 	return true;
 }
 
+/*
+ * ExecHashJoinNewChunk
+ *		switch to the next chunk of an oversized batch
+ *
+ * The hash table is reloaded with as many of the batch's remaining inner
+ * tuples as fit, and the batch's outer tuples are rewound for another pass.
+ */
+static void
+ExecHashJoinNewChunk(HashJoinState *hjstate)
+{
+	HashJoinTable hashtable = hjstate->hj_HashTable;
+	BufFile    *innerFile = hashtable->chunkInnerFile;
+	TupleTableSlot *slot;
+	uint32		hashvalue;
+
+	Assert(innerFile != NULL && hashtable->chunkInnerTuples > 0);
+
+	if (hashtable->curchunk == 0)
+	{
+		/*
+		 * The outer tuples that matched the skew hashtable, if any, are done
+		 * with; it goes away with the rest of the first chunk.
+		 */
+		hashtable->skewEnabled = false;
+		hashtable->skewBucket = NULL;
+		hashtable->skewBucketNums = NULL;
+		hashtable->nSkewBuckets = 0;
+		hashtable->spaceUsedSkew = 0;
+
+		if (BufFileSeek(innerFile, 0, 0L, SEEK_SET))
+			ereport(ERROR,
+					(errcode_for_file_access(),
+				   errmsg("could not rewind hash-join temporary file: %m")));
+	}
+	hashtable->curchunk++;
+
+	ExecHashTableReset(hashtable);
+
+	/*
+	 * Growth of nbatch is disabled by now, so ExecHashTableInsert puts all
+	 * these tuples in memory, as long as there's room.
+	 */
+	Assert(!hashtable->growEnabled);
+	while (hashtable->chunkInnerTuples > 0 &&
+		   hashtable->spaceUsed <= hashtable->spaceAllowed)
+	{
+		slot = ExecHashJoinGetSavedTuple(innerFile,
+										 &hashvalue,
+										 hjstate->hj_HashTupleSlot);
+		if (TupIsNull(slot))
+			ereport(ERROR,
+					(errcode_for_file_access(),
+				errmsg("unexpected end of hash-join temporary file")));
+		hashtable->chunkInnerTuples--;
+		ExecHashTableInsert(hashtable, slot, hashvalue);
+	}
+	ExecHashTableFlushInserts(hashtable);
+
+	/* if that was the last chunk, we're done with the file */
+	if (hashtable->chunkInnerTuples == 0)
+	{
+		BufFileClose(innerFile);
+		hashtable->chunkInnerFile = NULL;
+	}
+
+	hashtable->chunkOuterRead = 0;
+	if (hashtable->chunkOuterFile != NULL)
+	{
+		if (BufFileSeek(hashtable->chunkOuterFile, 0, 0L, SEEK_SET))
+			ereport(ERROR,
+					(errcode_for_file_access(),
+				   errmsg("could not rewind hash-join temporary file: %m")));
+	}
+}
+
+/*
+ * ExecHashJoinSetOuterMatched
+ *		remember that an outer tuple of a chunked batch has found a match
+ *
+ * tupno is the tuple's position in chunkOuterFile.  The bitmap is enlarged
+ * as needed; bits beyond its end are implicitly zero.
+ */
+static void
+ExecHashJoinSetOuterMatched(HashJoinTable hashtable, long tupno)
+{
+	long		byteno = tupno / BITS_PER_BYTE;
+
+	if (byteno >= hashtable->chunkOuterMatchedSize)
+	{
+		long		oldsize = hashtable->chunkOuterMatchedSize;
+		long		newsize = Max(oldsize * 2, 1024);
+
+		while (newsize <= byteno)
+			newsize *= 2;
+
+		if (hashtable->chunkOuterMatched == NULL)
+			hashtable->chunkOuterMatched = (uint8 *)
+				MemoryContextAllocZero(hashtable->hashCxt, newsize);
+		else
+		{
+			hashtable->chunkOuterMatched = (uint8 *)
+				repalloc(hashtable->chunkOuterMatched, newsize);
+			memset(hashtable->chunkOuterMatched + oldsize, 0,
+				   newsize - oldsize);
+		}
+		hashtable->chunkOuterMatchedSize = newsize;
+	}
+
+	hashtable->chunkOuterMatched[byteno] |= 1 << (tupno % BITS_PER_BYTE);
+}
+
+/*
+ * ExecHashJoinOuterMatched
+ *		has an outer tuple of a chunked batch found a match yet?
+ */
+static bool
+ExecHashJoinOuterMatched(HashJoinTable hashtable, long tupno)
+{
+	long		byteno = tupno / BITS_PER_BYTE;
+
+	if (byteno >= hashtable->chunkOuterMatchedSize)
+		return false;
+	return (hashtable->chunkOuterMatched[byteno] &
+			(1 << (tupno % BITS_PER_BYTE))) != 0;
+}
+
 /*
  * ExecHashJoinSaveTuple
  *		save a tuple to a batch file.
@@ -901,9 +1311,8 @@ ExecHashJoinSaveTuple(MinimalTuple tuple, uint32 hashvalue,
  * On success, *hashvalue is set to the tuple's hash value, and the tuple
  * itself is stored in the given slot.
  */
-static TupleTableSlot *
-ExecHashJoinGetSavedTuple(HashJoinState *hjstate,
-						  BufFile *file,
+TupleTableSlot *
+ExecHashJoinGetSavedTuple(BufFile *file,
 						  uint32 *hashvalue,
 						  TupleTableSlot *tupleSlot)
 {
@@ -946,13 +1355,14 @@ ExecReScanHashJoin(HashJoinState *node)
 	/*
 	 * In a multi-batch join, we currently have to do rescans the hard way,
 	 * primarily because batch temp files may have already been released. But
-	 * if it's a single-batch join, and there is no parameter change for the
-	 * inner subnode, then we can just re-use the existing hash table without
-	 * rebuilding it.
+	 * if it's a single-batch join whose batch fit in memory, and there is no
+	 * parameter change for the inner subnode, then we can just re-use the
+	 * existing hash table without rebuilding it.
 	 */
 	if (node->hj_HashTable != NULL)
 	{
 		if (node->hj_HashTable->nbatch == 1 &&
+			node->hj_HashTable->nchunkedBatches == 0 &&
 			node->js.ps.righttree->chgParam == NULL)
 		{
 			/*
@@ -981,6 +1391,12 @@ ExecReScanHashJoin(HashJoinState *node)
 		else
 		{
 			/* must destroy and rebuild hash table */
+			if (node->hj_BloomPushedDown)
+			{
+				ExecSeqScanSetBloomFilter((SeqScanState *) outerPlanState(node),
+										  NULL, NIL);
+				node->hj_BloomPushedDown = false;
+			}
 			ExecHashTableDestroy(node->hj_HashTable);
 			node->hj_HashTable = NULL;
 			node->hj_JoinState = HJ_BUILD_HASHTABLE;
@@ -999,6 +1415,13 @@ ExecReScanHashJoin(HashJoinState *node)
 	node->hj_CurBucketNo = 0;
 	node->hj_CurSkewBucketNo = INVALID_SKEW_BUCKET_NO;
 	node->hj_CurTuple = NULL;
+	node->hj_CurOuterTupleNo = -1;
+
+	/* Discard any outer tuples read ahead */
+	while (node->hj_OuterGroupNext < node->hj_OuterGroupSize)
+		pfree(node->hj_OuterGroup[node->hj_OuterGroupNext++]);
+	node->hj_OuterGroupSize = 0;
+	node->hj_OuterGroupNext = 0;
 
 	node->js.ps.ps_TupFromTlist = false;
 	node->hj_MatchedOuter = false;
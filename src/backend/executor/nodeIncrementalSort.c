@@ -0,0 +1,353 @@
+/*-------------------------------------------------------------------------
+ *
+ * nodeIncrementalSort.c
+ *	  Routines to handle sorting of relations that are already sorted on a
+ *	  leading part of the sort keys.
+ *
+ * If the input is sorted on (a) and we need it sorted on (a, b), only the
+ * tuples with equal values of a need to be put in order.  So rather than
+ * reading and sorting the whole input before returning the first tuple,
+ * as a Sort does, we read one group of tuples with equal values of the
+ * presorted columns at a time, sort it, and return it.  That makes for
+ * many small sorts that fit in work_mem, and a LIMIT above us can stop the
+ * scan after the first few groups.
+ *
+ * To keep the per-sort overhead down when groups are small, a batch
+ * contains at least INCREMENTAL_SORT_MIN_BATCH tuples, and as many groups
+ * as that takes.  Batches are sorted on all the sort columns, so it makes
+ * no difference how many groups each contains.
+ *
+ * Portions Copyright (c) 1996-2013, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ *
+ * IDENTIFICATION
+ *	  src/backend/executor/nodeIncrementalSort.c
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+
+#include "executor/execdebug.h"
+#include "executor/executor.h"
+#include "executor/nodeIncrementalSort.h"
+#include "miscadmin.h"
+#include "utils/lsyscache.h"
+#include "utils/tuplesort.h"
+
+
+static bool IncrementalSortReadBatch(IncrementalSortState *node);
+static void IncrementalSortEndBatch(IncrementalSortState *node);
+
+
+/* ----------------------------------------------------------------
+ *		ExecIncrementalSort
+ *
+ *		Returns the next tuple of the current batch, reading and
+ *		sorting the next batch from the outer subtree when the current
+ *		one is exhausted.
+ *
+ *		Conditions:
+ *		  -- the outer subtree returns tuples sorted on the presorted
+ *			 columns.
+ *
+ *		Initial States:
+ *		  -- the outer child is prepared to return the first tuple.
+ * ----------------------------------------------------------------
+ */
+TupleTableSlot *
+ExecIncrementalSort(IncrementalSortState *node)
+{
+	TupleTableSlot *slot = node->ss.ps.ps_ResultTupleSlot;
+
+	for (;;)
+	{
+		if (node->tuplesortstate != NULL)
+		{
+			if (tuplesort_gettupleslot((Tuplesortstate *) node->tuplesortstate,
+									   true, slot))
+			{
+				node->bound_Done++;
+				return slot;
+			}
+			IncrementalSortEndBatch(node);
+		}
+
+		if (node->bounded && node->bound_Done >= node->bound)
+			break;
+
+		if (!IncrementalSortReadBatch(node))
+			break;
+	}
+
+	return ExecClearTuple(slot);
+}
+
+/*
+ * Read the next batch of tuples from the outer subtree and sort it.
+ *
+ * Returns false if there are no more tuples.
+ */
+static bool
+IncrementalSortReadBatch(IncrementalSortState *node)
+{
+	IncrementalSort *plannode = (IncrementalSort *) node->ss.ps.plan;
+	PlanState  *outerNode = outerPlanState(node);
+	ExprContext *econtext = node->ss.ps.ps_ExprContext;
+	Tuplesortstate *tuplesortstate;
+	TupleTableSlot *slot;
+	int64		ntuples = 0;
+
+	if (node->outerDone && TupIsNull(node->nextTuple))
+		return false;
+
+	SO1_printf("IncrementalSortReadBatch: %s\n", "reading batch");
+
+	tuplesortstate = tuplesort_begin_heap(ExecGetResultType(outerNode),
+										  plannode->sort.numCols,
+										  plannode->sort.sortColIdx,
+										  plannode->sort.sortOperators,
+										  plannode->sort.collations,
+										  plannode->sort.nullsFirst,
+										  work_mem,
+										  false);
+	if (node->bounded)
+		tuplesort_set_bound(tuplesortstate, node->bound - node->bound_Done);
+	node->tuplesortstate = (void *) tuplesortstate;
+
+	/* the tuple that ended the last batch starts this one */
+	if (!TupIsNull(node->nextTuple))
+	{
+		tuplesort_puttupleslot(tuplesortstate, node->nextTuple);
+		ExecCopySlot(node->groupPivot, node->nextTuple);
+		ExecClearTuple(node->nextTuple);
+		ntuples++;
+	}
+
+	while (!node->outerDone)
+	{
+		slot = ExecProcNode(outerNode);
+		if (TupIsNull(slot))
+		{
+			node->outerDone = true;
+			break;
+		}
+
+		/* does the tuple start a new group? */
+		if (ntuples == 0)
+			ExecCopySlot(node->groupPivot, slot);
+		else if (!execTuplesMatch(node->groupPivot, slot,
+								  plannode->presortedCols,
+								  plannode->sort.sortColIdx,
+								  node->eqfunctions,
+								  econtext->ecxt_per_tuple_memory))
+		{
+			/* if the batch is big enough, the group goes in the next one */
+			if (ntuples >= INCREMENTAL_SORT_MIN_BATCH)
+			{
+				ExecCopySlot(node->nextTuple, slot);
+				break;
+			}
+			ExecCopySlot(node->groupPivot, slot);
+		}
+
+		tuplesort_puttupleslot(tuplesortstate, slot);
+		ntuples++;
+	}
+
+	tuplesort_performsort(tuplesortstate);
+	node->nbatches++;
+
+	SO1_printf("IncrementalSortReadBatch: %s\n", "batch sorted");
+
+	return true;
+}
+
+/*
+ * Release the sort of the current batch, remembering how much space it took
+ * for EXPLAIN ANALYZE.
+ */
+static void
+IncrementalSortEndBatch(IncrementalSortState *node)
+{
+	Tuplesortstate *tuplesortstate = (Tuplesortstate *) node->tuplesortstate;
+
+	if (node->ss.ps.instrument != NULL)
+	{
+		const char *sortMethod;
+		const char *spaceType;
+		long		spaceUsed;
+
+		tuplesort_get_stats(tuplesortstate,
+							&sortMethod, &spaceType, &spaceUsed);
+		if (spaceUsed > node->maxSpace || node->maxSpaceType == NULL)
+		{
+			node->maxSpace = spaceUsed;
+			node->maxSpaceType = spaceType;
+		}
+	}
+
+	tuplesort_end(tuplesortstate);
+	node->tuplesortstate = NULL;
+}
+
+/* ----------------------------------------------------------------
+ *		ExecInitIncrementalSort
+ *
+ *		Creates the run-time state information for the incremental
+ *		sort node produced by the planner and initializes its outer
+ *		subtree.
+ * ----------------------------------------------------------------
+ */
+IncrementalSortState *
+ExecInitIncrementalSort(IncrementalSort *node, EState *estate, int eflags)
+{
+	IncrementalSortState *sortstate;
+	Oid		   *eqOperators;
+	int			i;
+
+	SO1_printf("ExecInitIncrementalSort: %s\n",
+			   "initializing incremental sort node");
+
+	/* we only ever hold one batch, so we can't go back */
+	Assert(!(eflags & (EXEC_FLAG_BACKWARD | EXEC_FLAG_MARK)));
+
+	/*
+	 * create state structure
+	 */
+	sortstate = makeNode(IncrementalSortState);
+	sortstate->ss.ps.plan = (Plan *) node;
+	sortstate->ss.ps.state = estate;
+
+	sortstate->bounded = false;
+	sortstate->bound_Done = 0;
+	sortstate->outerDone = false;
+	sortstate->tuplesortstate = NULL;
+	sortstate->nbatches = 0;
+	sortstate->maxSpace = 0;
+	sortstate->maxSpaceType = NULL;
+
+	/*
+	 * Miscellaneous initialization
+	 *
+	 * We need an ExprContext only for its per-tuple memory, which comparing
+	 * tuples with the group pivot uses.
+	 */
+	ExecAssignExprContext(estate, &sortstate->ss.ps);
+
+	/*
+	 * tuple table initialization
+	 */
+	ExecInitResultTupleSlot(estate, &sortstate->ss.ps);
+	ExecInitScanTupleSlot(estate, &sortstate->ss);
+	sortstate->groupPivot = ExecInitExtraTupleSlot(estate);
+	sortstate->nextTuple = ExecInitExtraTupleSlot(estate);
+
+	/*
+	 * initialize child nodes
+	 *
+	 * We shield the child node from the need to support REWIND, BACKWARD, or
+	 * MARK/RESTORE.
+	 */
+	eflags &= ~(EXEC_FLAG_REWIND | EXEC_FLAG_BACKWARD | EXEC_FLAG_MARK);
+
+	outerPlanState(sortstate) = ExecInitNode(outerPlan(node), estate, eflags);
+
+	/*
+	 * initialize tuple type.  no need to initialize projection info because
+	 * this node doesn't do projections.
+	 */
+	ExecAssignResultTypeFromTL(&sortstate->ss.ps);
+	ExecAssignScanTypeFromOuterPlan(&sortstate->ss);
+	sortstate->ss.ps.ps_ProjInfo = NULL;
+	ExecSetSlotDescriptor(sortstate->groupPivot,
+						  ExecGetResultType(outerPlanState(sortstate)));
+	ExecSetSlotDescriptor(sortstate->nextTuple,
+						  ExecGetResultType(outerPlanState(sortstate)));
+
+	/*
+	 * Precompute fmgr lookup data for comparing the presorted columns.
+	 */
+	eqOperators = (Oid *) palloc(node->presortedCols * sizeof(Oid));
+	for (i = 0; i < node->presortedCols; i++)
+	{
+		eqOperators[i] = get_equality_op_for_ordering_op(node->sort.sortOperators[i],
+														 NULL);
+		if (!OidIsValid(eqOperators[i]))
+			elog(ERROR, "could not find equality operator for ordering operator %u",
+				 node->sort.sortOperators[i]);
+	}
+	sortstate->eqfunctions = execTuplesMatchPrepare(node->presortedCols,
+													eqOperators);
+
+	SO1_printf("ExecInitIncrementalSort: %s\n",
+			   "incremental sort node initialized");
+
+	return sortstate;
+}
+
+/* ----------------------------------------------------------------
+ *		ExecEndIncrementalSort(node)
+ * ----------------------------------------------------------------
+ */
+void
+ExecEndIncrementalSort(IncrementalSortState *node)
+{
+	SO1_printf("ExecEndIncrementalSort: %s\n",
+			   "shutting down incremental sort node");
+
+	/*
+	 * Free the exprcontext
+	 */
+	ExecFreeExprContext(&node->ss.ps);
+
+	/*
+	 * clean out the tuple table
+	 */
+	ExecClearTuple(node->ss.ss_ScanTupleSlot);
+	/* must drop pointer to sort result tuple */
+	ExecClearTuple(node->ss.ps.ps_ResultTupleSlot);
+	ExecClearTuple(node->groupPivot);
+	ExecClearTuple(node->nextTuple);
+
+	/*
+	 * Release tuplesort resources
+	 */
+	if (node->tuplesortstate != NULL)
+		tuplesort_end((Tuplesortstate *) node->tuplesortstate);
+	node->tuplesortstate = NULL;
+
+	/*
+	 * shut down the subplan
+	 */
+	ExecEndNode(outerPlanState(node));
+
+	SO1_printf("ExecEndIncrementalSort: %s\n",
+			   "incremental sort node shutdown");
+}
+
+void
+ExecReScanIncrementalSort(IncrementalSortState *node)
+{
+	/*
+	 * We keep only the current batch, so we always have to read the input
+	 * again.
+	 */
+	ExecClearTuple(node->ss.ps.ps_ResultTupleSlot);
+	ExecClearTuple(node->groupPivot);
+	ExecClearTuple(node->nextTuple);
+
+	if (node->tuplesortstate != NULL)
+		tuplesort_end((Tuplesortstate *) node->tuplesortstate);
+	node->tuplesortstate = NULL;
+	node->outerDone = false;
+	node->bound_Done = 0;
+
+	/*
+	 * if chgParam of subnode is not null then plan will be re-scanned by
+	 * first ExecProcNode.
+	 */
+	if (node->ss.ps.lefttree->chgParam == NULL)
+		ExecReScan(node->ss.ps.lefttree);
+}
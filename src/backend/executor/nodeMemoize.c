@@ -0,0 +1,553 @@
+/*-------------------------------------------------------------------------
+ *
+ * nodeMemoize.c
+ *	  Routines to handle caching of the results of parameterized subplans.
+ *
+ * A Memoize node sits on the inner side of a nestloop whose inner plan is
+ * parameterized by the outer side.  The nestloop rescans the inner plan for
+ * every outer tuple, but when the outer side repeats the same join keys,
+ * the inner plan keeps returning the same tuples.  So we remember the tuples
+ * the subplan returned for each set of values of the cache keys, which are
+ * the expressions the nestloop parameters are computed from, and answer
+ * later scans with the same key values from the cache.
+ *
+ * The cache is a TupleHashTable keyed by the key values, whose entries hold
+ * a list of the cached tuples.  It may not take up more than work_mem; when
+ * it would, the least recently used entries are evicted.  An entry is only
+ * used for a later scan if the scan that filled it ran to completion.  A
+ * scan that alone returns too much to fit in work_mem isn't cached at all.
+ *
+ * The cache is thrown away whenever a parameter changes that the subplan
+ * depends on but that the cache keys don't, since the cached tuples may not
+ * be valid anymore then.
+ *
+ * Portions Copyright (c) 1996-2013, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ *
+ * IDENTIFICATION
+ *	  src/backend/executor/nodeMemoize.c
+ *
+ *-------------------------------------------------------------------------
+ */
+/*
+ * INTERFACE ROUTINES
+ *		ExecMemoize			- return tuples from the cache or the subplan
+ *		ExecInitMemoize		- initialize node and subnodes
+ *		ExecEndMemoize		- shutdown node and subnodes
+ *		ExecReScanMemoize	- start a scan for new parameter values
+ */
+#include "postgres.h"
+
+#include "executor/executor.h"
+#include "executor/nodeMemoize.h"
+#include "miscadmin.h"
+#include "nodes/nodeFuncs.h"
+#include "utils/memutils.h"
+
+/* states of the ExecMemoize state machine */
+#define MEMO_CACHE_LOOKUP			1	/* look up the keys in the cache */
+#define MEMO_CACHE_FETCH_NEXT_TUPLE 2	/* return tuples from the cache */
+#define MEMO_FILLING_CACHE			3	/* cache tuples from the subplan */
+#define MEMO_CACHE_BYPASS			4	/* subplan tuples don't fit in cache */
+#define MEMO_END_OF_SCAN			5	/* ready for a rescan */
+
+/* a cached tuple */
+typedef struct MemoizeTuple
+{
+	MinimalTuple mintuple;		/* the tuple */
+	struct MemoizeTuple *next;	/* next tuple of the same entry */
+} MemoizeTuple;
+
+/* a cache entry, holding the tuples for one set of key values */
+typedef struct MemoizeEntry
+{
+	TupleHashEntryData shared;	/* common header for hash table entries */
+	MemoizeTuple *tuplehead;	/* cached tuples, in subplan order */
+	MemoizeTuple *tupletail;	/* last of them */
+	dlist_node	lru_node;		/* position in the LRU list */
+	Size		mem_used;		/* memory taken up by this entry */
+	bool		complete;		/* all the subplan's tuples are cached */
+} MemoizeEntry;
+
+/* initial hash table size if the planner didn't estimate it */
+#define MEMO_DEFAULT_BUCKETS	1024
+
+
+static void build_hash_table(MemoizeState *node);
+static MemoizeEntry *cache_lookup(MemoizeState *node, bool *found);
+static bool cache_store_tuple(MemoizeState *node, TupleTableSlot *slot);
+static bool cache_reduce_memory(MemoizeState *node, MemoizeEntry *keep);
+static void entry_free_tuples(MemoizeState *node, MemoizeEntry *entry);
+static void remove_cache_entry(MemoizeState *node, MemoizeEntry *entry);
+
+
+/*
+ * Create an empty cache.
+ */
+static void
+build_hash_table(MemoizeState *node)
+{
+	Memoize    *plannode = (Memoize *) node->ss.ps.plan;
+	AttrNumber *keyColIdx;
+	int			i;
+
+	keyColIdx = (AttrNumber *) MemoryContextAlloc(node->tableContext,
+												  node->nkeys * sizeof(AttrNumber));
+	for (i = 0; i < node->nkeys; i++)
+		keyColIdx[i] = i + 1;
+
+	node->hashtable = BuildTupleHashTable(node->nkeys,
+										  keyColIdx,
+										  node->eqfunctions,
+										  node->hashfunctions,
+										  plannode->est_entries > 0 ?
+										  plannode->est_entries :
+										  MEMO_DEFAULT_BUCKETS,
+										  sizeof(MemoizeEntry),
+										  node->tableContext,
+							 node->ss.ps.ps_ExprContext->ecxt_per_tuple_memory);
+	dlist_init(&node->lru_list);
+	node->mem_used = 0;
+}
+
+/*
+ * Find the cache entry for the current key values, creating it if there is
+ * none.  *found tells whether an entry for them existed already; one that
+ * wasn't filled completely is emptied, since its scan has to be run again.
+ * The entry becomes the most recently used.
+ *
+ * Returns NULL if there's no room for even the new entry.
+ */
+static MemoizeEntry *
+cache_lookup(MemoizeState *node, bool *found)
+{
+	ExprContext *econtext = node->ss.ps.ps_ExprContext;
+	TupleTableSlot *probeslot = node->probeslot;
+	MemoizeEntry *entry;
+	MemoryContext oldcontext;
+	ListCell   *lc;
+	bool		isnew;
+	int			i;
+
+	/* Compute the key values for the current parameter values */
+	ResetExprContext(econtext);
+	oldcontext = MemoryContextSwitchTo(econtext->ecxt_per_tuple_memory);
+
+	ExecClearTuple(probeslot);
+	i = 0;
+	foreach(lc, node->param_exprs)
+	{
+		ExprState  *keyexpr = (ExprState *) lfirst(lc);
+
+		probeslot->tts_values[i] = ExecEvalExpr(keyexpr, econtext,
+												&probeslot->tts_isnull[i],
+												NULL);
+		i++;
+	}
+	ExecStoreVirtualTuple(probeslot);
+
+	MemoryContextSwitchTo(oldcontext);
+
+	entry = (MemoizeEntry *) LookupTupleHashEntry(node->hashtable, probeslot,
+												  &isnew);
+	*found = !isnew;
+
+	if (isnew)
+	{
+		entry->mem_used = node->hashtable->entrysize +
+			GetMemoryChunkSpace(entry->shared.firstTuple);
+		node->mem_used += entry->mem_used;
+		if (node->mem_used > node->mem_peak)
+			node->mem_peak = node->mem_used;
+		dlist_push_tail(&node->lru_list, &entry->lru_node);
+
+		if (node->mem_used > node->mem_limit &&
+			!cache_reduce_memory(node, entry))
+			return NULL;
+	}
+	else
+	{
+		dlist_delete(&entry->lru_node);
+		dlist_push_tail(&node->lru_list, &entry->lru_node);
+		if (!entry->complete)
+			entry_free_tuples(node, entry);
+	}
+
+	return entry;
+}
+
+/*
+ * Add the tuple in 'slot' to the entry of the current scan.
+ *
+ * Returns false if the entry got too big to keep, in which case it has been
+ * removed from the cache.
+ */
+static bool
+cache_store_tuple(MemoizeState *node, TupleTableSlot *slot)
+{
+	MemoizeEntry *entry = node->entry;
+	MemoizeTuple *tuple;
+	MemoryContext oldcontext;
+	Size		size;
+
+	oldcontext = MemoryContextSwitchTo(node->tableContext);
+	tuple = (MemoizeTuple *) palloc(sizeof(MemoizeTuple));
+	tuple->mintuple = ExecCopySlotMinimalTuple(slot);
+	tuple->next = NULL;
+	MemoryContextSwitchTo(oldcontext);
+
+	if (entry->tupletail != NULL)
+		entry->tupletail->next = tuple;
+	else
+		entry->tuplehead = tuple;
+	entry->tupletail = tuple;
+
+	size = GetMemoryChunkSpace(tuple) + GetMemoryChunkSpace(tuple->mintuple);
+	entry->mem_used += size;
+	node->mem_used += size;
+	if (node->mem_used > node->mem_peak)
+		node->mem_peak = node->mem_used;
+
+	if (node->mem_used > node->mem_limit)
+		return cache_reduce_memory(node, entry);
+
+	return true;
+}
+
+/*
+ * Evict the least recently used entries until the cache fits in its memory
+ * limit again.  'keep' is the entry of the current scan, which is only
+ * evicted if it is too big for the cache on its own; then we return false.
+ */
+static bool
+cache_reduce_memory(MemoizeState *node, MemoizeEntry *keep)
+{
+	while (node->mem_used > node->mem_limit)
+	{
+		MemoizeEntry *victim;
+
+		victim = dlist_container(MemoizeEntry, lru_node,
+								 dlist_head_node(&node->lru_list));
+		remove_cache_entry(node, victim);
+		if (victim == keep)
+			return false;
+		node->cache_evictions++;
+	}
+
+	return true;
+}
+
+/*
+ * Free the tuples cached in an entry.
+ */
+static void
+entry_free_tuples(MemoizeState *node, MemoizeEntry *entry)
+{
+	MemoizeTuple *tuple = entry->tuplehead;
+
+	while (tuple != NULL)
+	{
+		MemoizeTuple *next = tuple->next;
+		Size		size;
+
+		size = GetMemoryChunkSpace(tuple) + GetMemoryChunkSpace(tuple->mintuple);
+		entry->mem_used -= size;
+		node->mem_used -= size;
+		pfree(tuple->mintuple);
+		pfree(tuple);
+		tuple = next;
+	}
+	entry->tuplehead = entry->tupletail = NULL;
+	entry->complete = false;
+}
+
+/*
+ * Remove an entry from the cache.
+ */
+static void
+remove_cache_entry(MemoizeState *node, MemoizeEntry *entry)
+{
+	entry_free_tuples(node, entry);
+	node->mem_used -= entry->mem_used;
+	dlist_delete(&entry->lru_node);
+	RemoveTupleHashEntry(node->hashtable, &entry->shared);
+}
+
+/* ----------------------------------------------------------------
+ *		ExecMemoize
+ *
+ *		On the first call after a rescan, look up the current key values
+ *		in the cache.  If the cache has all the tuples for them, return
+ *		those; otherwise run the subplan, adding the tuples it returns to
+ *		the cache as we go.
+ * ----------------------------------------------------------------
+ */
+TupleTableSlot *
+ExecMemoize(MemoizeState *node)
+{
+	PlanState  *outerNode = outerPlanState(node);
+	TupleTableSlot *resultslot = node->ss.ps.ps_ResultTupleSlot;
+	TupleTableSlot *slot;
+
+	switch (node->mstatus)
+	{
+		case MEMO_CACHE_LOOKUP:
+			{
+				MemoizeEntry *entry;
+				bool		found;
+
+				entry = cache_lookup(node, &found);
+
+				if (found && entry->complete)
+				{
+					node->cache_hits++;
+
+					node->last_tuple = entry->tuplehead;
+					if (node->last_tuple == NULL)
+					{
+						node->mstatus = MEMO_END_OF_SCAN;
+						return ExecClearTuple(resultslot);
+					}
+					node->mstatus = MEMO_CACHE_FETCH_NEXT_TUPLE;
+					return ExecStoreMinimalTuple(node->last_tuple->mintuple,
+												 resultslot, false);
+				}
+
+				node->cache_misses++;
+				node->entry = entry;
+
+				slot = ExecProcNode(outerNode);
+				if (TupIsNull(slot))
+				{
+					/* remember that there's nothing for these keys */
+					if (entry != NULL)
+						entry->complete = true;
+					node->mstatus = MEMO_END_OF_SCAN;
+					return ExecClearTuple(resultslot);
+				}
+
+				if (entry != NULL && cache_store_tuple(node, slot))
+					node->mstatus = MEMO_FILLING_CACHE;
+				else
+				{
+					node->cache_overflows++;
+					node->entry = NULL;
+					node->mstatus = MEMO_CACHE_BYPASS;
+				}
+				return slot;
+			}
+
+		case MEMO_CACHE_FETCH_NEXT_TUPLE:
+			node->last_tuple = node->last_tuple->next;
+			if (node->last_tuple == NULL)
+			{
+				node->mstatus = MEMO_END_OF_SCAN;
+				return ExecClearTuple(resultslot);
+			}
+			return ExecStoreMinimalTuple(node->last_tuple->mintuple,
+										 resultslot, false);
+
+		case MEMO_FILLING_CACHE:
+			slot = ExecProcNode(outerNode);
+			if (TupIsNull(slot))
+			{
+				node->entry->complete = true;
+				node->mstatus = MEMO_END_OF_SCAN;
+				return ExecClearTuple(resultslot);
+			}
+
+			if (!cache_store_tuple(node, slot))
+			{
+				node->cache_overflows++;
+				node->entry = NULL;
+				node->mstatus = MEMO_CACHE_BYPASS;
+			}
+			return slot;
+
+		case MEMO_CACHE_BYPASS:
+			slot = ExecProcNode(outerNode);
+			if (TupIsNull(slot))
+			{
+				node->mstatus = MEMO_END_OF_SCAN;
+				return ExecClearTuple(resultslot);
+			}
+			return slot;
+
+		case MEMO_END_OF_SCAN:
+			return ExecClearTuple(resultslot);
+
+		default:
+			elog(ERROR, "unrecognized memoize state: %d",
+				 (int) node->mstatus);
+			return NULL;		/* keep compiler quiet */
+	}
+}
+
+/* ----------------------------------------------------------------
+ *		ExecInitMemoize
+ * ----------------------------------------------------------------
+ */
+MemoizeState *
+ExecInitMemoize(Memoize *node, EState *estate, int eflags)
+{
+	MemoizeState *mstate;
+	TupleDesc	keydesc;
+	ListCell   *lc;
+	int			i;
+
+	/* check for unsupported flags */
+	Assert(!(eflags & (EXEC_FLAG_BACKWARD | EXEC_FLAG_MARK)));
+
+	/*
+	 * create state structure
+	 */
+	mstate = makeNode(MemoizeState);
+	mstate->ss.ps.plan = (Plan *) node;
+	mstate->ss.ps.state = estate;
+
+	mstate->mstatus = MEMO_CACHE_LOOKUP;
+	mstate->nkeys = node->numKeys;
+	mstate->keyparamids = node->keyparamids;
+	mstate->entry = NULL;
+	mstate->last_tuple = NULL;
+	mstate->mem_limit = work_mem * 1024L;
+
+	/*
+	 * Miscellaneous initialization
+	 *
+	 * The expression context evaluates the cache keys, and its per-tuple
+	 * memory is also used for hashing and comparing them.
+	 */
+	ExecAssignExprContext(estate, &mstate->ss.ps);
+
+	/*
+	 * tuple table initialization
+	 */
+	ExecInitResultTupleSlot(estate, &mstate->ss.ps);
+	ExecInitScanTupleSlot(estate, &mstate->ss);
+	mstate->probeslot = ExecInitExtraTupleSlot(estate);
+
+	/*
+	 * initialize child nodes
+	 *
+	 * We shield the child node from the need to support REWIND, BACKWARD, or
+	 * MARK/RESTORE.
+	 */
+	eflags &= ~(EXEC_FLAG_REWIND | EXEC_FLAG_BACKWARD | EXEC_FLAG_MARK);
+
+	outerPlanState(mstate) = ExecInitNode(outerPlan(node), estate, eflags);
+
+	/*
+	 * initialize tuple type.  no need to initialize projection info because
+	 * this node doesn't do projections.
+	 */
+	ExecAssignResultTypeFromTL(&mstate->ss.ps);
+	ExecAssignScanTypeFromOuterPlan(&mstate->ss);
+	mstate->ss.ps.ps_ProjInfo = NULL;
+
+	/*
+	 * initialize the cache keys
+	 */
+	keydesc = CreateTemplateTupleDesc(node->numKeys, false);
+	i = 0;
+	foreach(lc, node->param_exprs)
+	{
+		Node	   *keyexpr = (Node *) lfirst(lc);
+
+		i++;
+		TupleDescInitEntry(keydesc, i, NULL,
+						   exprType(keyexpr), exprTypmod(keyexpr), 0);
+		mstate->param_exprs = lappend(mstate->param_exprs,
+									  ExecInitExpr((Expr *) keyexpr,
+												   (PlanState *) mstate));
+	}
+	ExecSetSlotDescriptor(mstate->probeslot, keydesc);
+
+	execTuplesHashPrepare(node->numKeys, node->hashOperators,
+						  &mstate->eqfunctions, &mstate->hashfunctions);
+
+	mstate->tableContext = AllocSetContextCreate(CurrentMemoryContext,
+												 "MemoizeHashTable",
+												 ALLOCSET_DEFAULT_MINSIZE,
+												 ALLOCSET_DEFAULT_INITSIZE,
+												 ALLOCSET_DEFAULT_MAXSIZE);
+	build_hash_table(mstate);
+
+	return mstate;
+}
+
+/* ----------------------------------------------------------------
+ *		ExecEndMemoize
+ * ----------------------------------------------------------------
+ */
+void
+ExecEndMemoize(MemoizeState *node)
+{
+	/*
+	 * Free the exprcontext
+	 */
+	ExecFreeExprContext(&node->ss.ps);
+
+	/*
+	 * clean out the tuple table
+	 */
+	ExecClearTuple(node->ss.ss_ScanTupleSlot);
+	ExecClearTuple(node->ss.ps.ps_ResultTupleSlot);
+	ExecClearTuple(node->probeslot);
+
+	/*
+	 * Release the cache
+	 */
+	MemoryContextDelete(node->tableContext);
+
+	/*
+	 * shut down the subplan
+	 */
+	ExecEndNode(outerPlanState(node));
+}
+
+/* ----------------------------------------------------------------
+ *		ExecReScanMemoize
+ *
+ *		Prepares to look up the new parameter values in the cache.
+ * ----------------------------------------------------------------
+ */
+void
+ExecReScanMemoize(MemoizeState *node)
+{
+	PlanState  *outerPlan = outerPlanState(node);
+
+	node->mstatus = MEMO_CACHE_LOOKUP;
+	node->entry = NULL;
+	node->last_tuple = NULL;
+	ExecClearTuple(node->ss.ps.ps_ResultTupleSlot);
+
+	/*
+	 * if chgParam of subnode is not null then plan will be re-scanned by
+	 * first ExecProcNode.
+	 */
+	if (outerPlan->chgParam == NULL)
+		ExecReScan(outerPlan);
+
+	/*
+	 * If a parameter changed that the subplan depends on but the keys don't,
+	 * the cached tuples may be wrong for the keys they're cached under.
+	 */
+	if (bms_nonempty_difference(outerPlan->chgParam, node->keyparamids))
+	{
+		MemoryContextReset(node->tableContext);
+		build_hash_table(node);
+	}
+}
+
+/*
+ * Estimate the memory a cache entry for ntuples tuples takes up on top of
+ * the tuples themselves, for the planner.
+ */
+double
+ExecEstimateCacheEntryOverheadBytes(double ntuples)
+{
+	return MAXALIGN(sizeof(MemoizeEntry)) + sizeof(TupleHashBucketData) * 2 +
+		MAXALIGN(sizeof(MemoizeTuple)) * ntuples;
+}
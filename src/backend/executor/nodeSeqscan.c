@@ -21,16 +21,45 @@
  *		ExecReScanSeqScan		rescans the relation
  *		ExecSeqMarkPos			marks scan position
  *		ExecSeqRestrPos			restores scan position
+ *		ExecSeqScanInitBatch	switches the scan to batch mode
+ *		ExecSeqScanBatch		retrieve next batch of tuples
+ *		ExecSeqScanInitPartialAgg	lets scan workers aggregate their tuples
+ *		ExecSeqScanGetPartialAgg	retrieve transition values of a worker
+ *		ExecSeqScanInitSharedHash	lets scan workers build a hash table
+ *		ExecSeqScanSetBloomFilter	discard tuples without join partner
  */
 #include "postgres.h"
 
 #include "access/relscan.h"
+#include "access/transam.h"
+#include "access/xact.h"
 #include "executor/execdebug.h"
+#include "executor/hashjoin.h"
+#include "executor/instrument.h"
+#include "executor/nodeHash.h"
 #include "executor/nodeSeqscan.h"
+#include "nodes/nodeFuncs.h"
+#include "postmaster/scanworker.h"
+#include "storage/bufmgr.h"
+#include "utils/memutils.h"
 #include "utils/rel.h"
+#include "utils/tqual.h"
+
+/*
+ * Relations smaller than this many pages are not worth handing over to
+ * scan workers.
+ */
+#define PARALLEL_SCAN_MIN_PAGES		1024
 
 static void InitScanRelation(SeqScanState *node, EState *estate);
 static TupleTableSlot *SeqNext(SeqScanState *node);
+static TupleTableSlot *SeqNextTuple(SeqScanState *node);
+static bool SeqBloomCheck(SeqScanState *node, TupleTableSlot *slot);
+static bool SeqWorkersAllowed(SeqScanState *node);
+static void SeqStartWorkers(SeqScanState *node);
+static HeapTuple SeqNextParallel(SeqScanState *node, bool *fromworker);
+static void SeqEndWorkers(SeqScanState *node);
+static void SeqFillBatch(SeqScanState *node);
 
 /* ----------------------------------------------------------------
  *						Scan Support
@@ -45,6 +74,23 @@ static TupleTableSlot *SeqNext(SeqScanState *node);
  */
 static TupleTableSlot *
 SeqNext(SeqScanState *node)
+{
+	TupleTableSlot *slot;
+
+	for (;;)
+	{
+		slot = SeqNextTuple(node);
+		if (node->bloomTable == NULL || TupIsNull(slot) ||
+			SeqBloomCheck(node, slot))
+			return slot;
+	}
+}
+
+/*
+ * SeqNextTuple -- get the next tuple of the scan
+ */
+static TupleTableSlot *
+SeqNextTuple(SeqScanState *node)
 {
 	HeapTuple	tuple;
 	HeapScanDesc scandesc;
@@ -55,10 +101,29 @@ SeqNext(SeqScanState *node)
 	/*
 	 * get information from the estate and scan state
 	 */
-	scandesc = node->ss_currentScanDesc;
-	estate = node->ps.state;
+	scandesc = node->ss.ss_currentScanDesc;
+	estate = node->ss.ps.state;
 	direction = estate->es_direction;
-	slot = node->ss_ScanTupleSlot;
+	slot = node->ss.ss_ScanTupleSlot;
+
+	if (!node->started)
+	{
+		SeqStartWorkers(node);
+		scandesc = node->ss.ss_currentScanDesc;
+	}
+
+	if (node->workers != NULL && node->partialAggs == NIL)
+	{
+		bool		fromworker;
+
+		tuple = SeqNextParallel(node, &fromworker);
+		if (tuple == NULL)
+			return ExecClearTuple(slot);
+		if (fromworker)
+			return ExecStoreTuple(tuple, slot, InvalidBuffer, false);
+		/* SeqNextParallel has stored our own tuple in the slot already */
+		return slot;
+	}
 
 	/*
 	 * get the next tuple from the table
@@ -85,6 +150,196 @@ SeqNext(SeqScanState *node)
 	return slot;
 }
 
+/*
+ * SeqBloomCheck -- check a tuple against the bloom filter of a hash join
+ *
+ * Returns false if the tuple can't have a join partner, either because the
+ * filter rejects its hash value or because it has a null key.
+ */
+static bool
+SeqBloomCheck(SeqScanState *node, TupleTableSlot *slot)
+{
+	HashJoinTable hashtable = node->bloomTable;
+	ExprContext *econtext = node->ss.ps.ps_ExprContext;
+	uint32		hashvalue;
+
+	/* stop computing hash values once the join has given up on the filter */
+	if (!hashtable->bloomEnabled)
+	{
+		node->bloomTable = NULL;
+		node->bloomKeys = NIL;
+		return true;
+	}
+
+	ResetExprContext(econtext);
+	econtext->ecxt_scantuple = slot;
+	if (!ExecHashGetHashValue(hashtable, econtext, node->bloomKeys,
+							  true, false, &hashvalue))
+		return false;
+
+	return ExecHashBloomCheck(hashtable, hashvalue);
+}
+
+/*
+ * SeqWorkersAllowed -- may scan workers help with the scan?
+ */
+static bool
+SeqWorkersAllowed(SeqScanState *node)
+{
+	EState	   *estate = node->ss.ps.state;
+	Relation	relation = node->ss.ss_currentRelation;
+
+	return (node->parallelOK &&
+			parallel_scan_degree > 0 &&
+			IsMVCCSnapshot(estate->es_snapshot) &&
+			!IsolationIsSerializable() &&
+			!TransactionIdIsValid(GetTopTransactionIdIfAny()) &&
+			!RelationUsesLocalBuffers(relation) &&
+			RelationGetNumberOfBlocks(relation) >= PARALLEL_SCAN_MIN_PAGES);
+}
+
+/*
+ * SeqStartWorkers -- hand the scan over to scan workers, if possible
+ *
+ * Called at the first fetch, rather than at ExecInitSeqScan, so that plans
+ * that are initialized but never run don't tie up workers.  The workers run
+ * the scan under a copy of our snapshot, which rules out anything that might
+ * need to see our own changes or lock rows; and each of them checks the quals
+ * for its tuples, so ours are only applied to the tuples we scan ourselves.
+ *
+ * If the Agg node above has asked the workers to aggregate their tuples,
+ * they don't send any; we just scan our own pages, as if the relation had
+ * no others.  Similarly if the Hash node above has asked them to insert
+ * their tuples into its hash table, except that they send those that don't
+ * fit.  Should the aggregates or hash keys be unfit for the workers, they
+ * return their tuples after all.
+ */
+static void
+SeqStartWorkers(SeqScanState *node)
+{
+	EState	   *estate = node->ss.ps.state;
+	Relation	relation = node->ss.ss_currentRelation;
+	ScanWorkerGroup *workers;
+	List	   *hashtlist = NIL;
+
+	node->started = true;
+
+	if (!SeqWorkersAllowed(node))
+		return;
+
+	/* the workers must store the tuples the way we return them */
+	if (node->ss.ps.ps_ProjInfo != NULL)
+		hashtlist = node->ss.ps.plan->targetlist;
+
+	workers = ScanWorkersStart(relation, estate->es_snapshot,
+							   node->ss.ps.plan->qual, node->partialAggs,
+							   node->sharedHashKeys, hashtlist,
+							   parallel_scan_degree);
+	if (workers == NULL &&
+		(node->partialAggs != NIL || node->sharedHashKeys != NIL))
+	{
+		node->partialAggs = NIL;
+		node->sharedHashKeys = NIL;
+		workers = ScanWorkersStart(relation, estate->es_snapshot,
+								   node->ss.ps.plan->qual, NIL, NIL, NIL,
+								   parallel_scan_degree);
+	}
+	if (workers == NULL)
+		return;
+
+	heap_endscan(node->ss.ss_currentScanDesc);
+	node->ss.ss_currentScanDesc =
+		heap_beginscan_parallel(relation, estate->es_snapshot, workers->pscan);
+
+	node->workers = workers;
+	node->leaderDone = false;
+	if (node->partialAggs == NIL)
+	{
+		node->leaderQual = node->ss.ps.qual;
+		node->ss.ps.qual = NIL;
+	}
+}
+
+/*
+ * SeqNextParallel -- get the next tuple of a scan helped by scan workers
+ *
+ * Tuples sent by the workers are taken first, so that they never wait for
+ * queue space; when there are none, we scan a page of our own.  Returns NULL
+ * at the end of the scan.  *fromworker tells whether the tuple came from a
+ * worker; if not, it has been stored in the scan tuple slot and has passed
+ * the quals.
+ */
+static HeapTuple
+SeqNextParallel(SeqScanState *node, bool *fromworker)
+{
+	HeapScanDesc scandesc = node->ss.ss_currentScanDesc;
+	TupleTableSlot *slot = node->ss.ss_ScanTupleSlot;
+	ExprContext *econtext = node->ss.ps.ps_ExprContext;
+	HeapTuple	tuple;
+
+	for (;;)
+	{
+		/*
+		 * Workers that insert their tuples into a hash table only send the
+		 * few that don't fit, so leave those until we're done ourselves.
+		 */
+		*fromworker = true;
+		if (node->sharedHashKeys == NIL || node->leaderDone)
+		{
+			tuple = ScanWorkersGetTuple(node->workers, node->leaderDone);
+			if (tuple != NULL)
+				return tuple;
+		}
+
+		if (node->leaderDone)
+		{
+			/* all workers are done too */
+			InstrCountFiltered1(node, node->workers->nfiltered);
+			node->workers->nfiltered = 0;
+			return NULL;
+		}
+
+		*fromworker = false;
+		tuple = heap_getnext(scandesc, ForwardScanDirection);
+		if (tuple == NULL)
+		{
+			node->leaderDone = true;
+			continue;
+		}
+
+		ExecStoreTuple(tuple, slot, scandesc->rs_cbuf, false);
+		if (node->leaderQual != NIL)
+		{
+			econtext->ecxt_scantuple = slot;
+			ResetExprContext(econtext);
+			if (!ExecQual(node->leaderQual, econtext, false))
+			{
+				InstrCountFiltered1(node, 1);
+				continue;
+			}
+		}
+		return tuple;
+	}
+}
+
+/*
+ * SeqEndWorkers -- let go of the scan workers, if we have any
+ */
+static void
+SeqEndWorkers(SeqScanState *node)
+{
+	if (node->workers == NULL)
+		return;
+
+	ScanWorkersFinish(node->workers);
+	node->workers = NULL;
+	if (node->partialAggs == NIL)
+	{
+		node->ss.ps.qual = node->leaderQual;
+		node->leaderQual = NIL;
+	}
+}
+
 /*
  * SeqRecheck -- access method routine to recheck a tuple in EvalPlanQual
  */
@@ -133,17 +388,17 @@ InitScanRelation(SeqScanState *node, EState *estate)
 	 * open that relation and acquire appropriate lock on it.
 	 */
 	currentRelation = ExecOpenScanRelation(estate,
-									 ((SeqScan *) node->ps.plan)->scanrelid);
+									 ((SeqScan *) node->ss.ps.plan)->scanrelid);
 
 	currentScanDesc = heap_beginscan(currentRelation,
 									 estate->es_snapshot,
 									 0,
 									 NULL);
 
-	node->ss_currentRelation = currentRelation;
-	node->ss_currentScanDesc = currentScanDesc;
+	node->ss.ss_currentRelation = currentRelation;
+	node->ss.ss_currentScanDesc = currentScanDesc;
 
-	ExecAssignScanType(node, RelationGetDescr(currentRelation));
+	ExecAssignScanType(&node->ss, RelationGetDescr(currentRelation));
 }
 
 
@@ -167,44 +422,56 @@ ExecInitSeqScan(SeqScan *node, EState *estate, int eflags)
 	 * create state structure
 	 */
 	scanstate = makeNode(SeqScanState);
-	scanstate->ps.plan = (Plan *) node;
-	scanstate->ps.state = estate;
+	scanstate->ss.ps.plan = (Plan *) node;
+	scanstate->ss.ps.state = estate;
 
 	/*
 	 * Miscellaneous initialization
 	 *
 	 * create expression context for node
 	 */
-	ExecAssignExprContext(estate, &scanstate->ps);
+	ExecAssignExprContext(estate, &scanstate->ss.ps);
 
 	/*
 	 * initialize child expressions
 	 */
-	scanstate->ps.targetlist = (List *)
+	scanstate->ss.ps.targetlist = (List *)
 		ExecInitExpr((Expr *) node->plan.targetlist,
 					 (PlanState *) scanstate);
-	scanstate->ps.qual = (List *)
+	scanstate->ss.ps.qual = (List *)
 		ExecInitExpr((Expr *) node->plan.qual,
 					 (PlanState *) scanstate);
 
+	/*
+	 * Scan workers can only help with a plain forward scan that doesn't lock
+	 * rows; see SeqStartWorkers for the other conditions, which are checked
+	 * when the scan starts.
+	 */
+	scanstate->parallelOK =
+		(eflags & (EXEC_FLAG_BACKWARD | EXEC_FLAG_MARK)) == 0 &&
+		estate->es_plannedstmt != NULL &&
+		estate->es_plannedstmt->commandType == CMD_SELECT &&
+		estate->es_rowMarks == NIL &&
+		estate->es_epqTuple == NULL;
+
 	/*
 	 * tuple table initialization
 	 */
-	ExecInitResultTupleSlot(estate, &scanstate->ps);
-	ExecInitScanTupleSlot(estate, scanstate);
+	ExecInitResultTupleSlot(estate, &scanstate->ss.ps);
+	ExecInitScanTupleSlot(estate, &scanstate->ss);
 
 	/*
 	 * initialize scan relation
 	 */
 	InitScanRelation(scanstate, estate);
 
-	scanstate->ps.ps_TupFromTlist = false;
+	scanstate->ss.ps.ps_TupFromTlist = false;
 
 	/*
 	 * Initialize result tuple type and projection info.
 	 */
-	ExecAssignResultTypeFromTL(&scanstate->ps);
-	ExecAssignScanProjectionInfo(scanstate);
+	ExecAssignResultTypeFromTL(&scanstate->ss.ps);
+	ExecAssignScanProjectionInfo(&scanstate->ss);
 
 	return scanstate;
 }
@@ -224,19 +491,24 @@ ExecEndSeqScan(SeqScanState *node)
 	/*
 	 * get information from node
 	 */
-	relation = node->ss_currentRelation;
-	scanDesc = node->ss_currentScanDesc;
+	relation = node->ss.ss_currentRelation;
+	scanDesc = node->ss.ss_currentScanDesc;
 
 	/*
 	 * Free the exprcontext
 	 */
-	ExecFreeExprContext(&node->ps);
+	ExecFreeExprContext(&node->ss.ps);
 
 	/*
 	 * clean out the tuple table
 	 */
-	ExecClearTuple(node->ps.ps_ResultTupleSlot);
-	ExecClearTuple(node->ss_ScanTupleSlot);
+	ExecClearTuple(node->ss.ps.ps_ResultTupleSlot);
+	ExecClearTuple(node->ss.ss_ScanTupleSlot);
+
+	/*
+	 * stop any scan workers
+	 */
+	SeqEndWorkers(node);
 
 	/*
 	 * close heap scan
@@ -265,7 +537,23 @@ ExecReScanSeqScan(SeqScanState *node)
 {
 	HeapScanDesc scan;
 
-	scan = node->ss_currentScanDesc;
+	/*
+	 * Only the first scan is run in parallel; the page counter the workers
+	 * shared with us can't be reset.  Rescan serially from now on.
+	 */
+	if (node->workers != NULL)
+	{
+		EState	   *estate = node->ss.ps.state;
+
+		ExecClearTuple(node->ss.ss_ScanTupleSlot);
+		SeqEndWorkers(node);
+		heap_endscan(node->ss.ss_currentScanDesc);
+		node->ss.ss_currentScanDesc =
+			heap_beginscan(node->ss.ss_currentRelation, estate->es_snapshot,
+						   0, NULL);
+	}
+
+	scan = node->ss.ss_currentScanDesc;
 
 	heap_rescan(scan,			/* scan desc */
 				NULL);			/* new scan keys */
@@ -282,7 +570,7 @@ ExecReScanSeqScan(SeqScanState *node)
 void
 ExecSeqMarkPos(SeqScanState *node)
 {
-	HeapScanDesc scan = node->ss_currentScanDesc;
+	HeapScanDesc scan = node->ss.ss_currentScanDesc;
 
 	heap_markpos(scan);
 }
@@ -296,7 +584,7 @@ ExecSeqMarkPos(SeqScanState *node)
 void
 ExecSeqRestrPos(SeqScanState *node)
 {
-	HeapScanDesc scan = node->ss_currentScanDesc;
+	HeapScanDesc scan = node->ss.ss_currentScanDesc;
 
 	/*
 	 * Clear any reference to the previously returned tuple.  This is needed
@@ -304,7 +592,291 @@ ExecSeqRestrPos(SeqScanState *node)
 	 * heap_restrpos will change; we'd have an internally inconsistent slot if
 	 * we didn't do this.
 	 */
-	ExecClearTuple(node->ss_ScanTupleSlot);
+	ExecClearTuple(node->ss.ss_ScanTupleSlot);
 
 	heap_restrpos(scan);
 }
+
+/* ----------------------------------------------------------------
+ *						Batch Mode Support
+ * ----------------------------------------------------------------
+ */
+
+/* ----------------------------------------------------------------
+ *		ExecSeqScanInitBatch
+ *
+ *		Switches the scan to batch mode, in which the parent fetches
+ *		its rows with ExecSeqScanBatch instead of ExecProcNode (see
+ *		execBatch.c).  The batches hold at least the given scan
+ *		attributes; the targetlist is not evaluated.  Returns false,
+ *		leaving the scan alone, if it can't run in batch mode.
+ * ----------------------------------------------------------------
+ */
+bool
+ExecSeqScanInitBatch(SeqScanState *node, Bitmapset *attnos)
+{
+	Index		scanrelid = ((SeqScan *) node->ss.ps.plan)->scanrelid;
+	List	   *batchquals = NIL;
+	Bitmapset  *qualattnos = NULL;
+	int			nclauses = 0;
+	ListCell   *lc;
+
+	/* EvalPlanQual substitutes a test tuple for the scan's rows */
+	if (node->ss.ps.state->es_epqTuple != NULL)
+		return false;
+
+	/*
+	 * Evaluate the longest run of trailing quals that can be BatchQuals over
+	 * whole batches, and all others row by row before them.
+	 */
+	foreach(lc, node->ss.ps.qual)
+	{
+		ExprState  *clause = (ExprState *) lfirst(lc);
+		BatchQual  *bqual;
+
+		nclauses++;
+		bqual = ExecInitBatchQual(clause, scanrelid, &qualattnos);
+		if (bqual != NULL)
+			batchquals = lappend(batchquals, bqual);
+		else
+		{
+			node->rowquals = list_truncate(list_copy(node->ss.ps.qual),
+										   nclauses);
+			batchquals = NIL;
+			bms_free(qualattnos);
+			qualattnos = NULL;
+		}
+	}
+	node->batchquals = batchquals;
+	node->batch = ExecCreateTupleBatch(bms_union(attnos, qualattnos));
+
+	return true;
+}
+
+/*
+ * SeqFillBatch -- fill the batch with rows we scan ourselves
+ *
+ * Rows failing the quals that aren't BatchQuals are left out.  Unless the
+ * batch gets full, the scan is exhausted on return.
+ */
+static void
+SeqFillBatch(SeqScanState *node)
+{
+	TupleBatch *batch = node->batch;
+	HeapScanDesc scandesc = node->ss.ss_currentScanDesc;
+	ScanDirection direction = node->ss.ps.state->es_direction;
+	TupleTableSlot *slot = node->ss.ss_ScanTupleSlot;
+	ExprContext *econtext = node->ss.ps.ps_ExprContext;
+	HeapTuple	tuple;
+
+	econtext->ecxt_scantuple = slot;
+
+	while (batch->nrows < batch->maxrows &&
+		   (tuple = heap_getnext(scandesc, direction)) != NULL)
+	{
+		ExecStoreTuple(tuple, slot, scandesc->rs_cbuf, false);
+
+		if (node->rowquals != NIL)
+		{
+			ResetExprContext(econtext);
+			if (!ExecQual(node->rowquals, econtext, false))
+			{
+				InstrCountFiltered1(node, 1);
+				continue;
+			}
+		}
+
+		ExecTupleBatchAddRow(batch, slot);
+	}
+
+	/* don't keep the last buffer pinned */
+	ExecClearTuple(slot);
+}
+
+/* ----------------------------------------------------------------
+ *		ExecSeqScanBatch
+ *
+ *		Fills the batch with the next rows of the scan that satisfy
+ *		its quals, and returns it.  Returns NULL once the scan is
+ *		exhausted; batches returned before may have no rows selected.
+ * ----------------------------------------------------------------
+ */
+TupleBatch *
+ExecSeqScanBatch(SeqScanState *node)
+{
+	TupleBatch *batch = node->batch;
+	TupleTableSlot *slot = node->ss.ss_ScanTupleSlot;
+	HeapTuple	tuple;
+	bool		fromworkers = false;
+
+	Assert(batch != NULL);
+
+	/* what ExecProcNode would do */
+	if (node->ss.ps.chgParam != NULL)
+		ExecReScan((PlanState *) node);
+	if (node->ss.ps.instrument)
+		InstrStartNode(node->ss.ps.instrument);
+
+	if (!node->started)
+		SeqStartWorkers(node);
+
+	batch->nrows = 0;
+	batch->nsel = 0;
+
+	if (node->workers == NULL || node->partialAggs != NIL)
+		SeqFillBatch(node);
+	else
+	{
+		/*
+		 * A batch holds either tuples sent by the workers, which have passed
+		 * the quals already, or tuples we scanned ourselves.  Batch columns
+		 * are all pass-by-value, so they don't point into the workers'
+		 * queues.
+		 */
+		for (;;)
+		{
+			while (batch->nrows < batch->maxrows &&
+				   (tuple = ScanWorkersGetTuple(node->workers,
+												node->leaderDone)) != NULL)
+			{
+				ExecStoreTuple(tuple, slot, InvalidBuffer, false);
+				ExecTupleBatchAddRow(batch, slot);
+			}
+			ExecClearTuple(slot);
+
+			if (batch->nrows > 0)
+			{
+				fromworkers = true;
+				break;
+			}
+			if (node->leaderDone)
+			{
+				/* all workers are done too */
+				InstrCountFiltered1(node, node->workers->nfiltered);
+				node->workers->nfiltered = 0;
+				break;
+			}
+
+			SeqFillBatch(node);
+			if (batch->nrows < batch->maxrows)
+				node->leaderDone = true;
+			if (batch->nrows > 0)
+				break;
+		}
+	}
+
+	if (fromworkers)
+		ExecBatchQual(NIL, batch);
+	else if (batch->nrows > 0)
+	{
+		ExecBatchQual(node->batchquals, batch);
+		InstrCountFiltered1(node, batch->nrows - batch->nsel);
+	}
+
+	if (node->ss.ps.instrument)
+		InstrStopNode(node->ss.ps.instrument, batch->nsel);
+
+	return (batch->nrows > 0) ? batch : NULL;
+}
+
+/* ----------------------------------------------------------------
+ *						Partial Aggregation Support
+ * ----------------------------------------------------------------
+ */
+
+/* ----------------------------------------------------------------
+ *		ExecSeqScanInitPartialAgg
+ *
+ *		Asks the scan workers, if the scan gets any, to advance the
+ *		given aggregates (Aggrefs over the scanned relation) over their
+ *		tuples instead of returning them.  The parent (see nodeAgg.c)
+ *		then only gets the tuples we scan ourselves, and collects the
+ *		workers' transition values with ExecSeqScanGetPartialAgg at the
+ *		end of the scan.
+ * ----------------------------------------------------------------
+ */
+void
+ExecSeqScanInitPartialAgg(SeqScanState *node, List *aggrefs)
+{
+	Assert(!node->started);
+	node->partialAggs = aggrefs;
+}
+
+/* ----------------------------------------------------------------
+ *		ExecSeqScanGetPartialAgg
+ *
+ *		Waits for the next scan worker to finish, and returns the
+ *		tuple of transition values it has sent, valid until the next
+ *		call.  Returns NULL when there are no more, which is right away
+ *		if the scan wasn't run in parallel.  Only to be called once the
+ *		scan has returned all its tuples.
+ * ----------------------------------------------------------------
+ */
+HeapTuple
+ExecSeqScanGetPartialAgg(SeqScanState *node)
+{
+	HeapTuple	tuple;
+
+	if (node->workers == NULL || node->partialAggs == NIL)
+		return NULL;
+
+	tuple = ScanWorkersGetTuple(node->workers, true);
+	if (tuple == NULL)
+	{
+		InstrCountFiltered1(node, node->workers->nfiltered);
+		node->workers->nfiltered = 0;
+	}
+
+	return tuple;
+}
+
+/* ----------------------------------------------------------------
+ *		ExecSeqScanInitSharedHash
+ *
+ *		Called by a Hash node over the scan, before the first fetch,
+ *		with its hash table and the table's inner hash keys.  If the
+ *		scan is likely to get scan workers, the table is moved to shared
+ *		memory (see ExecHashTableShare) so that the workers can insert
+ *		their tuples themselves; the parent then only gets the tuples we
+ *		scan ourselves, and any the workers couldn't fit in.
+ * ----------------------------------------------------------------
+ */
+void
+ExecSeqScanInitSharedHash(SeqScanState *node, HashJoinTable hashtable,
+						  List *hashkeys)
+{
+	List	   *keyexprs = NIL;
+	ListCell   *lc;
+
+	if (node->started || !SeqWorkersAllowed(node))
+		return;
+
+	/* the workers can't return more than one row per tuple */
+	if (node->ss.ps.ps_ProjInfo != NULL &&
+		expression_returns_set((Node *) node->ss.ps.plan->targetlist))
+		return;
+
+	foreach(lc, hashkeys)
+		keyexprs = lappend(keyexprs, ((ExprState *) lfirst(lc))->expr);
+
+	if (ExecHashTableShare(hashtable, list_length(keyexprs)))
+		node->sharedHashKeys = keyexprs;
+}
+
+/* ----------------------------------------------------------------
+ *		ExecSeqScanSetBloomFilter
+ *
+ *		Makes the scan discard tuples that the bloom filter of the
+ *		given hash join table rejects, saving the parent hash join
+ *		(see nodeHashjoin.c) the trouble of getting them.  hashkeys
+ *		are the join's outer hash keys, evaluated over our scan tuple.
+ *		Called with a NULL hashtable to stop that again.
+ * ----------------------------------------------------------------
+ */
+void
+ExecSeqScanSetBloomFilter(SeqScanState *node, HashJoinTable hashtable,
+						  List *hashkeys)
+{
+	node->bloomTable = hashtable;
+	node->bloomKeys = hashkeys;
+}
@@ -92,6 +92,9 @@ ExecSort(SortState *node)
 											  node->randomAccess);
 		if (node->bounded)
 			tuplesort_set_bound(tuplesortstate, node->bound);
+		if (node->getcomparator != NULL)
+			tuplesort_set_heap_comparator(tuplesortstate,
+										  node->getcomparator(node));
 		node->tuplesortstate = (void *) tuplesortstate;
 
 		/*
@@ -175,6 +178,8 @@ ExecInitSort(Sort *node, EState *estate, int eflags)
 	sortstate->bounded = false;
 	sortstate->sort_Done = false;
 	sortstate->tuplesortstate = NULL;
+	sortstate->getcomparator = NULL;
+	sortstate->getcomparator_arg = NULL;
 
 	/*
 	 * Miscellaneous initialization
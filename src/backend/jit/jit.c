@@ -0,0 +1,388 @@
+/*-------------------------------------------------------------------------
+ *
+ * jit.c
+ *	  Provider independent support for just-in-time compilation.
+ *
+ * This file decides whether a query is worth compiling, keeps track of the
+ * JitContexts holding generated code, and hands the expressions of plan
+ * nodes to the provider.  LLVM is the only provider at present; when the
+ * server is built without it, everything here degrades to a no-op and the
+ * executor keeps using the interpreted evalfunc of every ExprState.
+ *
+ * Portions Copyright (c) 1996-2013, PostgreSQL Global Development Group
+ *
+ *
+ * IDENTIFICATION
+ *	  src/backend/jit/jit.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "jit/jit.h"
+#ifdef USE_LLVM
+#include "jit/llvmjit.h"
+#endif
+#include "utils/memutils.h"
+
+
+/* GUC parameters */
+bool		jit_enabled = false;
+double		jit_above_cost = 100000;
+double		jit_optimize_above_cost = 500000;
+double		jit_inline_above_cost = 500000;
+bool		jit_tuple_deforming = true;
+bool		jit_code_cache = false;
+
+/* all JitContexts that have not been released yet */
+static dlist_head jit_contexts = DLIST_STATIC_INIT(jit_contexts);
+static bool jit_callback_registered = false;
+
+static void jit_resource_release(ResourceReleasePhase phase,
+					 bool isCommit, bool isTopLevel, void *arg);
+static void jit_compile_planstate_parts(PlanState *planstate,
+							JitContext *context);
+static bool jit_compile_exprlist(JitContext *context, List *exprs);
+static bool jit_compile_deform(JitContext *context, TupleTableSlot *slot);
+static bool jit_compile_agg(JitContext *context, AggState *aggstate);
+static bool jit_compile_hashjoin(JitContext *context, HashJoinState *hjstate);
+static bool jit_compile_sort(JitContext *context, SortState *sortstate);
+
+
+/*
+ * jit_flags_for_plan
+ *
+ * Decide, based on the estimated total cost of the plan, whether the query
+ * should be JIT compiled and how hard the optimizer should try.  The code of
+ * plans that the plan cache expects to be executed again is shared with
+ * other backends through the code cache.  The result is stored in
+ * EState->es_jit_flags.
+ */
+int
+jit_flags_for_plan(PlannedStmt *plannedstmt)
+{
+	int			flags = PGJIT_NONE;
+
+#ifdef USE_LLVM
+	Plan	   *plan = plannedstmt->planTree;
+
+	if (!jit_enabled || plan == NULL)
+		return PGJIT_NONE;
+
+	if (plan->total_cost < jit_above_cost)
+		return PGJIT_NONE;
+
+	flags = PGJIT_PERFORM | PGJIT_EXPR;
+	if (plan->total_cost >= jit_optimize_above_cost)
+		flags |= PGJIT_OPT3;
+	if (plan->total_cost >= jit_inline_above_cost)
+		flags |= PGJIT_INLINE;
+	if (jit_tuple_deforming)
+		flags |= PGJIT_DEFORM;
+	if (jit_code_cache && plannedstmt->jitCodeCacheable)
+		flags |= PGJIT_CACHE;
+#endif
+
+	return flags;
+}
+
+/*
+ * jit_get_context
+ *
+ * Return the JitContext of an EState, creating it if necessary.  The caller
+ * must have checked that JIT compilation was requested for the EState.
+ */
+JitContext *
+jit_get_context(EState *estate)
+{
+	Assert(estate->es_jit_flags & PGJIT_PERFORM);
+
+	if (estate->es_jit_context == NULL)
+	{
+#ifdef USE_LLVM
+		JitContext *context;
+		int			flags = estate->es_jit_flags;
+
+		/*
+		 * Instrumented code embeds the addresses of its counters, so it must
+		 * not be shared through the code cache.
+		 */
+		if (estate->es_instrument & INSTRUMENT_JIT)
+			flags &= ~PGJIT_CACHE;
+
+		context = (JitContext *) llvm_create_context(flags);
+
+		context->resowner = CurrentResourceOwner;
+		dlist_push_head(&jit_contexts, &context->node);
+
+		if (!jit_callback_registered)
+		{
+			RegisterResourceReleaseCallback(jit_resource_release, NULL);
+			jit_callback_registered = true;
+		}
+
+		estate->es_jit_context = context;
+#else
+		elog(ERROR, "JIT compilation is not supported by this build");
+#endif
+	}
+
+	return estate->es_jit_context;
+}
+
+/*
+ * jit_release_context
+ *
+ * Release a JitContext and all the code generated into it.  Pointers to that
+ * code must not be used afterwards.
+ */
+void
+jit_release_context(JitContext *context)
+{
+	dlist_delete(&context->node);
+
+#ifdef USE_LLVM
+	llvm_release_context(context);
+#endif
+
+	MemoryContextDelete(context->mcxt);
+}
+
+/*
+ * Resource owner callback: release contexts whose executor was abandoned,
+ * typically because of an error.  On the normal path FreeExecutorState()
+ * has already released them by the time their owner goes away.
+ */
+static void
+jit_resource_release(ResourceReleasePhase phase, bool isCommit,
+					 bool isTopLevel, void *arg)
+{
+	dlist_mutable_iter iter;
+
+	if (phase != RESOURCE_RELEASE_AFTER_LOCKS)
+		return;
+
+	dlist_foreach_modify(iter, &jit_contexts)
+	{
+		JitContext *context = dlist_container(JitContext, node, iter.cur);
+
+		if (context->resowner == CurrentResourceOwner)
+			jit_release_context(context);
+	}
+}
+
+/*
+ * jit_compile_planstate
+ *
+ * Called by ExecInitNode once a plan node has been initialized.  Hands the
+ * node's qual, join qual and projection expressions to the provider, which
+ * replaces the evalfunc of every expression it was able to compile.  For
+ * nodes scanning a relation, a routine deforming the relation's tuples is
+ * generated as well.  For Agg nodes the per-input-row evaluation of the
+ * aggregates' arguments and transition functions is compiled, and for
+ * HashJoin nodes the hashing of both sides' join keys and the evaluation of
+ * the hash clauses.  Sort nodes get a comparator specialized for their sort
+ * keys.  The actual machine code is only emitted when some of
+ * it is first used, so plans that are initialized but never run (EXPLAIN
+ * without ANALYZE, for instance) pay for IR generation only.
+ *
+ * The time spent here is accounted to the context as generation time.  If
+ * EXPLAIN (ANALYZE, JIT) is being run, the node also gets a
+ * JitNodeInstrumentation recording what was compiled, and the generated
+ * code counts its calls into it.
+ */
+void
+jit_compile_planstate(PlanState *planstate)
+{
+	EState	   *estate = planstate->state;
+	JitContext *context = jit_get_context(estate);
+	instr_time	starttime;
+	instr_time	endtime;
+
+	if (estate->es_instrument & INSTRUMENT_JIT)
+		planstate->jit_instrument = (JitNodeInstrumentation *)
+			palloc0(sizeof(JitNodeInstrumentation));
+	context->node_instr = planstate->jit_instrument;
+
+	INSTR_TIME_SET_CURRENT(starttime);
+	jit_compile_planstate_parts(planstate, context);
+	INSTR_TIME_SET_CURRENT(endtime);
+	INSTR_TIME_ACCUM_DIFF(context->instr.generation_counter,
+						  endtime, starttime);
+
+	context->node_instr = NULL;
+}
+
+/*
+ * Do the work of jit_compile_planstate, noting in the node's JIT
+ * instrumentation, if any, which parts of it were compiled.
+ */
+static void
+jit_compile_planstate_parts(PlanState *planstate, JitContext *context)
+{
+	EState	   *estate = planstate->state;
+	JitNodeInstrumentation *instr = planstate->jit_instrument;
+	int			compiled = 0;
+	List	   *tlist = NIL;
+	ListCell   *lc;
+
+	if (estate->es_jit_flags & PGJIT_DEFORM)
+	{
+		switch (nodeTag(planstate))
+		{
+			case T_SeqScanState:
+			case T_IndexScanState:
+			case T_BitmapHeapScanState:
+			case T_TidScanState:
+				if (jit_compile_deform(context,
+								((ScanState *) planstate)->ss_ScanTupleSlot))
+					compiled |= JIT_NODE_DEFORM;
+				break;
+			case T_HashJoinState:
+				/* inner tuples fetched from the hash table for matching */
+				if (jit_compile_deform(context,
+							   ((HashJoinState *) planstate)->hj_HashTupleSlot))
+					compiled |= JIT_NODE_DEFORM;
+				break;
+			default:
+				break;
+		}
+	}
+
+	if (!(estate->es_jit_flags & PGJIT_EXPR))
+		goto done;
+
+	if (jit_compile_exprlist(context, planstate->qual))
+		compiled |= JIT_NODE_FILTER;
+
+	switch (nodeTag(planstate))
+	{
+		case T_NestLoopState:
+		case T_MergeJoinState:
+		case T_HashJoinState:
+			if (jit_compile_exprlist(context,
+									 ((JoinState *) planstate)->joinqual))
+				compiled |= JIT_NODE_JOIN_FILTER;
+			break;
+		default:
+			break;
+	}
+
+	if (planstate->ps_ProjInfo != NULL)
+	{
+		foreach(lc, planstate->ps_ProjInfo->pi_targetlist)
+		{
+			GenericExprState *gstate = (GenericExprState *) lfirst(lc);
+
+			tlist = lappend(tlist, gstate->arg);
+		}
+		if (jit_compile_exprlist(context, tlist))
+			compiled |= JIT_NODE_OUTPUT;
+		list_free(tlist);
+	}
+
+	if (IsA(planstate, AggState))
+	{
+		if (jit_compile_agg(context, (AggState *) planstate))
+			compiled |= JIT_NODE_AGGREGATE;
+	}
+	else if (IsA(planstate, HashJoinState))
+	{
+		if (jit_compile_hashjoin(context, (HashJoinState *) planstate))
+			compiled |= JIT_NODE_HASH;
+	}
+	else if (IsA(planstate, SortState))
+	{
+		if (jit_compile_sort(context, (SortState *) planstate))
+			compiled |= JIT_NODE_SORT;
+	}
+
+done:
+	if (instr)
+		instr->compiled = compiled;
+}
+
+/*
+ * Offer each expression of the list to the provider.  Expressions it cannot
+ * handle are left alone and keep being interpreted.  Returns whether any
+ * expression was compiled.
+ */
+static bool
+jit_compile_exprlist(JitContext *context, List *exprs)
+{
+	int			ncompiled = 0;
+#ifdef USE_LLVM
+	ListCell   *lc;
+
+	foreach(lc, exprs)
+	{
+		if (llvm_compile_expr((LLVMJitContext *) context,
+							  (ExprState *) lfirst(lc)))
+			ncompiled++;
+	}
+#endif
+
+	if (context->node_instr)
+	{
+		context->node_instr->nexprs += list_length(exprs);
+		context->node_instr->ncompiled_exprs += ncompiled;
+	}
+
+	return ncompiled > 0;
+}
+
+/*
+ * Offer a slot to the provider for generating a deforming routine specific
+ * to its tuple descriptor.
+ */
+static bool
+jit_compile_deform(JitContext *context, TupleTableSlot *slot)
+{
+#ifdef USE_LLVM
+	return llvm_compile_deform((LLVMJitContext *) context, slot);
+#else
+	return false;
+#endif
+}
+
+/*
+ * Offer an Agg node to the provider for compiling the work done for each
+ * input row.
+ */
+static bool
+jit_compile_agg(JitContext *context, AggState *aggstate)
+{
+#ifdef USE_LLVM
+	return llvm_compile_agg((LLVMJitContext *) context, aggstate);
+#else
+	return false;
+#endif
+}
+
+/*
+ * Offer a HashJoin node to the provider for compiling the hashing and
+ * matching of its join keys.
+ */
+static bool
+jit_compile_hashjoin(JitContext *context, HashJoinState *hjstate)
+{
+#ifdef USE_LLVM
+	return llvm_compile_hashjoin((LLVMJitContext *) context, hjstate);
+#else
+	return false;
+#endif
+}
+
+/*
+ * Offer a Sort node to the provider for generating a comparator specific to
+ * its sort keys.
+ */
+static bool
+jit_compile_sort(JitContext *context, SortState *sortstate)
+{
+#ifdef USE_LLVM
+	return llvm_compile_sort((LLVMJitContext *) context, sortstate);
+#else
+	return false;
+#endif
+}
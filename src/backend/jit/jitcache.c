@@ -0,0 +1,237 @@
+/*-------------------------------------------------------------------------
+ *
+ * jitcache.c
+ *	  On-disk cache of JIT compiled code, shared by all backends.
+ *
+ * The provider stores the machine code it emitted for a module in a file
+ * named after a key computed from the module's contents, so that other
+ * backends that generate the same code (typically because they execute the
+ * same prepared statement) can load it instead of optimizing and compiling
+ * it again.  As the key is derived from the code itself, entries never need
+ * to be invalidated; the code of a plan that has gone away simply isn't
+ * asked for anymore.
+ *
+ * Generated code may refer to addresses of server functions, which only
+ * stay the same while the postmaster is running, so the cache is emptied at
+ * every server start.  Nothing here is crash safe, nor needs to be: entries
+ * are written to a temporary file and renamed into place, and one that
+ * fails its checksum when read is treated as missing.
+ *
+ * Portions Copyright (c) 1996-2013, PostgreSQL Global Development Group
+ *
+ *
+ * IDENTIFICATION
+ *	  src/backend/jit/jitcache.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "jit/jit.h"
+#include "miscadmin.h"
+#include "storage/fd.h"
+#include "utils/memutils.h"
+#include "utils/pg_crc.h"
+
+
+/* directory holding the cache, relative to the data directory */
+#define JIT_CACHE_DIR		"pg_jitcache"
+
+#define JIT_CACHE_MAGIC		0x4A495431	/* "JIT1" */
+
+/* header preceding the code in each cache file */
+typedef struct JitCacheFileHeader
+{
+	uint32		magic;			/* JIT_CACHE_MAGIC */
+	uint32		len;			/* length of the code following */
+	pg_crc32	crc;			/* CRC of the code */
+} JitCacheFileHeader;
+
+
+static void jit_cache_path(char *path, const char *key);
+
+
+/*
+ * jit_cache_read
+ *
+ * Return a palloc'd copy of the code stored under 'key' and set *len to its
+ * length, or return NULL if there is no usable entry.
+ */
+char *
+jit_cache_read(const char *key, Size *len)
+{
+	char		path[MAXPGPATH];
+	JitCacheFileHeader hdr;
+	pg_crc32	crc;
+	char	   *data;
+	int			fd;
+
+	jit_cache_path(path, key);
+
+	fd = OpenTransientFile(path, O_RDONLY | PG_BINARY, 0);
+	if (fd < 0)
+	{
+		if (errno != ENOENT)
+			ereport(LOG,
+					(errcode_for_file_access(),
+					 errmsg("could not open JIT code cache file \"%s\": %m",
+							path)));
+		return NULL;
+	}
+
+	if (read(fd, &hdr, sizeof(hdr)) != sizeof(hdr) ||
+		hdr.magic != JIT_CACHE_MAGIC || !AllocSizeIsValid(hdr.len))
+	{
+		CloseTransientFile(fd);
+		elog(LOG, "invalid JIT code cache file \"%s\"", path);
+		return NULL;
+	}
+
+	data = palloc(hdr.len);
+	if (read(fd, data, hdr.len) != hdr.len)
+	{
+		CloseTransientFile(fd);
+		pfree(data);
+		elog(LOG, "invalid JIT code cache file \"%s\"", path);
+		return NULL;
+	}
+	CloseTransientFile(fd);
+
+	INIT_CRC32(crc);
+	COMP_CRC32(crc, data, hdr.len);
+	FIN_CRC32(crc);
+	if (!EQ_CRC32(crc, hdr.crc))
+	{
+		pfree(data);
+		elog(LOG, "incorrect checksum in JIT code cache file \"%s\"", path);
+		return NULL;
+	}
+
+	*len = hdr.len;
+	return data;
+}
+
+/*
+ * jit_cache_write
+ *
+ * Store 'len' bytes of code under 'key'.  Failures are logged and otherwise
+ * ignored; the code just won't be found by others.  If another backend
+ * stores the same key concurrently, one of the two identical files wins.
+ */
+void
+jit_cache_write(const char *key, const char *data, Size len)
+{
+	char		path[MAXPGPATH];
+	char		tmppath[MAXPGPATH];
+	JitCacheFileHeader hdr;
+	int			fd;
+
+	jit_cache_path(path, key);
+	snprintf(tmppath, sizeof(tmppath), "%s/%s.%d.tmp",
+			 JIT_CACHE_DIR, key, MyProcPid);
+
+	hdr.magic = JIT_CACHE_MAGIC;
+	hdr.len = len;
+	INIT_CRC32(hdr.crc);
+	COMP_CRC32(hdr.crc, data, len);
+	FIN_CRC32(hdr.crc);
+
+	fd = OpenTransientFile(tmppath, O_WRONLY | O_CREAT | O_TRUNC | PG_BINARY,
+						   S_IRUSR | S_IWUSR);
+	if (fd < 0 && errno == ENOENT)
+	{
+		/* the directory is missing in clusters initialized without it */
+		if (mkdir(JIT_CACHE_DIR, S_IRWXU) < 0 && errno != EEXIST)
+		{
+			ereport(LOG,
+					(errcode_for_file_access(),
+					 errmsg("could not create directory \"%s\": %m",
+							JIT_CACHE_DIR)));
+			return;
+		}
+		fd = OpenTransientFile(tmppath,
+							   O_WRONLY | O_CREAT | O_TRUNC | PG_BINARY,
+							   S_IRUSR | S_IWUSR);
+	}
+	if (fd < 0)
+	{
+		ereport(LOG,
+				(errcode_for_file_access(),
+				 errmsg("could not create JIT code cache file \"%s\": %m",
+						tmppath)));
+		return;
+	}
+
+	if (write(fd, &hdr, sizeof(hdr)) != sizeof(hdr) ||
+		write(fd, data, len) != len)
+	{
+		ereport(LOG,
+				(errcode_for_file_access(),
+				 errmsg("could not write JIT code cache file \"%s\": %m",
+						tmppath)));
+		CloseTransientFile(fd);
+		unlink(tmppath);
+		return;
+	}
+
+	if (CloseTransientFile(fd) < 0 || rename(tmppath, path) < 0)
+	{
+		ereport(LOG,
+				(errcode_for_file_access(),
+				 errmsg("could not rename JIT code cache file \"%s\" to \"%s\": %m",
+						tmppath, path)));
+		unlink(tmppath);
+	}
+}
+
+/*
+ * RemoveJitCodeCache
+ *
+ * Remove all entries of the cache.  Called by the postmaster at startup,
+ * when no backend can be using it.
+ */
+void
+RemoveJitCodeCache(void)
+{
+	DIR		   *dir;
+	struct dirent *de;
+	char		rm_path[MAXPGPATH];
+
+	dir = AllocateDir(JIT_CACHE_DIR);
+	if (dir == NULL)
+	{
+		/* anything except ENOENT is fishy */
+		if (errno != ENOENT)
+			elog(LOG,
+				 "could not open JIT code cache directory \"%s\": %m",
+				 JIT_CACHE_DIR);
+		return;
+	}
+
+	while ((de = ReadDir(dir, JIT_CACHE_DIR)) != NULL)
+	{
+		if (strcmp(de->d_name, ".") == 0 ||
+			strcmp(de->d_name, "..") == 0)
+			continue;
+
+		snprintf(rm_path, sizeof(rm_path), "%s/%s",
+				 JIT_CACHE_DIR, de->d_name);
+		unlink(rm_path);		/* note we ignore any error */
+	}
+
+	FreeDir(dir);
+}
+
+/*
+ * Build the path of the cache file for 'key' into 'path', which must be
+ * MAXPGPATH long.
+ */
+static void
+jit_cache_path(char *path, const char *key)
+{
+	snprintf(path, MAXPGPATH, "%s/%s", JIT_CACHE_DIR, key);
+}
@@ -0,0 +1,696 @@
+/*-------------------------------------------------------------------------
+ *
+ * llvmjit.c
+ *	  Core part of the LLVM JIT provider: session setup, module handling,
+ *	  optimization and emission of machine code.
+ *
+ * Code is generated into one LLVM module per JitContext at a time.  When a
+ * function of that module is needed for the first time, the whole module is
+ * optimized and handed to an ORC LLJIT instance, which lives as long as the
+ * backend does.  Each emitted module is tracked by its own resource tracker,
+ * so that its code can be thrown away when the owning context is released.
+ *
+ * Modules of queries whose code is to be shared through the code cache (see
+ * jitcache.c) take a different route: they are compiled into an object file
+ * by us, which is stored in the cache and then handed to LLJIT.  The
+ * functions of such modules are named after a hash of the module's
+ * contents, so that all backends generating the same module agree on the
+ * names and the hash can serve as the key of the cache entry.
+ *
+ * Portions Copyright (c) 1996-2013, PostgreSQL Global Development Group
+ *
+ *
+ * IDENTIFICATION
+ *	  src/backend/jit/llvmjit.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include <llvm-c/Analysis.h>
+#include <llvm-c/Core.h>
+#include <llvm-c/Error.h>
+#include <llvm-c/LLJIT.h>
+#include <llvm-c/Orc.h>
+#include <llvm-c/Target.h>
+#include <llvm-c/TargetMachine.h>
+#include <llvm-c/Transforms/IPO.h>
+#include <llvm-c/Transforms/PassManagerBuilder.h>
+#include <llvm-c/Transforms/Scalar.h>
+#include <llvm-c/Transforms/Utils.h>
+
+#include "jit/llvmjit.h"
+#include "lib/stringinfo.h"
+#include "libpq/md5.h"
+#include "miscadmin.h"
+#include "nodes/execnodes.h"
+#include "utils/hsearch.h"
+#include "utils/memutils.h"
+
+
+/* length of the keys of cached modules, an MD5 hash in hex */
+#define LLVM_CACHE_KEY_LEN	32
+
+/*
+ * A module of the code cache loaded into this backend.  Contexts generating
+ * the same module share its code, as its symbols can only be defined once.
+ */
+typedef struct LLVMCachedModule
+{
+	char		key[LLVM_CACHE_KEY_LEN + 1];	/* hash key, must be first */
+	LLVMOrcResourceTrackerRef tracker;
+	int			refcount;		/* number of contexts using it */
+} LLVMCachedModule;
+
+/* name a function of a cached module ended up with */
+typedef struct LLVMRenamedFunction
+{
+	char	   *funcname;		/* as returned by llvm_expand_funcname() */
+	char	   *symbol;			/* name in the emitted module */
+} LLVMRenamedFunction;
+
+
+/* handles for the per-backend LLVM state */
+LLVMContextRef llvm_context = NULL;
+LLVMTypeRef TypeSizeT;
+LLVMTypeRef TypeDatum;
+LLVMTypeRef TypeStorageBool;
+LLVMTypeRef TypeParamBool;
+LLVMTypeRef TypePtr;
+LLVMTypeRef TypeExprStateEvalFunc;
+
+static bool llvm_session_initialized = false;
+static LLVMOrcThreadSafeContextRef llvm_ts_context = NULL;
+static LLVMOrcLLJITRef llvm_jit = NULL;
+static const char *llvm_triple = NULL;
+static const char *llvm_layout = NULL;
+static LLVMTargetMachineRef llvm_target_machine = NULL;
+
+/* LLVMCachedModules loaded into this backend, by key */
+static HTAB *llvm_cached_modules = NULL;
+
+/* counter making module and function names unique within the backend */
+static int	llvm_generation = 0;
+
+
+static void llvm_session_initialize(void);
+static void llvm_optimize_module(LLVMJitContext *context, LLVMModuleRef module);
+static void llvm_compile_module(LLVMJitContext *context);
+static void llvm_compile_module_cached(LLVMJitContext *context,
+						   LLVMModuleRef module);
+static void llvm_name_module(LLVMJitContext *context, LLVMModuleRef module,
+				 char *key);
+static LLVMMemoryBufferRef llvm_emit_object(LLVMModuleRef module);
+static void llvm_remove_tracker(LLVMOrcResourceTrackerRef tracker);
+static void llvm_report_error(LLVMErrorRef error, const char *what);
+
+
+/*
+ * Create a context for JIT compilation of the code belonging to one EState.
+ */
+LLVMJitContext *
+llvm_create_context(int jitFlags)
+{
+	MemoryContext mcxt;
+	LLVMJitContext *context;
+
+	llvm_session_initialize();
+
+	mcxt = AllocSetContextCreate(TopMemoryContext,
+								 "JIT context",
+								 ALLOCSET_SMALL_MINSIZE,
+								 ALLOCSET_SMALL_INITSIZE,
+								 ALLOCSET_DEFAULT_MAXSIZE);
+
+	context = MemoryContextAllocZero(mcxt, sizeof(LLVMJitContext));
+	context->base.flags = jitFlags;
+	context->base.mcxt = mcxt;
+
+	return context;
+}
+
+/*
+ * Release all resources of a context.  The caller takes care of the memory
+ * context the LLVMJitContext itself lives in.
+ */
+void
+llvm_release_context(JitContext *context)
+{
+	LLVMJitContext *jcontext = (LLVMJitContext *) context;
+	ListCell   *lc;
+
+	if (jcontext->module)
+	{
+		LLVMDisposeModule(jcontext->module);
+		jcontext->module = NULL;
+	}
+
+	foreach(lc, jcontext->handles)
+		llvm_remove_tracker((LLVMOrcResourceTrackerRef) lfirst(lc));
+
+	foreach(lc, jcontext->cached_modules)
+	{
+		LLVMCachedModule *entry = (LLVMCachedModule *) lfirst(lc);
+
+		if (--entry->refcount == 0)
+		{
+			llvm_remove_tracker(entry->tracker);
+			hash_search(llvm_cached_modules, entry->key, HASH_REMOVE, NULL);
+		}
+	}
+	jcontext->handles = NIL;
+	jcontext->cached_modules = NIL;
+	jcontext->renamed_functions = NIL;
+	jcontext->compiled_exprs = NIL;
+}
+
+/*
+ * Return the module new code for the context should be generated into,
+ * creating one if necessary.
+ */
+LLVMModuleRef
+llvm_mutable_module(LLVMJitContext *context)
+{
+	if (context->module == NULL)
+	{
+		char		name[64];
+
+		snprintf(name, sizeof(name), "pg_jit_module_%d_%d",
+				 MyProcPid, ++llvm_generation);
+		context->module = LLVMModuleCreateWithNameInContext(name, llvm_context);
+		LLVMSetTarget(context->module, llvm_triple);
+		LLVMSetDataLayout(context->module, llvm_layout);
+		context->module_generation++;
+	}
+
+	return context->module;
+}
+
+/*
+ * Return a name for a new function, unique within the backend.  The result
+ * is allocated in the context's memory context.
+ */
+char *
+llvm_expand_funcname(LLVMJitContext *context, const char *basename)
+{
+	char		buf[NAMEDATALEN * 2];
+
+	snprintf(buf, sizeof(buf), "%s_%d", basename, ++llvm_generation);
+	context->base.instr.created_functions++;
+
+	return MemoryContextStrdup(context->base.mcxt, buf);
+}
+
+/*
+ * Return a pointer to the machine code of function 'funcname'.  If the
+ * function lives in the module that is still being built, that module is
+ * optimized and emitted first.
+ */
+void *
+llvm_get_function(LLVMJitContext *context, const char *funcname)
+{
+	LLVMOrcExecutorAddress addr;
+	LLVMErrorRef error;
+	ListCell   *lc;
+	instr_time	starttime;
+	instr_time	endtime;
+
+	if (context->module != NULL)
+		llvm_compile_module(context);
+
+	foreach(lc, context->renamed_functions)
+	{
+		LLVMRenamedFunction *renamed = (LLVMRenamedFunction *) lfirst(lc);
+
+		if (strcmp(renamed->funcname, funcname) == 0)
+		{
+			funcname = renamed->symbol;
+			break;
+		}
+	}
+
+	/* LLJIT emits the machine code of IR modules on their first lookup */
+	INSTR_TIME_SET_CURRENT(starttime);
+	error = LLVMOrcLLJITLookup(llvm_jit, &addr, funcname);
+	INSTR_TIME_SET_CURRENT(endtime);
+	INSTR_TIME_ACCUM_DIFF(context->base.instr.emission_counter,
+						  endtime, starttime);
+	if (error)
+		llvm_report_error(error, "could not look up JIT compiled function");
+
+	if (addr == 0)
+		elog(ERROR, "failed to JIT: %s", funcname);
+
+	return (void *) (uintptr_t) addr;
+}
+
+/*
+ * Return a declaration of the external function 'name' usable in 'mod',
+ * adding one if the module doesn't have it yet.  The symbol is resolved
+ * against the server binary when the module is emitted.
+ */
+LLVMValueRef
+llvm_get_decl(LLVMModuleRef mod, const char *name, LLVMTypeRef functype)
+{
+	LLVMValueRef fn;
+
+	fn = LLVMGetNamedFunction(mod, name);
+	if (fn)
+		return fn;
+
+	fn = LLVMAddFunction(mod, name, functype);
+	LLVMSetLinkage(fn, LLVMExternalLinkage);
+
+	return fn;
+}
+
+/*
+ * Return a declaration of the server's global variable 'name', of type
+ * 'type', usable in 'mod'.
+ */
+LLVMValueRef
+llvm_get_global(LLVMModuleRef mod, const char *name, LLVMTypeRef type)
+{
+	LLVMValueRef gv;
+
+	gv = LLVMGetNamedGlobal(mod, name);
+	if (gv)
+		return gv;
+
+	gv = LLVMAddGlobal(mod, type, name);
+	LLVMSetLinkage(gv, LLVMExternalLinkage);
+
+	return gv;
+}
+
+/*
+ * Optimize a module.  Cheap queries only get the passes that clean up after
+ * our IR generation (most importantly turning the allocas used for
+ * intermediate results into SSA values); expensive ones get -O3.  If
+ * builtins are to be inlined, their definitions are imported first, and the
+ * inliner is run.
+ */
+static void
+llvm_optimize_module(LLVMJitContext *context, LLVMModuleRef module)
+{
+	LLVMPassManagerBuilderRef pmb;
+	LLVMPassManagerRef fpm;
+	LLVMPassManagerRef mpm;
+	LLVMValueRef func;
+	int			level;
+	bool		inline_builtins;
+	instr_time	starttime;
+	instr_time	endtime;
+
+	INSTR_TIME_SET_CURRENT(starttime);
+
+	level = (context->base.flags & PGJIT_OPT3) ? 3 : 0;
+	inline_builtins = (context->base.flags & PGJIT_INLINE) != 0;
+
+	if (inline_builtins)
+		llvm_inline(module);
+
+	pmb = LLVMPassManagerBuilderCreate();
+	LLVMPassManagerBuilderSetOptLevel(pmb, level);
+	if (inline_builtins)
+		LLVMPassManagerBuilderUseInlinerWithThreshold(pmb, 512);
+
+	/*
+	 * Without -O3, inline before cleaning up, so that the FunctionCallInfo
+	 * set up for inlined calls can be broken up into SSA values, too.
+	 */
+	if (level == 0 && inline_builtins)
+	{
+		mpm = LLVMCreatePassManager();
+		LLVMAddFunctionInliningPass(mpm);
+		LLVMAddGlobalDCEPass(mpm);
+		LLVMRunPassManager(mpm, module);
+		LLVMDisposePassManager(mpm);
+	}
+
+	fpm = LLVMCreateFunctionPassManagerForModule(module);
+	if (level == 0)
+	{
+		if (inline_builtins)
+			LLVMAddScalarReplAggregatesPass(fpm);
+		else
+			LLVMAddPromoteMemoryToRegisterPass(fpm);
+		LLVMAddInstructionCombiningPass(fpm);
+		LLVMAddCFGSimplificationPass(fpm);
+	}
+	else
+		LLVMPassManagerBuilderPopulateFunctionPassManager(pmb, fpm);
+
+	LLVMInitializeFunctionPassManager(fpm);
+	for (func = LLVMGetFirstFunction(module);
+		 func != NULL;
+		 func = LLVMGetNextFunction(func))
+		LLVMRunFunctionPassManager(fpm, func);
+	LLVMFinalizeFunctionPassManager(fpm);
+	LLVMDisposePassManager(fpm);
+
+	if (level > 0)
+	{
+		mpm = LLVMCreatePassManager();
+		LLVMPassManagerBuilderPopulateModulePassManager(pmb, mpm);
+		LLVMRunPassManager(mpm, module);
+		LLVMDisposePassManager(mpm);
+	}
+
+	LLVMPassManagerBuilderDispose(pmb);
+
+	INSTR_TIME_SET_CURRENT(endtime);
+	INSTR_TIME_ACCUM_DIFF(context->base.instr.optimization_counter,
+						  endtime, starttime);
+}
+
+/*
+ * Optimize and emit the module currently being built by the context.
+ */
+static void
+llvm_compile_module(LLVMJitContext *context)
+{
+	LLVMModuleRef module = context->module;
+	LLVMOrcResourceTrackerRef tracker;
+	LLVMOrcThreadSafeModuleRef ts_module;
+	LLVMErrorRef error;
+	MemoryContext oldcontext;
+
+	/* the module is owned by LLJIT from here on, whatever happens */
+	context->module = NULL;
+
+#ifdef USE_ASSERT_CHECKING
+	if (LLVMVerifyModule(module, LLVMPrintMessageAction, NULL))
+		elog(ERROR, "JIT generated invalid module");
+#endif
+
+	if (context->base.flags & PGJIT_CACHE)
+	{
+		llvm_compile_module_cached(context, module);
+		return;
+	}
+
+	llvm_optimize_module(context, module);
+
+	tracker = LLVMOrcJITDylibCreateResourceTracker(LLVMOrcLLJITGetMainJITDylib(llvm_jit));
+	ts_module = LLVMOrcCreateNewThreadSafeModule(module, llvm_ts_context);
+
+	oldcontext = MemoryContextSwitchTo(context->base.mcxt);
+	context->handles = lappend(context->handles, tracker);
+	MemoryContextSwitchTo(oldcontext);
+
+	error = LLVMOrcLLJITAddLLVMIRModuleWithRT(llvm_jit, tracker, ts_module);
+	if (error)
+	{
+		LLVMOrcDisposeThreadSafeModule(ts_module);
+		llvm_report_error(error, "could not add module to JIT");
+	}
+}
+
+/*
+ * Emit a module through the code cache.  If this backend has loaded the
+ * same module for another context already, that code is used; otherwise the
+ * object file is read from the cache, or compiled and stored there.
+ */
+static void
+llvm_compile_module_cached(LLVMJitContext *context, LLVMModuleRef module)
+{
+	char		key[LLVM_CACHE_KEY_LEN + 1];
+	LLVMCachedModule *entry;
+	MemoryContext oldcontext;
+
+	llvm_name_module(context, module, key);
+
+	if (llvm_cached_modules == NULL)
+	{
+		HASHCTL		ctl;
+
+		MemSet(&ctl, 0, sizeof(ctl));
+		ctl.keysize = LLVM_CACHE_KEY_LEN + 1;
+		ctl.entrysize = sizeof(LLVMCachedModule);
+		llvm_cached_modules = hash_create("JIT cached modules", 16,
+										  &ctl, HASH_ELEM);
+	}
+
+	entry = (LLVMCachedModule *) hash_search(llvm_cached_modules, key,
+											 HASH_FIND, NULL);
+	if (entry == NULL)
+	{
+		LLVMOrcResourceTrackerRef tracker;
+		LLVMMemoryBufferRef buf;
+		LLVMErrorRef error;
+		char	   *data;
+		Size		len;
+
+		data = jit_cache_read(key, &len);
+		if (data != NULL)
+		{
+			buf = LLVMCreateMemoryBufferWithMemoryRangeCopy(data, len, key);
+			pfree(data);
+		}
+		else
+		{
+			instr_time	starttime;
+			instr_time	endtime;
+
+			llvm_optimize_module(context, module);
+
+			INSTR_TIME_SET_CURRENT(starttime);
+			buf = llvm_emit_object(module);
+			INSTR_TIME_SET_CURRENT(endtime);
+			INSTR_TIME_ACCUM_DIFF(context->base.instr.emission_counter,
+								  endtime, starttime);
+
+			jit_cache_write(key, LLVMGetBufferStart(buf),
+							LLVMGetBufferSize(buf));
+		}
+		LLVMDisposeModule(module);
+
+		tracker = LLVMOrcJITDylibCreateResourceTracker(LLVMOrcLLJITGetMainJITDylib(llvm_jit));
+		error = LLVMOrcLLJITAddObjectFileWithRT(llvm_jit, tracker, buf);
+		if (error)
+		{
+			LLVMOrcReleaseResourceTracker(tracker);
+			llvm_report_error(error, "could not add object file to JIT");
+		}
+
+		entry = (LLVMCachedModule *) hash_search(llvm_cached_modules, key,
+												 HASH_ENTER, NULL);
+		entry->tracker = tracker;
+		entry->refcount = 0;
+	}
+	else
+		LLVMDisposeModule(module);
+
+	oldcontext = MemoryContextSwitchTo(context->base.mcxt);
+	context->cached_modules = lappend(context->cached_modules, entry);
+	MemoryContextSwitchTo(oldcontext);
+	entry->refcount++;
+}
+
+/*
+ * Replace everything specific to this backend in the names of a module and
+ * the functions defined by it, and compute the module's cache key into
+ * 'key'.  The functions are numbered while the key is computed, then named
+ * after it; the new names are remembered for llvm_get_function().
+ */
+static void
+llvm_name_module(LLVMJitContext *context, LLVMModuleRef module, char *key)
+{
+	static const char modname[] = "pg_jit_module";
+	LLVMValueRef func;
+	List	   *funcnames = NIL;
+	ListCell   *lc;
+	StringInfoData buf;
+	char	   *ir;
+	char		symbol[NAMEDATALEN];
+	int			n;
+	MemoryContext oldcontext;
+
+	oldcontext = MemoryContextSwitchTo(context->base.mcxt);
+
+	LLVMSetModuleIdentifier(module, modname, strlen(modname));
+	LLVMSetSourceFileName(module, modname, strlen(modname));
+
+	n = 0;
+	for (func = LLVMGetFirstFunction(module);
+		 func != NULL;
+		 func = LLVMGetNextFunction(func))
+	{
+		size_t		len;
+
+		if (LLVMIsDeclaration(func))
+			continue;
+
+		funcnames = lappend(funcnames, pstrdup(LLVMGetValueName2(func, &len)));
+		snprintf(symbol, sizeof(symbol), "pgjit_%d", n++);
+		LLVMSetValueName2(func, symbol, strlen(symbol));
+	}
+
+	/* the optimization level and inlining decide about the code, too */
+	ir = LLVMPrintModuleToString(module);
+	initStringInfo(&buf);
+	appendStringInfo(&buf, "opt%d inline%d\n",
+					 (context->base.flags & PGJIT_OPT3) ? 3 : 0,
+					 (context->base.flags & PGJIT_INLINE) ? 1 : 0);
+	appendStringInfoString(&buf, ir);
+	LLVMDisposeMessage(ir);
+
+	if (!pg_md5_hash(buf.data, buf.len, key))
+		ereport(ERROR,
+				(errcode(ERRCODE_OUT_OF_MEMORY),
+				 errmsg("out of memory")));
+	pfree(buf.data);
+
+	n = 0;
+	lc = list_head(funcnames);
+	for (func = LLVMGetFirstFunction(module);
+		 func != NULL;
+		 func = LLVMGetNextFunction(func))
+	{
+		LLVMRenamedFunction *renamed;
+
+		if (LLVMIsDeclaration(func))
+			continue;
+
+		snprintf(symbol, sizeof(symbol), "pgjit_%s_%d", key, n++);
+		LLVMSetValueName2(func, symbol, strlen(symbol));
+
+		renamed = palloc(sizeof(LLVMRenamedFunction));
+		renamed->funcname = (char *) lfirst(lc);
+		renamed->symbol = pstrdup(symbol);
+		context->renamed_functions = lappend(context->renamed_functions,
+											 renamed);
+		lc = lnext(lc);
+	}
+
+	list_free(funcnames);
+	MemoryContextSwitchTo(oldcontext);
+}
+
+/*
+ * Compile a module, which must have been optimized already, into an object
+ * file for the host.
+ */
+static LLVMMemoryBufferRef
+llvm_emit_object(LLVMModuleRef module)
+{
+	LLVMMemoryBufferRef buf;
+	char	   *msg;
+
+	if (llvm_target_machine == NULL)
+	{
+		LLVMTargetRef target;
+		char	   *cpu;
+		char	   *features;
+
+		if (LLVMGetTargetFromTriple(llvm_triple, &target, &msg))
+			elog(ERROR, "could not find LLVM target for \"%s\": %s",
+				 llvm_triple, msg);
+
+		/* generate code for this machine, as LLJIT does */
+		cpu = LLVMGetHostCPUName();
+		features = LLVMGetHostCPUFeatures();
+		llvm_target_machine =
+			LLVMCreateTargetMachine(target, llvm_triple, cpu, features,
+									LLVMCodeGenLevelDefault,
+									LLVMRelocDefault,
+									LLVMCodeModelJITDefault);
+		LLVMDisposeMessage(cpu);
+		LLVMDisposeMessage(features);
+	}
+
+	if (LLVMTargetMachineEmitToMemoryBuffer(llvm_target_machine, module,
+											LLVMObjectFile, &msg, &buf))
+		elog(ERROR, "could not emit JIT object file: %s", msg);
+
+	return buf;
+}
+
+/*
+ * Throw away the code of a module and release its resource tracker.
+ */
+static void
+llvm_remove_tracker(LLVMOrcResourceTrackerRef tracker)
+{
+	LLVMErrorRef error;
+
+	error = LLVMOrcResourceTrackerRemove(tracker);
+	LLVMOrcReleaseResourceTracker(tracker);
+
+	/* we might be cleaning up after an error; don't throw another */
+	if (error)
+	{
+		char	   *msg = LLVMGetErrorMessage(error);
+
+		elog(WARNING, "could not release JIT code: %s", msg);
+		LLVMDisposeErrorMessage(msg);
+	}
+}
+
+/*
+ * Per backend initialization of LLVM: target setup, the JIT instance and the
+ * types used throughout code generation.
+ */
+static void
+llvm_session_initialize(void)
+{
+	LLVMOrcDefinitionGeneratorRef generator;
+	LLVMErrorRef error;
+	LLVMTypeRef param_types[4];
+
+	if (llvm_session_initialized)
+		return;
+
+	LLVMInitializeNativeTarget();
+	LLVMInitializeNativeAsmPrinter();
+	LLVMInitializeNativeAsmParser();
+
+	error = LLVMOrcCreateLLJIT(&llvm_jit, NULL);
+	if (error)
+		llvm_report_error(error, "could not create LLVM JIT");
+
+	/* resolve references to functions of the server binary */
+	error = LLVMOrcCreateDynamicLibrarySearchGeneratorForProcess(&generator,
+									   LLVMOrcLLJITGetGlobalPrefix(llvm_jit),
+																 NULL, NULL);
+	if (error)
+		llvm_report_error(error, "could not create LLVM symbol generator");
+	LLVMOrcJITDylibAddGenerator(LLVMOrcLLJITGetMainJITDylib(llvm_jit),
+								generator);
+
+	llvm_triple = LLVMOrcLLJITGetTripleString(llvm_jit);
+	llvm_layout = LLVMOrcLLJITGetDataLayoutStr(llvm_jit);
+
+	llvm_ts_context = LLVMOrcCreateNewThreadSafeContext();
+	llvm_context = LLVMOrcThreadSafeContextGetContext(llvm_ts_context);
+
+	TypeSizeT = LLVMIntTypeInContext(llvm_context, sizeof(size_t) * 8);
+	TypeDatum = LLVMIntTypeInContext(llvm_context, sizeof(Datum) * 8);
+	TypeStorageBool = LLVMIntTypeInContext(llvm_context, sizeof(bool) * 8);
+	TypeParamBool = LLVMInt1TypeInContext(llvm_context);
+	TypePtr = LLVMPointerType(LLVMInt8TypeInContext(llvm_context), 0);
+
+	/* Datum (*)(ExprState *, ExprContext *, bool *, ExprDoneCond *) */
+	param_types[0] = TypePtr;
+	param_types[1] = TypePtr;
+	param_types[2] = TypePtr;
+	param_types[3] = TypePtr;
+	TypeExprStateEvalFunc = LLVMFunctionType(TypeDatum, param_types, 4, false);
+
+	llvm_session_initialized = true;
+}
+
+/*
+ * Convert an LLVM error into an ERROR.
+ */
+static void
+llvm_report_error(LLVMErrorRef error, const char *what)
+{
+	char	   *llvm_msg = LLVMGetErrorMessage(error);
+	char	   *msg = pstrdup(llvm_msg);
+
+	LLVMDisposeErrorMessage(llvm_msg);
+
+	elog(ERROR, "%s: %s", what, msg);
+}
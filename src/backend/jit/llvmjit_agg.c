@@ -0,0 +1,526 @@
+/*-------------------------------------------------------------------------
+ *
+ * llvmjit_agg.c
+ *	  Generate the per-input-row work of an Agg node.
+ *
+ * For every input row, advance_aggregates() loops over the node's
+ * aggregates, projects each one's arguments into a slot, copies them into
+ * a FunctionCallInfoData and calls advance_transition_function(), which
+ * checks strictness and calls the transition function through fmgr.  The
+ * code generated here does all of that for a whole Agg node in a single
+ * function, installed as the AggState's advance_func:
+ *
+ *	- argument expressions are evaluated inline, straight into the
+ *	  FunctionCallInfoData, using the code generator of llvmjit_expr.c,
+ *	- NULL inputs of strict transition functions are skipped without a call,
+ *	- the transition functions of count(), of sum() over int2, int4 and
+ *	  float8 and of min() and max() over int2, int4, int8 and float8 are
+ *	  evaluated inline when their state is passed by value,
+ *	- all other transition functions go through advance_transition_function
+ *	  as before, which takes care of pass-by-reference states.
+ *
+ * Aggregates with DISTINCT or ORDER BY feed a tuplesort instead and are left
+ * to the interpreter; the node is then not compiled at all.  Like the
+ * expression code, the generated code contains no pointers into executor
+ * state, it finds the per-aggregate data by following the AggState.
+ *
+ * Portions Copyright (c) 1996-2013, PostgreSQL Global Development Group
+ *
+ *
+ * IDENTIFICATION
+ *	  src/backend/jit/llvmjit_agg.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "executor/nodeAgg.h"
+#include "jit/llvmjit.h"
+#include "nodes/nodeFuncs.h"
+#include "utils/fmgroids.h"
+#include "utils/memutils.h"
+
+
+/*
+ * What the stub installed as advance_func needs to find the generated code.
+ */
+typedef struct CompiledAgg
+{
+	LLVMJitContext *context;
+	char	   *funcname;
+} CompiledAgg;
+
+/* how a transition function evaluated inline combines state and input */
+typedef enum InlineTransKind
+{
+	TRANS_COUNT,				/* state + 1 */
+	TRANS_ADD,					/* op(state, input) */
+	TRANS_KEEP_IF,				/* op(state, input) ? state : input */
+	TRANS_INT_SUM				/* int2_sum, int4_sum: non-strict, no overflow
+								 * check */
+} InlineTransKind;
+
+typedef struct InlineTrans
+{
+	Oid			transfn;
+	InlineTransKind kind;
+	Oid			opfuncid;		/* operator applied, for ADD and KEEP_IF */
+	int			inputbits;		/* width of the input, for INT_SUM */
+} InlineTrans;
+
+static const InlineTrans inline_trans[] = {
+	{F_INT8INC, TRANS_COUNT, F_INT8PL, 0},
+	{F_INT8INC_ANY, TRANS_COUNT, F_INT8PL, 0},
+	{F_INT2_SUM, TRANS_INT_SUM, InvalidOid, 16},
+	{F_INT4_SUM, TRANS_INT_SUM, InvalidOid, 32},
+	{F_FLOAT8PL, TRANS_ADD, F_FLOAT8PL, 0},
+	{F_INT2LARGER, TRANS_KEEP_IF, F_INT2GT, 0},
+	{F_INT2SMALLER, TRANS_KEEP_IF, F_INT2LT, 0},
+	{F_INT4LARGER, TRANS_KEEP_IF, F_INT4GT, 0},
+	{F_INT4SMALLER, TRANS_KEEP_IF, F_INT4LT, 0},
+	{F_INT8LARGER, TRANS_KEEP_IF, F_INT8GT, 0},
+	{F_INT8SMALLER, TRANS_KEEP_IF, F_INT8LT, 0},
+	{F_FLOAT8LARGER, TRANS_KEEP_IF, F_FLOAT8GT, 0},
+	{F_FLOAT8SMALLER, TRANS_KEEP_IF, F_FLOAT8LT, 0}
+};
+
+static void ExecRunCompiledAgg(AggState *aggstate, AggStatePerGroup pergroup);
+static bool agg_is_worth_compiling(AggState *aggstate);
+static const InlineTrans *find_inline_trans(AggStatePerAgg peraggstate);
+static void agg_emit_inline_trans(LLVMJitContext *context, LLVMBuilderRef b,
+					  const InlineTrans *trans, AggStatePerAgg peraggstate,
+					  LLVMValueRef v_pergroup, LLVMValueRef v_fcinfo,
+					  LLVMBasicBlockRef b_next);
+
+
+/*
+ * llvm_compile_agg
+ *
+ * Generate the per-input-row work of an Agg node into the context's current
+ * module and install a stub emitting it on first use as the node's
+ * advance_func.  Returns false, leaving the node alone, if it has aggregates
+ * we can't handle.
+ */
+bool
+llvm_compile_agg(LLVMJitContext *context, AggState *aggstate)
+{
+	LLVMModuleRef mod;
+	LLVMBuilderRef b;
+	LLVMTypeRef param_types[4];
+	LLVMTypeRef functype;
+	LLVMTypeRef transfntype;
+	LLVMValueRef fn;
+	LLVMValueRef v_aggstate;
+	LLVMValueRef v_pergroups;
+	LLVMValueRef v_tmpcontext;
+	LLVMValueRef v_oldcontext;
+	LLVMValueRef v_peraggs;
+	LLVMValueRef v_fcinfo;
+	LLVMValueRef v_transfn;
+	LLVMBasicBlockRef b_next;
+	CompiledAgg *compiled;
+	MemoryContext oldcontext;
+	char	   *funcname;
+	int			aggno;
+
+	/* in batch mode, advance_aggregates() isn't used at all */
+	if (aggstate->advance_func != NULL || aggstate->batch_mode ||
+		!agg_is_worth_compiling(aggstate))
+		return false;
+
+	funcname = llvm_expand_funcname(context, "advance_aggs");
+	mod = llvm_mutable_module(context);
+	b = LLVMCreateBuilderInContext(llvm_context);
+
+	/* void (*)(AggState *aggstate, AggStatePerGroup pergroup) */
+	param_types[0] = TypePtr;
+	param_types[1] = TypePtr;
+	functype = LLVMFunctionType(LLVMVoidTypeInContext(llvm_context),
+								param_types, 2, false);
+	fn = LLVMAddFunction(mod, funcname, functype);
+	v_aggstate = LLVMGetParam(fn, 0);
+	v_pergroups = LLVMGetParam(fn, 1);
+
+	/* void advance_transition_function(aggstate, peragg, pergroup, fcinfo) */
+	param_types[0] = TypePtr;
+	param_types[1] = TypePtr;
+	param_types[2] = TypePtr;
+	param_types[3] = TypePtr;
+	transfntype = LLVMFunctionType(LLVMVoidTypeInContext(llvm_context),
+								   param_types, 4, false);
+	v_transfn = llvm_get_decl(mod, "advance_transition_function", transfntype);
+
+	LLVMPositionBuilderAtEnd(b,
+							 LLVMAppendBasicBlockInContext(llvm_context, fn,
+														   "entry"));
+	l_count_call(context, b, false);
+
+	v_fcinfo = l_entry_alloca(b,
+							  LLVMArrayType(LLVMInt8TypeInContext(llvm_context),
+											sizeof(FunctionCallInfoData)),
+							  "fcinfo");
+	LLVMSetAlignment(v_fcinfo, MAXIMUM_ALIGNOF);
+	v_fcinfo = LLVMBuildPointerCast(b, v_fcinfo, TypePtr, "");
+
+	/*
+	 * Input expressions are evaluated in the per-input-tuple memory context,
+	 * as ExecProject would do.  advance_transition_function doesn't care.
+	 */
+	v_tmpcontext = l_load_member(b, v_aggstate,
+								 offsetof(AggState, tmpcontext),
+								 TypePtr, "tmpcontext");
+	v_oldcontext = l_mcxt_switch(mod, b,
+								 l_load_member(b, v_tmpcontext,
+								offsetof(ExprContext, ecxt_per_tuple_memory),
+											   TypePtr, ""));
+
+	v_peraggs = l_load_member(b, v_aggstate, offsetof(AggState, peragg),
+							  TypePtr, "peragg");
+
+	for (aggno = 0; aggno < aggstate->numaggs; aggno++)
+	{
+		AggStatePerAgg peraggstate = &aggstate->peragg[aggno];
+		const InlineTrans *trans = find_inline_trans(peraggstate);
+		LLVMValueRef v_peragg;
+		LLVMValueRef v_pergroup;
+		LLVMValueRef v_cell = NULL;
+		ListCell   *lc;
+		int			argno;
+
+		b_next = LLVMAppendBasicBlockInContext(llvm_context, fn, "agg.next");
+
+		v_peragg = l_member_addr(b, v_peraggs,
+								 aggno * sizeof(AggStatePerAggData),
+								 LLVMInt8TypeInContext(llvm_context));
+		v_pergroup = l_member_addr(b, v_pergroups,
+								   aggno * sizeof(AggStatePerGroupData),
+								   LLVMInt8TypeInContext(llvm_context));
+
+		/* evaluate the arguments into fcinfo->arg[1..] */
+		argno = 0;
+		foreach(lc, peraggstate->aggrefstate->args)
+		{
+			GenericExprState *gstate = (GenericExprState *) lfirst(lc);
+			LLVMValueRef v_gstate;
+
+			if (argno >= peraggstate->numArguments)
+				break;
+
+			if (v_cell == NULL)
+			{
+				LLVMValueRef v_aggref;
+				LLVMValueRef v_args;
+
+				v_aggref = l_load_member(b, v_peragg,
+									offsetof(AggStatePerAggData, aggrefstate),
+										 TypePtr, "aggrefstate");
+				v_args = l_load_member(b, v_aggref,
+									   offsetof(AggrefExprState, args),
+									   TypePtr, "args");
+				v_cell = l_load_member(b, v_args, offsetof(List, head),
+									   TypePtr, "cell");
+			}
+			else
+				v_cell = l_load_member(b, v_cell, offsetof(ListCell, next),
+									   TypePtr, "cell");
+
+			v_gstate = l_load_member(b, v_cell,
+									 offsetof(ListCell, data.ptr_value),
+									 TypePtr, "tle");
+			llvm_emit_expr(context, b, v_tmpcontext, gstate->arg,
+						   l_load_member(b, v_gstate,
+										 offsetof(GenericExprState, arg),
+										 TypePtr, "arg"),
+						   l_member_addr(b, v_fcinfo,
+										 offsetof(FunctionCallInfoData, arg) +
+										 (argno + 1) * sizeof(Datum),
+										 TypeDatum),
+						   l_member_addr(b, v_fcinfo,
+										 offsetof(FunctionCallInfoData, argnull) +
+										 (argno + 1) * sizeof(bool),
+										 TypeStorageBool));
+			argno++;
+		}
+		Assert(argno == peraggstate->numArguments);
+
+		/* for a strict transition function, NULL inputs change nothing */
+		if (peraggstate->transfn.fn_strict)
+		{
+			for (argno = 1; argno <= peraggstate->numArguments; argno++)
+			{
+				LLVMBasicBlockRef b_notnull;
+
+				b_notnull = LLVMAppendBasicBlockInContext(llvm_context, fn,
+														  "agg.argnotnull");
+				LLVMBuildCondBr(b,
+								l_isnull(b,
+										 l_member_addr(b, v_fcinfo,
+									   offsetof(FunctionCallInfoData, argnull) +
+													   argno * sizeof(bool),
+													   TypeStorageBool)),
+								b_next, b_notnull);
+				LLVMPositionBuilderAtEnd(b, b_notnull);
+			}
+		}
+
+		if (trans != NULL)
+			agg_emit_inline_trans(context, b, trans, peraggstate,
+								  v_pergroup, v_fcinfo, b_next);
+		else
+		{
+			LLVMValueRef v_params[4];
+
+			v_params[0] = v_aggstate;
+			v_params[1] = v_peragg;
+			v_params[2] = v_pergroup;
+			v_params[3] = v_fcinfo;
+			LLVMBuildCall2(b, transfntype, v_transfn, v_params, 4, "");
+			LLVMBuildBr(b, b_next);
+		}
+
+		LLVMPositionBuilderAtEnd(b, b_next);
+	}
+
+	l_mcxt_switch(mod, b, v_oldcontext);
+	LLVMBuildRetVoid(b);
+
+	LLVMDisposeBuilder(b);
+
+	oldcontext = MemoryContextSwitchTo(context->base.mcxt);
+	compiled = palloc(sizeof(CompiledAgg));
+	compiled->context = context;
+	compiled->funcname = funcname;
+	MemoryContextSwitchTo(oldcontext);
+
+	aggstate->advance_func = ExecRunCompiledAgg;
+	aggstate->advance_arg = compiled;
+
+	return true;
+}
+
+/*
+ * Installed as advance_func of Agg nodes until the first call: emit the
+ * code, then make later calls go to it directly.
+ */
+static void
+ExecRunCompiledAgg(AggState *aggstate, AggStatePerGroup pergroup)
+{
+	CompiledAgg *compiled = (CompiledAgg *) aggstate->advance_arg;
+	AggAdvanceFunc func;
+
+	func = (AggAdvanceFunc) llvm_get_function(compiled->context,
+											  compiled->funcname);
+	aggstate->advance_func = func;
+
+	func(aggstate, pergroup);
+}
+
+/*
+ * Aggregates with DISTINCT or ORDER BY need the projection into a slot and
+ * the tuplesort the interpreter uses.  Set-returning arguments need the
+ * interpreter to complain about them.
+ */
+static bool
+agg_is_worth_compiling(AggState *aggstate)
+{
+	int			aggno;
+
+	if (aggstate->numaggs == 0)
+		return false;
+
+	for (aggno = 0; aggno < aggstate->numaggs; aggno++)
+	{
+		AggStatePerAgg peraggstate = &aggstate->peragg[aggno];
+
+		if (peraggstate->numSortCols > 0)
+			return false;
+		if (expression_returns_set((Node *) peraggstate->aggref->args))
+			return false;
+	}
+
+	return true;
+}
+
+/*
+ * Return how to evaluate the transition function of an aggregate inline, or
+ * NULL if it must be called.  Only pass-by-value states are handled, which
+ * for the int8 states of count() and sum() means only on 64 bit platforms.
+ */
+static const InlineTrans *
+find_inline_trans(AggStatePerAgg peraggstate)
+{
+	int			i;
+
+	if (!peraggstate->transtypeByVal)
+		return NULL;
+
+	for (i = 0; i < lengthof(inline_trans); i++)
+	{
+		if (inline_trans[i].transfn == peraggstate->transfn_oid)
+			return &inline_trans[i];
+	}
+
+	return NULL;
+}
+
+/*
+ * Emit an inlined transition function, updating the AggStatePerGroupData at
+ * 'v_pergroup' as advance_transition_function would, then branch to
+ * 'b_next'.  For strict functions the inputs are known to be non-null here.
+ */
+static void
+agg_emit_inline_trans(LLVMJitContext *context, LLVMBuilderRef b,
+					  const InlineTrans *trans, AggStatePerAgg peraggstate,
+					  LLVMValueRef v_pergroup, LLVMValueRef v_fcinfo,
+					  LLVMBasicBlockRef b_next)
+{
+	LLVMValueRef fn = LLVMGetBasicBlockParent(LLVMGetInsertBlock(b));
+	LLVMValueRef v_transvaluep;
+	LLVMValueRef v_transnullp;
+	LLVMValueRef v_inputp = NULL;
+	LLVMValueRef v_resvaluep;
+	LLVMBasicBlockRef b_advance;
+
+	v_transvaluep = l_member_addr(b, v_pergroup,
+								  offsetof(AggStatePerGroupData, transValue),
+								  TypeDatum);
+	v_transnullp = l_member_addr(b, v_pergroup,
+							 offsetof(AggStatePerGroupData, transValueIsNull),
+								 TypeStorageBool);
+	if (peraggstate->numArguments > 0)
+		v_inputp = l_member_addr(b, v_fcinfo,
+								 offsetof(FunctionCallInfoData, arg) +
+								 sizeof(Datum),
+								 TypeDatum);
+
+	if (trans->kind == TRANS_INT_SUM)
+	{
+		LLVMTypeRef i64 = LLVMInt64TypeInContext(llvm_context);
+		LLVMBasicBlockRef b_first = LLVMAppendBasicBlockInContext(llvm_context,
+																  fn, "sum.first");
+		LLVMBasicBlockRef b_add = LLVMAppendBasicBlockInContext(llvm_context,
+																fn, "sum.add");
+		LLVMBasicBlockRef b_notnull = LLVMAppendBasicBlockInContext(llvm_context,
+																	fn, "sum.notnull");
+		LLVMValueRef v_input;
+
+		Assert(!peraggstate->transfn.fn_strict && v_inputp != NULL);
+
+		/* a NULL input leaves the sum alone, even if that is NULL too */
+		LLVMBuildCondBr(b,
+						l_isnull(b,
+								 l_member_addr(b, v_fcinfo,
+									   offsetof(FunctionCallInfoData, argnull) +
+											   sizeof(bool),
+											   TypeStorageBool)),
+						b_next, b_notnull);
+
+		LLVMPositionBuilderAtEnd(b, b_notnull);
+		v_input = LLVMBuildTrunc(b, LLVMBuildLoad2(b, TypeDatum, v_inputp, ""),
+								 LLVMIntTypeInContext(llvm_context,
+													  trans->inputbits), "");
+		v_input = LLVMBuildSExt(b, v_input, i64, "");
+		LLVMBuildCondBr(b, l_isnull(b, v_transnullp), b_first, b_add);
+
+		/* the first non-null input becomes the sum */
+		LLVMPositionBuilderAtEnd(b, b_first);
+		LLVMBuildStore(b, LLVMBuildZExtOrBitCast(b, v_input, TypeDatum, ""),
+					   v_transvaluep);
+		LLVMBuildStore(b, l_int8_const(0), v_transnullp);
+		LLVMBuildBr(b, b_next);
+
+		/* like the C code, don't check for overflow */
+		LLVMPositionBuilderAtEnd(b, b_add);
+		LLVMBuildStore(b,
+					   LLVMBuildZExtOrBitCast(b,
+							LLVMBuildAdd(b,
+										 LLVMBuildTrunc(b,
+											LLVMBuildLoad2(b, TypeDatum,
+														   v_transvaluep, ""),
+														i64, ""),
+										 v_input, ""),
+											  TypeDatum, ""),
+					   v_transvaluep);
+		LLVMBuildBr(b, b_next);
+		return;
+	}
+
+	Assert(peraggstate->transfn.fn_strict);
+
+	b_advance = LLVMAppendBasicBlockInContext(llvm_context, fn, "trans.advance");
+
+	/*
+	 * The first non-null input becomes the state if there's no initial
+	 * value.  Being passed by value, it needs no copying.
+	 */
+	if (peraggstate->numArguments > 0)
+	{
+		LLVMValueRef v_notransp;
+		LLVMBasicBlockRef b_first = LLVMAppendBasicBlockInContext(llvm_context,
+																  fn, "trans.first");
+		LLVMBasicBlockRef b_checknull = LLVMAppendBasicBlockInContext(llvm_context,
+																	  fn, "trans.checknull");
+
+		v_notransp = l_member_addr(b, v_pergroup,
+								   offsetof(AggStatePerGroupData, noTransValue),
+								   TypeStorageBool);
+		LLVMBuildCondBr(b, l_isnull(b, v_notransp), b_first, b_checknull);
+
+		LLVMPositionBuilderAtEnd(b, b_first);
+		LLVMBuildStore(b, LLVMBuildLoad2(b, TypeDatum, v_inputp, ""),
+					   v_transvaluep);
+		LLVMBuildStore(b, l_int8_const(0), v_transnullp);
+		LLVMBuildStore(b, l_int8_const(0), v_notransp);
+		LLVMBuildBr(b, b_next);
+
+		LLVMPositionBuilderAtEnd(b, b_checknull);
+	}
+
+	/* a strict function that returned NULL before keeps the state NULL */
+	LLVMBuildCondBr(b, l_isnull(b, v_transnullp), b_next, b_advance);
+
+	LLVMPositionBuilderAtEnd(b, b_advance);
+	v_resvaluep = l_entry_alloca(b, TypeDatum, "transresult");
+	switch (trans->kind)
+	{
+		case TRANS_COUNT:
+			llvm_emit_inline_op(context, b, trans->opfuncid,
+								LLVMBuildLoad2(b, TypeDatum, v_transvaluep, ""),
+								l_datum_const(Int64GetDatum(1)),
+								v_resvaluep);
+			break;
+
+		case TRANS_ADD:
+			llvm_emit_inline_op(context, b, trans->opfuncid,
+								LLVMBuildLoad2(b, TypeDatum, v_transvaluep, ""),
+								LLVMBuildLoad2(b, TypeDatum, v_inputp, ""),
+								v_resvaluep);
+			break;
+
+		case TRANS_KEEP_IF:
+			{
+				LLVMValueRef v_trans;
+				LLVMValueRef v_input;
+				LLVMValueRef v_keep;
+
+				v_trans = LLVMBuildLoad2(b, TypeDatum, v_transvaluep, "");
+				v_input = LLVMBuildLoad2(b, TypeDatum, v_inputp, "");
+				llvm_emit_inline_op(context, b, trans->opfuncid,
+									v_trans, v_input, v_resvaluep);
+				v_keep = LLVMBuildICmp(b, LLVMIntNE,
+									   LLVMBuildLoad2(b, TypeDatum,
+													  v_resvaluep, ""),
+									   l_datum_const((Datum) 0), "");
+				LLVMBuildStore(b,
+							   LLVMBuildSelect(b, v_keep, v_trans, v_input, ""),
+							   v_resvaluep);
+				break;
+			}
+
+		default:
+			elog(ERROR, "unexpected inline transition %d", (int) trans->kind);
+	}
+	LLVMBuildStore(b, LLVMBuildLoad2(b, TypeDatum, v_resvaluep, ""),
+				   v_transvaluep);
+	LLVMBuildBr(b, b_next);
+}
@@ -0,0 +1,539 @@
+/*-------------------------------------------------------------------------
+ *
+ * llvmjit_deform.c
+ *	  Generate tuple deforming routines specialized for a tuple descriptor.
+ *
+ * slot_deform_tuple() has to look up length, alignment and cached offset of
+ * every attribute and check the null bitmap for it on every row.  For a
+ * given descriptor most of that is known in advance: the code generated
+ * here is a straight line of per-attribute blocks, in which
+ *
+ *	- the null bitmap is not consulted for NOT NULL columns,
+ *	- the offset of every column that follows only fixed-width NOT NULL
+ *	  columns is a constant,
+ *	- alignment, length and the way the value is fetched are constants.
+ *
+ * The routine has the same contract as slot_deform_tuple(), including being
+ * able to resume where an earlier call stopped, and is installed as the
+ * slot's tts_deform, which slot_deform_tuple() defers to.  Callers only ask
+ * for attributes the physical tuple actually has, which is what makes it
+ * safe to rely on attnotnull.
+ *
+ * llvm_emit_deform_tuple() emits the same per-attribute code inline into
+ * other generated functions, for tuples that are not stored in a slot, such
+ * as those compared by the sort comparators of llvmjit_sort.c.
+ *
+ * Portions Copyright (c) 1996-2013, PostgreSQL Global Development Group
+ *
+ *
+ * IDENTIFICATION
+ *	  src/backend/jit/llvmjit_deform.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "access/htup_details.h"
+#include "executor/tuptable.h"
+#include "jit/llvmjit.h"
+#include "utils/memutils.h"
+
+
+/*
+ * What the stub installed as tts_deform needs to find the generated code.
+ */
+typedef struct CompiledDeform
+{
+	LLVMJitContext *context;
+	char	   *funcname;
+} CompiledDeform;
+
+/*
+ * State while emitting the extraction of a tuple's attributes.
+ */
+typedef struct DeformEmitState
+{
+	LLVMValueRef fn;			/* function being built */
+	LLVMValueRef v_tp;			/* start of the tuple's data */
+	LLVMValueRef v_bits;		/* its null bitmap */
+	LLVMValueRef v_hasnulls;	/* i1, does it have one? */
+	LLVMValueRef v_offp;		/* size_t variable, current offset */
+	LLVMValueRef v_values;		/* Datum array to fill */
+	LLVMValueRef v_isnull;		/* bool array to fill */
+	LLVMValueRef v_varsize_any; /* declarations of functions called */
+	LLVMValueRef v_strlen;
+	bool		known_offset;	/* offset of the current attribute constant? */
+	long		offset;			/* if so, its unaligned value */
+} DeformEmitState;
+
+static void ExecRunCompiledDeform(TupleTableSlot *slot, int natts);
+static void deform_emit_attribute(LLVMBuilderRef b, DeformEmitState *ds,
+					  Form_pg_attribute att, int attnum,
+					  LLVMBasicBlockRef b_next);
+static int	attalign_bytes(char attalign);
+static LLVMValueRef l_align(LLVMBuilderRef b, LLVMValueRef v_off, int alignto);
+
+
+/*
+ * llvm_compile_deform
+ *
+ * Generate a deforming routine for the descriptor of 'slot' into the
+ * context's current module and install a stub emitting it on first use as
+ * the slot's tts_deform.  Returns false, leaving the slot alone, if there's
+ * nothing worth generating code for.
+ */
+bool
+llvm_compile_deform(LLVMJitContext *context, TupleTableSlot *slot)
+{
+	TupleDesc	desc = slot->tts_tupleDescriptor;
+	int			natts;
+	LLVMModuleRef mod;
+	LLVMBuilderRef b;
+	LLVMTypeRef param_types[2];
+	LLVMTypeRef functype;
+	LLVMTypeRef i8 = LLVMInt8TypeInContext(llvm_context);
+	LLVMTypeRef i16 = LLVMInt16TypeInContext(llvm_context);
+	LLVMTypeRef i32 = LLVMInt32TypeInContext(llvm_context);
+	LLVMTypeRef longtype = LLVMIntTypeInContext(llvm_context,
+												sizeof(long) * 8);
+	LLVMValueRef fn;
+	LLVMValueRef v_slot;
+	LLVMValueRef v_natts;
+	LLVMValueRef v_tuple;
+	LLVMValueRef v_tupdata;
+	LLVMValueRef v_values;
+	LLVMValueRef v_isnull;
+	LLVMValueRef v_hasnulls;
+	LLVMValueRef v_bits;
+	LLVMValueRef v_tp;
+	LLVMValueRef v_nvalid;
+	LLVMValueRef v_offp;
+	LLVMValueRef v_switch;
+	LLVMValueRef v_varsize_any;
+	LLVMValueRef v_strlen;
+	LLVMBasicBlockRef entry;
+	LLVMBasicBlockRef *b_check;
+	LLVMBasicBlockRef *b_out;
+	CompiledDeform *compiled;
+	MemoryContext oldcontext;
+	char	   *funcname;
+	DeformEmitState ds;
+	int			attnum;
+
+	if (desc == NULL || desc->natts == 0 || slot->tts_deform != NULL)
+		return false;
+	natts = desc->natts;
+
+	funcname = llvm_expand_funcname(context, "deform");
+	mod = llvm_mutable_module(context);
+	b = LLVMCreateBuilderInContext(llvm_context);
+
+	/* void (*)(TupleTableSlot *slot, int natts) */
+	param_types[0] = TypePtr;
+	param_types[1] = i32;
+	functype = LLVMFunctionType(LLVMVoidTypeInContext(llvm_context),
+								param_types, 2, false);
+	fn = LLVMAddFunction(mod, funcname, functype);
+	v_slot = LLVMGetParam(fn, 0);
+	v_natts = LLVMGetParam(fn, 1);
+
+	param_types[0] = TypePtr;
+	v_varsize_any = llvm_get_decl(mod, "varsize_any",
+								  LLVMFunctionType(TypeSizeT, param_types, 1,
+												   false));
+	v_strlen = llvm_get_decl(mod, "strlen",
+							 LLVMFunctionType(TypeSizeT, param_types, 1,
+											  false));
+
+	entry = LLVMAppendBasicBlockInContext(llvm_context, fn, "entry");
+	b_check = palloc((natts + 1) * sizeof(LLVMBasicBlockRef));
+	b_out = palloc((natts + 1) * sizeof(LLVMBasicBlockRef));
+	for (attnum = 0; attnum <= natts; attnum++)
+	{
+		b_check[attnum] = LLVMAppendBasicBlockInContext(llvm_context, fn,
+														"check");
+		b_out[attnum] = LLVMAppendBasicBlockInContext(llvm_context, fn,
+													  "out");
+	}
+
+	/* load what's needed from the slot and the tuple header */
+	LLVMPositionBuilderAtEnd(b, entry);
+	l_count_call(context, b, false);
+	v_offp = LLVMBuildAlloca(b, TypeSizeT, "off");
+	v_tuple = l_load_member(b, v_slot, offsetof(TupleTableSlot, tts_tuple),
+							TypePtr, "tuple");
+	v_tupdata = l_load_member(b, v_tuple, offsetof(HeapTupleData, t_data),
+							  TypePtr, "t_data");
+	v_values = l_load_member(b, v_slot, offsetof(TupleTableSlot, tts_values),
+							 TypePtr, "values");
+	v_isnull = l_load_member(b, v_slot, offsetof(TupleTableSlot, tts_isnull),
+							 TypePtr, "isnull");
+	v_hasnulls =
+		LLVMBuildICmp(b, LLVMIntNE,
+					  LLVMBuildAnd(b,
+								   l_load_member(b, v_tupdata,
+							   offsetof(HeapTupleHeaderData, t_infomask),
+												 i16, "infomask"),
+								   LLVMConstInt(i16, HEAP_HASNULL, false), ""),
+					  LLVMConstInt(i16, 0, false), "hasnulls");
+	v_bits = l_member_addr(b, v_tupdata, offsetof(HeapTupleHeaderData, t_bits),
+						   i8);
+	{
+		LLVMValueRef v_hoff;
+
+		v_hoff = LLVMBuildZExt(b,
+							   l_load_member(b, v_tupdata,
+								  offsetof(HeapTupleHeaderData, t_hoff),
+											 i8, "t_hoff"),
+							   TypeSizeT, "");
+		v_tp = LLVMBuildGEP2(b, i8, v_tupdata, &v_hoff, 1, "tp");
+	}
+
+	/* start at the beginning, or resume where the last call stopped */
+	v_nvalid = l_load_member(b, v_slot, offsetof(TupleTableSlot, tts_nvalid),
+							 i32, "nvalid");
+	LLVMBuildStore(b,
+				   LLVMBuildSelect(b,
+								   LLVMBuildICmp(b, LLVMIntEQ, v_nvalid,
+												 l_int32_const(0), ""),
+								   l_sizet_const(0),
+								   LLVMBuildIntCast2(b,
+													 l_load_member(b, v_slot,
+											 offsetof(TupleTableSlot, tts_off),
+														longtype, "tts_off"),
+													 TypeSizeT, true, ""),
+								   ""),
+				   v_offp);
+	v_switch = LLVMBuildSwitch(b, v_nvalid, b_out[natts], natts);
+	for (attnum = 0; attnum < natts; attnum++)
+		LLVMAddCase(v_switch, l_int32_const(attnum), b_check[attnum]);
+
+	/*
+	 * One exit per attribute, saving the state for the next call.  The
+	 * generated code never uses attcacheoff, so claim to be slow in case
+	 * slot_deform_tuple() ever continues from here.
+	 */
+	for (attnum = 0; attnum <= natts; attnum++)
+	{
+		LLVMPositionBuilderAtEnd(b, b_out[attnum]);
+		l_store_member(b, l_int32_const(attnum), v_slot,
+					   offsetof(TupleTableSlot, tts_nvalid));
+		l_store_member(b,
+					   LLVMBuildIntCast2(b,
+										 LLVMBuildLoad2(b, TypeSizeT, v_offp, ""),
+										 longtype, true, ""),
+					   v_slot, offsetof(TupleTableSlot, tts_off));
+		l_store_member(b, l_int8_const(1), v_slot,
+					   offsetof(TupleTableSlot, tts_slow));
+		LLVMBuildRetVoid(b);
+	}
+
+	ds.fn = fn;
+	ds.v_tp = v_tp;
+	ds.v_bits = v_bits;
+	ds.v_hasnulls = v_hasnulls;
+	ds.v_offp = v_offp;
+	ds.v_values = v_values;
+	ds.v_isnull = v_isnull;
+	ds.v_varsize_any = v_varsize_any;
+	ds.v_strlen = v_strlen;
+	ds.known_offset = true;
+	ds.offset = 0;
+	for (attnum = 0; attnum < natts; attnum++)
+	{
+		LLVMBasicBlockRef b_fetch;
+
+		/* stop if the caller doesn't need this attribute */
+		LLVMPositionBuilderAtEnd(b, b_check[attnum]);
+		b_fetch = LLVMAppendBasicBlockInContext(llvm_context, fn, "fetch");
+		LLVMBuildCondBr(b,
+						LLVMBuildICmp(b, LLVMIntSGE, l_int32_const(attnum),
+									  v_natts, ""),
+						b_out[attnum], b_fetch);
+
+		LLVMPositionBuilderAtEnd(b, b_fetch);
+		deform_emit_attribute(b, &ds, desc->attrs[attnum], attnum,
+							  b_check[attnum + 1]);
+	}
+
+	/* all attributes done */
+	LLVMPositionBuilderAtEnd(b, b_check[natts]);
+	LLVMBuildBr(b, b_out[natts]);
+
+	LLVMDisposeBuilder(b);
+	pfree(b_check);
+	pfree(b_out);
+
+	oldcontext = MemoryContextSwitchTo(context->base.mcxt);
+	compiled = palloc(sizeof(CompiledDeform));
+	compiled->context = context;
+	compiled->funcname = funcname;
+	MemoryContextSwitchTo(oldcontext);
+
+	slot->tts_deform = ExecRunCompiledDeform;
+	slot->tts_deform_arg = compiled;
+
+	return true;
+}
+
+/*
+ * llvm_emit_deform_tuple
+ *
+ * Emit, at the current position of 'b', the extraction of the first 'natts'
+ * attributes of a tuple described by 'desc', whose HeapTupleHeader is at
+ * 'v_tupdata', into the Datum array 'v_values' and bool array 'v_isnull'.
+ * Unlike the routines installed in slots, this is a single pass that can't
+ * be resumed, for callers that look at tuples outside of slots.  The tuple
+ * must have at least 'natts' attributes.
+ */
+void
+llvm_emit_deform_tuple(LLVMBuilderRef b, TupleDesc desc, int natts,
+					   LLVMValueRef v_tupdata,
+					   LLVMValueRef v_values, LLVMValueRef v_isnull)
+{
+	LLVMModuleRef mod;
+	LLVMTypeRef i8 = LLVMInt8TypeInContext(llvm_context);
+	LLVMTypeRef i16 = LLVMInt16TypeInContext(llvm_context);
+	LLVMTypeRef param_types[1];
+	LLVMValueRef v_hoff;
+	DeformEmitState ds;
+	int			attnum;
+
+	Assert(natts <= desc->natts);
+
+	ds.fn = LLVMGetBasicBlockParent(LLVMGetInsertBlock(b));
+	mod = LLVMGetGlobalParent(ds.fn);
+
+	param_types[0] = TypePtr;
+	ds.v_varsize_any = llvm_get_decl(mod, "varsize_any",
+									 LLVMFunctionType(TypeSizeT, param_types,
+													  1, false));
+	ds.v_strlen = llvm_get_decl(mod, "strlen",
+								LLVMFunctionType(TypeSizeT, param_types, 1,
+												 false));
+
+	ds.v_hasnulls =
+		LLVMBuildICmp(b, LLVMIntNE,
+					  LLVMBuildAnd(b,
+								   l_load_member(b, v_tupdata,
+								   offsetof(HeapTupleHeaderData, t_infomask),
+												 i16, "infomask"),
+								   LLVMConstInt(i16, HEAP_HASNULL, false), ""),
+					  LLVMConstInt(i16, 0, false), "hasnulls");
+	ds.v_bits = l_member_addr(b, v_tupdata,
+							  offsetof(HeapTupleHeaderData, t_bits), i8);
+	v_hoff = LLVMBuildZExt(b,
+						   l_load_member(b, v_tupdata,
+										 offsetof(HeapTupleHeaderData, t_hoff),
+										 i8, "t_hoff"),
+						   TypeSizeT, "");
+	ds.v_tp = LLVMBuildGEP2(b, i8, v_tupdata, &v_hoff, 1, "tp");
+	ds.v_offp = l_entry_alloca(b, TypeSizeT, "off");
+	LLVMBuildStore(b, l_sizet_const(0), ds.v_offp);
+	ds.v_values = v_values;
+	ds.v_isnull = v_isnull;
+	ds.known_offset = true;
+	ds.offset = 0;
+
+	for (attnum = 0; attnum < natts; attnum++)
+	{
+		LLVMBasicBlockRef b_next;
+
+		b_next = LLVMAppendBasicBlockInContext(llvm_context, ds.fn,
+											   "deform.next");
+		deform_emit_attribute(b, &ds, desc->attrs[attnum], attnum, b_next);
+		LLVMPositionBuilderAtEnd(b, b_next);
+	}
+}
+
+/*
+ * Emit the extraction of attribute 'attnum', described by 'att', of the
+ * tuple described by 'ds' into its values/isnull arrays, then branch to
+ * 'b_next'.  ds->known_offset and ds->offset are updated for the following
+ * attribute.
+ */
+static void
+deform_emit_attribute(LLVMBuilderRef b, DeformEmitState *ds,
+					  Form_pg_attribute att, int attnum,
+					  LLVMBasicBlockRef b_next)
+{
+	LLVMTypeRef i8 = LLVMInt8TypeInContext(llvm_context);
+	int			alignto = attalign_bytes(att->attalign);
+	LLVMValueRef v_off;
+	LLVMValueRef v_attp;
+	LLVMValueRef v_value;
+	LLVMValueRef v_idx;
+
+	/* check the null bitmap, unless the column can't be NULL */
+	if (!att->attnotnull)
+	{
+		LLVMBasicBlockRef b_null;
+		LLVMBasicBlockRef b_notnull;
+		LLVMValueRef v_byte;
+		LLVMValueRef v_isnullbit;
+
+		b_null = LLVMAppendBasicBlockInContext(llvm_context, ds->fn, "null");
+		b_notnull = LLVMAppendBasicBlockInContext(llvm_context, ds->fn,
+												  "notnull");
+
+		v_idx = l_sizet_const(attnum >> 3);
+		v_byte = LLVMBuildLoad2(b, i8,
+								LLVMBuildGEP2(b, i8, ds->v_bits, &v_idx, 1, ""),
+								"nullbyte");
+		v_isnullbit = LLVMBuildICmp(b, LLVMIntEQ,
+									LLVMBuildAnd(b, v_byte,
+								LLVMConstInt(i8, 1 << (attnum & 0x07),
+											 false),
+												 ""),
+									l_int8_const(0), "");
+		LLVMBuildCondBr(b, LLVMBuildAnd(b, ds->v_hasnulls, v_isnullbit, ""),
+						b_null, b_notnull);
+
+		LLVMPositionBuilderAtEnd(b, b_null);
+		v_idx = l_sizet_const(attnum);
+		LLVMBuildStore(b, l_datum_const(0),
+					   LLVMBuildGEP2(b, TypeDatum, ds->v_values, &v_idx, 1, ""));
+		LLVMBuildStore(b, l_int8_const(1),
+					   LLVMBuildGEP2(b, TypeStorageBool, ds->v_isnull, &v_idx,
+									 1, ""));
+		LLVMBuildBr(b, b_next);
+
+		LLVMPositionBuilderAtEnd(b, b_notnull);
+	}
+
+	v_idx = l_sizet_const(attnum);
+	LLVMBuildStore(b, l_int8_const(0),
+				   LLVMBuildGEP2(b, TypeStorageBool, ds->v_isnull, &v_idx, 1, ""));
+
+	/* align the offset, as att_align_nominal/att_align_pointer would */
+	if (att->attlen == -1)
+	{
+		if (ds->known_offset)
+			v_off = l_sizet_const(ds->offset);
+		else
+			v_off = LLVMBuildLoad2(b, TypeSizeT, ds->v_offp, "off");
+
+		/* a short varlena header isn't aligned, there's no pad byte */
+		if (alignto > 1 &&
+			!(ds->known_offset && TYPEALIGN(alignto, ds->offset) == ds->offset))
+		{
+			LLVMValueRef v_byte;
+
+			v_byte = LLVMBuildLoad2(b, i8,
+									LLVMBuildGEP2(b, i8, ds->v_tp, &v_off, 1, ""),
+									"padbyte");
+			v_off = LLVMBuildSelect(b,
+									LLVMBuildICmp(b, LLVMIntEQ, v_byte,
+												  l_int8_const(0), ""),
+									l_align(b, v_off, alignto),
+									v_off, "");
+		}
+	}
+	else if (ds->known_offset)
+		v_off = l_sizet_const(TYPEALIGN(alignto, ds->offset));
+	else
+		v_off = l_align(b, LLVMBuildLoad2(b, TypeSizeT, ds->v_offp, "off"),
+						alignto);
+
+	/* fetch the value, as fetchatt would */
+	v_attp = LLVMBuildGEP2(b, i8, ds->v_tp, &v_off, 1, "attp");
+	if (att->attbyval)
+	{
+		LLVMTypeRef vtype = LLVMIntTypeInContext(llvm_context,
+												 att->attlen * 8);
+
+		v_value = LLVMBuildLoad2(b, vtype,
+								 LLVMBuildPointerCast(b, v_attp,
+											 LLVMPointerType(vtype, 0), ""),
+								 "");
+		if (att->attlen != sizeof(Datum))
+			v_value = LLVMBuildZExt(b, v_value, TypeDatum, "");
+	}
+	else
+		v_value = LLVMBuildPtrToInt(b, v_attp, TypeDatum, "");
+	LLVMBuildStore(b, v_value,
+				   LLVMBuildGEP2(b, TypeDatum, ds->v_values, &v_idx, 1, ""));
+
+	/* advance past it, as att_addlength_pointer would */
+	if (att->attlen > 0)
+		v_off = LLVMBuildAdd(b, v_off, l_sizet_const(att->attlen), "");
+	else if (att->attlen == -1)
+		v_off = LLVMBuildAdd(b, v_off,
+							 LLVMBuildCall2(b,
+											LLVMGlobalGetValueType(ds->v_varsize_any),
+											ds->v_varsize_any, &v_attp, 1, ""),
+							 "");
+	else
+	{
+		Assert(att->attlen == -2);
+		v_off = LLVMBuildAdd(b, v_off,
+							 LLVMBuildAdd(b,
+										  LLVMBuildCall2(b,
+											LLVMGlobalGetValueType(ds->v_strlen),
+											ds->v_strlen, &v_attp, 1, ""),
+										  l_sizet_const(1), ""),
+							 "");
+	}
+	LLVMBuildStore(b, v_off, ds->v_offp);
+	LLVMBuildBr(b, b_next);
+
+	/*
+	 * The following attribute's offset is only known if this one always
+	 * has the same width.
+	 */
+	if (ds->known_offset && att->attlen > 0 && att->attnotnull)
+		ds->offset = TYPEALIGN(alignto, ds->offset) + att->attlen;
+	else
+		ds->known_offset = false;
+}
+
+/*
+ * Installed as tts_deform of slots until the first call: emit the code, then
+ * make later calls go to it directly.
+ */
+static void
+ExecRunCompiledDeform(TupleTableSlot *slot, int natts)
+{
+	CompiledDeform *compiled = (CompiledDeform *) slot->tts_deform_arg;
+	SlotDeformFunc func;
+
+	func = (SlotDeformFunc) llvm_get_function(compiled->context,
+											  compiled->funcname);
+	slot->tts_deform = func;
+
+	func(slot, natts);
+}
+
+/*
+ * Alignment in bytes corresponding to an attalign code.
+ */
+static int
+attalign_bytes(char attalign)
+{
+	switch (attalign)
+	{
+		case 'i':
+			return ALIGNOF_INT;
+		case 'c':
+			return 1;
+		case 'd':
+			return ALIGNOF_DOUBLE;
+		case 's':
+			return ALIGNOF_SHORT;
+		default:
+			elog(ERROR, "unrecognized attalign: %d", (int) attalign);
+			return 0;			/* keep compiler quiet */
+	}
+}
+
+/* emit TYPEALIGN(alignto, off) */
+static LLVMValueRef
+l_align(LLVMBuilderRef b, LLVMValueRef v_off, int alignto)
+{
+	if (alignto <= 1)
+		return v_off;
+
+	return LLVMBuildAnd(b,
+						LLVMBuildAdd(b, v_off, l_sizet_const(alignto - 1), ""),
+						l_sizet_const(~((size_t) (alignto - 1))), "");
+}
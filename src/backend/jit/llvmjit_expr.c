@@ -0,0 +1,1385 @@
+/*-------------------------------------------------------------------------
+ *
+ * llvmjit_expr.c
+ *	  JIT compile expressions using LLVM.
+ *
+ * An ExprState tree built by ExecInitExpr is translated into a single
+ * function with the signature of an ExprStateEvalFunc, which then replaces
+ * the evalfunc of the tree's root.  Vars, Consts, AND/OR/NOT, NULL tests and
+ * the common strict int2/int4/int8/float8/bool operators are evaluated inline;
+ * other function calls go straight through fmgr using the FuncExprState's
+ * FunctionCallInfoData, and every node type we don't know about is evaluated
+ * by calling its interpreted evalfunc.  With PGJIT_INLINE, builtins whose
+ * bitcode is installed are called directly instead, so that the optimizer
+ * can inline them (see llvmjit_inline.c).  Compiled and interpreted evaluation
+ * can therefore be mixed freely within one tree.
+ *
+ * The generated code contains no pointers into the ExprState tree; the
+ * states of child nodes are reached at runtime by following the same links
+ * the interpreter uses.  The code thus only depends on the shape of the
+ * expression, not on where the executor happened to allocate it.  The only
+ * addresses embedded are those of server functions, which are the same in
+ * all backends.
+ *
+ * Portions Copyright (c) 1996-2013, PostgreSQL Global Development Group
+ *
+ *
+ * IDENTIFICATION
+ *	  src/backend/jit/llvmjit_expr.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "catalog/objectaccess.h"
+#include "executor/tuptable.h"
+#include "jit/llvmjit.h"
+#include "miscadmin.h"
+#include "nodes/nodeFuncs.h"
+#include "pgstat.h"
+#include "utils/acl.h"
+#include "utils/builtins.h"
+#include "utils/fmgroids.h"
+#include "utils/lsyscache.h"
+#include "utils/memutils.h"
+
+
+/*
+ * Expressions compiled into a context, so that ExecRunCompiledExpr can find
+ * the function belonging to an ExprState.
+ */
+typedef struct CompiledExpr
+{
+	ExprState  *state;
+	char	   *funcname;
+} CompiledExpr;
+
+/* state while generating one function */
+typedef struct ExprCompileState
+{
+	LLVMJitContext *context;
+	LLVMModuleRef mod;
+	LLVMBuilderRef b;
+	LLVMValueRef fn;
+	LLVMValueRef v_econtext;
+	ExprState  *root;			/* ExprState the function is built for */
+	ExprStateEvalFunc root_evalfunc;	/* its interpreted evalfunc */
+} ExprCompileState;
+
+/* how a FuncExpr or OpExpr is evaluated by generated code */
+typedef enum FuncEvalMode
+{
+	FUNC_EVAL_INLINE,			/* the operation itself is emitted */
+	FUNC_EVAL_FMGR,				/* call through fmgr */
+	FUNC_EVAL_INTERPRETED		/* call the interpreted evalfunc */
+} FuncEvalMode;
+
+/* operations of the builtin functions evaluated inline */
+typedef enum InlineOpKind
+{
+	INLINE_EQ,
+	INLINE_NE,
+	INLINE_LT,
+	INLINE_LE,
+	INLINE_GT,
+	INLINE_GE,
+	INLINE_ADD,
+	INLINE_SUB,
+	INLINE_MUL
+} InlineOpKind;
+
+typedef struct InlineOp
+{
+	Oid			funcid;
+	char		argtype;		/* 'i'nteger, 'f'loat8 or 'b'ool */
+	int8		lbits;			/* width of the integer arguments */
+	int8		rbits;
+	InlineOpKind kind;
+	bool		byval64;		/* needs 64 bit pass-by-value Datums */
+} InlineOp;
+
+#define INT_CMP_OPS(prefix, l, r, b64) \
+	{F_##prefix##EQ, 'i', l, r, INLINE_EQ, b64}, \
+	{F_##prefix##NE, 'i', l, r, INLINE_NE, b64}, \
+	{F_##prefix##LT, 'i', l, r, INLINE_LT, b64}, \
+	{F_##prefix##LE, 'i', l, r, INLINE_LE, b64}, \
+	{F_##prefix##GT, 'i', l, r, INLINE_GT, b64}, \
+	{F_##prefix##GE, 'i', l, r, INLINE_GE, b64}
+
+static const InlineOp inline_ops[] = {
+	INT_CMP_OPS(INT2, 16, 16, false),
+	INT_CMP_OPS(INT4, 32, 32, false),
+	INT_CMP_OPS(INT24, 16, 32, false),
+	INT_CMP_OPS(INT42, 32, 16, false),
+	INT_CMP_OPS(INT8, 64, 64, true),
+	INT_CMP_OPS(INT28, 16, 64, true),
+	INT_CMP_OPS(INT82, 64, 16, true),
+	INT_CMP_OPS(INT48, 32, 64, true),
+	INT_CMP_OPS(INT84, 64, 32, true),
+	{F_INT4PL, 'i', 32, 32, INLINE_ADD, false},
+	{F_INT4MI, 'i', 32, 32, INLINE_SUB, false},
+	{F_INT4MUL, 'i', 32, 32, INLINE_MUL, false},
+	{F_INT8PL, 'i', 64, 64, INLINE_ADD, true},
+	{F_INT8MI, 'i', 64, 64, INLINE_SUB, true},
+	{F_INT8MUL, 'i', 64, 64, INLINE_MUL, true},
+	{F_FLOAT8EQ, 'f', 64, 64, INLINE_EQ, true},
+	{F_FLOAT8NE, 'f', 64, 64, INLINE_NE, true},
+	{F_FLOAT8LT, 'f', 64, 64, INLINE_LT, true},
+	{F_FLOAT8LE, 'f', 64, 64, INLINE_LE, true},
+	{F_FLOAT8GT, 'f', 64, 64, INLINE_GT, true},
+	{F_FLOAT8GE, 'f', 64, 64, INLINE_GE, true},
+	{F_FLOAT8PL, 'f', 64, 64, INLINE_ADD, true},
+	{F_FLOAT8MI, 'f', 64, 64, INLINE_SUB, true},
+	{F_FLOAT8MUL, 'f', 64, 64, INLINE_MUL, true},
+	{F_BOOLEQ, 'b', 8, 8, INLINE_EQ, false},
+	{F_BOOLNE, 'b', 8, 8, INLINE_NE, false},
+	{F_BOOLLT, 'b', 8, 8, INLINE_LT, false},
+	{F_BOOLLE, 'b', 8, 8, INLINE_LE, false},
+	{F_BOOLGT, 'b', 8, 8, INLINE_GT, false},
+	{F_BOOLGE, 'b', 8, 8, INLINE_GE, false}
+};
+
+
+static Datum ExecRunCompiledExpr(ExprState *state, ExprContext *econtext,
+					bool *isNull, ExprDoneCond *isDone);
+static bool expr_is_worth_compiling(ExprState *state);
+static void expr_emit(ExprCompileState *cs, ExprState *state,
+		  LLVMValueRef v_state,
+		  LLVMValueRef v_resvaluep, LLVMValueRef v_resnullp);
+static void expr_emit_interpreted(ExprCompileState *cs, LLVMValueRef v_state,
+					  LLVMValueRef v_resvaluep, LLVMValueRef v_resnullp);
+static void expr_emit_var(ExprCompileState *cs, ExprState *state,
+			  LLVMValueRef v_state,
+			  LLVMValueRef v_resvaluep, LLVMValueRef v_resnullp);
+static void expr_emit_bool(ExprCompileState *cs, BoolExprState *bstate,
+			   LLVMValueRef v_state,
+			   LLVMValueRef v_resvaluep, LLVMValueRef v_resnullp);
+static FuncEvalMode func_eval_mode(FuncExprState *fstate, Oid funcid,
+			   const InlineOp **op);
+static void expr_emit_func(ExprCompileState *cs, FuncExprState *fstate,
+			   Oid funcid, LLVMValueRef v_state,
+			   LLVMValueRef v_resvaluep, LLVMValueRef v_resnullp);
+static void expr_emit_inline_op(ExprCompileState *cs, const InlineOp *op,
+					LLVMValueRef v_left, LLVMValueRef v_right,
+					LLVMValueRef v_resvaluep);
+static const InlineOp *find_inline_op(Oid funcid);
+static LLVMValueRef l_list_nth(ExprCompileState *cs, LLVMValueRef v_list, int n);
+static LLVMValueRef l_datum_to_bool(ExprCompileState *cs, LLVMValueRef v);
+static LLVMValueRef l_bool_to_datum(ExprCompileState *cs, LLVMValueRef v);
+static LLVMBasicBlockRef l_bb_append(ExprCompileState *cs, const char *name);
+
+
+/*
+ * llvm_compile_expr
+ *
+ * Generate code for the expression rooted at 'state' into the context's
+ * current module.  If that was possible, the ExprState's evalfunc is
+ * redirected to a stub that emits the module on first use.  Returns false,
+ * leaving the ExprState alone, for expressions that are not worth it.
+ */
+bool
+llvm_compile_expr(LLVMJitContext *context, ExprState *state)
+{
+	ExprCompileState cs;
+	LLVMBasicBlockRef entry;
+	LLVMBasicBlockRef setdone;
+	LLVMBasicBlockRef eval;
+	LLVMValueRef v_isdone;
+	LLVMValueRef v_resvaluep;
+	CompiledExpr *compiled;
+	char	   *funcname;
+	MemoryContext oldcontext;
+
+	if (!expr_is_worth_compiling(state))
+		return false;
+
+	funcname = llvm_expand_funcname(context, "evalexpr");
+
+	cs.context = context;
+	cs.mod = llvm_mutable_module(context);
+	cs.b = LLVMCreateBuilderInContext(llvm_context);
+	cs.fn = LLVMAddFunction(cs.mod, funcname, TypeExprStateEvalFunc);
+	cs.v_econtext = LLVMGetParam(cs.fn, 1);
+	cs.root = state;
+	cs.root_evalfunc = state->evalfunc;
+
+	entry = LLVMAppendBasicBlockInContext(llvm_context, cs.fn, "entry");
+	setdone = LLVMAppendBasicBlockInContext(llvm_context, cs.fn, "setdone");
+	eval = LLVMAppendBasicBlockInContext(llvm_context, cs.fn, "eval");
+
+	/* if (isDone) *isDone = ExprSingleResult; */
+	LLVMPositionBuilderAtEnd(cs.b, entry);
+	l_count_call(context, cs.b, false);
+	v_isdone = LLVMGetParam(cs.fn, 3);
+	v_resvaluep = LLVMBuildAlloca(cs.b, TypeDatum, "resvalue");
+	LLVMBuildCondBr(cs.b,
+					LLVMBuildIsNull(cs.b, v_isdone, ""),
+					eval, setdone);
+
+	LLVMPositionBuilderAtEnd(cs.b, setdone);
+	LLVMBuildStore(cs.b,
+				   LLVMConstInt(LLVMInt32TypeInContext(llvm_context),
+								ExprSingleResult, false),
+				   LLVMBuildPointerCast(cs.b, v_isdone,
+						LLVMPointerType(LLVMInt32TypeInContext(llvm_context), 0),
+										""));
+	LLVMBuildBr(cs.b, eval);
+
+	/* evaluate the tree, storing the null flag directly into *isNull */
+	LLVMPositionBuilderAtEnd(cs.b, eval);
+	expr_emit(&cs, state, LLVMGetParam(cs.fn, 0),
+			  v_resvaluep, LLVMGetParam(cs.fn, 2));
+	LLVMBuildRet(cs.b, LLVMBuildLoad2(cs.b, TypeDatum, v_resvaluep, ""));
+
+	LLVMDisposeBuilder(cs.b);
+
+	oldcontext = MemoryContextSwitchTo(context->base.mcxt);
+	compiled = palloc(sizeof(CompiledExpr));
+	compiled->state = state;
+	compiled->funcname = funcname;
+	context->compiled_exprs = lappend(context->compiled_exprs, compiled);
+	MemoryContextSwitchTo(oldcontext);
+
+	state->evalfunc = ExecRunCompiledExpr;
+
+	return true;
+}
+
+/*
+ * llvm_emit_expr
+ *
+ * Emit code evaluating the ExprState 'state', found at runtime in 'v_state',
+ * at the current position of 'b', storing the result into the Datum at
+ * 'v_resvaluep' and the bool at 'v_resnullp'.  This lets other generators,
+ * such as that of aggregate transitions, evaluate their input expressions
+ * inline.  Set-returning expressions must not be passed.
+ */
+void
+llvm_emit_expr(LLVMJitContext *context, LLVMBuilderRef b,
+			   LLVMValueRef v_econtext, ExprState *state, LLVMValueRef v_state,
+			   LLVMValueRef v_resvaluep, LLVMValueRef v_resnullp)
+{
+	ExprCompileState cs;
+
+	cs.context = context;
+	cs.b = b;
+	cs.fn = LLVMGetBasicBlockParent(LLVMGetInsertBlock(b));
+	cs.mod = LLVMGetGlobalParent(cs.fn);
+	cs.v_econtext = v_econtext;
+	cs.root = NULL;
+	cs.root_evalfunc = NULL;
+
+	expr_emit(&cs, state, v_state, v_resvaluep, v_resnullp);
+}
+
+/*
+ * llvm_emit_inline_op
+ *
+ * Emit the operation of the builtin strict binary function 'funcid' on two
+ * non-null Datums at the current position of 'b', storing the result into
+ * the Datum at 'v_resvaluep'.  Returns false, emitting nothing, if the
+ * function is not one of those evaluated inline.  No permission check is
+ * made; that is up to the caller.
+ */
+bool
+llvm_emit_inline_op(LLVMJitContext *context, LLVMBuilderRef b, Oid funcid,
+					LLVMValueRef v_left, LLVMValueRef v_right,
+					LLVMValueRef v_resvaluep)
+{
+	const InlineOp *op = find_inline_op(funcid);
+	ExprCompileState cs;
+
+	if (op == NULL)
+		return false;
+
+	cs.context = context;
+	cs.b = b;
+	cs.fn = LLVMGetBasicBlockParent(LLVMGetInsertBlock(b));
+	cs.mod = LLVMGetGlobalParent(cs.fn);
+	cs.v_econtext = NULL;
+	cs.root = NULL;
+	cs.root_evalfunc = NULL;
+
+	expr_emit_inline_op(&cs, op, v_left, v_right, v_resvaluep);
+
+	return true;
+}
+
+/*
+ * Installed as evalfunc of compiled expressions until their first call:
+ * emit the code, then make later calls go to it directly.
+ */
+static Datum
+ExecRunCompiledExpr(ExprState *state, ExprContext *econtext,
+					bool *isNull, ExprDoneCond *isDone)
+{
+	LLVMJitContext *context;
+	ExprStateEvalFunc func = NULL;
+	ListCell   *lc;
+
+	Assert(econtext->ecxt_estate != NULL);
+	context = (LLVMJitContext *) econtext->ecxt_estate->es_jit_context;
+	Assert(context != NULL);
+
+	foreach(lc, context->compiled_exprs)
+	{
+		CompiledExpr *compiled = (CompiledExpr *) lfirst(lc);
+
+		if (compiled->state == state)
+		{
+			func = (ExprStateEvalFunc) llvm_get_function(context,
+														 compiled->funcname);
+			break;
+		}
+	}
+
+	if (func == NULL)
+		elog(ERROR, "could not find JIT compiled expression");
+
+	state->evalfunc = func;
+
+	return func(state, econtext, isNull, isDone);
+}
+
+/*
+ * Only trees whose root we can evaluate natively are compiled: for a lone
+ * Var or a call of an unknown node type the generated code would just add a
+ * layer of indirection.  (It would also be incorrect, as the root's evalfunc
+ * is the generated function itself.)  Set-returning expressions are left to
+ * the interpreter, which has all the machinery for them.
+ */
+static bool
+expr_is_worth_compiling(ExprState *state)
+{
+	Node	   *expr;
+	const InlineOp *op;
+
+	if (state == NULL)
+		return false;
+	expr = (Node *) state->expr;
+
+	switch (nodeTag(expr))
+	{
+		case T_OpExpr:
+			if (func_eval_mode((FuncExprState *) state,
+							   ((OpExpr *) expr)->opfuncid,
+							   &op) == FUNC_EVAL_INTERPRETED)
+				return false;
+			break;
+		case T_FuncExpr:
+			if (func_eval_mode((FuncExprState *) state,
+							   ((FuncExpr *) expr)->funcid,
+							   &op) == FUNC_EVAL_INTERPRETED)
+				return false;
+			break;
+		case T_BoolExpr:
+			break;
+		case T_NullTest:
+			if (((NullTest *) expr)->argisrow)
+				return false;
+			break;
+		default:
+			return false;
+	}
+
+	return !expression_returns_set(expr);
+}
+
+/*
+ * Emit code evaluating the ExprState 'state', which at runtime is found in
+ * 'v_state'.  The result is stored into the Datum at 'v_resvaluep' and the
+ * bool at 'v_resnullp'.
+ */
+static void
+expr_emit(ExprCompileState *cs, ExprState *state, LLVMValueRef v_state,
+		  LLVMValueRef v_resvaluep, LLVMValueRef v_resnullp)
+{
+	LLVMBuilderRef b = cs->b;
+	Node	   *expr = (Node *) state->expr;
+
+	switch (nodeTag(expr))
+	{
+		case T_Const:
+			{
+				Const	   *con = (Const *) expr;
+				LLVMValueRef v_value;
+
+				if (con->constisnull)
+					v_value = l_datum_const((Datum) 0);
+				else if (con->constbyval)
+					v_value = l_datum_const(con->constvalue);
+				else
+				{
+					/* reference the Const node rather than embed a pointer */
+					LLVMValueRef v_expr;
+
+					v_expr = l_load_member(b, v_state,
+										   offsetof(ExprState, expr),
+										   TypePtr, "const");
+					v_value = l_load_member(b, v_expr,
+											offsetof(Const, constvalue),
+											TypeDatum, "constvalue");
+				}
+				LLVMBuildStore(b, v_value, v_resvaluep);
+				LLVMBuildStore(b, l_int8_const(con->constisnull ? 1 : 0),
+							   v_resnullp);
+				return;
+			}
+
+		case T_Var:
+			if (IsA(state, ExprState) && ((Var *) expr)->varattno > 0)
+			{
+				expr_emit_var(cs, state, v_state, v_resvaluep, v_resnullp);
+				return;
+			}
+			break;
+
+		case T_BoolExpr:
+			expr_emit_bool(cs, (BoolExprState *) state, v_state,
+						   v_resvaluep, v_resnullp);
+			return;
+
+		case T_NullTest:
+			{
+				NullTest   *ntest = (NullTest *) expr;
+				NullTestState *nstate = (NullTestState *) state;
+				LLVMValueRef v_arg;
+				LLVMValueRef v_argnullp;
+				LLVMValueRef v_isnull;
+				LLVMValueRef v_result;
+
+				if (ntest->argisrow)
+					break;
+
+				v_arg = l_load_member(b, v_state,
+									  offsetof(NullTestState, arg),
+									  TypePtr, "arg");
+				v_argnullp = l_entry_alloca(b, TypeStorageBool, "argnull");
+				expr_emit(cs, nstate->arg, v_arg, v_resvaluep, v_argnullp);
+
+				v_isnull = LLVMBuildICmp(b, LLVMIntNE,
+										 LLVMBuildLoad2(b, TypeStorageBool,
+														v_argnullp, ""),
+										 l_int8_const(0), "");
+				if (ntest->nulltesttype == IS_NOT_NULL)
+					v_isnull = LLVMBuildNot(b, v_isnull, "");
+				else if (ntest->nulltesttype != IS_NULL)
+					elog(ERROR, "unrecognized nulltesttype: %d",
+						 (int) ntest->nulltesttype);
+
+				v_result = l_bool_to_datum(cs, v_isnull);
+				LLVMBuildStore(b, v_result, v_resvaluep);
+				LLVMBuildStore(b, l_int8_const(0), v_resnullp);
+				return;
+			}
+
+		case T_RelabelType:
+			{
+				GenericExprState *gstate = (GenericExprState *) state;
+				LLVMValueRef v_arg;
+
+				v_arg = l_load_member(b, v_state,
+									  offsetof(GenericExprState, arg),
+									  TypePtr, "arg");
+				expr_emit(cs, gstate->arg, v_arg, v_resvaluep, v_resnullp);
+				return;
+			}
+
+		case T_OpExpr:
+			expr_emit_func(cs, (FuncExprState *) state,
+						   ((OpExpr *) expr)->opfuncid, v_state,
+						   v_resvaluep, v_resnullp);
+			return;
+
+		case T_FuncExpr:
+			expr_emit_func(cs, (FuncExprState *) state,
+						   ((FuncExpr *) expr)->funcid, v_state,
+						   v_resvaluep, v_resnullp);
+			return;
+
+		default:
+			break;
+	}
+
+	expr_emit_interpreted(cs, v_state, v_resvaluep, v_resnullp);
+}
+
+/*
+ * Emit a call to the interpreted evalfunc of the ExprState in 'v_state'.
+ * The function pointer is loaded at runtime, so that evalfuncs replacing
+ * themselves after their first call keep working.
+ */
+static void
+expr_emit_interpreted(ExprCompileState *cs, LLVMValueRef v_state,
+					  LLVMValueRef v_resvaluep, LLVMValueRef v_resnullp)
+{
+	LLVMBuilderRef b = cs->b;
+	LLVMValueRef v_evalfunc;
+	LLVMValueRef v_params[4];
+	LLVMValueRef v_value;
+
+	l_count_call(cs->context, b, true);
+
+	v_evalfunc = l_load_member(b, v_state, offsetof(ExprState, evalfunc),
+							   LLVMPointerType(TypeExprStateEvalFunc, 0),
+							   "evalfunc");
+
+	v_params[0] = v_state;
+	v_params[1] = cs->v_econtext;
+	v_params[2] = LLVMBuildPointerCast(b, v_resnullp, TypePtr, "");
+	v_params[3] = LLVMConstNull(TypePtr);
+	v_value = LLVMBuildCall2(b, TypeExprStateEvalFunc, v_evalfunc,
+							 v_params, 4, "");
+	LLVMBuildStore(b, v_value, v_resvaluep);
+}
+
+/*
+ * Emit the fetch of a scalar user attribute.  If the slot has already been
+ * deformed far enough, the value is read straight from tts_values/tts_isnull;
+ * otherwise the interpreted evalfunc is called.  The interpreter is also used
+ * as long as the Var's evalfunc is still the one we saw here, because that
+ * one performs sanity checks on the attribute's type on its first call and
+ * then replaces itself.
+ */
+static void
+expr_emit_var(ExprCompileState *cs, ExprState *state, LLVMValueRef v_state,
+			  LLVMValueRef v_resvaluep, LLVMValueRef v_resnullp)
+{
+	LLVMBuilderRef b = cs->b;
+	Var		   *variable = (Var *) state->expr;
+	AttrNumber	attnum = variable->varattno;
+	size_t		slotoff;
+	LLVMTypeRef i32 = LLVMInt32TypeInContext(llvm_context);
+	LLVMBasicBlockRef b_fast = l_bb_append(cs, "var.fast");
+	LLVMBasicBlockRef b_slow = l_bb_append(cs, "var.slow");
+	LLVMBasicBlockRef b_done = l_bb_append(cs, "var.done");
+	LLVMValueRef v_evalfunc;
+	LLVMValueRef v_checked;
+	LLVMValueRef v_slot;
+	LLVMValueRef v_nvalid;
+	LLVMValueRef v_values;
+	LLVMValueRef v_nulls;
+	LLVMValueRef v_idx;
+	LLVMValueRef v_addr;
+
+	switch (variable->varno)
+	{
+		case INNER_VAR:
+			slotoff = offsetof(ExprContext, ecxt_innertuple);
+			break;
+		case OUTER_VAR:
+			slotoff = offsetof(ExprContext, ecxt_outertuple);
+			break;
+		default:
+			slotoff = offsetof(ExprContext, ecxt_scantuple);
+			break;
+	}
+
+	v_evalfunc = l_load_member(b, v_state, offsetof(ExprState, evalfunc),
+							   TypeSizeT, "evalfunc");
+	v_checked = LLVMBuildICmp(b, LLVMIntNE, v_evalfunc,
+							  l_sizet_const((size_t) state->evalfunc), "");
+	v_slot = l_load_member(b, cs->v_econtext, slotoff, TypePtr, "slot");
+	v_nvalid = l_load_member(b, v_slot, offsetof(TupleTableSlot, tts_nvalid),
+							 i32, "nvalid");
+	LLVMBuildCondBr(b,
+					LLVMBuildAnd(b, v_checked,
+								 LLVMBuildICmp(b, LLVMIntSGE, v_nvalid,
+											   l_int32_const(attnum), ""),
+								 ""),
+					b_fast, b_slow);
+
+	LLVMPositionBuilderAtEnd(b, b_fast);
+	v_values = l_load_member(b, v_slot, offsetof(TupleTableSlot, tts_values),
+							 TypePtr, "values");
+	v_nulls = l_load_member(b, v_slot, offsetof(TupleTableSlot, tts_isnull),
+							TypePtr, "nulls");
+	v_idx = l_sizet_const(attnum - 1);
+	v_addr = LLVMBuildGEP2(b, TypeDatum,
+						   LLVMBuildPointerCast(b, v_values,
+											LLVMPointerType(TypeDatum, 0), ""),
+						   &v_idx, 1, "");
+	LLVMBuildStore(b, LLVMBuildLoad2(b, TypeDatum, v_addr, ""), v_resvaluep);
+	v_addr = LLVMBuildGEP2(b, TypeStorageBool, v_nulls, &v_idx, 1, "");
+	LLVMBuildStore(b, LLVMBuildLoad2(b, TypeStorageBool, v_addr, ""),
+				   v_resnullp);
+	LLVMBuildBr(b, b_done);
+
+	LLVMPositionBuilderAtEnd(b, b_slow);
+	expr_emit_interpreted(cs, v_state, v_resvaluep, v_resnullp);
+	LLVMBuildBr(b, b_done);
+
+	LLVMPositionBuilderAtEnd(b, b_done);
+}
+
+/*
+ * Emit AND, OR and NOT with the same three-valued logic and short-circuit
+ * behaviour as ExecEvalAnd, ExecEvalOr and ExecEvalNot.
+ */
+static void
+expr_emit_bool(ExprCompileState *cs, BoolExprState *bstate,
+			   LLVMValueRef v_state,
+			   LLVMValueRef v_resvaluep, LLVMValueRef v_resnullp)
+{
+	LLVMBuilderRef b = cs->b;
+	BoolExpr   *boolexpr = (BoolExpr *) bstate->xprstate.expr;
+	LLVMValueRef v_args;
+	LLVMValueRef v_anynullp;
+	LLVMValueRef v_anynull;
+	LLVMBasicBlockRef b_done;
+	bool		is_and;
+	ListCell   *lc;
+	int			argno;
+
+	v_args = l_load_member(b, v_state, offsetof(BoolExprState, args),
+						   TypePtr, "args");
+
+	if (boolexpr->boolop == NOT_EXPR)
+	{
+		LLVMValueRef v_value;
+
+		expr_emit(cs, (ExprState *) linitial(bstate->args),
+				  l_list_nth(cs, v_args, 0), v_resvaluep, v_resnullp);
+
+		/* a NULL input is passed through unchanged */
+		v_value = LLVMBuildLoad2(b, TypeDatum, v_resvaluep, "");
+		v_value = l_bool_to_datum(cs,
+								  LLVMBuildNot(b, l_datum_to_bool(cs, v_value),
+											   ""));
+		LLVMBuildStore(b, v_value, v_resvaluep);
+		return;
+	}
+
+	if (boolexpr->boolop != AND_EXPR && boolexpr->boolop != OR_EXPR)
+		elog(ERROR, "unrecognized boolop: %d", (int) boolexpr->boolop);
+	is_and = (boolexpr->boolop == AND_EXPR);
+
+	v_anynullp = l_entry_alloca(b, TypeStorageBool, "anynull");
+	LLVMBuildStore(b, l_int8_const(0), v_anynullp);
+	b_done = l_bb_append(cs, is_and ? "and.done" : "or.done");
+
+	argno = 0;
+	foreach(lc, bstate->args)
+	{
+		LLVMBasicBlockRef b_isnull = l_bb_append(cs, "bool.isnull");
+		LLVMBasicBlockRef b_notnull = l_bb_append(cs, "bool.notnull");
+		LLVMBasicBlockRef b_shortcircuit = l_bb_append(cs, "bool.short");
+		LLVMBasicBlockRef b_next = l_bb_append(cs, "bool.next");
+		LLVMValueRef v_isnull;
+		LLVMValueRef v_value;
+
+		expr_emit(cs, (ExprState *) lfirst(lc), l_list_nth(cs, v_args, argno),
+				  v_resvaluep, v_resnullp);
+		argno++;
+
+		v_isnull = LLVMBuildLoad2(b, TypeStorageBool, v_resnullp, "");
+		LLVMBuildCondBr(b,
+						LLVMBuildICmp(b, LLVMIntNE, v_isnull,
+									  l_int8_const(0), ""),
+						b_isnull, b_notnull);
+
+		/* remember we got a null */
+		LLVMPositionBuilderAtEnd(b, b_isnull);
+		LLVMBuildStore(b, l_int8_const(1), v_anynullp);
+		LLVMBuildBr(b, b_next);
+
+		/* a non-null FALSE (for AND) or TRUE (for OR) decides the result */
+		LLVMPositionBuilderAtEnd(b, b_notnull);
+		v_value = l_datum_to_bool(cs,
+								  LLVMBuildLoad2(b, TypeDatum, v_resvaluep, ""));
+		if (is_and)
+			LLVMBuildCondBr(b, v_value, b_next, b_shortcircuit);
+		else
+			LLVMBuildCondBr(b, v_value, b_shortcircuit, b_next);
+
+		LLVMPositionBuilderAtEnd(b, b_shortcircuit);
+		LLVMBuildStore(b, l_datum_const(BoolGetDatum(!is_and)), v_resvaluep);
+		LLVMBuildStore(b, l_int8_const(0), v_resnullp);
+		LLVMBuildBr(b, b_done);
+
+		LLVMPositionBuilderAtEnd(b, b_next);
+	}
+
+	/*
+	 * All inputs were TRUE (AND) or FALSE (OR), or NULL.  The result is NULL
+	 * if any was NULL, else TRUE for AND and FALSE for OR.
+	 */
+	v_anynull = LLVMBuildLoad2(b, TypeStorageBool, v_anynullp, "");
+	LLVMBuildStore(b, v_anynull, v_resnullp);
+	if (is_and)
+		LLVMBuildStore(b,
+					   l_bool_to_datum(cs,
+									   LLVMBuildICmp(b, LLVMIntEQ, v_anynull,
+													 l_int8_const(0), "")),
+					   v_resvaluep);
+	else
+		LLVMBuildStore(b, l_datum_const(BoolGetDatum(false)), v_resvaluep);
+	LLVMBuildBr(b, b_done);
+
+	LLVMPositionBuilderAtEnd(b, b_done);
+}
+
+/*
+ * Decide how to evaluate a FuncExpr or OpExpr.
+ *
+ * Builtin operators listed in inline_ops are evaluated inline.  For those the
+ * permission check normally done by init_fcache happens here instead; if it
+ * fails, or if an object access hook wants to see the call, we fall back to
+ * fmgr so that the error or hook fires at execution as usual.  Calls tracked
+ * by track_functions need the bookkeeping the interpreter does around them.
+ */
+static FuncEvalMode
+func_eval_mode(FuncExprState *fstate, Oid funcid, const InlineOp **op)
+{
+	*op = NULL;
+
+	if (!OidIsValid(funcid) || list_length(fstate->args) > FUNC_MAX_ARGS)
+		return FUNC_EVAL_INTERPRETED;
+
+	*op = find_inline_op(funcid);
+	if (*op != NULL && list_length(fstate->args) == 2 &&
+		object_access_hook == NULL &&
+		pg_proc_aclcheck(funcid, GetUserId(), ACL_EXECUTE) == ACLCHECK_OK)
+		return FUNC_EVAL_INLINE;
+	*op = NULL;
+
+	if (pgstat_track_functions != TRACK_FUNC_OFF)
+		return FUNC_EVAL_INTERPRETED;
+
+	return FUNC_EVAL_FMGR;
+}
+
+/*
+ * Emit a FuncExpr or OpExpr.
+ *
+ * Functions not evaluated inline are called through fmgr, with the arguments
+ * evaluated straight into the FunctionCallInfoData of the FuncExprState.  The
+ * very first call goes through the interpreter, which sets up that struct.
+ *
+ * Builtins that can be imported from bitcode are called by name instead, with
+ * a FunctionCallInfoData on the stack that is filled in from the
+ * FuncExprState's one.  Once the call is inlined, the optimizer can keep the
+ * arguments and the result in registers.
+ */
+static void
+expr_emit_func(ExprCompileState *cs, FuncExprState *fstate, Oid funcid,
+			   LLVMValueRef v_state,
+			   LLVMValueRef v_resvaluep, LLVMValueRef v_resnullp)
+{
+	LLVMBuilderRef b = cs->b;
+	const InlineOp *op;
+	FuncEvalMode mode = func_eval_mode(fstate, funcid, &op);
+	bool		strict;
+	LLVMValueRef v_args;
+	LLVMValueRef v_fcinfo;
+	LLVMValueRef v_fn = NULL;
+	LLVMBasicBlockRef b_init;
+	LLVMBasicBlockRef b_call;
+	LLVMBasicBlockRef b_strictnull;
+	LLVMBasicBlockRef b_done;
+	ListCell   *lc;
+	int			argno;
+
+	if (mode == FUNC_EVAL_INTERPRETED)
+	{
+		Assert(&fstate->xprstate != cs->root);
+		expr_emit_interpreted(cs, v_state, v_resvaluep, v_resnullp);
+		return;
+	}
+
+	if (mode == FUNC_EVAL_INLINE)
+	{
+		LLVMValueRef v_argvalues[2];
+		LLVMValueRef v_argnulls[2];
+
+		v_args = l_load_member(b, v_state, offsetof(FuncExprState, args),
+							   TypePtr, "args");
+		b_call = l_bb_append(cs, "op.call");
+		b_strictnull = l_bb_append(cs, "op.strictnull");
+		b_done = l_bb_append(cs, "op.done");
+
+		/* all inlined operators are strict */
+		argno = 0;
+		foreach(lc, fstate->args)
+		{
+			LLVMBasicBlockRef b_next = l_bb_append(cs, "op.argnotnull");
+
+			v_argvalues[argno] = l_entry_alloca(b, TypeDatum, "argvalue");
+			v_argnulls[argno] = l_entry_alloca(b, TypeStorageBool, "argnull");
+			expr_emit(cs, (ExprState *) lfirst(lc),
+					  l_list_nth(cs, v_args, argno),
+					  v_argvalues[argno], v_argnulls[argno]);
+			LLVMBuildCondBr(b,
+							LLVMBuildICmp(b, LLVMIntNE,
+										  LLVMBuildLoad2(b, TypeStorageBool,
+														 v_argnulls[argno], ""),
+										  l_int8_const(0), ""),
+							b_strictnull, b_next);
+			LLVMPositionBuilderAtEnd(b, b_next);
+			argno++;
+		}
+		LLVMBuildBr(b, b_call);
+
+		LLVMPositionBuilderAtEnd(b, b_call);
+		expr_emit_inline_op(cs, op,
+							LLVMBuildLoad2(b, TypeDatum, v_argvalues[0], ""),
+							LLVMBuildLoad2(b, TypeDatum, v_argvalues[1], ""),
+							v_resvaluep);
+		LLVMBuildStore(b, l_int8_const(0), v_resnullp);
+		LLVMBuildBr(b, b_done);
+
+		LLVMPositionBuilderAtEnd(b, b_strictnull);
+		LLVMBuildStore(b, l_datum_const((Datum) 0), v_resvaluep);
+		LLVMBuildStore(b, l_int8_const(1), v_resnullp);
+		LLVMBuildBr(b, b_done);
+
+		LLVMPositionBuilderAtEnd(b, b_done);
+		return;
+	}
+
+	strict = func_strict(funcid);
+	if (cs->context->base.flags & PGJIT_INLINE)
+		v_fn = llvm_inline_function_decl(cs->mod, funcid);
+
+	b_init = l_bb_append(cs, "func.init");
+	b_call = l_bb_append(cs, "func.args");
+	b_strictnull = l_bb_append(cs, "func.strictnull");
+	b_done = l_bb_append(cs, "func.done");
+
+	/* until the interpreter has initialized the fcache, let it do the call */
+	LLVMBuildCondBr(b,
+					LLVMBuildICmp(b, LLVMIntEQ,
+								  l_load_member(b, v_state,
+											offsetof(FuncExprState, func) +
+												offsetof(FmgrInfo, fn_oid),
+											LLVMInt32TypeInContext(llvm_context),
+												"fn_oid"),
+								  l_int32_const(InvalidOid), ""),
+					b_init, b_call);
+
+	LLVMPositionBuilderAtEnd(b, b_init);
+	if (&fstate->xprstate == cs->root)
+	{
+		/*
+		 * The root's evalfunc is the function being built, so call the
+		 * original one.  It replaces itself after initializing the fcache;
+		 * point the ExprState back to the generated code afterwards.
+		 */
+		LLVMValueRef v_evalfunc;
+		LLVMValueRef v_params[4];
+		LLVMValueRef v_value;
+
+		v_evalfunc = LLVMConstIntToPtr(l_sizet_const((size_t) cs->root_evalfunc),
+								   LLVMPointerType(TypeExprStateEvalFunc, 0));
+		v_params[0] = v_state;
+		v_params[1] = cs->v_econtext;
+		v_params[2] = LLVMBuildPointerCast(b, v_resnullp, TypePtr, "");
+		v_params[3] = LLVMConstNull(TypePtr);
+		v_value = LLVMBuildCall2(b, TypeExprStateEvalFunc, v_evalfunc,
+								 v_params, 4, "");
+		LLVMBuildStore(b, v_value, v_resvaluep);
+		l_store_member(b, cs->fn, v_state, offsetof(ExprState, evalfunc));
+	}
+	else
+		expr_emit_interpreted(cs, v_state, v_resvaluep, v_resnullp);
+	LLVMBuildBr(b, b_done);
+
+	LLVMPositionBuilderAtEnd(b, b_call);
+	v_args = l_load_member(b, v_state, offsetof(FuncExprState, args),
+						   TypePtr, "args");
+	v_fcinfo = l_member_addr(b, v_state, offsetof(FuncExprState, fcinfo_data),
+							 LLVMInt8TypeInContext(llvm_context));
+
+	if (v_fn != NULL)
+	{
+		LLVMValueRef v_shared = v_fcinfo;
+
+		v_fcinfo = l_entry_alloca(b,
+							  LLVMArrayType(LLVMInt8TypeInContext(llvm_context),
+											sizeof(FunctionCallInfoData)),
+								  "fcinfo");
+		LLVMSetAlignment(v_fcinfo, MAXIMUM_ALIGNOF);
+		v_fcinfo = LLVMBuildPointerCast(b, v_fcinfo, TypePtr, "");
+
+		l_store_member(b,
+					   l_member_addr(b, v_state, offsetof(FuncExprState, func),
+									 LLVMInt8TypeInContext(llvm_context)),
+					   v_fcinfo, offsetof(FunctionCallInfoData, flinfo));
+		l_store_member(b,
+					   l_load_member(b, v_shared,
+									 offsetof(FunctionCallInfoData, context),
+									 TypePtr, ""),
+					   v_fcinfo, offsetof(FunctionCallInfoData, context));
+		l_store_member(b,
+					   l_load_member(b, v_shared,
+									 offsetof(FunctionCallInfoData, resultinfo),
+									 TypePtr, ""),
+					   v_fcinfo, offsetof(FunctionCallInfoData, resultinfo));
+		l_store_member(b,
+					   l_load_member(b, v_shared,
+								   offsetof(FunctionCallInfoData, fncollation),
+									 LLVMInt32TypeInContext(llvm_context), ""),
+					   v_fcinfo, offsetof(FunctionCallInfoData, fncollation));
+		l_store_member(b,
+					   LLVMConstInt(LLVMInt16TypeInContext(llvm_context),
+									list_length(fstate->args), false),
+					   v_fcinfo, offsetof(FunctionCallInfoData, nargs));
+	}
+
+	argno = 0;
+	foreach(lc, fstate->args)
+	{
+		LLVMValueRef v_argvaluep;
+		LLVMValueRef v_argnullp;
+
+		v_argvaluep = l_member_addr(b, v_fcinfo,
+									offsetof(FunctionCallInfoData, arg) +
+									argno * sizeof(Datum),
+									TypeDatum);
+		v_argnullp = l_member_addr(b, v_fcinfo,
+								   offsetof(FunctionCallInfoData, argnull) +
+								   argno * sizeof(bool),
+								   TypeStorageBool);
+		expr_emit(cs, (ExprState *) lfirst(lc), l_list_nth(cs, v_args, argno),
+				  v_argvaluep, v_argnullp);
+
+		if (strict)
+		{
+			LLVMBasicBlockRef b_next = l_bb_append(cs, "func.argnotnull");
+
+			LLVMBuildCondBr(b,
+							LLVMBuildICmp(b, LLVMIntNE,
+										  LLVMBuildLoad2(b, TypeStorageBool,
+														 v_argnullp, ""),
+										  l_int8_const(0), ""),
+							b_strictnull, b_next);
+			LLVMPositionBuilderAtEnd(b, b_next);
+		}
+		argno++;
+	}
+
+	/* fcinfo->isnull = false; result = FunctionCallInvoke(fcinfo); */
+	{
+		LLVMTypeRef fntype = LLVMFunctionType(TypeDatum, &TypePtr, 1, false);
+		LLVMValueRef v_fn_addr;
+		LLVMValueRef v_result;
+
+		l_store_member(b, l_int8_const(0), v_fcinfo,
+					   offsetof(FunctionCallInfoData, isnull));
+		if (v_fn != NULL)
+		{
+			LLVMTypeRef fntype = LLVMGlobalGetValueType(v_fn);
+			LLVMTypeRef paramtype;
+			LLVMValueRef v_param;
+
+			LLVMGetParamTypes(fntype, &paramtype);
+			v_param = LLVMBuildPointerCast(b, v_fcinfo, paramtype, "");
+			v_result = LLVMBuildCall2(b, fntype, v_fn, &v_param, 1, "");
+		}
+		else
+		{
+			v_fn_addr = l_load_member(b, v_state,
+									  offsetof(FuncExprState, func) +
+									  offsetof(FmgrInfo, fn_addr),
+									  LLVMPointerType(fntype, 0), "fn_addr");
+			v_result = LLVMBuildCall2(b, fntype, v_fn_addr, &v_fcinfo, 1, "");
+		}
+		LLVMBuildStore(b, v_result, v_resvaluep);
+		LLVMBuildStore(b,
+					   l_load_member(b, v_fcinfo,
+									 offsetof(FunctionCallInfoData, isnull),
+									 TypeStorageBool, ""),
+					   v_resnullp);
+		LLVMBuildBr(b, b_done);
+	}
+
+	LLVMPositionBuilderAtEnd(b, b_strictnull);
+	LLVMBuildStore(b, l_datum_const((Datum) 0), v_resvaluep);
+	LLVMBuildStore(b, l_int8_const(1), v_resnullp);
+	LLVMBuildBr(b, b_done);
+
+	LLVMPositionBuilderAtEnd(b, b_done);
+}
+
+/*
+ * Emit the body of an inlined builtin operator, given its two non-null
+ * argument Datums.  Errors are raised through the same messages the C
+ * implementations use.
+ */
+static void
+expr_emit_inline_op(ExprCompileState *cs, const InlineOp *op,
+					LLVMValueRef v_left, LLVMValueRef v_right,
+					LLVMValueRef v_resvaluep)
+{
+	LLVMBuilderRef b = cs->b;
+	LLVMValueRef v_result;
+
+	if (op->argtype == 'i' || op->argtype == 'b')
+	{
+		int			width = Max(op->lbits, op->rbits);
+		LLVMTypeRef argtype = LLVMIntTypeInContext(llvm_context, width);
+		LLVMValueRef v_l;
+		LLVMValueRef v_r;
+		bool		is_signed = (op->argtype == 'i');
+
+		/* DatumGetInt16 and friends: truncate, then widen to common type */
+		v_l = LLVMBuildTrunc(b, v_left,
+							 LLVMIntTypeInContext(llvm_context, op->lbits), "");
+		v_r = LLVMBuildTrunc(b, v_right,
+							 LLVMIntTypeInContext(llvm_context, op->rbits), "");
+		if (is_signed)
+		{
+			v_l = LLVMBuildSExtOrBitCast(b, v_l, argtype, "");
+			v_r = LLVMBuildSExtOrBitCast(b, v_r, argtype, "");
+		}
+		else
+		{
+			/* bool: only "nonzero" matters */
+			v_l = LLVMBuildZExt(b, LLVMBuildICmp(b, LLVMIntNE, v_l,
+											 LLVMConstNull(argtype), ""),
+								argtype, "");
+			v_r = LLVMBuildZExt(b, LLVMBuildICmp(b, LLVMIntNE, v_r,
+											 LLVMConstNull(argtype), ""),
+								argtype, "");
+		}
+
+		switch (op->kind)
+		{
+			case INLINE_EQ:
+			case INLINE_NE:
+			case INLINE_LT:
+			case INLINE_LE:
+			case INLINE_GT:
+			case INLINE_GE:
+				{
+					LLVMIntPredicate pred = LLVMIntEQ;
+
+					switch (op->kind)
+					{
+						case INLINE_EQ:
+							pred = LLVMIntEQ;
+							break;
+						case INLINE_NE:
+							pred = LLVMIntNE;
+							break;
+						case INLINE_LT:
+							pred = is_signed ? LLVMIntSLT : LLVMIntULT;
+							break;
+						case INLINE_LE:
+							pred = is_signed ? LLVMIntSLE : LLVMIntULE;
+							break;
+						case INLINE_GT:
+							pred = is_signed ? LLVMIntSGT : LLVMIntUGT;
+							break;
+						case INLINE_GE:
+							pred = is_signed ? LLVMIntSGE : LLVMIntUGE;
+							break;
+						default:
+							break;
+					}
+					v_result = l_bool_to_datum(cs,
+										LLVMBuildICmp(b, pred, v_l, v_r, ""));
+					break;
+				}
+
+			case INLINE_ADD:
+			case INLINE_SUB:
+			case INLINE_MUL:
+				{
+					const char *intrinsic;
+					unsigned	id;
+					LLVMValueRef v_fn;
+					LLVMValueRef v_params[2];
+					LLVMValueRef v_ret;
+					LLVMBasicBlockRef b_overflow = l_bb_append(cs, "op.overflow");
+					LLVMBasicBlockRef b_ok = l_bb_append(cs, "op.ok");
+					LLVMTypeRef errfntype;
+
+					if (op->kind == INLINE_ADD)
+						intrinsic = "llvm.sadd.with.overflow";
+					else if (op->kind == INLINE_SUB)
+						intrinsic = "llvm.ssub.with.overflow";
+					else
+						intrinsic = "llvm.smul.with.overflow";
+
+					id = LLVMLookupIntrinsicID(intrinsic, strlen(intrinsic));
+					v_fn = LLVMGetIntrinsicDeclaration(cs->mod, id, &argtype, 1);
+					v_params[0] = v_l;
+					v_params[1] = v_r;
+					v_ret = LLVMBuildCall2(b, LLVMIntrinsicGetType(llvm_context, id, &argtype, 1),
+										   v_fn, v_params, 2, "");
+					LLVMBuildCondBr(b, LLVMBuildExtractValue(b, v_ret, 1, ""),
+									b_overflow, b_ok);
+
+					LLVMPositionBuilderAtEnd(b, b_overflow);
+					errfntype = LLVMFunctionType(LLVMVoidTypeInContext(llvm_context),
+												 NULL, 0, false);
+					LLVMBuildCall2(b, errfntype,
+								   llvm_get_decl(cs->mod,
+												 width == 64 ?
+												 "llvmjit_error_int8_out_of_range" :
+												 "llvmjit_error_int4_out_of_range",
+												 errfntype),
+								   NULL, 0, "");
+					LLVMBuildUnreachable(b);
+
+					LLVMPositionBuilderAtEnd(b, b_ok);
+					v_result = LLVMBuildExtractValue(b, v_ret, 0, "");
+					/* Int32GetDatum zero-extends, Int64GetDatum is a no-op */
+					v_result = LLVMBuildZExtOrBitCast(b, v_result, TypeDatum, "");
+					break;
+				}
+
+			default:
+				elog(ERROR, "unexpected inline operation %d", (int) op->kind);
+				v_result = NULL;	/* keep compiler quiet */
+		}
+	}
+	else
+	{
+		LLVMTypeRef dbl = LLVMDoubleTypeInContext(llvm_context);
+		LLVMValueRef v_l = LLVMBuildBitCast(b, v_left, dbl, "");
+		LLVMValueRef v_r = LLVMBuildBitCast(b, v_right, dbl, "");
+
+		Assert(op->argtype == 'f');
+
+		if (op->kind <= INLINE_GE)
+		{
+			/*
+			 * Same as float8_cmp_internal: NaNs are equal to each other and
+			 * sort after all non-NaN values.
+			 */
+			LLVMTypeRef i32 = LLVMInt32TypeInContext(llvm_context);
+			LLVMValueRef v_lnan = LLVMBuildFCmp(b, LLVMRealUNO, v_l, v_l, "");
+			LLVMValueRef v_rnan = LLVMBuildFCmp(b, LLVMRealUNO, v_r, v_r, "");
+			LLVMValueRef v_cmp;
+			LLVMIntPredicate pred = LLVMIntEQ;
+
+			v_cmp = LLVMBuildSelect(b,
+									LLVMBuildFCmp(b, LLVMRealOLT, v_l, v_r, ""),
+									LLVMConstInt(i32, -1, true),
+									LLVMConstInt(i32, 0, false), "");
+			v_cmp = LLVMBuildSelect(b,
+									LLVMBuildFCmp(b, LLVMRealOGT, v_l, v_r, ""),
+									LLVMConstInt(i32, 1, false),
+									v_cmp, "");
+			v_cmp = LLVMBuildSelect(b, v_rnan,
+									LLVMConstInt(i32, -1, true), v_cmp, "");
+			v_cmp = LLVMBuildSelect(b, v_lnan,
+									LLVMBuildSelect(b, v_rnan,
+													LLVMConstInt(i32, 0, false),
+													LLVMConstInt(i32, 1, false),
+													""),
+									v_cmp, "");
+
+			switch (op->kind)
+			{
+				case INLINE_EQ:
+					pred = LLVMIntEQ;
+					break;
+				case INLINE_NE:
+					pred = LLVMIntNE;
+					break;
+				case INLINE_LT:
+					pred = LLVMIntSLT;
+					break;
+				case INLINE_LE:
+					pred = LLVMIntSLE;
+					break;
+				case INLINE_GT:
+					pred = LLVMIntSGT;
+					break;
+				case INLINE_GE:
+					pred = LLVMIntSGE;
+					break;
+				default:
+					break;
+			}
+			v_result = l_bool_to_datum(cs,
+									   LLVMBuildICmp(b, pred, v_cmp,
+													 LLVMConstInt(i32, 0, false),
+													 ""));
+		}
+		else
+		{
+			/* CHECKFLOATVAL(result, isinf(l) || isinf(r), zero_is_valid) */
+			LLVMValueRef v_res;
+			LLVMValueRef v_inf = LLVMConstReal(dbl, get_float8_infinity());
+			LLVMValueRef v_zero = LLVMConstReal(dbl, 0.0);
+			LLVMValueRef v_isinf;
+			LLVMValueRef v_inf_valid;
+			LLVMValueRef v_fabs;
+			LLVMTypeRef errfntype;
+			LLVMBasicBlockRef b_overflow = l_bb_append(cs, "op.overflow");
+			LLVMBasicBlockRef b_checkzero = l_bb_append(cs, "op.checkzero");
+			LLVMBasicBlockRef b_ok = l_bb_append(cs, "op.ok");
+			unsigned	id;
+
+			if (op->kind == INLINE_ADD)
+				v_res = LLVMBuildFAdd(b, v_l, v_r, "");
+			else if (op->kind == INLINE_SUB)
+				v_res = LLVMBuildFSub(b, v_l, v_r, "");
+			else
+				v_res = LLVMBuildFMul(b, v_l, v_r, "");
+
+			id = LLVMLookupIntrinsicID("llvm.fabs", strlen("llvm.fabs"));
+			v_fabs = LLVMGetIntrinsicDeclaration(cs->mod, id, &dbl, 1);
+
+#define L_ISINF(v) \
+			LLVMBuildFCmp(b, LLVMRealOEQ, \
+						  LLVMBuildCall2(b, LLVMIntrinsicGetType(llvm_context, id, &dbl, 1), \
+										 v_fabs, &(v), 1, ""), \
+						  v_inf, "")
+
+			v_isinf = L_ISINF(v_res);
+			v_inf_valid = LLVMBuildOr(b, L_ISINF(v_l), L_ISINF(v_r), "");
+#undef L_ISINF
+
+			errfntype = LLVMFunctionType(LLVMVoidTypeInContext(llvm_context),
+										 NULL, 0, false);
+
+			LLVMBuildCondBr(b,
+							LLVMBuildAnd(b, v_isinf,
+										 LLVMBuildNot(b, v_inf_valid, ""), ""),
+							b_overflow, b_checkzero);
+
+			LLVMPositionBuilderAtEnd(b, b_overflow);
+			LLVMBuildCall2(b, errfntype,
+						   llvm_get_decl(cs->mod,
+										 "llvmjit_error_float8_overflow",
+										 errfntype),
+						   NULL, 0, "");
+			LLVMBuildUnreachable(b);
+
+			LLVMPositionBuilderAtEnd(b, b_checkzero);
+			if (op->kind == INLINE_MUL)
+			{
+				LLVMBasicBlockRef b_underflow = l_bb_append(cs, "op.underflow");
+				LLVMValueRef v_zero_valid;
+
+				v_zero_valid = LLVMBuildOr(b,
+										   LLVMBuildFCmp(b, LLVMRealOEQ,
+														 v_l, v_zero, ""),
+										   LLVMBuildFCmp(b, LLVMRealOEQ,
+														 v_r, v_zero, ""),
+										   "");
+				LLVMBuildCondBr(b,
+								LLVMBuildAnd(b,
+											 LLVMBuildFCmp(b, LLVMRealOEQ,
+														   v_res, v_zero, ""),
+											 LLVMBuildNot(b, v_zero_valid, ""),
+											 ""),
+								b_underflow, b_ok);
+
+				LLVMPositionBuilderAtEnd(b, b_underflow);
+				LLVMBuildCall2(b, errfntype,
+							   llvm_get_decl(cs->mod,
+											 "llvmjit_error_float8_underflow",
+											 errfntype),
+							   NULL, 0, "");
+				LLVMBuildUnreachable(b);
+			}
+			else
+				LLVMBuildBr(b, b_ok);
+
+			LLVMPositionBuilderAtEnd(b, b_ok);
+			v_result = LLVMBuildBitCast(b, v_res, TypeDatum, "");
+		}
+	}
+
+	LLVMBuildStore(b, v_result, v_resvaluep);
+}
+
+static const InlineOp *
+find_inline_op(Oid funcid)
+{
+	int			i;
+
+	for (i = 0; i < lengthof(inline_ops); i++)
+	{
+		if (inline_ops[i].funcid != funcid)
+			continue;
+		/* int8 and float8 are only simple values if passed by value */
+		if (inline_ops[i].byval64 && !FLOAT8PASSBYVAL)
+			return NULL;
+		return &inline_ops[i];
+	}
+
+	return NULL;
+}
+
+/*
+ * Emit list_nth() for a List of pointers, following the cell links.
+ */
+static LLVMValueRef
+l_list_nth(ExprCompileState *cs, LLVMValueRef v_list, int n)
+{
+	LLVMBuilderRef b = cs->b;
+	LLVMValueRef v_cell;
+
+	v_cell = l_load_member(b, v_list, offsetof(List, head), TypePtr, "cell");
+	while (n-- > 0)
+		v_cell = l_load_member(b, v_cell, offsetof(ListCell, next),
+							   TypePtr, "cell");
+
+	return l_load_member(b, v_cell, offsetof(ListCell, data.ptr_value),
+						 TypePtr, "elem");
+}
+
+/* DatumGetBool(): the low byte decides */
+static LLVMValueRef
+l_datum_to_bool(ExprCompileState *cs, LLVMValueRef v)
+{
+	return LLVMBuildICmp(cs->b, LLVMIntNE,
+						 LLVMBuildTrunc(cs->b, v, TypeStorageBool, ""),
+						 l_int8_const(0), "");
+}
+
+/* BoolGetDatum() of an i1 */
+static LLVMValueRef
+l_bool_to_datum(ExprCompileState *cs, LLVMValueRef v)
+{
+	return LLVMBuildZExt(cs->b, v, TypeDatum, "");
+}
+
+static LLVMBasicBlockRef
+l_bb_append(ExprCompileState *cs, const char *name)
+{
+	return LLVMAppendBasicBlockInContext(llvm_context, cs->fn, name);
+}
+
+
+/*
+ * Error reporting routines called from generated code.
+ */
+void
+llvmjit_error_int4_out_of_range(void)
+{
+	ereport(ERROR,
+			(errcode(ERRCODE_NUMERIC_VALUE_OUT_OF_RANGE),
+			 errmsg("integer out of range")));
+}
+
+void
+llvmjit_error_int8_out_of_range(void)
+{
+	ereport(ERROR,
+			(errcode(ERRCODE_NUMERIC_VALUE_OUT_OF_RANGE),
+			 errmsg("bigint out of range")));
+}
+
+void
+llvmjit_error_float8_overflow(void)
+{
+	ereport(ERROR,
+			(errcode(ERRCODE_NUMERIC_VALUE_OUT_OF_RANGE),
+			 errmsg("value out of range: overflow")));
+}
+
+void
+llvmjit_error_float8_underflow(void)
+{
+	ereport(ERROR,
+			(errcode(ERRCODE_NUMERIC_VALUE_OUT_OF_RANGE),
+			 errmsg("value out of range: underflow")));
+}
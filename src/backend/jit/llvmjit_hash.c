@@ -0,0 +1,546 @@
+/*-------------------------------------------------------------------------
+ *
+ * llvmjit_hash.c
+ *	  Generate the hashing and matching of hash join keys.
+ *
+ * Every tuple entering a hash join is hashed by ExecHashGetHashValue(),
+ * which evaluates the join keys one by one and calls each key's hash
+ * function through fmgr, and every inner tuple found in the probed bucket
+ * with the right hash value is checked by running ExecQual() over the
+ * hash clauses.  For a HashJoin node, the code generated here replaces:
+ *
+ *	- ExecHashGetHashValue() for the outer keys, installed as the
+ *	  HashJoinState's hj_OuterHashValueFunc,
+ *	- ExecHashGetHashValue() for the inner keys, installed as the child
+ *	  HashState's hashvaluefunc,
+ *	- the ExecQual() over the hash clauses in ExecScanHashBucket(),
+ *	  installed as the HashJoinState's hj_MatchFunc.
+ *
+ * The key and clause expressions are evaluated inline with the code
+ * generator of llvmjit_expr.c.  The hash functions of int2, int4, int8 and
+ * oid are evaluated inline as well, other key types call their hash
+ * function through the FmgrInfo kept in the hash table.  The result has to
+ * be exactly what the interpreted path would compute, because batch files
+ * written before a rescan and skew buckets are addressed by hash value.
+ *
+ * Portions Copyright (c) 1996-2013, PostgreSQL Global Development Group
+ *
+ *
+ * IDENTIFICATION
+ *	  src/backend/jit/llvmjit_hash.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "executor/hashjoin.h"
+#include "jit/llvmjit.h"
+#include "nodes/nodeFuncs.h"
+#include "utils/fmgroids.h"
+#include "utils/lsyscache.h"
+
+
+/*
+ * What the stubs installed by llvm_compile_hashjoin need to find the
+ * generated code.  Shared by the HashJoinState and its HashState.
+ */
+typedef struct CompiledHashJoin
+{
+	LLVMJitContext *context;
+	char	   *outer_funcname;
+	char	   *inner_funcname;
+	char	   *match_funcname;
+} CompiledHashJoin;
+
+static bool ExecRunCompiledHashValue(PlanState *node, HashJoinTable hashtable,
+						 ExprContext *econtext, bool keep_nulls,
+						 uint32 *hashvalue);
+static bool ExecRunCompiledHashMatch(HashJoinState *hjstate,
+						 ExprContext *econtext);
+static char *hash_emit_hashvalue(LLVMJitContext *context, List *hashkeys,
+					size_t keysoff, bool outer_tuple, List *hashops);
+static char *hash_emit_match(LLVMJitContext *context, List *hashclauses);
+static LLVMValueRef hash_emit_hashfunc(LLVMBuilderRef b, Oid hashfn,
+				   LLVMValueRef v_key);
+static LLVMValueRef hash_emit_uint32(LLVMBuilderRef b, LLVMValueRef v_k);
+static LLVMValueRef l_rot32(LLVMBuilderRef b, LLVMValueRef v_x, int k);
+
+
+/*
+ * llvm_compile_hashjoin
+ *
+ * Generate the hash value computation of both sides of a HashJoin node and
+ * the evaluation of its hash clauses into the context's current module, and
+ * install stubs emitting them on first use.  Returns false, leaving the
+ * nodes alone, if the join has a key we can't handle.
+ */
+bool
+llvm_compile_hashjoin(LLVMJitContext *context, HashJoinState *hjstate)
+{
+	HashJoin   *node = (HashJoin *) hjstate->js.ps.plan;
+	HashState  *hashstate = (HashState *) innerPlanState(hjstate);
+	CompiledHashJoin *compiled;
+	MemoryContext oldcontext;
+	char	   *outer_funcname;
+	char	   *inner_funcname;
+	char	   *match_funcname;
+
+	Assert(IsA(hashstate, HashState));
+
+	if (hjstate->hj_MatchFunc != NULL || hashstate->hashvaluefunc != NULL)
+		return false;
+
+	/* the interpreter has to complain about set-returning keys */
+	if (expression_returns_set((Node *) node->hashclauses))
+		return false;
+
+	outer_funcname = hash_emit_hashvalue(context, hjstate->hj_OuterHashKeys,
+									   offsetof(HashJoinState, hj_OuterHashKeys),
+										 true, hjstate->hj_HashOperators);
+	inner_funcname = hash_emit_hashvalue(context, hashstate->hashkeys,
+										 offsetof(HashState, hashkeys),
+										 false, hjstate->hj_HashOperators);
+	match_funcname = hash_emit_match(context, hjstate->hashclauses);
+
+	oldcontext = MemoryContextSwitchTo(context->base.mcxt);
+	compiled = palloc(sizeof(CompiledHashJoin));
+	compiled->context = context;
+	compiled->outer_funcname = outer_funcname;
+	compiled->inner_funcname = inner_funcname;
+	compiled->match_funcname = match_funcname;
+	MemoryContextSwitchTo(oldcontext);
+
+	hjstate->hj_OuterHashValueFunc = ExecRunCompiledHashValue;
+	hjstate->hj_MatchFunc = ExecRunCompiledHashMatch;
+	hjstate->hj_JitArg = compiled;
+	hashstate->hashvaluefunc = ExecRunCompiledHashValue;
+	hashstate->hashvaluearg = compiled;
+
+	return true;
+}
+
+/*
+ * Installed as the hash value function of both sides until the first call:
+ * emit the code, then make later calls go to it directly.
+ */
+static bool
+ExecRunCompiledHashValue(PlanState *node, HashJoinTable hashtable,
+						 ExprContext *econtext, bool keep_nulls,
+						 uint32 *hashvalue)
+{
+	ExecHashValueFunc func;
+
+	if (IsA(node, HashState))
+	{
+		HashState  *hashstate = (HashState *) node;
+		CompiledHashJoin *compiled = (CompiledHashJoin *) hashstate->hashvaluearg;
+
+		func = (ExecHashValueFunc) llvm_get_function(compiled->context,
+													 compiled->inner_funcname);
+		hashstate->hashvaluefunc = func;
+	}
+	else
+	{
+		HashJoinState *hjstate = (HashJoinState *) node;
+		CompiledHashJoin *compiled = (CompiledHashJoin *) hjstate->hj_JitArg;
+
+		Assert(IsA(node, HashJoinState));
+		func = (ExecHashValueFunc) llvm_get_function(compiled->context,
+													 compiled->outer_funcname);
+		hjstate->hj_OuterHashValueFunc = func;
+	}
+
+	return func(node, hashtable, econtext, keep_nulls, hashvalue);
+}
+
+/*
+ * Installed as hj_MatchFunc until the first call, like the above.
+ */
+static bool
+ExecRunCompiledHashMatch(HashJoinState *hjstate, ExprContext *econtext)
+{
+	CompiledHashJoin *compiled = (CompiledHashJoin *) hjstate->hj_JitArg;
+	ExecHashMatchFunc func;
+
+	func = (ExecHashMatchFunc) llvm_get_function(compiled->context,
+												 compiled->match_funcname);
+	hjstate->hj_MatchFunc = func;
+
+	return func(hjstate, econtext);
+}
+
+/*
+ * Emit the equivalent of ExecHashGetHashValue() for one side of the join,
+ * whose key ExprStates are found at runtime in the List at byte offset
+ * 'keysoff' of the node passed in.  Returns the name of the function.
+ */
+static char *
+hash_emit_hashvalue(LLVMJitContext *context, List *hashkeys, size_t keysoff,
+					bool outer_tuple, List *hashops)
+{
+	LLVMModuleRef mod;
+	LLVMBuilderRef b;
+	LLVMTypeRef i32 = LLVMInt32TypeInContext(llvm_context);
+	LLVMTypeRef param_types[5];
+	LLVMTypeRef functype;
+	LLVMTypeRef resettype;
+	LLVMTypeRef fmgrtype;
+	LLVMValueRef fn;
+	LLVMValueRef v_node;
+	LLVMValueRef v_hashtable;
+	LLVMValueRef v_econtext;
+	LLVMValueRef v_keepnulls;
+	LLVMValueRef v_hashvaluep;
+	LLVMValueRef v_tuplecontext;
+	LLVMValueRef v_oldcontext;
+	LLVMValueRef v_hashfns;
+	LLVMValueRef v_hashkeyp;
+	LLVMValueRef v_keyp;
+	LLVMValueRef v_keynullp;
+	LLVMValueRef v_cell = NULL;
+	LLVMValueRef v_reset;
+	LLVMValueRef v_fmgr;
+	LLVMBasicBlockRef b_reject;
+	ListCell   *lk;
+	ListCell   *lo;
+	char	   *funcname;
+	int			i;
+
+	funcname = llvm_expand_funcname(context,
+									outer_tuple ? "hash_outer" : "hash_inner");
+	mod = llvm_mutable_module(context);
+	b = LLVMCreateBuilderInContext(llvm_context);
+
+	/* bool (*)(node, hashtable, econtext, bool keep_nulls, uint32 *) */
+	param_types[0] = TypePtr;
+	param_types[1] = TypePtr;
+	param_types[2] = TypePtr;
+	param_types[3] = TypeStorageBool;
+	param_types[4] = TypePtr;
+	functype = LLVMFunctionType(TypeStorageBool, param_types, 5, false);
+	fn = LLVMAddFunction(mod, funcname, functype);
+	v_node = LLVMGetParam(fn, 0);
+	v_hashtable = LLVMGetParam(fn, 1);
+	v_econtext = LLVMGetParam(fn, 2);
+	v_keepnulls = LLVMGetParam(fn, 3);
+	v_hashvaluep = LLVMGetParam(fn, 4);
+
+	/* void MemoryContextReset(MemoryContext) */
+	resettype = LLVMFunctionType(LLVMVoidTypeInContext(llvm_context),
+								 &TypePtr, 1, false);
+	v_reset = llvm_get_decl(mod, "MemoryContextReset", resettype);
+
+	/* Datum FunctionCall1Coll(FmgrInfo *, Oid, Datum) */
+	param_types[0] = TypePtr;
+	param_types[1] = i32;
+	param_types[2] = TypeDatum;
+	fmgrtype = LLVMFunctionType(TypeDatum, param_types, 3, false);
+	v_fmgr = llvm_get_decl(mod, "FunctionCall1Coll", fmgrtype);
+
+	LLVMPositionBuilderAtEnd(b,
+							 LLVMAppendBasicBlockInContext(llvm_context, fn,
+														   "entry"));
+	l_count_call(context, b, false);
+	b_reject = LLVMAppendBasicBlockInContext(llvm_context, fn, "reject");
+
+	v_hashkeyp = l_entry_alloca(b, i32, "hashkey");
+	v_keyp = l_entry_alloca(b, TypeDatum, "key");
+	v_keynullp = l_entry_alloca(b, TypeStorageBool, "keynull");
+	LLVMBuildStore(b, l_int32_const(0), v_hashkeyp);
+
+	/* reset the per-tuple memory, to reclaim what the keys leaked */
+	v_tuplecontext = l_load_member(b, v_econtext,
+								offsetof(ExprContext, ecxt_per_tuple_memory),
+								   TypePtr, "tuplecontext");
+	LLVMBuildCall2(b, resettype, v_reset, &v_tuplecontext, 1, "");
+	v_oldcontext = l_mcxt_switch(mod, b, v_tuplecontext);
+
+	v_hashfns = l_load_member(b, v_hashtable,
+							  outer_tuple ?
+							  offsetof(HashJoinTableData, outer_hashfunctions) :
+							  offsetof(HashJoinTableData, inner_hashfunctions),
+							  TypePtr, "hashfunctions");
+
+	i = 0;
+	forboth(lk, hashkeys, lo, hashops)
+	{
+		ExprState  *keyexpr = (ExprState *) lfirst(lk);
+		Oid			hashop = lfirst_oid(lo);
+		Oid			left_hashfn;
+		Oid			right_hashfn;
+		Oid			hashfn;
+		LLVMValueRef v_hashkey;
+		LLVMValueRef v_hkey;
+		LLVMBasicBlockRef b_null;
+		LLVMBasicBlockRef b_notnull;
+		LLVMBasicBlockRef b_next;
+
+		/* ExecHashTableCreate looks the functions up the same way */
+		if (!get_op_hash_functions(hashop, &left_hashfn, &right_hashfn))
+			elog(ERROR, "could not find hash function for hash operator %u",
+				 hashop);
+		hashfn = outer_tuple ? left_hashfn : right_hashfn;
+
+		b_null = LLVMAppendBasicBlockInContext(llvm_context, fn, "key.null");
+		b_notnull = LLVMAppendBasicBlockInContext(llvm_context, fn,
+												  "key.notnull");
+		b_next = LLVMAppendBasicBlockInContext(llvm_context, fn, "key.next");
+
+		/* rotate hashkey left 1 bit at each step */
+		LLVMBuildStore(b,
+					   l_rot32(b, LLVMBuildLoad2(b, i32, v_hashkeyp, ""), 1),
+					   v_hashkeyp);
+
+		if (v_cell == NULL)
+			v_cell = l_load_member(b,
+								   l_load_member(b, v_node, keysoff,
+												 TypePtr, "hashkeys"),
+								   offsetof(List, head), TypePtr, "cell");
+		else
+			v_cell = l_load_member(b, v_cell, offsetof(ListCell, next),
+								   TypePtr, "cell");
+
+		llvm_emit_expr(context, b, v_econtext, keyexpr,
+					   l_load_member(b, v_cell,
+									 offsetof(ListCell, data.ptr_value),
+									 TypePtr, "keyexpr"),
+					   v_keyp, v_keynullp);
+		LLVMBuildCondBr(b, l_isnull(b, v_keynullp), b_null, b_notnull);
+
+		/*
+		 * A NULL key of a strict operator can't match, unless we're keeping
+		 * unmatched tuples.  Otherwise it acts as hash code zero.
+		 */
+		LLVMPositionBuilderAtEnd(b, b_null);
+		if (op_strict(hashop))
+			LLVMBuildCondBr(b,
+							LLVMBuildICmp(b, LLVMIntNE, v_keepnulls,
+										  l_int8_const(0), ""),
+							b_next, b_reject);
+		else
+			LLVMBuildBr(b, b_next);
+
+		LLVMPositionBuilderAtEnd(b, b_notnull);
+		v_hkey = hash_emit_hashfunc(b, hashfn,
+									LLVMBuildLoad2(b, TypeDatum, v_keyp, ""));
+		if (v_hkey == NULL)
+		{
+			LLVMValueRef v_params[3];
+
+			v_params[0] = l_member_addr(b, v_hashfns, i * sizeof(FmgrInfo),
+										LLVMInt8TypeInContext(llvm_context));
+			v_params[1] = l_int32_const(InvalidOid);
+			v_params[2] = LLVMBuildLoad2(b, TypeDatum, v_keyp, "");
+			v_hkey = LLVMBuildTrunc(b,
+									LLVMBuildCall2(b, fmgrtype, v_fmgr,
+												   v_params, 3, ""),
+									i32, "");
+		}
+		v_hashkey = LLVMBuildLoad2(b, i32, v_hashkeyp, "");
+		LLVMBuildStore(b, LLVMBuildXor(b, v_hashkey, v_hkey, ""), v_hashkeyp);
+		LLVMBuildBr(b, b_next);
+
+		LLVMPositionBuilderAtEnd(b, b_next);
+		i++;
+	}
+
+	l_mcxt_switch(mod, b, v_oldcontext);
+	LLVMBuildStore(b, LLVMBuildLoad2(b, i32, v_hashkeyp, ""),
+				   LLVMBuildPointerCast(b, v_hashvaluep,
+										LLVMPointerType(i32, 0), ""));
+	LLVMBuildRet(b, l_int8_const(1));
+
+	LLVMPositionBuilderAtEnd(b, b_reject);
+	l_mcxt_switch(mod, b, v_oldcontext);
+	LLVMBuildRet(b, l_int8_const(0));
+
+	LLVMDisposeBuilder(b);
+
+	return funcname;
+}
+
+/*
+ * Emit the equivalent of ExecQual(hjstate->hashclauses, econtext, false).
+ * Returns the name of the function.
+ */
+static char *
+hash_emit_match(LLVMJitContext *context, List *hashclauses)
+{
+	LLVMModuleRef mod;
+	LLVMBuilderRef b;
+	LLVMTypeRef param_types[2];
+	LLVMTypeRef functype;
+	LLVMValueRef fn;
+	LLVMValueRef v_hjstate;
+	LLVMValueRef v_econtext;
+	LLVMValueRef v_oldcontext;
+	LLVMValueRef v_resvaluep;
+	LLVMValueRef v_resnullp;
+	LLVMValueRef v_cell = NULL;
+	LLVMBasicBlockRef b_fail;
+	ListCell   *lc;
+	char	   *funcname;
+
+	funcname = llvm_expand_funcname(context, "hash_match");
+	mod = llvm_mutable_module(context);
+	b = LLVMCreateBuilderInContext(llvm_context);
+
+	/* bool (*)(HashJoinState *hjstate, ExprContext *econtext) */
+	param_types[0] = TypePtr;
+	param_types[1] = TypePtr;
+	functype = LLVMFunctionType(TypeStorageBool, param_types, 2, false);
+	fn = LLVMAddFunction(mod, funcname, functype);
+	v_hjstate = LLVMGetParam(fn, 0);
+	v_econtext = LLVMGetParam(fn, 1);
+
+	LLVMPositionBuilderAtEnd(b,
+							 LLVMAppendBasicBlockInContext(llvm_context, fn,
+														   "entry"));
+	l_count_call(context, b, false);
+	b_fail = LLVMAppendBasicBlockInContext(llvm_context, fn, "fail");
+
+	v_resvaluep = l_entry_alloca(b, TypeDatum, "clauseresult");
+	v_resnullp = l_entry_alloca(b, TypeStorageBool, "clausenull");
+
+	/* as in ExecQual, evaluate in the per-tuple memory context */
+	v_oldcontext = l_mcxt_switch(mod, b,
+								 l_load_member(b, v_econtext,
+								offsetof(ExprContext, ecxt_per_tuple_memory),
+											   TypePtr, ""));
+
+	foreach(lc, hashclauses)
+	{
+		ExprState  *clause = (ExprState *) lfirst(lc);
+		LLVMBasicBlockRef b_notnull;
+		LLVMBasicBlockRef b_next;
+
+		b_notnull = LLVMAppendBasicBlockInContext(llvm_context, fn,
+												  "clause.notnull");
+		b_next = LLVMAppendBasicBlockInContext(llvm_context, fn,
+											   "clause.next");
+
+		if (v_cell == NULL)
+			v_cell = l_load_member(b,
+								   l_load_member(b, v_hjstate,
+											offsetof(HashJoinState, hashclauses),
+												 TypePtr, "hashclauses"),
+								   offsetof(List, head), TypePtr, "cell");
+		else
+			v_cell = l_load_member(b, v_cell, offsetof(ListCell, next),
+								   TypePtr, "cell");
+
+		llvm_emit_expr(context, b, v_econtext, clause,
+					   l_load_member(b, v_cell,
+									 offsetof(ListCell, data.ptr_value),
+									 TypePtr, "clause"),
+					   v_resvaluep, v_resnullp);
+
+		/* a NULL or false clause fails the match */
+		LLVMBuildCondBr(b, l_isnull(b, v_resnullp), b_fail, b_notnull);
+		LLVMPositionBuilderAtEnd(b, b_notnull);
+		LLVMBuildCondBr(b,
+						LLVMBuildICmp(b, LLVMIntEQ,
+									  LLVMBuildLoad2(b, TypeDatum,
+													 v_resvaluep, ""),
+									  l_datum_const((Datum) 0), ""),
+						b_fail, b_next);
+		LLVMPositionBuilderAtEnd(b, b_next);
+	}
+
+	l_mcxt_switch(mod, b, v_oldcontext);
+	LLVMBuildRet(b, l_int8_const(1));
+
+	LLVMPositionBuilderAtEnd(b, b_fail);
+	l_mcxt_switch(mod, b, v_oldcontext);
+	LLVMBuildRet(b, l_int8_const(0));
+
+	LLVMDisposeBuilder(b);
+
+	return funcname;
+}
+
+/*
+ * Emit the hash function 'hashfn' applied to the non-null Datum 'v_key',
+ * returning the i32 hash code, or NULL if it is not one of the functions
+ * evaluated inline.
+ */
+static LLVMValueRef
+hash_emit_hashfunc(LLVMBuilderRef b, Oid hashfn, LLVMValueRef v_key)
+{
+	LLVMTypeRef i32 = LLVMInt32TypeInContext(llvm_context);
+
+	switch (hashfn)
+	{
+		case F_HASHINT2:
+			/* hash_uint32((int32) PG_GETARG_INT16(0)) */
+			return hash_emit_uint32(b,
+					   LLVMBuildSExt(b,
+									 LLVMBuildTrunc(b, v_key,
+										 LLVMInt16TypeInContext(llvm_context),
+													""),
+									 i32, ""));
+
+		case F_HASHINT4:
+		case F_HASHOID:
+			return hash_emit_uint32(b, LLVMBuildTrunc(b, v_key, i32, ""));
+
+#ifdef USE_FLOAT8_BYVAL
+		case F_HASHINT8:
+			{
+				/* xor in the high half, or its complement if negative */
+				LLVMValueRef v_lo;
+				LLVMValueRef v_hi;
+				LLVMValueRef v_neg;
+
+				v_lo = LLVMBuildTrunc(b, v_key, i32, "");
+				v_hi = LLVMBuildTrunc(b,
+									  LLVMBuildLShr(b, v_key,
+													l_datum_const(32), ""),
+									  i32, "");
+				v_neg = LLVMBuildICmp(b, LLVMIntSLT, v_key,
+									  l_datum_const((Datum) 0), "");
+				v_hi = LLVMBuildSelect(b, v_neg, LLVMBuildNot(b, v_hi, ""),
+									   v_hi, "");
+				return hash_emit_uint32(b, LLVMBuildXor(b, v_lo, v_hi, ""));
+			}
+#endif
+
+		default:
+			return NULL;
+	}
+}
+
+/*
+ * Emit hash_uint32() of the i32 'v_k'.
+ */
+static LLVMValueRef
+hash_emit_uint32(LLVMBuilderRef b, LLVMValueRef v_k)
+{
+	LLVMValueRef a;
+	LLVMValueRef bb;
+	LLVMValueRef c;
+
+	bb = c = l_int32_const(0x9e3779b9 + (uint32) sizeof(uint32) + 3923095);
+	a = LLVMBuildAdd(b, c, v_k, "");
+
+	/* final(a, b, c) */
+	c = LLVMBuildSub(b, LLVMBuildXor(b, c, bb, ""), l_rot32(b, bb, 14), "");
+	a = LLVMBuildSub(b, LLVMBuildXor(b, a, c, ""), l_rot32(b, c, 11), "");
+	bb = LLVMBuildSub(b, LLVMBuildXor(b, bb, a, ""), l_rot32(b, a, 25), "");
+	c = LLVMBuildSub(b, LLVMBuildXor(b, c, bb, ""), l_rot32(b, bb, 16), "");
+	a = LLVMBuildSub(b, LLVMBuildXor(b, a, c, ""), l_rot32(b, c, 4), "");
+	bb = LLVMBuildSub(b, LLVMBuildXor(b, bb, a, ""), l_rot32(b, a, 14), "");
+	c = LLVMBuildSub(b, LLVMBuildXor(b, c, bb, ""), l_rot32(b, bb, 24), "");
+
+	return c;
+}
+
+/* rotate the i32 'v_x' left by 'k' bits */
+static LLVMValueRef
+l_rot32(LLVMBuilderRef b, LLVMValueRef v_x, int k)
+{
+	return LLVMBuildOr(b,
+					   LLVMBuildShl(b, v_x, l_int32_const(k), ""),
+					   LLVMBuildLShr(b, v_x, l_int32_const(32 - k), ""),
+					   "");
+}
@@ -0,0 +1,547 @@
+/*-------------------------------------------------------------------------
+ *
+ * llvmjit_inline.c
+ *	  Inline builtin functions into JIT compiled code, using the LLVM
+ *	  bitcode of their source files installed with the server.
+ *
+ * When clang is available at build time, the source files defining the most
+ * common operators are also compiled into bitcode (see utils/adt/Makefile),
+ * which ends up in $pkglibdir/bitcode.  Generated code calls the builtins
+ * found there directly by their C name, rather than through
+ * FmgrInfo->fn_addr.  Before such a module is optimized, the definitions of
+ * the functions it calls are copied into it with available_externally
+ * linkage: the optimizer may inline them, and calls it leaves alone still go
+ * to the server's own copy.
+ *
+ * Only functions that can be copied without changing their meaning are
+ * imported.  Their bodies may refer to external functions and variables of
+ * the server, which the copy refers to as well, to constants, and to static
+ * functions of their file, which are imported along with them.  A static
+ * variable, however, would be duplicated by the copy, so functions using one
+ * directly or through their static callees are left alone.
+ *
+ * The bitcode is loaded once per backend, on first use.  Which functions it
+ * defines is kept in an index; whether they can be imported is only worked
+ * out when they are first asked for.
+ *
+ * Portions Copyright (c) 1996-2013, PostgreSQL Global Development Group
+ *
+ *
+ * IDENTIFICATION
+ *	  src/backend/jit/llvmjit_inline.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include <llvm-c/BitReader.h>
+#include <llvm-c/Core.h>
+#include <llvm-c/Linker.h>
+
+#include "jit/llvmjit.h"
+#include "miscadmin.h"
+#include "storage/fd.h"
+#include "utils/fmgrtab.h"
+#include "utils/hsearch.h"
+#include "utils/memutils.h"
+
+
+/* directory below pkglibdir holding the bitcode files */
+#define BITCODE_DIR		"bitcode"
+
+/* whether a function defined in bitcode can be imported */
+typedef enum InlineState
+{
+	INLINE_UNKNOWN,				/* not checked yet */
+	INLINE_OK,
+	INLINE_IMPOSSIBLE
+} InlineState;
+
+/* a function defined in bitcode */
+typedef struct InlineIndexEntry
+{
+	char		name[NAMEDATALEN];	/* function name, hash key */
+	LLVMModuleRef module;		/* bitcode module defining it */
+	InlineState state;
+} InlineIndexEntry;
+
+/* functions defined in bitcode by name, NULL until loaded */
+static HTAB *llvm_inline_index = NULL;
+
+
+static void llvm_load_bitcode(void);
+static void llvm_load_bitcode_file(const char *path);
+static InlineIndexEntry *llvm_inline_lookup(const char *name);
+static bool llvm_inline_check_function(LLVMValueRef fn, List **statics);
+static bool llvm_inline_check_value(LLVMValueRef v, List **statics);
+static void llvm_import_functions(LLVMModuleRef mod, LLVMModuleRef src,
+					  List *names);
+static void llvm_replace_with_declaration(LLVMValueRef gv);
+static bool llvm_is_local(LLVMValueRef gv);
+
+
+/*
+ * Return a declaration, usable in 'mod', of the C function implementing the
+ * builtin 'funcid', if its definition can be imported from bitcode; NULL
+ * otherwise.  Calls to it are subject to llvm_inline().
+ */
+LLVMValueRef
+llvm_inline_function_decl(LLVMModuleRef mod, Oid funcid)
+{
+	const FmgrBuiltin *fbp = fmgr_isbuiltin(funcid);
+	InlineIndexEntry *entry;
+	LLVMValueRef fn;
+
+	if (fbp == NULL)
+		return NULL;
+
+	entry = llvm_inline_lookup(fbp->funcName);
+	if (entry == NULL)
+		return NULL;
+
+	/* use the exact type of the definition, so the call can be inlined */
+	fn = LLVMGetNamedFunction(entry->module, entry->name);
+	return llvm_get_decl(mod, entry->name, LLVMGlobalGetValueType(fn));
+}
+
+/*
+ * Import the definitions of all functions 'mod' declares that can be
+ * imported from bitcode.
+ */
+void
+llvm_inline(LLVMModuleRef mod)
+{
+	List	   *modules = NIL;
+	List	   *names = NIL;
+	ListCell   *lc1;
+	ListCell   *lc2;
+	LLVMValueRef fn;
+
+	/* collect the functions to import, grouped by the module defining them */
+	for (fn = LLVMGetFirstFunction(mod); fn != NULL; fn = LLVMGetNextFunction(fn))
+	{
+		InlineIndexEntry *entry;
+		const char *name;
+		size_t		len;
+		bool		found = false;
+
+		if (!LLVMIsDeclaration(fn) || LLVMGetIntrinsicID(fn) != 0)
+			continue;
+
+		name = LLVMGetValueName2(fn, &len);
+		if (len >= NAMEDATALEN || (entry = llvm_inline_lookup(name)) == NULL)
+			continue;
+
+		forboth(lc1, modules, lc2, names)
+		{
+			if ((LLVMModuleRef) lfirst(lc1) == entry->module)
+			{
+				lfirst(lc2) = lappend((List *) lfirst(lc2), entry->name);
+				found = true;
+				break;
+			}
+		}
+		if (!found)
+		{
+			modules = lappend(modules, entry->module);
+			names = lappend(names, list_make1(entry->name));
+		}
+	}
+
+	forboth(lc1, modules, lc2, names)
+	{
+		llvm_import_functions(mod, (LLVMModuleRef) lfirst(lc1),
+							  (List *) lfirst(lc2));
+		list_free((List *) lfirst(lc2));
+	}
+	list_free(modules);
+	list_free(names);
+}
+
+/*
+ * Copy the functions named 'names' from the bitcode module 'src' into
+ * 'mod', along with the static functions and constants they use.
+ *
+ * The C API has no way to copy single functions between modules, so a copy
+ * of the whole module is reduced to what is needed and then linked into
+ * 'mod'.
+ */
+static void
+llvm_import_functions(LLVMModuleRef mod, LLVMModuleRef src, List *names)
+{
+	LLVMModuleRef copy = LLVMCloneModule(src);
+	List	   *keep = NIL;
+	List	   *others = NIL;
+	ListCell   *lc;
+	LLVMValueRef fn;
+	LLVMValueRef gv;
+
+	foreach(lc, names)
+	{
+		const char *name = (const char *) lfirst(lc);
+		bool		ok PG_USED_FOR_ASSERTS_ONLY;
+
+		fn = LLVMGetNamedFunction(copy, name);
+		keep = lappend(keep, fn);
+		ok = llvm_inline_check_function(fn, &keep);
+		Assert(ok);
+	}
+
+	/*
+	 * Functions imported for the optimizer's eyes only mustn't be emitted,
+	 * and their static callees have nothing to do with the server's copy.
+	 * The bitcode was compiled for a generic CPU, which would keep it from
+	 * being inlined into code generated for this one.
+	 */
+	for (fn = LLVMGetFirstFunction(copy); fn != NULL; fn = LLVMGetNextFunction(fn))
+	{
+		if (list_member_ptr(keep, fn))
+		{
+			if (!llvm_is_local(fn))
+				LLVMSetLinkage(fn, LLVMAvailableExternallyLinkage);
+			LLVMRemoveStringAttributeAtIndex(fn, LLVMAttributeFunctionIndex,
+											 "target-cpu", strlen("target-cpu"));
+			LLVMRemoveStringAttributeAtIndex(fn, LLVMAttributeFunctionIndex,
+											 "target-features",
+											 strlen("target-features"));
+		}
+		else
+			others = lappend(others, fn);
+	}
+	for (gv = LLVMGetFirstGlobal(copy); gv != NULL; gv = LLVMGetNextGlobal(gv))
+	{
+		if (!list_member_ptr(keep, gv))
+			others = lappend(others, gv);
+	}
+
+	/*
+	 * Everything else becomes a declaration, resolved against the server.
+	 * Once no bodies are left referring to them, the declarations that
+	 * aren't used by the imported functions are removed.
+	 */
+	foreach(lc, others)
+	{
+		LLVMValueRef v = (LLVMValueRef) lfirst(lc);
+		size_t		len;
+
+		if (LLVMIsAGlobalVariable(v) &&
+			strncmp(LLVMGetValueName2(v, &len), "llvm.", 5) == 0)
+		{
+			/* llvm.used and the like, referring to everything */
+			LLVMDeleteGlobal(v);
+			lfirst(lc) = NULL;
+		}
+	}
+	foreach(lc, others)
+	{
+		LLVMValueRef v = (LLVMValueRef) lfirst(lc);
+
+		if (v == NULL)
+			continue;
+		if (LLVMIsAFunction(v) ? !LLVMIsDeclaration(v) :
+			LLVMGetInitializer(v) != NULL)
+		{
+			llvm_replace_with_declaration(v);
+			lfirst(lc) = NULL;
+		}
+	}
+	for (fn = LLVMGetFirstFunction(copy); fn != NULL;)
+	{
+		LLVMValueRef next = LLVMGetNextFunction(fn);
+
+		if (LLVMGetFirstUse(fn) == NULL && !list_member_ptr(keep, fn))
+			LLVMDeleteFunction(fn);
+		fn = next;
+	}
+	for (gv = LLVMGetFirstGlobal(copy); gv != NULL;)
+	{
+		LLVMValueRef next = LLVMGetNextGlobal(gv);
+
+		if (LLVMGetFirstUse(gv) == NULL && !list_member_ptr(keep, gv))
+			LLVMDeleteGlobal(gv);
+		gv = next;
+	}
+
+	list_free(keep);
+	list_free(others);
+
+	LLVMSetTarget(copy, LLVMGetTarget(mod));
+	LLVMSetDataLayout(copy, LLVMGetDataLayoutStr(mod));
+
+	/* this consumes the copy */
+	if (LLVMLinkModules2(mod, copy))
+		elog(ERROR, "could not link bitcode into JIT module");
+}
+
+/*
+ * Replace the definition of a function or global variable by a declaration
+ * of the same name and type, which refers to the server's symbol.
+ */
+static void
+llvm_replace_with_declaration(LLVMValueRef gv)
+{
+	LLVMModuleRef mod = LLVMGetGlobalParent(gv);
+	LLVMTypeRef type = LLVMGlobalGetValueType(gv);
+	LLVMValueRef decl;
+	const char *name;
+	char	   *namecopy;
+	size_t		len;
+
+	if (LLVMIsAFunction(gv))
+	{
+		decl = LLVMAddFunction(mod, "", type);
+		LLVMSetFunctionCallConv(decl, LLVMGetFunctionCallConv(gv));
+	}
+	else
+	{
+		decl = LLVMAddGlobal(mod, type, "");
+		LLVMSetThreadLocal(decl, LLVMIsThreadLocal(gv));
+	}
+	LLVMReplaceAllUsesWith(gv, decl);
+
+	name = LLVMGetValueName2(gv, &len);
+	namecopy = pnstrdup(name, len);
+	if (LLVMIsAFunction(gv))
+		LLVMDeleteFunction(gv);
+	else
+		LLVMDeleteGlobal(gv);
+	LLVMSetValueName2(decl, namecopy, len);
+	pfree(namecopy);
+}
+
+/*
+ * Return the index entry of function 'name' if it can be imported, NULL if
+ * not, checking on first use.
+ */
+static InlineIndexEntry *
+llvm_inline_lookup(const char *name)
+{
+	InlineIndexEntry *entry;
+	char		key[NAMEDATALEN];
+
+	if (llvm_inline_index == NULL)
+		llvm_load_bitcode();
+
+	if (strlen(name) >= NAMEDATALEN)
+		return NULL;
+	MemSet(key, 0, sizeof(key));
+	strcpy(key, name);
+
+	entry = (InlineIndexEntry *) hash_search(llvm_inline_index, key,
+											 HASH_FIND, NULL);
+	if (entry == NULL)
+		return NULL;
+
+	if (entry->state == INLINE_UNKNOWN)
+	{
+		List	   *statics = NIL;
+		LLVMValueRef fn = LLVMGetNamedFunction(entry->module, name);
+
+		entry->state = llvm_inline_check_function(fn, &statics) ?
+			INLINE_OK : INLINE_IMPOSSIBLE;
+		list_free(statics);
+	}
+
+	return entry->state == INLINE_OK ? entry : NULL;
+}
+
+/*
+ * Check whether the body of function 'fn' can be copied, adding the static
+ * functions and variables it uses that have to be copied along to
+ * '*statics'.
+ */
+static bool
+llvm_inline_check_function(LLVMValueRef fn, List **statics)
+{
+	LLVMBasicBlockRef bb;
+
+	for (bb = LLVMGetFirstBasicBlock(fn); bb != NULL; bb = LLVMGetNextBasicBlock(bb))
+	{
+		LLVMValueRef inst;
+
+		for (inst = LLVMGetFirstInstruction(bb);
+			 inst != NULL;
+			 inst = LLVMGetNextInstruction(inst))
+		{
+			int			nops = LLVMGetNumOperands(inst);
+			int			i;
+
+			for (i = 0; i < nops; i++)
+			{
+				if (!llvm_inline_check_value(LLVMGetOperand(inst, i), statics))
+					return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+/*
+ * Check a value used by a function to be copied, see above.
+ */
+static bool
+llvm_inline_check_value(LLVMValueRef v, List **statics)
+{
+	if (v == NULL)
+		return true;
+
+	if (LLVMIsAFunction(v))
+	{
+		/* external functions are called in the server */
+		if (LLVMIsDeclaration(v) || !llvm_is_local(v))
+			return true;
+		if (list_member_ptr(*statics, v))
+			return true;
+		*statics = lappend(*statics, v);
+		return llvm_inline_check_function(v, statics);
+	}
+
+	if (LLVMIsAGlobalVariable(v))
+	{
+		if (!llvm_is_local(v))
+			return true;
+		if (list_member_ptr(*statics, v))
+			return true;
+		/* a copy of a static variable would lead a life of its own */
+		if (!LLVMIsGlobalConstant(v))
+			return false;
+		*statics = lappend(*statics, v);
+		return llvm_inline_check_value(LLVMGetInitializer(v), statics);
+	}
+
+	/* aliases, ifuncs */
+	if (LLVMIsAGlobalValue(v))
+		return false;
+
+	if (LLVMIsAConstant(v))
+	{
+		int			nops = LLVMGetNumOperands(v);
+		int			i;
+
+		for (i = 0; i < nops; i++)
+		{
+			if (!llvm_inline_check_value(LLVMGetOperand(v, i), statics))
+				return false;
+		}
+	}
+
+	return true;
+}
+
+/*
+ * Load all bitcode files and build the index of the functions they define.
+ * A missing directory just means that nothing can be inlined.
+ */
+static void
+llvm_load_bitcode(void)
+{
+	HASHCTL		ctl;
+	char		dirpath[MAXPGPATH];
+	DIR		   *dir;
+	struct dirent *de;
+
+	MemSet(&ctl, 0, sizeof(ctl));
+	ctl.keysize = NAMEDATALEN;
+	ctl.entrysize = sizeof(InlineIndexEntry);
+	llvm_inline_index = hash_create("JIT inlining index", 1024,
+									&ctl, HASH_ELEM);
+
+	snprintf(dirpath, sizeof(dirpath), "%s/%s", pkglib_path, BITCODE_DIR);
+	dir = AllocateDir(dirpath);
+	if (dir == NULL)
+	{
+		elog(DEBUG1, "could not open bitcode directory \"%s\": %m", dirpath);
+		return;
+	}
+
+	while ((de = ReadDir(dir, dirpath)) != NULL)
+	{
+		char		path[MAXPGPATH];
+		size_t		len = strlen(de->d_name);
+
+		if (len <= 3 || strcmp(de->d_name + len - 3, ".bc") != 0)
+			continue;
+
+		if (snprintf(path, sizeof(path), "%s/%s",
+					 dirpath, de->d_name) >= (int) sizeof(path))
+			elog(ERROR, "path of bitcode file \"%s\" is too long",
+				 de->d_name);
+		llvm_load_bitcode_file(path);
+	}
+
+	FreeDir(dir);
+}
+
+/*
+ * Load one bitcode file, adding the external functions it defines to the
+ * index.  Unusable files are skipped.
+ */
+static void
+llvm_load_bitcode_file(const char *path)
+{
+	LLVMMemoryBufferRef buf;
+	LLVMModuleRef mod;
+	LLVMValueRef fn;
+	char	   *msg;
+
+	if (LLVMCreateMemoryBufferWithContentsOfFile(path, &buf, &msg))
+	{
+		elog(LOG, "could not read bitcode file \"%s\": %s", path, msg);
+		LLVMDisposeMessage(msg);
+		return;
+	}
+
+	if (LLVMParseBitcodeInContext2(llvm_context, buf, &mod))
+	{
+		LLVMDisposeMemoryBuffer(buf);
+		elog(LOG, "could not parse bitcode file \"%s\"", path);
+		return;
+	}
+	LLVMDisposeMemoryBuffer(buf);
+
+	/* aliases would need more care when reducing copies of the module */
+	if (LLVMGetFirstGlobalAlias(mod) != NULL)
+	{
+		LLVMDisposeModule(mod);
+		elog(LOG, "ignoring bitcode file \"%s\" defining aliases", path);
+		return;
+	}
+
+	for (fn = LLVMGetFirstFunction(mod); fn != NULL; fn = LLVMGetNextFunction(fn))
+	{
+		InlineIndexEntry *entry;
+		const char *name;
+		char		key[NAMEDATALEN];
+		size_t		len;
+		bool		found;
+
+		if (LLVMIsDeclaration(fn) || llvm_is_local(fn))
+			continue;
+
+		name = LLVMGetValueName2(fn, &len);
+		if (len >= NAMEDATALEN)
+			continue;
+		MemSet(key, 0, sizeof(key));
+		memcpy(key, name, len);
+
+		entry = (InlineIndexEntry *) hash_search(llvm_inline_index, key,
+												 HASH_ENTER, &found);
+		if (!found)
+		{
+			entry->module = mod;
+			entry->state = INLINE_UNKNOWN;
+		}
+	}
+}
+
+/*
+ * Is a function or global variable local to its module?
+ */
+static bool
+llvm_is_local(LLVMValueRef gv)
+{
+	LLVMLinkage linkage = LLVMGetLinkage(gv);
+
+	return linkage == LLVMInternalLinkage || linkage == LLVMPrivateLinkage;
+}
@@ -0,0 +1,391 @@
+/*-------------------------------------------------------------------------
+ *
+ * llvmjit_sort.c
+ *	  Generate tuple comparators specialized for the keys of a Sort node.
+ *
+ * comparetup_heap() compares the leading sort key, which tuplesort keeps
+ * next to each tuple, and then fetches every further key of both tuples
+ * with heap_getattr() and compares it through ApplySortComparator() and
+ * the key's SortSupport.  The comparator generated here knows the sort keys
+ * of a particular Sort node:
+ *
+ *	- the further keys of both tuples are extracted in one pass over each
+ *	  tuple, specialized for the input's tuple descriptor,
+ *	- NULL ordering and sort direction are constants,
+ *	- keys of integer-like types (int2, int4, int8, oid, "char", bool, date
+ *	  and integer timestamps) are compared inline,
+ *	- other keys are compared through tuplesort_heap_compare_key(), which
+ *	  uses the key's SortSupport as before.
+ *
+ * The comparator is handed to tuplesort when the node starts sorting, and
+ * is then used both to quicksort runs in memory and to merge runs from
+ * tape.  Single-key sorts are left alone, tuplesort has a specialized
+ * quicksort for them already.
+ *
+ * Portions Copyright (c) 1996-2013, PostgreSQL Global Development Group
+ *
+ *
+ * IDENTIFICATION
+ *	  src/backend/jit/llvmjit_sort.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "access/htup_details.h"
+#include "access/nbtree.h"
+#include "executor/executor.h"
+#include "jit/llvmjit.h"
+#include "utils/fmgroids.h"
+#include "utils/lsyscache.h"
+#include "utils/tuplesort.h"
+
+
+/*
+ * What the getcomparator callback installed in the SortState needs to find
+ * the generated code.
+ */
+typedef struct CompiledSort
+{
+	LLVMJitContext *context;
+	char	   *funcname;
+	SortTupleComparator comparator; /* NULL until emitted */
+} CompiledSort;
+
+/* btree comparison functions of types compared inline */
+typedef struct InlineCmp
+{
+	Oid			cmpproc;
+	int			bits;			/* width of the values */
+	bool		is_signed;
+} InlineCmp;
+
+static const InlineCmp inline_cmps[] = {
+	{F_BTINT2CMP, 16, true},
+	{F_BTINT4CMP, 32, true},
+#ifdef USE_FLOAT8_BYVAL
+	{F_BTINT8CMP, 64, true},
+#endif
+	{F_BTOIDCMP, 32, false},
+	{F_BTCHARCMP, 8, false},
+	{F_BTBOOLCMP, 8, false},
+	{F_DATE_CMP, 32, true},
+#if defined(HAVE_INT64_TIMESTAMP) && defined(USE_FLOAT8_BYVAL)
+	{F_TIMESTAMP_CMP, 64, true},
+#endif
+};
+
+static SortTupleComparator ExecGetCompiledSortComparator(SortState *node);
+static const InlineCmp *find_inline_cmp(Oid sortop, bool *reverse);
+static void sort_emit_key(LLVMBuilderRef b, LLVMValueRef v_state,
+			  Sort *plannode, int keyno,
+			  LLVMValueRef v_datum1, LLVMValueRef v_isnull1p,
+			  LLVMValueRef v_datum2, LLVMValueRef v_isnull2p,
+			  LLVMValueRef v_resultp, LLVMBasicBlockRef b_done);
+
+
+/*
+ * llvm_compile_sort
+ *
+ * Generate a comparator for the sort keys of a Sort node into the context's
+ * current module, and make the node hand it to tuplesort, emitting it on
+ * first use.  Returns false, leaving the node alone, if the node sorts on a
+ * single key.
+ */
+bool
+llvm_compile_sort(LLVMJitContext *context, SortState *sortstate)
+{
+	Sort	   *plannode = (Sort *) sortstate->ss.ps.plan;
+	TupleDesc	desc = ExecGetResultType(outerPlanState(sortstate));
+	LLVMModuleRef mod;
+	LLVMBuilderRef b;
+	LLVMTypeRef i32 = LLVMInt32TypeInContext(llvm_context);
+	LLVMTypeRef param_types[3];
+	LLVMTypeRef functype;
+	LLVMValueRef fn;
+	LLVMValueRef v_a;
+	LLVMValueRef v_b;
+	LLVMValueRef v_state;
+	LLVMValueRef v_resultp;
+	LLVMValueRef v_values[2];
+	LLVMValueRef v_isnull[2];
+	LLVMValueRef v_tuples[2];
+	LLVMBasicBlockRef b_done;
+	CompiledSort *compiled;
+	MemoryContext oldcontext;
+	char	   *funcname;
+	int			natts;
+	int			keyno;
+	int			side;
+
+	if (sortstate->getcomparator != NULL || plannode->numCols < 2)
+		return false;
+
+	/* the further keys are found by extracting the tuples up to the last */
+	natts = 0;
+	for (keyno = 1; keyno < plannode->numCols; keyno++)
+		natts = Max(natts, plannode->sortColIdx[keyno]);
+	Assert(natts <= desc->natts);
+
+	funcname = llvm_expand_funcname(context, "sortcmp");
+	mod = llvm_mutable_module(context);
+	b = LLVMCreateBuilderInContext(llvm_context);
+
+	/* int (*)(const SortTuple *a, const SortTuple *b, Tuplesortstate *) */
+	param_types[0] = TypePtr;
+	param_types[1] = TypePtr;
+	param_types[2] = TypePtr;
+	functype = LLVMFunctionType(i32, param_types, 3, false);
+	fn = LLVMAddFunction(mod, funcname, functype);
+	v_a = LLVMGetParam(fn, 0);
+	v_b = LLVMGetParam(fn, 1);
+	v_state = LLVMGetParam(fn, 2);
+
+	LLVMPositionBuilderAtEnd(b,
+							 LLVMAppendBasicBlockInContext(llvm_context, fn,
+														   "entry"));
+	l_count_call(context, b, false);
+	b_done = LLVMAppendBasicBlockInContext(llvm_context, fn, "done");
+
+	v_resultp = l_entry_alloca(b, i32, "result");
+
+	/* the leading key is kept in the SortTuples */
+	sort_emit_key(b, v_state, plannode, 0,
+				  l_load_member(b, v_a, offsetof(SortTuple, datum1),
+								TypeDatum, "datum1"),
+				  l_member_addr(b, v_a, offsetof(SortTuple, isnull1),
+								TypeStorageBool),
+				  l_load_member(b, v_b, offsetof(SortTuple, datum1),
+								TypeDatum, "datum1"),
+				  l_member_addr(b, v_b, offsetof(SortTuple, isnull1),
+								TypeStorageBool),
+				  v_resultp, b_done);
+
+	/* on a tie, extract the further keys from both MinimalTuples */
+	v_tuples[0] = v_a;
+	v_tuples[1] = v_b;
+	for (side = 0; side < 2; side++)
+	{
+		LLVMValueRef v_mintuple;
+		LLVMValueRef v_idx;
+
+		v_values[side] = l_entry_alloca(b, LLVMArrayType(TypeDatum, natts),
+										"values");
+		v_values[side] = LLVMBuildPointerCast(b, v_values[side],
+											  LLVMPointerType(TypeDatum, 0),
+											  "");
+		v_isnull[side] = l_entry_alloca(b,
+										LLVMArrayType(TypeStorageBool, natts),
+										"isnull");
+		v_isnull[side] = LLVMBuildPointerCast(b, v_isnull[side],
+										LLVMPointerType(TypeStorageBool, 0),
+											  "");
+
+		v_mintuple = l_load_member(b, v_tuples[side],
+								   offsetof(SortTuple, tuple),
+								   TypePtr, "tuple");
+		v_idx = LLVMConstInt(TypeSizeT, -((long) MINIMAL_TUPLE_OFFSET), true);
+		llvm_emit_deform_tuple(b, desc, natts,
+							   LLVMBuildGEP2(b,
+										 LLVMInt8TypeInContext(llvm_context),
+											 v_mintuple, &v_idx, 1, "t_data"),
+							   v_values[side], v_isnull[side]);
+	}
+
+	for (keyno = 1; keyno < plannode->numCols; keyno++)
+	{
+		LLVMValueRef v_idx = l_sizet_const(plannode->sortColIdx[keyno] - 1);
+
+		sort_emit_key(b, v_state, plannode, keyno,
+					  LLVMBuildLoad2(b, TypeDatum,
+									 LLVMBuildGEP2(b, TypeDatum, v_values[0],
+												   &v_idx, 1, ""),
+									 "datum"),
+					  LLVMBuildGEP2(b, TypeStorageBool, v_isnull[0],
+									&v_idx, 1, ""),
+					  LLVMBuildLoad2(b, TypeDatum,
+									 LLVMBuildGEP2(b, TypeDatum, v_values[1],
+												   &v_idx, 1, ""),
+									 "datum"),
+					  LLVMBuildGEP2(b, TypeStorageBool, v_isnull[1],
+									&v_idx, 1, ""),
+					  v_resultp, b_done);
+	}
+
+	/* all keys are equal */
+	LLVMBuildStore(b, l_int32_const(0), v_resultp);
+	LLVMBuildBr(b, b_done);
+
+	LLVMPositionBuilderAtEnd(b, b_done);
+	LLVMBuildRet(b, LLVMBuildLoad2(b, i32, v_resultp, ""));
+
+	LLVMDisposeBuilder(b);
+
+	oldcontext = MemoryContextSwitchTo(context->base.mcxt);
+	compiled = palloc(sizeof(CompiledSort));
+	compiled->context = context;
+	compiled->funcname = funcname;
+	compiled->comparator = NULL;
+	MemoryContextSwitchTo(oldcontext);
+
+	sortstate->getcomparator = ExecGetCompiledSortComparator;
+	sortstate->getcomparator_arg = compiled;
+
+	return true;
+}
+
+/*
+ * Installed as getcomparator of Sort nodes: emit the code on the first call,
+ * and return the comparator.  Called again on every rescan that re-sorts.
+ */
+static SortTupleComparator
+ExecGetCompiledSortComparator(SortState *node)
+{
+	CompiledSort *compiled = (CompiledSort *) node->getcomparator_arg;
+
+	if (compiled->comparator == NULL)
+		compiled->comparator = (SortTupleComparator)
+			llvm_get_function(compiled->context, compiled->funcname);
+
+	return compiled->comparator;
+}
+
+/*
+ * Return how to compare the keys ordered by 'sortop' inline, or NULL if
+ * they have to be compared through their SortSupport.  Sets *reverse if
+ * 'sortop' is a descending ordering operator.
+ */
+static const InlineCmp *
+find_inline_cmp(Oid sortop, bool *reverse)
+{
+	Oid			opfamily;
+	Oid			opcintype;
+	int16		strategy;
+	Oid			cmpproc;
+	int			i;
+
+	/* PrepareSortSupportFromOrderingOp finds the function the same way */
+	if (!get_ordering_op_properties(sortop, &opfamily, &opcintype, &strategy))
+		elog(ERROR, "operator %u is not a valid ordering operator", sortop);
+	*reverse = (strategy == BTGreaterStrategyNumber);
+
+	cmpproc = get_opfamily_proc(opfamily, opcintype, opcintype, BTORDER_PROC);
+	for (i = 0; i < lengthof(inline_cmps); i++)
+	{
+		if (inline_cmps[i].cmpproc == cmpproc)
+			return &inline_cmps[i];
+	}
+
+	return NULL;
+}
+
+/*
+ * Emit the comparison of sort key 'keyno' of two tuples, as
+ * ApplySortComparator() does it.  If the values differ, the result is
+ * stored into 'v_resultp' and control goes to 'b_done'; otherwise code
+ * generation continues in a new block.
+ */
+static void
+sort_emit_key(LLVMBuilderRef b, LLVMValueRef v_state,
+			  Sort *plannode, int keyno,
+			  LLVMValueRef v_datum1, LLVMValueRef v_isnull1p,
+			  LLVMValueRef v_datum2, LLVMValueRef v_isnull2p,
+			  LLVMValueRef v_resultp, LLVMBasicBlockRef b_done)
+{
+	LLVMValueRef fn = LLVMGetBasicBlockParent(LLVMGetInsertBlock(b));
+	LLVMTypeRef i32 = LLVMInt32TypeInContext(llvm_context);
+	bool		nulls_first = plannode->nullsFirst[keyno];
+	const InlineCmp *cmp;
+	bool		reverse;
+	LLVMValueRef v_isnull2;
+	LLVMValueRef v_result;
+	LLVMBasicBlockRef b_null1;
+	LLVMBasicBlockRef b_notnull1;
+	LLVMBasicBlockRef b_null2;
+	LLVMBasicBlockRef b_compare;
+	LLVMBasicBlockRef b_next;
+
+	cmp = find_inline_cmp(plannode->sortOperators[keyno], &reverse);
+
+	b_null1 = LLVMAppendBasicBlockInContext(llvm_context, fn, "key.null1");
+	b_notnull1 = LLVMAppendBasicBlockInContext(llvm_context, fn,
+											   "key.notnull1");
+	b_null2 = LLVMAppendBasicBlockInContext(llvm_context, fn, "key.null2");
+	b_compare = LLVMAppendBasicBlockInContext(llvm_context, fn,
+											  "key.compare");
+	b_next = LLVMAppendBasicBlockInContext(llvm_context, fn, "key.next");
+
+	v_isnull2 = l_isnull(b, v_isnull2p);
+	LLVMBuildCondBr(b, l_isnull(b, v_isnull1p), b_null1, b_notnull1);
+
+	/* NULL sorts equal to NULL, and before or after anything else */
+	LLVMPositionBuilderAtEnd(b, b_null1);
+	LLVMBuildStore(b, l_int32_const(nulls_first ? -1 : 1), v_resultp);
+	LLVMBuildCondBr(b, v_isnull2, b_next, b_done);
+
+	LLVMPositionBuilderAtEnd(b, b_notnull1);
+	LLVMBuildCondBr(b, v_isnull2, b_null2, b_compare);
+
+	LLVMPositionBuilderAtEnd(b, b_null2);
+	LLVMBuildStore(b, l_int32_const(nulls_first ? 1 : -1), v_resultp);
+	LLVMBuildBr(b, b_done);
+
+	LLVMPositionBuilderAtEnd(b, b_compare);
+	if (cmp != NULL)
+	{
+		LLVMTypeRef vtype = LLVMIntTypeInContext(llvm_context, cmp->bits);
+		LLVMValueRef v_left = LLVMBuildTrunc(b, v_datum1, vtype, "");
+		LLVMValueRef v_right = LLVMBuildTrunc(b, v_datum2, vtype, "");
+		LLVMValueRef v_gt;
+		LLVMValueRef v_lt;
+
+		if (reverse)
+		{
+			LLVMValueRef v_tmp = v_left;
+
+			v_left = v_right;
+			v_right = v_tmp;
+		}
+
+		/* (left > right) - (left < right) */
+		v_gt = LLVMBuildICmp(b, cmp->is_signed ? LLVMIntSGT : LLVMIntUGT,
+							 v_left, v_right, "");
+		v_lt = LLVMBuildICmp(b, cmp->is_signed ? LLVMIntSLT : LLVMIntULT,
+							 v_left, v_right, "");
+		v_result = LLVMBuildSub(b,
+								LLVMBuildZExt(b, v_gt, i32, ""),
+								LLVMBuildZExt(b, v_lt, i32, ""),
+								"");
+	}
+	else
+	{
+		LLVMModuleRef mod = LLVMGetGlobalParent(fn);
+		LLVMTypeRef param_types[4];
+		LLVMTypeRef functype;
+		LLVMValueRef v_params[4];
+
+		/* int tuplesort_heap_compare_key(state, keyno, datum1, datum2) */
+		param_types[0] = TypePtr;
+		param_types[1] = i32;
+		param_types[2] = TypeDatum;
+		param_types[3] = TypeDatum;
+		functype = LLVMFunctionType(i32, param_types, 4, false);
+
+		v_params[0] = v_state;
+		v_params[1] = l_int32_const(keyno);
+		v_params[2] = v_datum1;
+		v_params[3] = v_datum2;
+		v_result = LLVMBuildCall2(b, functype,
+								  llvm_get_decl(mod,
+												"tuplesort_heap_compare_key",
+												functype),
+								  v_params, 4, "");
+	}
+	LLVMBuildStore(b, v_result, v_resultp);
+	LLVMBuildCondBr(b,
+					LLVMBuildICmp(b, LLVMIntNE, v_result, l_int32_const(0),
+								  ""),
+					b_done, b_next);
+
+	LLVMPositionBuilderAtEnd(b, b_next);
+}
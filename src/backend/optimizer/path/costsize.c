@@ -76,6 +76,8 @@
 #include "access/htup_details.h"
 #include "executor/executor.h"
 #include "executor/nodeHash.h"
+#include "executor/nodeIncrementalSort.h"
+#include "executor/nodeMemoize.h"
 #include "miscadmin.h"
 #include "nodes/nodeFuncs.h"
 #include "optimizer/clauses.h"
@@ -86,6 +88,7 @@
 #include "optimizer/plancat.h"
 #include "optimizer/planmain.h"
 #include "optimizer/restrictinfo.h"
+#include "optimizer/var.h"
 #include "parser/parsetree.h"
 #include "utils/lsyscache.h"
 #include "utils/selfuncs.h"
@@ -112,9 +115,11 @@ bool		enable_indexonlyscan = true;
 bool		enable_bitmapscan = true;
 bool		enable_tidscan = true;
 bool		enable_sort = true;
+bool		enable_incrementalsort = true;
 bool		enable_hashagg = true;
 bool		enable_nestloop = true;
 bool		enable_material = true;
+bool		enable_memoize = true;
 bool		enable_mergejoin = true;
 bool		enable_hashjoin = true;
 
@@ -129,6 +134,9 @@ static MergeScanSelCache *cached_scansel(PlannerInfo *root,
 			   PathKey *pathkey);
 static void cost_rescan(PlannerInfo *root, Path *path,
 			Cost *rescan_startup_cost, Cost *rescan_total_cost);
+static void cost_memoize_rescan(PlannerInfo *root, MemoizePath *mpath,
+					Cost *rescan_startup_cost, Cost *rescan_total_cost);
+static bool memoize_keys_have_stats(PlannerInfo *root, List *param_exprs);
 static bool cost_qual_eval_walker(Node *node, cost_qual_eval_context *context);
 static void get_restriction_qual_cost(PlannerInfo *root, RelOptInfo *baserel,
 						  ParamPathInfo *param_info,
@@ -1333,6 +1341,100 @@ cost_sort(Path *path, PlannerInfo *root,
 	path->total_cost = startup_cost + run_cost;
 }
 
+/*
+ * cost_incremental_sort
+ *	  Determines and returns the cost of sorting a relation that is already
+ *	  sorted by the first presorted_keys of the pathkeys, including the cost
+ *	  of reading the input data.
+ *
+ * An Incremental Sort sorts each group of tuples that are equal in the
+ * presorted keys separately, and can return the first group's tuples as
+ * soon as it has read and sorted that group.  So we estimate the number of
+ * groups, and charge a sort of an average group per group; only the first
+ * one, and the share of the input cost needed to read it, is startup cost.
+ * Since groups are rarely of equal size, and the executor doesn't sort less
+ * than INCREMENTAL_SORT_MIN_BATCH tuples at a time, we assume somewhat
+ * bigger groups than the average.  On top of the sorts, every input tuple
+ * has to be compared with the first of its group to find where groups end.
+ *
+ * 'pathkeys' is the list of sort keys, presorted ones included
+ * 'presorted_keys' is the number of leading pathkeys the input is sorted by
+ * 'input_startup_cost' is the startup cost for reading the input data
+ * 'input_total_cost' is the total cost for reading the input data
+ * The other parameters are as for cost_sort.
+ */
+void
+cost_incremental_sort(Path *path, PlannerInfo *root,
+					  List *pathkeys, int presorted_keys,
+					  Cost input_startup_cost, Cost input_total_cost,
+					  double tuples, int width, Cost comparison_cost,
+					  int sort_mem, double limit_tuples)
+{
+	Cost		startup_cost;
+	Cost		run_cost;
+	Cost		input_run_cost = input_total_cost - input_startup_cost;
+	Cost		group_startup_cost;
+	Cost		group_run_cost;
+	double		input_groups;
+	double		group_tuples;
+	List	   *presortedExprs = NIL;
+	ListCell   *l;
+	Path		sort_path;		/* dummy for result of cost_sort */
+
+	Assert(presorted_keys > 0 && presorted_keys < list_length(pathkeys));
+
+	path->rows = tuples;
+
+	/* Mustn't divide by zero below */
+	if (tuples < 2.0)
+		tuples = 2.0;
+
+	/*
+	 * Estimate the number of groups from any member of each presorted key's
+	 * equivalence class; they are all equal.
+	 */
+	foreach(l, pathkeys)
+	{
+		PathKey    *key = (PathKey *) lfirst(l);
+		EquivalenceMember *member = (EquivalenceMember *)
+		linitial(key->pk_eclass->ec_members);
+
+		presortedExprs = lappend(presortedExprs, member->em_expr);
+		if (list_length(presortedExprs) >= presorted_keys)
+			break;
+	}
+	input_groups = estimate_num_groups(root, presortedExprs, tuples);
+
+	group_tuples = Max(tuples / input_groups, INCREMENTAL_SORT_MIN_BATCH);
+	group_tuples = Min(group_tuples * 1.5, tuples);
+	input_groups = tuples / group_tuples;
+
+	/* Cost of sorting one group */
+	cost_sort(&sort_path, root, pathkeys, 0.0, group_tuples, width,
+			  comparison_cost, sort_mem, limit_tuples);
+	group_startup_cost = sort_path.startup_cost;
+	group_run_cost = sort_path.total_cost - sort_path.startup_cost;
+
+	/* The first group has to be read and sorted before we return anything */
+	startup_cost = input_startup_cost + input_run_cost / input_groups +
+		group_startup_cost;
+
+	/* ... and the others as we go */
+	run_cost = group_run_cost +
+		(group_startup_cost + group_run_cost) * (input_groups - 1) +
+		input_run_cost * (input_groups - 1) / input_groups;
+
+	/* Comparing each tuple with its group's first, and per-group overhead */
+	run_cost += (cpu_tuple_cost + presorted_keys * cpu_operator_cost) * tuples;
+	run_cost += 2.0 * cpu_tuple_cost * input_groups;
+
+	if (!enable_incrementalsort)
+		startup_cost += disable_cost;
+
+	path->startup_cost = startup_cost;
+	path->total_cost = startup_cost + run_cost;
+}
+
 /*
  * cost_merge_append
  *	  Determines and returns the cost of a MergeAppend node.
@@ -2877,6 +2979,10 @@ cost_rescan(PlannerInfo *root, Path *path,
 				*rescan_total_cost = run_cost;
 			}
 			break;
+		case T_Memoize:
+			cost_memoize_rescan(root, (MemoizePath *) path,
+								rescan_startup_cost, rescan_total_cost);
+			break;
 		default:
 			*rescan_startup_cost = path->startup_cost;
 			*rescan_total_cost = path->total_cost;
@@ -2884,6 +2990,112 @@ cost_rescan(PlannerInfo *root, Path *path,
 	}
 }
 
+/*
+ * cost_memoize_rescan
+ *	  Estimate the average cost of a rescan of a Memoize path.
+ *
+ * A rescan whose parameter values are found in the cache costs next to
+ * nothing; one that isn't runs the subpath.  So we estimate the fraction of
+ * the rescans that will hit the cache from the number of distinct parameter
+ * values among the calls and from how many entries fit in work_mem.  Each
+ * distinct value misses the first time it's seen, and if not all of them
+ * fit, a value's entry has been evicted again by the time it comes back in
+ * a proportionate share of the calls.  We also charge for putting tuples in
+ * the cache and taking them out again.
+ *
+ * As a side effect, the expected number of cache entries is stored into
+ * mpath->est_entries, for sizing the executor's hash table.
+ */
+static void
+cost_memoize_rescan(PlannerInfo *root, MemoizePath *mpath,
+					Cost *rescan_startup_cost, Cost *rescan_total_cost)
+{
+	Cost		input_startup_cost = mpath->subpath->startup_cost;
+	Cost		input_total_cost = mpath->subpath->total_cost;
+	double		tuples = mpath->subpath->rows;
+	double		calls = mpath->calls;
+	int			width = mpath->subpath->parent->width;
+	double		est_entry_bytes;
+	double		est_cache_entries;
+	double		ndistinct;
+	double		hit_ratio;
+	double		evict_ratio;
+	Cost		startup_cost;
+	Cost		total_cost;
+
+	/* How many entries of the expected size fit in work_mem? */
+	est_entry_bytes = relation_byte_size(tuples, width) +
+		ExecEstimateCacheEntryOverheadBytes(tuples);
+	est_cache_entries = floor(work_mem * 1024.0 / est_entry_bytes);
+
+	/*
+	 * How many distinct sets of parameter values will we be called with?
+	 * Unless we have statistics to tell, assume they're all different rather
+	 * than count on cache hits that may never happen.
+	 */
+	if (memoize_keys_have_stats(root, mpath->param_exprs))
+		ndistinct = estimate_num_groups(root, mpath->param_exprs, calls);
+	else
+		ndistinct = calls;
+	ndistinct = clamp_row_est(Min(ndistinct, calls));
+
+	mpath->est_entries = (uint32) Min(ndistinct, est_cache_entries);
+
+	hit_ratio = (calls - ndistinct) / calls *
+		Min(est_cache_entries / ndistinct, 1.0);
+	evict_ratio = 1.0 - Min(est_cache_entries / ndistinct, 1.0);
+
+	/* Misses run the subpath; every call pays for a lookup */
+	startup_cost = input_startup_cost * (1.0 - hit_ratio) + cpu_tuple_cost;
+	total_cost = input_total_cost * (1.0 - hit_ratio) + cpu_tuple_cost;
+
+	/* Misses store their tuples in the cache, and may evict an entry */
+	total_cost += (1.0 - hit_ratio) * cpu_operator_cost * tuples;
+	total_cost += evict_ratio * (cpu_tuple_cost +
+								 0.1 * cpu_operator_cost * tuples);
+
+	/* Hits return the cached tuples */
+	total_cost += hit_ratio * cpu_operator_cost * tuples;
+
+	*rescan_startup_cost = startup_cost;
+	*rescan_total_cost = total_cost;
+}
+
+/*
+ * memoize_keys_have_stats
+ *	  Are there statistics for all the Vars in a Memoize node's cache keys?
+ *
+ * Without them, estimate_num_groups guesses from the size of the Vars'
+ * relations, which says nothing about how often the keys repeat; a VALUES
+ * list or a small, unanalyzed table would make the cache look far better
+ * than it is.
+ */
+static bool
+memoize_keys_have_stats(PlannerInfo *root, List *param_exprs)
+{
+	List	   *vars;
+	ListCell   *lc;
+	bool		result = true;
+
+	vars = pull_var_clause((Node *) param_exprs,
+						   PVC_RECURSE_AGGREGATES,
+						   PVC_INCLUDE_PLACEHOLDERS);
+	foreach(lc, vars)
+	{
+		VariableStatData vardata;
+
+		examine_variable(root, (Node *) lfirst(lc), 0, &vardata);
+		if (!HeapTupleIsValid(vardata.statsTuple) && !vardata.isunique)
+			result = false;
+		ReleaseVariableStats(vardata);
+		if (!result)
+			break;
+	}
+	list_free(vars);
+
+	return result;
+}
+
 
 /*
  * cost_qual_eval
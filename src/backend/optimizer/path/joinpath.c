@@ -17,9 +17,13 @@
 #include <math.h>
 
 #include "executor/executor.h"
+#include "nodes/nodeFuncs.h"
+#include "optimizer/clauses.h"
 #include "optimizer/cost.h"
 #include "optimizer/pathnode.h"
 #include "optimizer/paths.h"
+#include "utils/lsyscache.h"
+#include "utils/typcache.h"
 
 
 #define PATH_PARAM_BY_REL(path, rel)  \
@@ -219,6 +223,102 @@ add_paths_to_joinrel(PlannerInfo *root,
 							 sjinfo, &semifactors, param_source_rels);
 }
 
+/*
+ * get_memoize_path
+ *	  If it's sensible and safe to put a Memoize node over 'inner_path', the
+ *	  inner side of a nestloop with 'outer_path', return a MemoizePath for
+ *	  that; else NULL.
+ *
+ * The cache keys are the outer sides of the join clauses the inner path is
+ * parameterized with, so the inner path must get its parameters from the
+ * outer side by way of such clauses and nothing else, and must give the
+ * same results whenever they're equal.  We only do this for scans of plain
+ * tables without lateral references, whose ppi_clauses hold all the
+ * clauses in question.
+ *
+ * Only inner and left joins are considered: the nestloop stops scanning the
+ * inner side after the first match for semi and anti joins, and an entry is
+ * only used again if its scan ran to completion.
+ */
+static Path *
+get_memoize_path(PlannerInfo *root, RelOptInfo *innerrel,
+				 RelOptInfo *outerrel, Path *inner_path,
+				 Path *outer_path, JoinType jointype)
+{
+	List	   *param_exprs = NIL;
+	List	   *hash_operators = NIL;
+	ListCell   *lc;
+
+	if (!enable_memoize)
+		return NULL;
+
+	if (jointype != JOIN_INNER && jointype != JOIN_LEFT)
+		return NULL;
+
+	/* No point unless the inner side gets rescanned */
+	if (outer_path->rows < 2)
+		return NULL;
+
+	if (inner_path->param_info == NULL ||
+		!PATH_PARAM_BY_REL(inner_path, outerrel))
+		return NULL;
+
+	if (innerrel->reloptkind != RELOPT_BASEREL ||
+		innerrel->rtekind != RTE_RELATION ||
+		innerrel->lateral_relids != NULL)
+		return NULL;
+
+	/* Volatile quals might give different results for the same keys */
+	foreach(lc, innerrel->baserestrictinfo)
+	{
+		RestrictInfo *rinfo = (RestrictInfo *) lfirst(lc);
+
+		if (contain_volatile_functions((Node *) rinfo->clause))
+			return NULL;
+	}
+
+	foreach(lc, inner_path->param_info->ppi_clauses)
+	{
+		RestrictInfo *rinfo = (RestrictInfo *) lfirst(lc);
+		Node	   *outer_expr;
+		Oid			keytype;
+		TypeCacheEntry *typentry;
+
+		if (!is_opclause(rinfo->clause) ||
+			list_length(((OpExpr *) rinfo->clause)->args) != 2 ||
+			contain_volatile_functions((Node *) rinfo->clause))
+			return NULL;
+
+		/* Which side of the clause comes from the outer relations? */
+		if (!bms_overlap(rinfo->left_relids, innerrel->relids) &&
+			bms_is_subset(rinfo->right_relids, innerrel->relids))
+			outer_expr = get_leftop(rinfo->clause);
+		else if (!bms_overlap(rinfo->right_relids, innerrel->relids) &&
+				 bms_is_subset(rinfo->left_relids, innerrel->relids))
+			outer_expr = get_rightop(rinfo->clause);
+		else
+			return NULL;
+
+		/* The cache must be able to hash and compare the key */
+		keytype = exprType(outer_expr);
+		typentry = lookup_type_cache(keytype, TYPECACHE_EQ_OPR);
+		if (!OidIsValid(typentry->eq_opr) ||
+			!op_hashjoinable(typentry->eq_opr, keytype))
+			return NULL;
+
+		if (list_member(param_exprs, outer_expr))
+			continue;
+		param_exprs = lappend(param_exprs, outer_expr);
+		hash_operators = lappend_oid(hash_operators, typentry->eq_opr);
+	}
+
+	if (param_exprs == NIL)
+		return NULL;
+
+	return (Path *) create_memoize_path(innerrel, inner_path, param_exprs,
+										hash_operators, outer_path->rows);
+}
+
 /*
  * try_nestloop_path
  *	  Consider a nestloop join path; if it appears useful, push it into
@@ -827,6 +927,7 @@ match_unsorted_outer(PlannerInfo *root,
 			foreach(lc2, innerrel->cheapest_parameterized_paths)
 			{
 				Path	   *innerpath = (Path *) lfirst(lc2);
+				Path	   *mpath;
 
 				try_nestloop_path(root,
 								  joinrel,
@@ -838,6 +939,21 @@ match_unsorted_outer(PlannerInfo *root,
 								  innerpath,
 								  restrictlist,
 								  merge_pathkeys);
+
+				/* Also consider caching the inner path's results */
+				mpath = get_memoize_path(root, innerrel, outerrel,
+										 innerpath, outerpath, jointype);
+				if (mpath != NULL)
+					try_nestloop_path(root,
+									  joinrel,
+									  jointype,
+									  sjinfo,
+									  semifactors,
+									  param_source_rels,
+									  outerpath,
+									  mpath,
+									  restrictlist,
+									  merge_pathkeys);
 			}
 
 			/* Also consider materialized form of the cheapest inner path */
@@ -407,6 +407,31 @@ pathkeys_contained_in(List *keys1, List *keys2)
 	return false;
 }
 
+/*
+ * pathkeys_common
+ *	  Returns the number of leading pathkeys keys1 and keys2 have in common.
+ *
+ * A path sorted by keys2 is then sorted by that many of keys1, which is
+ * enough for an Incremental Sort to finish sorting it by keys1.
+ */
+int
+pathkeys_common(List *keys1, List *keys2)
+{
+	int			n = 0;
+	ListCell   *key1,
+			   *key2;
+
+	/* as in compare_pathkeys, canonical pathkeys can be compared by pointer */
+	forboth(key1, keys1, key2, keys2)
+	{
+		if (lfirst(key1) != lfirst(key2))
+			break;
+		n++;
+	}
+
+	return n;
+}
+
 /*
  * get_cheapest_path_for_pathkeys
  *	  Find the cheapest path (according to the specified criterion) that
@@ -1470,9 +1495,10 @@ right_merge_direction(PlannerInfo *root, PathKey *pathkey)
  *		Count the number of pathkeys that are useful for meeting the
  *		query's requested output ordering.
  *
- * Unlike merge pathkeys, this is an all-or-nothing affair: it does us
- * no good to order by just the first key(s) of the requested ordering.
- * So the result is always either 0 or list_length(root->query_pathkeys).
+ * Ordering by just the first key(s) of the requested ordering is of use
+ * too, if query_planner has decided that an Incremental Sort may finish the
+ * job; otherwise the result is always either 0 or
+ * list_length(root->query_pathkeys).
  */
 static int
 pathkeys_useful_for_ordering(PlannerInfo *root, List *pathkeys)
@@ -1489,6 +1515,9 @@ pathkeys_useful_for_ordering(PlannerInfo *root, List *pathkeys)
 		return list_length(root->query_pathkeys);
 	}
 
+	if (root->incremental_sort)
+		return pathkeys_common(root->query_pathkeys, pathkeys);
+
 	return 0;					/* path ordering not useful */
 }
 
@@ -53,6 +53,7 @@ static Plan *create_append_plan(PlannerInfo *root, AppendPath *best_path);
 static Plan *create_merge_append_plan(PlannerInfo *root, MergeAppendPath *best_path);
 static Result *create_result_plan(PlannerInfo *root, ResultPath *best_path);
 static Material *create_material_plan(PlannerInfo *root, MaterialPath *best_path);
+static Memoize *create_memoize_plan(PlannerInfo *root, MemoizePath *best_path);
 static Plan *create_unique_plan(PlannerInfo *root, UniquePath *best_path);
 static SeqScan *create_seqscan_plan(PlannerInfo *root, Path *best_path,
 					List *tlist, List *scan_clauses);
@@ -168,6 +169,8 @@ static EquivalenceMember *find_ec_member_for_tle(EquivalenceClass *ec,
 					   TargetEntry *tle,
 					   Relids relids);
 static Material *make_material(Plan *lefttree);
+static Memoize *make_memoize(Plan *lefttree, List *hashoperators,
+			 List *param_exprs, uint32 est_entries);
 
 
 /*
@@ -259,6 +262,10 @@ create_plan_recurse(PlannerInfo *root, Path *best_path)
 			plan = (Plan *) create_material_plan(root,
 												 (MaterialPath *) best_path);
 			break;
+		case T_Memoize:
+			plan = (Plan *) create_memoize_plan(root,
+												(MemoizePath *) best_path);
+			break;
 		case T_Unique:
 			plan = create_unique_plan(root,
 									  (UniquePath *) best_path);
@@ -864,6 +871,40 @@ create_material_plan(PlannerInfo *root, MaterialPath *best_path)
 	return plan;
 }
 
+/*
+ * create_memoize_plan
+ *	  Create a Memoize plan for 'best_path' and (recursively) plans
+ *	  for its subpaths.
+ *
+ *	  Returns a Plan node.
+ */
+static Memoize *
+create_memoize_plan(PlannerInfo *root, MemoizePath *best_path)
+{
+	Memoize    *plan;
+	Plan	   *subplan;
+	List	   *param_exprs;
+
+	subplan = create_plan_recurse(root, best_path->subpath);
+
+	/* We don't want any excess columns in the cached tuples */
+	disuse_physical_tlist(subplan, best_path->subpath);
+
+	/*
+	 * The cache keys are expressions of the outer relations; make them use
+	 * the nestloop parameters the subplan was given for their Vars.
+	 */
+	param_exprs = (List *) replace_nestloop_params(root,
+										(Node *) best_path->param_exprs);
+
+	plan = make_memoize(subplan, best_path->hash_operators, param_exprs,
+						best_path->est_entries);
+
+	copy_path_costsize(&plan->plan, (Path *) best_path);
+
+	return plan;
+}
+
 /*
  * create_unique_plan
  *	  Create a Unique plan for 'best_path' and (recursively) plans
@@ -4098,6 +4139,80 @@ make_sort_from_pathkeys(PlannerInfo *root, Plan *lefttree, List *pathkeys,
 					 nullsFirst, limit_tuples);
 }
 
+/*
+ * make_incrementalsort_from_pathkeys
+ *	  Create an incremental sort plan to sort according to given pathkeys,
+ *	  when the input is already sorted by the first presortedKeys of them
+ *
+ *	  'lefttree' is the node which yields input tuples
+ *	  'pathkeys' is the list of pathkeys by which the result is to be sorted
+ *	  'presortedKeys' is the number of leading pathkeys lefttree is sorted by
+ *	  'limit_tuples' is the bound on the number of output tuples;
+ *				-1 if no bound
+ *
+ * Returns a plain Sort if the pathkeys don't map one-to-one to sort columns,
+ * so that we can't tell which columns the presorted ones are.
+ */
+Plan *
+make_incrementalsort_from_pathkeys(PlannerInfo *root, Plan *lefttree,
+								   List *pathkeys, int presortedKeys,
+								   double limit_tuples)
+{
+	IncrementalSort *node;
+	Plan	   *plan;
+	Path		sort_path;		/* dummy for result of cost_incremental_sort */
+	int			numsortkeys;
+	AttrNumber *sortColIdx;
+	Oid		   *sortOperators;
+	Oid		   *collations;
+	bool	   *nullsFirst;
+
+	Assert(presortedKeys > 0 && presortedKeys < list_length(pathkeys));
+
+	/* Compute sort column info, and adjust lefttree as needed */
+	lefttree = prepare_sort_from_pathkeys(root, lefttree, pathkeys,
+										  NULL,
+										  NULL,
+										  false,
+										  &numsortkeys,
+										  &sortColIdx,
+										  &sortOperators,
+										  &collations,
+										  &nullsFirst);
+
+	if (numsortkeys != list_length(pathkeys))
+		return (Plan *) make_sort(root, lefttree, numsortkeys,
+								  sortColIdx, sortOperators, collations,
+								  nullsFirst, limit_tuples);
+
+	node = makeNode(IncrementalSort);
+	plan = &node->sort.plan;
+
+	copy_plan_costsize(plan, lefttree); /* only care about copying size */
+	cost_incremental_sort(&sort_path, root, pathkeys, presortedKeys,
+						  lefttree->startup_cost,
+						  lefttree->total_cost,
+						  lefttree->plan_rows,
+						  lefttree->plan_width,
+						  0.0,
+						  work_mem,
+						  limit_tuples);
+	plan->startup_cost = sort_path.startup_cost;
+	plan->total_cost = sort_path.total_cost;
+	plan->targetlist = lefttree->targetlist;
+	plan->qual = NIL;
+	plan->lefttree = lefttree;
+	plan->righttree = NULL;
+	node->sort.numCols = numsortkeys;
+	node->sort.sortColIdx = sortColIdx;
+	node->sort.sortOperators = sortOperators;
+	node->sort.collations = collations;
+	node->sort.nullsFirst = nullsFirst;
+	node->presortedCols = presortedKeys;
+
+	return plan;
+}
+
 /*
  * make_sort_from_sortclauses
  *	  Create sort plan to sort according to given sortclauses
@@ -4208,6 +4323,33 @@ make_material(Plan *lefttree)
 	return node;
 }
 
+static Memoize *
+make_memoize(Plan *lefttree, List *hashoperators, List *param_exprs,
+			 uint32 est_entries)
+{
+	Memoize    *node = makeNode(Memoize);
+	Plan	   *plan = &node->plan;
+	ListCell   *lc;
+	int			i;
+
+	/* cost should be inserted by caller */
+	plan->targetlist = lefttree->targetlist;
+	plan->qual = NIL;
+	plan->lefttree = lefttree;
+	plan->righttree = NULL;
+
+	node->numKeys = list_length(param_exprs);
+	node->hashOperators = (Oid *) palloc(node->numKeys * sizeof(Oid));
+	i = 0;
+	foreach(lc, hashoperators)
+		node->hashOperators[i++] = lfirst_oid(lc);
+	node->param_exprs = param_exprs;
+	node->est_entries = est_entries;
+	node->keyparamids = pull_paramids((Expr *) param_exprs);
+
+	return node;
+}
+
 /*
  * materialize_finished_plan: stick a Material node atop a completed plan
  *
@@ -4815,7 +4957,9 @@ is_projection_capable_plan(Plan *plan)
 	{
 		case T_Hash:
 		case T_Material:
+		case T_Memoize:
 		case T_Sort:
+		case T_IncrementalSort:
 		case T_Unique:
 		case T_SetOp:
 		case T_LockRows:
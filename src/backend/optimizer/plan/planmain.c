@@ -59,7 +59,9 @@ static void canonicalize_all_pathkeys(PlannerInfo *root);
  * Output parameters:
  * *cheapest_path receives the overall-cheapest path for the query
  * *sorted_path receives the cheapest presorted path for the query,
- *				if any (NULL if there is no useful presorted path)
+ *				if any (NULL if there is no useful presorted path); for a
+ *				plain ORDER BY query, this may be a path sorted by just a
+ *				leading part of query_pathkeys, see below
  * *num_groups receives the estimated number of groups, or 1 if query
  *				does not use grouping
  *
@@ -123,6 +125,7 @@ query_planner(PlannerInfo *root, List *tlist,
 		 */
 		root->canon_pathkeys = NIL;
 		canonicalize_all_pathkeys(root);
+		root->incremental_sort = false;
 		return;
 	}
 
@@ -210,6 +213,22 @@ query_planner(PlannerInfo *root, List *tlist,
 	 */
 	canonicalize_all_pathkeys(root);
 
+	/*
+	 * If the query's rows go straight to the ORDER BY sort, a path sorted by
+	 * a leading part of the ORDER BY keys is of use too: grouping_planner
+	 * will finish sorting it with an Incremental Sort, which can return the
+	 * first rows long before a full sort could.  Decide that now, so that
+	 * such paths are only kept (see pathkeys_useful_for_ordering) when they
+	 * can be used; grouping_planner also checks this, since we only cost
+	 * the final sort that way here.
+	 */
+	root->incremental_sort = (enable_incrementalsort &&
+							  list_length(root->query_pathkeys) > 1 &&
+							  parse->sortClause && !parse->groupClause &&
+							  !parse->hasAggs && !root->hasHavingQual &&
+							  !parse->hasWindowFuncs &&
+							  !parse->distinctClause);
+
 	/*
 	 * Examine any "placeholder" expressions generated during subquery pullup.
 	 * Make sure that the Vars they need are marked as needed at the relevant
@@ -397,10 +416,13 @@ query_planner(PlannerInfo *root, List *tlist,
 	 * cheapest-total path.  Here we need consider only the behavior at the
 	 * tuple fraction point.
 	 */
-	if (sortedpath)
+	if (sortedpath || root->incremental_sort)
 	{
 		Path		sort_path;	/* dummy for result of cost_sort */
+		int			presorted_keys;
 
+		presorted_keys = pathkeys_common(root->query_pathkeys,
+										 cheapestpath->pathkeys);
 		if (root->query_pathkeys == NIL ||
 			pathkeys_contained_in(root->query_pathkeys,
 								  cheapestpath->pathkeys))
@@ -409,6 +431,16 @@ query_planner(PlannerInfo *root, List *tlist,
 			sort_path.startup_cost = cheapestpath->startup_cost;
 			sort_path.total_cost = cheapestpath->total_cost;
 		}
+		else if (root->incremental_sort && presorted_keys > 0)
+		{
+			/* Figure cost for finishing the sort of the cheapest path */
+			cost_incremental_sort(&sort_path, root, root->query_pathkeys,
+								  presorted_keys,
+								  cheapestpath->startup_cost,
+								  cheapestpath->total_cost,
+								  final_rel->rows, final_rel->width,
+								  0.0, work_mem, limit_tuples);
+		}
 		else
 		{
 			/* Figure cost for sorting */
@@ -418,12 +450,53 @@ query_planner(PlannerInfo *root, List *tlist,
 					  0.0, work_mem, limit_tuples);
 		}
 
-		if (compare_fractional_path_costs(sortedpath, &sort_path,
+		if (sortedpath &&
+			compare_fractional_path_costs(sortedpath, &sort_path,
 										  tuple_fraction) > 0)
 		{
 			/* Presorted path is a loser */
 			sortedpath = NULL;
 		}
+
+		/*
+		 * See if a partially sorted path plus an Incremental Sort beats both
+		 * the presorted path and sorting the cheapest one.
+		 */
+		if (root->incremental_sort)
+		{
+			Path	   *best = sortedpath ? sortedpath : &sort_path;
+			Path		incsort_path;
+			Path		best_incsort_path;
+			ListCell   *l;
+
+			foreach(l, final_rel->pathlist)
+			{
+				Path	   *path = (Path *) lfirst(l);
+
+				/* the cheapest path has been considered above */
+				if (path == cheapestpath)
+					continue;
+
+				presorted_keys = pathkeys_common(root->query_pathkeys,
+												 path->pathkeys);
+				if (presorted_keys == 0 ||
+					presorted_keys == list_length(root->query_pathkeys))
+					continue;
+
+				cost_incremental_sort(&incsort_path, root,
+									  root->query_pathkeys, presorted_keys,
+									  path->startup_cost, path->total_cost,
+									  final_rel->rows, final_rel->width,
+									  0.0, work_mem, limit_tuples);
+				if (compare_fractional_path_costs(&incsort_path, best,
+												  tuple_fraction) < 0)
+				{
+					best_incsort_path = incsort_path;
+					best = &best_incsort_path;
+					sortedpath = path;
+				}
+			}
+		}
 	}
 
 	*cheapest_path = cheapestpath;
@@ -235,6 +235,7 @@ standard_planner(Query *parse, int cursorOptions, ParamListInfo boundParams)
 	result->hasModifyingCTE = parse->hasModifyingCTE;
 	result->canSetTag = parse->canSetTag;
 	result->transientPlan = glob->transientPlan;
+	result->jitCodeCacheable = false;	/* plancache.c may set this */
 	result->planTree = top_plan;
 	result->rtable = glob->finalrtable;
 	result->resultRelations = glob->resultRelations;
@@ -1796,10 +1797,27 @@ grouping_planner(PlannerInfo *root, double tuple_fraction)
 	{
 		if (!pathkeys_contained_in(root->sort_pathkeys, current_pathkeys))
 		{
-			result_plan = (Plan *) make_sort_from_pathkeys(root,
-														   result_plan,
+			int			presorted_keys;
+
+			/*
+			 * If the plan is sorted by a leading part of the ORDER BY, an
+			 * Incremental Sort can do the rest.  Only use one if
+			 * query_planner costed the sort that way, though; it didn't
+			 * for the sort that follows grouping or window functions.
+			 */
+			presorted_keys = pathkeys_common(root->sort_pathkeys,
+											 current_pathkeys);
+			if (presorted_keys > 0 && root->incremental_sort)
+				result_plan = make_incrementalsort_from_pathkeys(root,
+																 result_plan,
+														 root->sort_pathkeys,
+															 presorted_keys,
+															   limit_tuples);
+			else
+				result_plan = (Plan *) make_sort_from_pathkeys(root,
+															   result_plan,
 														 root->sort_pathkeys,
-														   limit_tuples);
+															   limit_tuples);
 			current_pathkeys = root->sort_pathkeys;
 		}
 	}
@@ -1069,6 +1069,48 @@ create_material_path(RelOptInfo *rel, Path *subpath)
 	return pathnode;
 }
 
+/*
+ * create_memoize_path
+ *	  Creates a path corresponding to a Memoize plan, returning the
+ *	  pathnode.
+ *
+ * 'param_exprs' are the cache keys and 'hash_operators' their equality
+ * operators; 'calls' is the number of times the path is expected to be
+ * rescanned.
+ */
+MemoizePath *
+create_memoize_path(RelOptInfo *rel, Path *subpath, List *param_exprs,
+					List *hash_operators, double calls)
+{
+	MemoizePath *pathnode = makeNode(MemoizePath);
+
+	Assert(subpath->parent == rel);
+
+	pathnode->path.pathtype = T_Memoize;
+	pathnode->path.parent = rel;
+	pathnode->path.param_info = subpath->param_info;
+	pathnode->path.pathkeys = subpath->pathkeys;
+
+	pathnode->subpath = subpath;
+	pathnode->hash_operators = hash_operators;
+	pathnode->param_exprs = param_exprs;
+	pathnode->calls = calls;
+
+	/* cost_memoize_rescan works this out along with the rescan cost */
+	pathnode->est_entries = 0;
+
+	/*
+	 * The first scan misses the cache, so it costs what the subpath costs,
+	 * plus a little for the lookup.  See cost_memoize_rescan for the cost
+	 * of later scans.
+	 */
+	pathnode->path.rows = subpath->rows;
+	pathnode->path.startup_cost = subpath->startup_cost + cpu_tuple_cost;
+	pathnode->path.total_cost = subpath->total_cost + cpu_tuple_cost;
+
+	return pathnode;
+}
+
 /*
  * create_unique_path
  *	  Creates a path representing elimination of distinct rows from the
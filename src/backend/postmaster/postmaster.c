@@ -95,6 +95,7 @@
 #include "access/xlog.h"
 #include "bootstrap/bootstrap.h"
 #include "catalog/pg_control.h"
+#include "jit/jit.h"
 #include "lib/ilist.h"
 #include "libpq/auth.h"
 #include "libpq/ip.h"
@@ -107,6 +108,7 @@
 #include "postmaster/fork_process.h"
 #include "postmaster/pgarch.h"
 #include "postmaster/postmaster.h"
+#include "postmaster/scanworker.h"
 #include "postmaster/syslogger.h"
 #include "replication/walsender.h"
 #include "storage/fd.h"
@@ -425,6 +427,7 @@ static bool SignalUnconnectedWorkers(int signal);
 static int	CountChildren(int target);
 static int	CountUnconnectedWorkers(void);
 static void StartOneBackgroundWorker(void);
+static void RegisterBuiltinBackgroundWorkers(void);
 static bool CreateOptsFile(int argc, char *argv[], char *fullprogname);
 static pid_t StartChildProcess(AuxProcType type);
 static void StartAutovacuumWorker(void);
@@ -893,8 +896,10 @@ PostmasterMain(int argc, char *argv[])
 #endif
 
 	/*
-	 * process any libraries that should be preloaded at postmaster start
+	 * register the built-in background workers, then process any libraries
+	 * that should be preloaded at postmaster start
 	 */
+	RegisterBuiltinBackgroundWorkers();
 	process_shared_preload_libraries();
 
 	/*
@@ -1224,6 +1229,12 @@ PostmasterMain(int argc, char *argv[])
 	 */
 	RemovePgTempFiles();
 
+	/*
+	 * Likewise for the JIT code cache, whose code may refer to addresses
+	 * that are only valid in children of the old postmaster.
+	 */
+	RemoveJitCodeCache();
+
 	/*
 	 * Remember postmaster startup time
 	 */
@@ -4431,8 +4442,10 @@ SubPostmasterMain(int argc, char *argv[])
 	 * Reload any libraries that were preloaded by the postmaster.	Since we
 	 * exec'd this process, those libraries didn't come along with us; but we
 	 * should load them into all child processes to be consistent with the
-	 * non-EXEC_BACKEND behavior.
+	 * non-EXEC_BACKEND behavior.  The built-in background workers must be
+	 * registered in the same order as in the postmaster.
 	 */
+	RegisterBuiltinBackgroundWorkers();
 	process_shared_preload_libraries();
 
 	/* Run backend or appropriate child */
@@ -5257,6 +5270,22 @@ RegisterBackgroundWorker(BackgroundWorker *worker)
 	slist_push_head(&BackgroundWorkerList, &rw->rw_lnode);
 }
 
+/*
+ * Register the background workers that are part of the server itself.
+ *
+ * They go through the same machinery as the workers of loadable modules, so
+ * this is done as if it happened while loading shared_preload_libraries.
+ */
+static void
+RegisterBuiltinBackgroundWorkers(void)
+{
+	process_shared_preload_libraries_in_progress = true;
+
+	ScanWorkerRegister();
+
+	process_shared_preload_libraries_in_progress = false;
+}
+
 /*
  * Connect background worker to a database.
  */
@@ -0,0 +1,1353 @@
+/*-------------------------------------------------------------------------
+ *
+ * scanworker.c
+ *	  Background workers that help a backend with a sequential scan.
+ *
+ * A pool of parallel_scan_workers scan workers is registered as background
+ * workers at postmaster start.  An idle worker sleeps on its latch until a
+ * backend (the "leader") that is about to scan a large relation hands it a
+ * task: the relation, the leader's snapshot and the scan quals.  All workers
+ * of a task, and the leader itself, take chunks of pages from a shared page
+ * counter (see heap_beginscan_parallel), so every page is read by exactly one
+ * of them.  The workers check the quals and pass the qualifying tuples to the
+ * leader through a tuple queue; the leader runs the rest of the plan.
+ *
+ * If the leader aggregates the scan's tuples right away, the task may also
+ * include the aggregates.  The workers then advance their own transition
+ * values over their qualifying tuples, and just send one tuple holding those
+ * at the end, which the leader combines into its own (see nodeAgg.c).
+ *
+ * Likewise, if the leader builds a hash join table over the scan's tuples,
+ * the workers may insert their tuples into it themselves.  The table is then
+ * kept in the hash arena, a piece of shared memory of parallel_hash_mem
+ * kilobytes that one leader at a time can use (see nodeHash.c).  Should the
+ * table fill up, the workers send the rest of their tuples to the leader
+ * after all.
+ *
+ * Each worker has a slot in shared memory, consisting of its state, a tuple
+ * queue, and room for the description of a task.  The task of a scan is kept
+ * in the slot of the first worker the leader picked.
+ *
+ * The tuple queue is a ring buffer with a single writer (the worker) and a
+ * single reader (the leader).  The tuple data is copied in and out without
+ * holding any lock; only the read and write positions are exchanged under
+ * the slot's spinlock, and both sides do that in batches rather than per
+ * tuple.  A side that can't make progress sets a flag asking the other one to
+ * set its latch, and goes to sleep.
+ *
+ * A worker connects to the database of the first task it gets, and can only
+ * serve leaders in that database afterwards.  A worker that has been idle for
+ * a while exits, so that the postmaster restarts it unconnected.
+ *
+ * Since the workers see the leader's snapshot but not its transaction, a scan
+ * is only handed to workers if the leader hasn't modified anything yet, and
+ * the quals and aggregate arguments must be safe to evaluate in another
+ * process: no parameters, no subplans, and nothing but immutable functions.
+ *
+ *
+ * Portions Copyright (c) 1996-2013, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ * IDENTIFICATION
+ *	  src/backend/postmaster/scanworker.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "access/relscan.h"
+#include "access/xact.h"
+#include "commands/dbcommands.h"
+#include "executor/executor.h"
+#include "executor/hashjoin.h"
+#include "executor/nodeAgg.h"
+#include "executor/nodeHash.h"
+#include "miscadmin.h"
+#include "nodes/nodeFuncs.h"
+#include "optimizer/clauses.h"
+#include "postmaster/bgworker.h"
+#include "postmaster/scanworker.h"
+#include "storage/ipc.h"
+#include "storage/latch.h"
+#include "storage/lmgr.h"
+#include "storage/proc.h"
+#include "storage/shmem.h"
+#include "storage/spin.h"
+#include "tcop/tcopprot.h"
+#include "utils/guc.h"
+#include "utils/memutils.h"
+#include "utils/snapmgr.h"
+#include "utils/tqual.h"
+
+
+/* GUC variables */
+int			parallel_scan_workers = 0;
+int			parallel_scan_degree = 4;
+int			parallel_hash_mem = 65536;
+
+/* size of a worker's tuple queue; must hold the largest heap tuple */
+#define SCANWORKER_QUEUE_SIZE		Max(65536, 4 * BLCKSZ)
+
+/* workers make their tuples visible to the leader this many bytes at a time */
+#define SCANWORKER_PUBLISH_SIZE		(SCANWORKER_QUEUE_SIZE / 8)
+
+/* the leader gives queue space back to a worker this many bytes at a time */
+#define SCANWORKER_RELEASE_SIZE		(SCANWORKER_QUEUE_SIZE / 4)
+
+/* limits on the size of a task */
+#define SCANWORKER_MAX_XIDS			1024
+#define SCANWORKER_MAX_QUALS		8192
+#define SCANWORKER_MAX_AGGS			8192
+#define SCANWORKER_MAX_HASH			8192
+
+/* idle workers exit after this many milliseconds */
+#define SCANWORKER_IDLE_TIMEOUT		60000
+
+/* seconds before restarting a worker that exited with an error */
+#define SCANWORKER_RESTART_TIME		10
+
+/*
+ * Description of a scan.  It's set up by the leader before the workers are
+ * told about it, and read-only afterwards, except for the page counter.
+ */
+typedef struct ScanWorkerTask
+{
+	Oid			dboid;			/* database of the leader */
+	char		dbname[NAMEDATALEN];
+	Oid			relid;			/* relation to scan */
+	ParallelHeapScanDescData pscan;		/* shared page counter */
+
+	/* the leader's snapshot; the xids array holds xip, then subxip */
+	TransactionId xmin;
+	TransactionId xmax;
+	uint32		xcnt;
+	int32		subxcnt;
+	bool		suboverflowed;
+	bool		takenDuringRecovery;
+	CommandId	curcid;
+	TransactionId xids[SCANWORKER_MAX_XIDS];
+
+	/* scan quals, in nodeToString() format, or empty */
+	char		quals[SCANWORKER_MAX_QUALS];
+
+	/* list of Aggrefs to compute, in nodeToString() format, or empty */
+	char		aggs[SCANWORKER_MAX_AGGS];
+
+	/*
+	 * targetlist and hash keys of the hash table in the hash arena to insert
+	 * the tuples into, as a two-element list in nodeToString() format, or
+	 * empty
+	 */
+	char		hash[SCANWORKER_MAX_HASH];
+} ScanWorkerTask;
+
+typedef struct ScanWorkerSlot
+{
+	slock_t		mutex;			/* protects the fields below */
+	PGPROC	   *proc;			/* the worker, NULL if it's not running */
+	Oid			dboid;			/* database it's connected to, if any */
+	PGPROC	   *leader;			/* backend using the worker, or NULL */
+	int			task;			/* slot holding the task to run */
+	bool		busy;			/* worker has a task to run */
+	bool		done;			/* worker has finished the task */
+	bool		stop;			/* leader asks to abandon the task */
+	bool		leader_waiting; /* leader waits for tuples */
+	bool		worker_waiting; /* worker waits for queue space */
+	uint64		head;			/* bytes written to the queue */
+	uint64		tail;			/* bytes read from the queue */
+	double		nfiltered;		/* tuples removed by quals */
+	int			sqlerrcode;		/* error the task failed with, or 0 */
+	char		message[256];
+
+	ScanWorkerTask taskdata;	/* used if this is the first worker */
+} ScanWorkerSlot;
+
+typedef struct ScanWorkerShmemStruct
+{
+	slock_t		arena_mutex;	/* protects arena_owner */
+	PGPROC	   *arena_owner;	/* backend using the hash arena, or NULL */
+	int			nslots;
+	ScanWorkerSlot slots[1];	/* VARIABLE LENGTH ARRAY */
+} ScanWorkerShmemStruct;
+
+/*
+ * Tuples are stored in the queue with this header in front, both MAXALIGN'd.
+ * A zero length marks that the rest of the ring is unused, and the next
+ * tuple is at its start.
+ */
+typedef struct ScanWorkerTupleHeader
+{
+	uint32		t_len;			/* length of tuple */
+	ItemPointerData t_self;		/* its TID */
+} ScanWorkerTupleHeader;
+
+#define SCANWORKER_HDRSZ	MAXALIGN(sizeof(ScanWorkerTupleHeader))
+
+static ScanWorkerShmemStruct *ScanWorkerShmem = NULL;
+static char *ScanWorkerQueues = NULL;
+static char *ScanWorkerHashArena = NULL;
+
+#define SlotQueue(slotno) \
+	(ScanWorkerQueues + (Size) (slotno) * SCANWORKER_QUEUE_SIZE)
+
+/* number of slots this backend is using as a leader */
+static int	scanworkers_nattached = 0;
+
+/* is this backend using the hash arena? */
+static bool scanworkers_arena_held = false;
+
+/* state of a worker process */
+static volatile sig_atomic_t got_SIGHUP = false;
+static volatile ScanWorkerSlot *MySlot = NULL;
+static char *MyQueue = NULL;
+static uint64 queue_head;		/* bytes written so far */
+static uint64 queue_tail;		/* read position last seen */
+static uint64 queue_published;	/* write position last published */
+
+static void ScanWorkerMain(void *main_arg);
+static void scanworker_sighup(SIGNAL_ARGS);
+static void scanworker_exit(int code, Datum arg);
+static void scanworker_run(ScanWorkerTask *task);
+static bool scanworker_send(HeapTuple tuple);
+static bool scanworker_insert(HashJoinTable hashtable, List *hashkeys,
+				  ExprContext *hashcontext, ProjectionInfo *projection,
+				  TupleTableSlot *tupslot);
+static void scanworker_send_states(AggState *aggstate);
+static bool scanworker_publish(bool want_space);
+static void scanworker_finish(double nfiltered, int sqlerrcode,
+				  const char *message);
+static bool scanworker_unsafe_walker(Node *node, void *context);
+static HeapTuple scanworkers_read(ScanWorkerGroup *group, int i);
+static void scanworkers_sync(ScanWorkerGroup *group, int i, uint64 tail);
+static void scanworkers_release(int *slotnos, int nslots);
+
+
+/*
+ * ScanWorkerShmemSize
+ *		Compute space needed for scan worker related shared memory
+ */
+Size
+ScanWorkerShmemSize(void)
+{
+	Size		size;
+
+	size = offsetof(ScanWorkerShmemStruct, slots);
+	size = add_size(size, mul_size(parallel_scan_workers,
+								   sizeof(ScanWorkerSlot)));
+	size = MAXALIGN(size);
+	size = add_size(size, mul_size(parallel_scan_workers,
+								   SCANWORKER_QUEUE_SIZE));
+	if (parallel_scan_workers > 0)
+		size = add_size(size, mul_size(parallel_hash_mem, 1024));
+	return size;
+}
+
+/*
+ * ScanWorkerShmemInit
+ *		Allocate and initialize scan worker related shared memory
+ */
+void
+ScanWorkerShmemInit(void)
+{
+	bool		found;
+	Size		size;
+
+	ScanWorkerShmem = (ScanWorkerShmemStruct *)
+		ShmemInitStruct("Scan Worker Data", ScanWorkerShmemSize(), &found);
+
+	size = offsetof(ScanWorkerShmemStruct, slots) +
+		parallel_scan_workers * sizeof(ScanWorkerSlot);
+	ScanWorkerQueues = (char *) ScanWorkerShmem + MAXALIGN(size);
+	ScanWorkerHashArena = ScanWorkerQueues +
+		(Size) parallel_scan_workers * SCANWORKER_QUEUE_SIZE;
+
+	if (!IsUnderPostmaster)
+	{
+		int			i;
+
+		Assert(!found);
+
+		SpinLockInit(&ScanWorkerShmem->arena_mutex);
+		ScanWorkerShmem->arena_owner = NULL;
+		ScanWorkerShmem->nslots = parallel_scan_workers;
+		for (i = 0; i < parallel_scan_workers; i++)
+		{
+			ScanWorkerSlot *slot = &ScanWorkerShmem->slots[i];
+
+			memset(slot, 0, offsetof(ScanWorkerSlot, taskdata));
+			SpinLockInit(&slot->mutex);
+		}
+	}
+	else
+		Assert(found);
+}
+
+/*
+ * ScanWorkerRegister
+ *		Register the scan workers as background workers
+ *
+ * This is called by the postmaster at startup, along with loading the
+ * shared_preload_libraries.
+ */
+void
+ScanWorkerRegister(void)
+{
+	BackgroundWorker worker;
+	char		name[64];
+	int			i;
+
+	for (i = 0; i < parallel_scan_workers; i++)
+	{
+		snprintf(name, sizeof(name), "scan worker %d", i + 1);
+
+		worker.bgw_name = name;
+		worker.bgw_flags = BGWORKER_SHMEM_ACCESS |
+			BGWORKER_BACKEND_DATABASE_CONNECTION;
+		worker.bgw_start_time = BgWorkerStart_ConsistentState;
+		worker.bgw_restart_time = SCANWORKER_RESTART_TIME;
+		worker.bgw_main = ScanWorkerMain;
+		worker.bgw_main_arg = (void *) (intptr_t) i;
+		worker.bgw_sighup = scanworker_sighup;
+		worker.bgw_sigterm = die;
+
+		RegisterBackgroundWorker(&worker);
+	}
+}
+
+
+/* ----------------------------------------------------------------
+ *						Worker side
+ * ----------------------------------------------------------------
+ */
+
+/*
+ * ScanWorkerMain
+ *		Main loop of a scan worker
+ */
+static void
+ScanWorkerMain(void *main_arg)
+{
+	int			slotno = (int) (intptr_t) main_arg;
+	sigjmp_buf	local_sigjmp_buf;
+	volatile ScanWorkerSlot *slot;
+
+	MySlot = slot = &ScanWorkerShmem->slots[slotno];
+	MyQueue = SlotQueue(slotno);
+	on_shmem_exit(scanworker_exit, 0);
+
+	/*
+	 * If an error occurs while running a task, it's passed on to the leader,
+	 * which reports it.  The worker just cleans up and waits for the next
+	 * task.
+	 */
+	if (sigsetjmp(local_sigjmp_buf, 1) != 0)
+	{
+		ErrorData  *edata;
+
+		/* Since not using PG_TRY, must reset error stack by hand */
+		error_context_stack = NULL;
+
+		/* Prevent interrupts while cleaning up */
+		HOLD_INTERRUPTS();
+
+		MemoryContextSwitchTo(TopMemoryContext);
+		edata = CopyErrorData();
+		scanworker_finish(0, edata->sqlerrcode, edata->message);
+		FreeErrorData(edata);
+
+		AbortCurrentTransaction();
+		FlushErrorState();
+
+		RESUME_INTERRUPTS();
+	}
+
+	/* We can now handle ereport(ERROR) */
+	PG_exception_stack = &local_sigjmp_buf;
+
+	BackgroundWorkerUnblockSignals();
+
+	SpinLockAcquire(&slot->mutex);
+	slot->proc = MyProc;
+	slot->dboid = InvalidOid;
+	SpinLockRelease(&slot->mutex);
+
+	for (;;)
+	{
+		int			task = -1;
+		int			rc;
+
+		ResetLatch(&MyProc->procLatch);
+
+		CHECK_FOR_INTERRUPTS();
+
+		if (got_SIGHUP)
+		{
+			got_SIGHUP = false;
+			ProcessConfigFile(PGC_SIGHUP);
+		}
+
+		SpinLockAcquire(&slot->mutex);
+		if (slot->busy)
+			task = slot->task;
+		SpinLockRelease(&slot->mutex);
+
+		if (task >= 0)
+		{
+			scanworker_run(&ScanWorkerShmem->slots[task].taskdata);
+			continue;
+		}
+
+		rc = WaitLatch(&MyProc->procLatch,
+					   WL_LATCH_SET | WL_TIMEOUT | WL_POSTMASTER_DEATH,
+					   SCANWORKER_IDLE_TIMEOUT);
+
+		if (rc & WL_POSTMASTER_DEATH)
+			proc_exit(1);
+
+		/*
+		 * After being idle for a while, exit to give up the connection to
+		 * our database, unless a leader has picked us in the meantime.
+		 */
+		if ((rc & WL_TIMEOUT) && OidIsValid(MyDatabaseId))
+		{
+			bool		idle;
+
+			SpinLockAcquire(&slot->mutex);
+			idle = (slot->leader == NULL && !slot->busy);
+			if (idle)
+				slot->proc = NULL;
+			SpinLockRelease(&slot->mutex);
+
+			if (idle)
+				proc_exit(0);
+		}
+	}
+}
+
+/*
+ * Signal handler for SIGHUP
+ */
+static void
+scanworker_sighup(SIGNAL_ARGS)
+{
+	int			save_errno = errno;
+
+	got_SIGHUP = true;
+	if (MyProc)
+		SetLatch(&MyProc->procLatch);
+
+	errno = save_errno;
+}
+
+/*
+ * on_shmem_exit callback: take ourselves out of the pool, and fail the task
+ * we're running, if any.
+ */
+static void
+scanworker_exit(int code, Datum arg)
+{
+	volatile ScanWorkerSlot *slot = MySlot;
+	PGPROC	   *leader = NULL;
+
+	SpinLockAcquire(&slot->mutex);
+	slot->proc = NULL;
+	slot->dboid = InvalidOid;
+	if (slot->busy)
+	{
+		slot->busy = false;
+		slot->done = true;
+		slot->sqlerrcode = ERRCODE_ADMIN_SHUTDOWN;
+		strlcpy((char *) slot->message, "scan worker terminated",
+				sizeof(slot->message));
+		leader = slot->leader;
+	}
+	SpinLockRelease(&slot->mutex);
+
+	if (leader != NULL)
+		SetLatch(&leader->procLatch);
+}
+
+/*
+ * Run a task: scan our share of the relation, sending the tuples that pass
+ * the quals to the leader, or aggregating them if the task says so.
+ */
+static void
+scanworker_run(ScanWorkerTask *task)
+{
+	volatile ScanWorkerSlot *slot = MySlot;
+	SnapshotData snapshotdata;
+	Snapshot	snapshot;
+	double		nfiltered = 0;
+
+	queue_head = queue_tail = queue_published = 0;
+
+	/* connect to the leader's database, if this is our first task */
+	if (!OidIsValid(MyDatabaseId))
+	{
+		BackgroundWorkerInitializeConnection(task->dbname, NULL);
+
+		SpinLockAcquire(&slot->mutex);
+		slot->dboid = MyDatabaseId;
+		SpinLockRelease(&slot->mutex);
+	}
+	if (MyDatabaseId != task->dboid)
+		elog(ERROR, "scan worker is connected to the wrong database");
+
+	StartTransactionCommand();
+
+	/*
+	 * Take a snapshot of our own first; that sets RecentGlobalXmin, which
+	 * page pruning during the scan relies on.  Then use the leader's.
+	 */
+	(void) GetTransactionSnapshot();
+
+	snapshotdata.satisfies = HeapTupleSatisfiesMVCC;
+	snapshotdata.xmin = task->xmin;
+	snapshotdata.xmax = task->xmax;
+	snapshotdata.xip = task->xids;
+	snapshotdata.xcnt = task->xcnt;
+	snapshotdata.subxip = task->xids + task->xcnt;
+	snapshotdata.subxcnt = task->subxcnt;
+	snapshotdata.suboverflowed = task->suboverflowed;
+	snapshotdata.takenDuringRecovery = task->takenDuringRecovery;
+	snapshotdata.copied = false;
+	snapshotdata.curcid = task->curcid;
+	snapshotdata.active_count = 0;
+	snapshotdata.regd_count = 0;
+	PushActiveSnapshot(&snapshotdata);
+	snapshot = GetActiveSnapshot();
+
+	/*
+	 * The leader holds a lock on the relation.  If we'd have to wait for
+	 * ours, someone is waiting for a conflicting lock behind the leader's,
+	 * and the deadlock detector wouldn't see that the leader waits for us.
+	 * Leave the pages to the leader in that case.
+	 */
+	if (ConditionalLockRelationOid(task->relid, AccessShareLock))
+	{
+		Relation	rel;
+		List	   *qual = NIL;
+		EState	   *estate = NULL;
+		AggState   *aggstate = NULL;
+		HashJoinTable hashtable = NULL;
+		List	   *hashkeys = NIL;
+		ExprContext *hashcontext = NULL;
+		ProjectionInfo *projection = NULL;
+		ExprContext *econtext;
+		TupleTableSlot *tupslot;
+		HeapScanDesc scan;
+		HeapTuple	tuple;
+		bool		aggregated = false;
+
+		rel = heap_open(task->relid, NoLock);
+
+		if (task->quals[0] != '\0')
+			qual = (List *) ExecInitExpr((Expr *) stringToNode(task->quals),
+										 NULL);
+		econtext = CreateStandaloneExprContext();
+		tupslot = MakeSingleTupleTableSlot(RelationGetDescr(rel));
+		econtext->ecxt_scantuple = tupslot;
+
+		if (task->aggs[0] != '\0')
+		{
+			MemoryContext oldcontext;
+
+			estate = CreateExecutorState();
+			oldcontext = MemoryContextSwitchTo(estate->es_query_cxt);
+			aggstate = ExecInitPartialAgg((List *) stringToNode(task->aggs),
+										  estate);
+			MemoryContextSwitchTo(oldcontext);
+		}
+
+		if (task->hash[0] != '\0')
+		{
+			List	   *hashinfo = (List *) stringToNode(task->hash);
+			List	   *tlist = (List *) linitial(hashinfo);
+
+			hashtable = ExecHashTableAttach((SharedHashJoinTable)
+											ScanWorkerHashArena);
+			hashkeys = (List *) ExecInitExpr((Expr *) lsecond(hashinfo),
+											 NULL);
+			hashcontext = CreateStandaloneExprContext();
+
+			/* store the tuples the way the leader's scan returns them */
+			if (tlist != NIL)
+				projection = ExecBuildProjectionInfo((List *)
+												ExecInitExpr((Expr *) tlist,
+															 NULL),
+													 econtext,
+							 MakeSingleTupleTableSlot(ExecTypeFromTL(tlist,
+																  false)),
+													 RelationGetDescr(rel));
+		}
+
+		scan = heap_beginscan_parallel(rel, snapshot, &task->pscan);
+
+		while (!slot->stop &&
+			   (tuple = heap_getnext(scan, ForwardScanDirection)) != NULL)
+		{
+			CHECK_FOR_INTERRUPTS();
+
+			if (qual != NIL || aggstate != NULL || hashtable != NULL)
+				ExecStoreTuple(tuple, tupslot, scan->rs_cbuf, false);
+
+			if (qual != NIL)
+			{
+				ResetExprContext(econtext);
+				if (!ExecQual(qual, econtext, false))
+				{
+					nfiltered += 1;
+
+					/* don't hold back tuples from a waiting leader */
+					if (slot->leader_waiting && queue_head != queue_published)
+						(void) scanworker_publish(false);
+					continue;
+				}
+			}
+
+			if (aggstate != NULL)
+			{
+				MemoryContext oldcontext;
+
+				oldcontext = MemoryContextSwitchTo(estate->es_query_cxt);
+				ExecPartialAggAdvance(aggstate, tupslot);
+				MemoryContextSwitchTo(oldcontext);
+				aggregated = true;
+				continue;
+			}
+
+			/* once the hash table is full, send the leader the rest */
+			if (hashtable != NULL && !hashtable->shared->full &&
+				scanworker_insert(hashtable, hashkeys, hashcontext,
+								  projection, tupslot))
+				continue;
+
+			if (!scanworker_send(tuple))
+				break;
+		}
+
+		ExecDropSingleTupleTableSlot(tupslot);
+		heap_endscan(scan);
+		FreeExprContext(econtext, true);
+
+		if (aggstate != NULL)
+		{
+			if (aggregated && !slot->stop)
+				scanworker_send_states(aggstate);
+			ExecEndAgg(aggstate);
+			FreeExecutorState(estate);
+		}
+
+		if (hashtable != NULL)
+		{
+			ExecHashTableDetach(hashtable);
+			if (projection != NULL)
+				ExecDropSingleTupleTableSlot(projection->pi_slot);
+			FreeExprContext(hashcontext, true);
+		}
+
+		heap_close(rel, NoLock);
+	}
+
+	PopActiveSnapshot();
+	CommitTransactionCommand();
+
+	scanworker_finish(nfiltered, 0, NULL);
+}
+
+/*
+ * Insert the tuple in the scan tuple slot into the shared hash table,
+ * projecting it first if the leader's scan would.
+ *
+ * Returns false if it doesn't fit, which the caller has to send to the
+ * leader then.  Tuples with a null key that can't match are dropped.
+ */
+static bool
+scanworker_insert(HashJoinTable hashtable, List *hashkeys,
+				  ExprContext *hashcontext, ProjectionInfo *projection,
+				  TupleTableSlot *tupslot)
+{
+	TupleTableSlot *slot = tupslot;
+	uint32		hashvalue;
+
+	if (projection != NULL)
+	{
+		ResetExprContext(projection->pi_exprContext);
+		slot = ExecProject(projection, NULL);
+	}
+
+	hashcontext->ecxt_innertuple = slot;
+	if (!ExecHashGetHashValue(hashtable, hashcontext, hashkeys,
+							  false, hashtable->keepNulls, &hashvalue))
+		return true;
+
+	if (!ExecHashTableInsertShared(hashtable, slot, hashvalue))
+		return false;
+
+	hashtable->totalTuples += 1;
+	return true;
+}
+
+/*
+ * Append a tuple to our queue, waiting for space if necessary.
+ *
+ * Returns false if the leader asked us to stop.
+ */
+static bool
+scanworker_send(HeapTuple tuple)
+{
+	Size		len = SCANWORKER_HDRSZ + MAXALIGN(tuple->t_len);
+	Size		offset;
+	Size		contiguous;
+	ScanWorkerTupleHeader *hdr;
+
+	for (;;)
+	{
+		Size		needed;
+
+		/* a tuple doesn't wrap around the end of the ring */
+		offset = queue_head % SCANWORKER_QUEUE_SIZE;
+		contiguous = SCANWORKER_QUEUE_SIZE - offset;
+		needed = (contiguous < len) ? contiguous + len : len;
+
+		if (queue_head + needed - queue_tail <= SCANWORKER_QUEUE_SIZE)
+			break;
+
+		/* see if the leader has made room, and wait if not */
+		ResetLatch(&MyProc->procLatch);
+		if (!scanworker_publish(true))
+			return false;
+		if (queue_head + needed - queue_tail <= SCANWORKER_QUEUE_SIZE)
+			continue;
+
+		if (WaitLatch(&MyProc->procLatch,
+					  WL_LATCH_SET | WL_POSTMASTER_DEATH, 0) &
+			WL_POSTMASTER_DEATH)
+			proc_exit(1);
+
+		CHECK_FOR_INTERRUPTS();
+	}
+
+	if (contiguous < len)
+	{
+		*(uint32 *) (MyQueue + offset) = 0;
+		queue_head += contiguous;
+		offset = 0;
+	}
+
+	hdr = (ScanWorkerTupleHeader *) (MyQueue + offset);
+	hdr->t_len = tuple->t_len;
+	hdr->t_self = tuple->t_self;
+	memcpy(MyQueue + offset + SCANWORKER_HDRSZ, tuple->t_data, tuple->t_len);
+	queue_head += len;
+
+	if (queue_head - queue_published >= SCANWORKER_PUBLISH_SIZE ||
+		MySlot->leader_waiting)
+		return scanworker_publish(false);
+
+	return true;
+}
+
+/*
+ * Send the transition values of our aggregates to the leader
+ */
+static void
+scanworker_send_states(AggState *aggstate)
+{
+	HeapTuple	tuple;
+
+	tuple = ExecPartialAggGetStates(aggstate);
+
+	/* a tuple doesn't wrap around the end of the queue, which is empty */
+	if (SCANWORKER_HDRSZ + MAXALIGN(tuple->t_len) > SCANWORKER_QUEUE_SIZE)
+		ereport(ERROR,
+				(errcode(ERRCODE_PROGRAM_LIMIT_EXCEEDED),
+				 errmsg("aggregate transition values are too large to pass on from a scan worker")));
+
+	ItemPointerSetInvalid(&tuple->t_self);
+	(void) scanworker_send(tuple);
+	(void) scanworker_publish(false);
+	heap_freetuple(tuple);
+}
+
+/*
+ * Tell the leader how far we've written, and learn how far it has read.
+ * If want_space is true, ask the leader to wake us up when it reads more.
+ *
+ * Returns false if the leader asked us to stop.
+ */
+static bool
+scanworker_publish(bool want_space)
+{
+	volatile ScanWorkerSlot *slot = MySlot;
+	PGPROC	   *leader = NULL;
+	bool		stop;
+
+	SpinLockAcquire(&slot->mutex);
+	slot->head = queue_head;
+	queue_tail = slot->tail;
+	stop = slot->stop;
+	if (want_space)
+		slot->worker_waiting = true;
+	if (slot->leader_waiting)
+	{
+		slot->leader_waiting = false;
+		leader = slot->leader;
+	}
+	SpinLockRelease(&slot->mutex);
+
+	queue_published = queue_head;
+
+	if (leader != NULL)
+		SetLatch(&leader->procLatch);
+
+	return !stop;
+}
+
+/*
+ * Report the end of a task to the leader
+ */
+static void
+scanworker_finish(double nfiltered, int sqlerrcode, const char *message)
+{
+	volatile ScanWorkerSlot *slot = MySlot;
+	PGPROC	   *leader;
+
+	SpinLockAcquire(&slot->mutex);
+	slot->head = queue_head;
+	slot->nfiltered = nfiltered;
+	slot->sqlerrcode = sqlerrcode;
+	if (message != NULL)
+		strlcpy((char *) slot->message, message, sizeof(slot->message));
+	slot->done = true;
+	slot->busy = false;
+	slot->leader_waiting = false;
+	leader = slot->leader;
+	SpinLockRelease(&slot->mutex);
+
+	if (leader != NULL)
+		SetLatch(&leader->procLatch);
+}
+
+
+/* ----------------------------------------------------------------
+ *						Leader side
+ * ----------------------------------------------------------------
+ */
+
+/*
+ * ScanWorkersStart
+ *		Hand a scan over to up to nworkers idle scan workers
+ *
+ * Returns NULL if the scan can't be run in parallel, or no worker is
+ * available.  Otherwise the caller must scan the relation too, with
+ * heap_beginscan_parallel on group->pscan, and read the workers' tuples with
+ * ScanWorkersGetTuple.  Those tuples have passed the quals already.
+ *
+ * If aggs isn't NIL, it's a list of Aggrefs over the relation.  The workers
+ * then return one tuple each with the transition values of those aggregates
+ * over their tuples (see ExecPartialAggGetStates), rather than the tuples.
+ *
+ * If hashkeys isn't NIL, the workers insert their tuples into the hash table
+ * the caller has set up in the hash arena, rather than returning them, as
+ * long as it has room.  hashkeys are the table's inner hash keys, over the
+ * tuples projected by hashtlist, or over the relation's tuples if hashtlist
+ * is NIL.
+ */
+ScanWorkerGroup *
+ScanWorkersStart(Relation relation, Snapshot snapshot, List *quals,
+				 List *aggs, List *hashkeys, List *hashtlist, int nworkers)
+{
+	ScanWorkerGroup *group;
+	ScanWorkerTask *task;
+	char	   *qualstr = "";
+	char	   *aggstr = "";
+	char	   *hashstr = "";
+	char	   *dbname;
+	int		   *slotnos;
+	int			n = 0;
+	int			pass;
+	int			i;
+
+	if (nworkers <= 0 || ScanWorkerShmem->nslots == 0)
+		return NULL;
+
+	Assert(IsMVCCSnapshot(snapshot));
+	if (snapshot->xcnt + snapshot->subxcnt > SCANWORKER_MAX_XIDS)
+		return NULL;
+
+	if (quals != NIL)
+	{
+		if (contain_mutable_functions((Node *) quals) ||
+			scanworker_unsafe_walker((Node *) quals, NULL))
+			return NULL;
+		qualstr = nodeToString(quals);
+		if (strlen(qualstr) >= SCANWORKER_MAX_QUALS)
+			return NULL;
+	}
+
+	if (aggs != NIL)
+	{
+		if (contain_mutable_functions((Node *) aggs) ||
+			scanworker_unsafe_walker((Node *) aggs, NULL))
+			return NULL;
+		aggstr = nodeToString(aggs);
+		if (strlen(aggstr) >= SCANWORKER_MAX_AGGS)
+			return NULL;
+	}
+
+	if (hashkeys != NIL)
+	{
+		List	   *hashinfo = list_make2(hashtlist, hashkeys);
+
+		Assert(scanworkers_arena_held);
+		if (contain_mutable_functions((Node *) hashinfo) ||
+			scanworker_unsafe_walker((Node *) hashinfo, NULL))
+			return NULL;
+		hashstr = nodeToString(hashinfo);
+		if (strlen(hashstr) >= SCANWORKER_MAX_HASH)
+			return NULL;
+	}
+
+	dbname = get_database_name(MyDatabaseId);
+	if (dbname == NULL)
+		return NULL;
+
+	/*
+	 * Reserve idle workers, preferring those that are connected to our
+	 * database already.
+	 */
+	nworkers = Min(nworkers, ScanWorkerShmem->nslots);
+	slotnos = (int *) palloc(nworkers * sizeof(int));
+	for (pass = 0; pass < 2; pass++)
+	{
+		Oid			dboid = (pass == 0) ? MyDatabaseId : InvalidOid;
+
+		for (i = 0; i < ScanWorkerShmem->nslots && n < nworkers; i++)
+		{
+			volatile ScanWorkerSlot *slot = &ScanWorkerShmem->slots[i];
+
+			SpinLockAcquire(&slot->mutex);
+			if (slot->proc != NULL && slot->leader == NULL &&
+				!slot->busy && slot->dboid == dboid)
+			{
+				slot->leader = MyProc;
+				slotnos[n++] = i;
+			}
+			SpinLockRelease(&slot->mutex);
+		}
+	}
+
+	if (n == 0)
+	{
+		pfree(slotnos);
+		return NULL;
+	}
+	scanworkers_nattached += n;
+
+	/* describe the scan in the first worker's slot */
+	task = &ScanWorkerShmem->slots[slotnos[0]].taskdata;
+	task->dboid = MyDatabaseId;
+	strlcpy(task->dbname, dbname, NAMEDATALEN);
+	task->relid = RelationGetRelid(relation);
+	heap_parallelscan_initialize(&task->pscan, relation);
+	task->xmin = snapshot->xmin;
+	task->xmax = snapshot->xmax;
+	task->xcnt = snapshot->xcnt;
+	task->subxcnt = snapshot->subxcnt;
+	task->suboverflowed = snapshot->suboverflowed;
+	task->takenDuringRecovery = snapshot->takenDuringRecovery;
+	task->curcid = snapshot->curcid;
+	memcpy(task->xids, snapshot->xip,
+		   snapshot->xcnt * sizeof(TransactionId));
+	memcpy(task->xids + snapshot->xcnt, snapshot->subxip,
+		   snapshot->subxcnt * sizeof(TransactionId));
+	strcpy(task->quals, qualstr);
+	strcpy(task->aggs, aggstr);
+	strcpy(task->hash, hashstr);
+
+	/* and put the workers to work */
+	for (i = 0; i < n; i++)
+	{
+		volatile ScanWorkerSlot *slot = &ScanWorkerShmem->slots[slotnos[i]];
+		PGPROC	   *proc;
+
+		SpinLockAcquire(&slot->mutex);
+		proc = slot->proc;
+		slot->task = slotnos[0];
+		slot->head = slot->tail = 0;
+		slot->nfiltered = 0;
+		slot->sqlerrcode = 0;
+		slot->stop = false;
+		slot->leader_waiting = false;
+		slot->worker_waiting = false;
+		/* if the worker has exited since we picked it, there's nothing to do */
+		slot->busy = (proc != NULL);
+		slot->done = (proc == NULL);
+		SpinLockRelease(&slot->mutex);
+
+		if (proc != NULL)
+			SetLatch(&proc->procLatch);
+	}
+
+	group = (ScanWorkerGroup *) palloc0(sizeof(ScanWorkerGroup));
+	group->nworkers = n;
+	group->slotnos = slotnos;
+	group->readpos = (uint64 *) palloc0(n * sizeof(uint64));
+	group->headpos = (uint64 *) palloc0(n * sizeof(uint64));
+	group->tailpos = (uint64 *) palloc0(n * sizeof(uint64));
+	group->finished = (bool *) palloc0(n * sizeof(bool));
+	group->nactive = n;
+	group->current = 0;
+	group->pscan = &task->pscan;
+	group->tuple.t_tableOid = RelationGetRelid(relation);
+	group->nfiltered = 0;
+
+	return group;
+}
+
+/*
+ * Check for things in quals or aggregates that can't be evaluated by a scan
+ * worker
+ */
+static bool
+scanworker_unsafe_walker(Node *node, void *context)
+{
+	if (node == NULL)
+		return false;
+	if (IsA(node, Param) ||
+		IsA(node, SubLink) ||
+		IsA(node, SubPlan) ||
+		IsA(node, AlternativeSubPlan) ||
+		IsA(node, CurrentOfExpr))
+		return true;
+	return expression_tree_walker(node, scanworker_unsafe_walker, context);
+}
+
+/*
+ * ScanWorkersGetTuple
+ *		Get the next tuple sent by any of the workers
+ *
+ * If no tuple is available right away, wait for one if 'wait' is true, else
+ * return NULL.  NULL is also returned once all workers have finished; the
+ * caller can tell by group->nactive being zero.  The tuple is valid until the
+ * next call.
+ */
+HeapTuple
+ScanWorkersGetTuple(ScanWorkerGroup *group, bool wait)
+{
+	for (;;)
+	{
+		int			i;
+
+		/* keep reading from the same worker while it has tuples */
+		for (i = 0; i < group->nworkers && group->nactive > 0; i++)
+		{
+			int			w = (group->current + i) % group->nworkers;
+			HeapTuple	tuple;
+
+			if (group->finished[w])
+				continue;
+
+			tuple = scanworkers_read(group, w);
+			if (tuple != NULL)
+			{
+				group->current = w;
+				return tuple;
+			}
+		}
+
+		if (group->nactive == 0 || !wait)
+			return NULL;
+
+		/*
+		 * scanworkers_read asked every worker with an empty queue to wake us
+		 * up when it has more.
+		 */
+		WaitLatch(&MyProc->procLatch, WL_LATCH_SET, 0);
+		ResetLatch(&MyProc->procLatch);
+
+		CHECK_FOR_INTERRUPTS();
+	}
+}
+
+/*
+ * Read the next tuple from the i'th worker's queue, if there's one.
+ */
+static HeapTuple
+scanworkers_read(ScanWorkerGroup *group, int i)
+{
+	char	   *queue = SlotQueue(group->slotnos[i]);
+
+	for (;;)
+	{
+		uint64		start = group->readpos[i];
+
+		if (start < group->headpos[i])
+		{
+			Size		offset = start % SCANWORKER_QUEUE_SIZE;
+			ScanWorkerTupleHeader *hdr;
+
+			hdr = (ScanWorkerTupleHeader *) (queue + offset);
+			if (hdr->t_len == 0)
+			{
+				/* skip to the start of the ring */
+				group->readpos[i] += SCANWORKER_QUEUE_SIZE - offset;
+				continue;
+			}
+
+			group->tuple.t_len = hdr->t_len;
+			group->tuple.t_self = hdr->t_self;
+			group->tuple.t_data = (HeapTupleHeader)
+				(queue + offset + SCANWORKER_HDRSZ);
+			group->readpos[i] += SCANWORKER_HDRSZ + MAXALIGN(hdr->t_len);
+
+			/*
+			 * Give the space of the tuples read before this one back to the
+			 * worker from time to time.  This one has to stay put until the
+			 * next call.
+			 */
+			if (start - group->tailpos[i] >= SCANWORKER_RELEASE_SIZE)
+				scanworkers_sync(group, i, start);
+
+			return &group->tuple;
+		}
+
+		/* all read; see if the worker has written more */
+		scanworkers_sync(group, i, start);
+		if (group->readpos[i] == group->headpos[i])
+			return NULL;
+	}
+}
+
+/*
+ * Exchange queue positions with the i'th worker: report 'tail' as our read
+ * position, and learn its write position.  If the queue turns out to be
+ * empty, this either asks the worker to wake us up when it has written more,
+ * or notices that it's done.
+ */
+static void
+scanworkers_sync(ScanWorkerGroup *group, int i, uint64 tail)
+{
+	volatile ScanWorkerSlot *slot = &ScanWorkerShmem->slots[group->slotnos[i]];
+	PGPROC	   *worker = NULL;
+	bool		done;
+
+	SpinLockAcquire(&slot->mutex);
+	slot->tail = tail;
+	if (slot->worker_waiting)
+	{
+		slot->worker_waiting = false;
+		worker = slot->proc;
+	}
+	group->headpos[i] = slot->head;
+	done = slot->done;
+	if (!done && group->readpos[i] == group->headpos[i])
+		slot->leader_waiting = true;
+	SpinLockRelease(&slot->mutex);
+
+	group->tailpos[i] = tail;
+
+	if (worker != NULL)
+		SetLatch(&worker->procLatch);
+
+	if (done && group->readpos[i] == group->headpos[i])
+	{
+		/* the worker won't touch the slot until we release it */
+		group->finished[i] = true;
+		group->nactive--;
+		group->nfiltered += slot->nfiltered;
+
+		if (slot->sqlerrcode != 0)
+			ereport(ERROR,
+					(errcode(slot->sqlerrcode),
+					 errmsg_internal("%s", (char *) slot->message),
+					 errcontext("parallel scan worker")));
+	}
+}
+
+/*
+ * ScanWorkersFinish
+ *		Stop the workers of a scan and give them back to the pool
+ */
+void
+ScanWorkersFinish(ScanWorkerGroup *group)
+{
+	int			n = 0;
+	int			i;
+
+	/*
+	 * Skip slots that AtEOXact_ScanWorkers has released already, in case the
+	 * executor is shut down late in transaction abort.
+	 */
+	for (i = 0; i < group->nworkers; i++)
+	{
+		if (ScanWorkerShmem->slots[group->slotnos[i]].leader == MyProc)
+			group->slotnos[n++] = group->slotnos[i];
+	}
+
+	scanworkers_release(group->slotnos, n);
+	group->nworkers = group->nactive = 0;
+}
+
+/*
+ * Ask the workers in the given slots to stop, wait until they have, and
+ * detach from them.  The workers must not be running while the slot holding
+ * their task is handed to another leader.
+ */
+static void
+scanworkers_release(int *slotnos, int nslots)
+{
+	int			i;
+
+	for (i = 0; i < nslots; i++)
+	{
+		volatile ScanWorkerSlot *slot = &ScanWorkerShmem->slots[slotnos[i]];
+		PGPROC	   *worker = NULL;
+
+		SpinLockAcquire(&slot->mutex);
+		if (slot->busy)
+		{
+			slot->stop = true;
+			worker = slot->proc;
+		}
+		SpinLockRelease(&slot->mutex);
+
+		if (worker != NULL)
+			SetLatch(&worker->procLatch);
+	}
+
+	for (;;)
+	{
+		bool		running = false;
+
+		for (i = 0; i < nslots; i++)
+		{
+			volatile ScanWorkerSlot *slot = &ScanWorkerShmem->slots[slotnos[i]];
+
+			SpinLockAcquire(&slot->mutex);
+			if (slot->busy)
+				running = true;
+			SpinLockRelease(&slot->mutex);
+		}
+
+		if (!running)
+			break;
+
+		/* scanworker_finish sets our latch */
+		WaitLatch(&MyProc->procLatch, WL_LATCH_SET, 0);
+		ResetLatch(&MyProc->procLatch);
+	}
+
+	for (i = 0; i < nslots; i++)
+	{
+		volatile ScanWorkerSlot *slot = &ScanWorkerShmem->slots[slotnos[i]];
+
+		SpinLockAcquire(&slot->mutex);
+		slot->leader = NULL;
+		slot->done = false;
+		slot->stop = false;
+		slot->leader_waiting = false;
+		SpinLockRelease(&slot->mutex);
+	}
+
+	scanworkers_nattached -= nslots;
+	Assert(scanworkers_nattached >= 0);
+}
+
+/*
+ * ScanWorkersGetHashArena
+ *		Reserve the hash arena for this backend
+ *
+ * Returns the arena, setting *size to its size, or NULL if it's in use by
+ * another backend or there is none.  It's to be given back with
+ * ScanWorkersReleaseHashArena, once no worker is using it any more.
+ */
+void *
+ScanWorkersGetHashArena(Size *size)
+{
+	bool		got = false;
+
+	Assert(!scanworkers_arena_held);
+
+	if (ScanWorkerShmem->nslots == 0 || parallel_hash_mem == 0)
+		return NULL;
+
+	SpinLockAcquire(&ScanWorkerShmem->arena_mutex);
+	if (ScanWorkerShmem->arena_owner == NULL)
+	{
+		ScanWorkerShmem->arena_owner = MyProc;
+		got = true;
+	}
+	SpinLockRelease(&ScanWorkerShmem->arena_mutex);
+
+	if (!got)
+		return NULL;
+
+	scanworkers_arena_held = true;
+	*size = (Size) parallel_hash_mem * 1024;
+	return ScanWorkerHashArena;
+}
+
+/*
+ * ScanWorkersReleaseHashArena
+ *		Give back the hash arena
+ */
+void
+ScanWorkersReleaseHashArena(void)
+{
+	Assert(scanworkers_arena_held);
+
+	SpinLockAcquire(&ScanWorkerShmem->arena_mutex);
+	Assert(ScanWorkerShmem->arena_owner == MyProc);
+	ScanWorkerShmem->arena_owner = NULL;
+	SpinLockRelease(&ScanWorkerShmem->arena_mutex);
+
+	scanworkers_arena_held = false;
+}
+
+/*
+ * AtEOXact_ScanWorkers
+ *		Release any scan workers, and the hash arena, that a failed query
+ *		didn't get to release
+ */
+void
+AtEOXact_ScanWorkers(bool isCommit)
+{
+	int		   *slotnos;
+	int			n = 0;
+	int			i;
+
+	if (scanworkers_nattached == 0)
+	{
+		if (scanworkers_arena_held)
+		{
+			if (isCommit)
+				elog(WARNING, "hash arena still in use at end of transaction");
+			ScanWorkersReleaseHashArena();
+		}
+		return;
+	}
+
+	if (isCommit)
+		elog(WARNING, "scan workers still in use at end of transaction");
+
+	slotnos = (int *) palloc(ScanWorkerShmem->nslots * sizeof(int));
+	for (i = 0; i < ScanWorkerShmem->nslots; i++)
+	{
+		volatile ScanWorkerSlot *slot = &ScanWorkerShmem->slots[i];
+
+		/* only we can change the leader of a slot we're using */
+		if (slot->leader == MyProc)
+			slotnos[n++] = i;
+	}
+
+	scanworkers_release(slotnos, n);
+	pfree(slotnos);
+
+	scanworkers_nattached = 0;
+
+	/* the workers are gone, so nobody is using the arena any more */
+	if (scanworkers_arena_held)
+		ScanWorkersReleaseHashArena();
+}
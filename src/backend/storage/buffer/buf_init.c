@@ -50,7 +50,8 @@ int32	   *PrivateRefCount;
  *
  * refcount --	Counts the number of processes holding pins on a buffer.
  *		A buffer is pinned during IO and immediately after a BufferAlloc().
- *		Pins must be released before end of transaction.
+ *		Pins must be released before end of transaction.  It's kept in the
+ *		buffer header's state word, along with the usage count and flags.
  *
  * PrivateRefCount -- Each buffer also has a private refcount that keeps
  *		track of the number of times the buffer is pinned in the current
@@ -79,9 +80,13 @@ InitBufferPool(void)
 		ShmemInitStruct("Buffer Descriptors",
 						NBuffers * sizeof(BufferDesc), &foundDescs);
 
+	/* Align the pages for direct I/O, see mdread() and mdwrite() */
 	BufferBlocks = (char *)
-		ShmemInitStruct("Buffer Blocks",
-						NBuffers * (Size) BLCKSZ, &foundBufs);
+		TYPEALIGN(ALIGNOF_DIRECT_IO_BUFFER,
+				  ShmemInitStruct("Buffer Blocks",
+								  NBuffers * (Size) BLCKSZ +
+								  ALIGNOF_DIRECT_IO_BUFFER,
+								  &foundBufs));
 
 	if (foundDescs || foundBufs)
 	{
@@ -102,12 +107,12 @@ InitBufferPool(void)
 		for (i = 0; i < NBuffers; buf++, i++)
 		{
 			CLEAR_BUFFERTAG(buf->tag);
-			buf->flags = 0;
-			buf->usage_count = 0;
-			buf->refcount = 0;
+			buf->state = 0;
 			buf->wait_backend_pid = 0;
 
+#ifndef HAVE_PG_ATOMICS
 			SpinLockInit(&buf->buf_hdr_lock);
+#endif
 
 			buf->buf_id = i;
 
@@ -168,8 +173,9 @@ BufferShmemSize(void)
 	/* size of buffer descriptors */
 	size = add_size(size, mul_size(NBuffers, sizeof(BufferDesc)));
 
-	/* size of data pages */
+	/* size of data pages, plus alignment padding */
 	size = add_size(size, mul_size(NBuffers, BLCKSZ));
+	size = add_size(size, ALIGNOF_DIRECT_IO_BUFFER);
 
 	/* size of stuff controlled by freelist.c */
 	size = add_size(size, StrategyShmemSize());
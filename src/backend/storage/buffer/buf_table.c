@@ -9,6 +9,15 @@
  * in most cases the caller needs to adjust the buffer header contents
  * before the lock is released (see notes in README).
  *
+ * The exception is BufTableLookup, which may also be called with no lock
+ * at all.  The table is a fixed array of bucket chains in shared memory,
+ * and is modified in such a way that a concurrent reader never follows a
+ * pointer outside the table; but an unlocked lookup can miss an entry that
+ * is being inserted or moved, or return an entry that is just being deleted
+ * or reused.  The caller must verify the result against the buffer header
+ * once it has the buffer pinned.  An entry is never used for anything but
+ * a BufferTag and a buffer ID, so that check is all that is needed.
+ *
  *
  * Portions Copyright (c) 1996-2013, PostgreSQL Global Development Group
  * Portions Copyright (c) 1994, Regents of the University of California
@@ -21,51 +30,132 @@
  */
 #include "postgres.h"
 
+#include "storage/barrier.h"
 #include "storage/bufmgr.h"
 #include "storage/buf_internals.h"
+#include "storage/shmem.h"
+#include "storage/spin.h"
+#include "utils/hsearch.h"
+
 
+/*
+ * Each mapping partition is given about this many buffers, within the
+ * limits of MIN_BUFFER_PARTITIONS and NUM_BUFFER_PARTITIONS.
+ */
+#define BUFFERS_PER_PARTITION	1024
+#define MIN_BUFFER_PARTITIONS	16
 
 /* entry for buffer lookup hashtable */
 typedef struct
 {
 	BufferTag	key;			/* Tag of a disk page */
 	int			id;				/* Associated buffer ID */
+	int			next;			/* next entry in chain, or -1 */
 } BufferLookupEnt;
 
-static HTAB *SharedBufHash;
+/* shared state of the lookup table, other than the buckets and entries */
+typedef struct
+{
+	slock_t		mutex;			/* protects freeList */
+	int			freeList;		/* first unused entry, or -1 */
+} BufTableControl;
+
+/* number of partitions of the mapping table; a power of 2 */
+int			NumBufferPartitions = MIN_BUFFER_PARTITIONS;
+
+static volatile BufTableControl *SharedBufTable;
+static volatile int *SharedBufBuckets;
+static volatile BufferLookupEnt *SharedBufEntries;
+
+static int	nbuckets;			/* number of buckets; a power of 2 */
+static int	nentries;			/* number of entries */
+
+
+/*
+ * Work out the number of partitions, buckets and entries from NBuffers.
+ *
+ * Since we can't tolerate running out of lookup table entries, we must be
+ * sure to allocate enough of them.  The maximum steady-state usage is of
+ * course NBuffers entries, but BufferAlloc() tries to insert a new entry
+ * before deleting the old, and InvalidateBuffer() deletes an entry only
+ * after the buffer has been released.  Each of those happens with the
+ * partition's lock held exclusively, so there can be at most one extra
+ * entry per partition, for NBuffers + NumBufferPartitions in all.
+ */
+static void
+BufTableSetSize(void)
+{
+	NumBufferPartitions = MIN_BUFFER_PARTITIONS;
+	while (NumBufferPartitions < NUM_BUFFER_PARTITIONS &&
+		   NumBufferPartitions * BUFFERS_PER_PARTITION < NBuffers)
+		NumBufferPartitions <<= 1;
+
+	nentries = NBuffers + NumBufferPartitions;
 
+	/*
+	 * Every bucket must belong to a single partition, so there must be at
+	 * least as many buckets as partitions.
+	 */
+	nbuckets = NumBufferPartitions;
+	while (nbuckets < nentries)
+		nbuckets <<= 1;
+}
 
 /*
  * Estimate space needed for mapping hashtable
- *		size is the desired hash table size (possibly more than NBuffers)
  */
 Size
-BufTableShmemSize(int size)
+BufTableShmemSize(void)
 {
-	return hash_estimate_size(size, sizeof(BufferLookupEnt));
+	Size		size;
+
+	BufTableSetSize();
+
+	size = MAXALIGN(sizeof(BufTableControl));
+	size = add_size(size, MAXALIGN(mul_size(nbuckets, sizeof(int))));
+	size = add_size(size, mul_size(nentries, sizeof(BufferLookupEnt)));
+
+	return size;
 }
 
 /*
  * Initialize shmem hash table for mapping buffers
- *		size is the desired hash table size (possibly more than NBuffers)
  */
 void
-InitBufTable(int size)
+InitBufTable(void)
 {
-	HASHCTL		info;
+	bool		found;
+	char	   *ptr;
+	int			i;
+
+	BufTableSetSize();
+
+	ptr = ShmemInitStruct("Shared Buffer Lookup Table",
+						  BufTableShmemSize(), &found);
+
+	SharedBufTable = (BufTableControl *) ptr;
+	ptr += MAXALIGN(sizeof(BufTableControl));
+	SharedBufBuckets = (int *) ptr;
+	ptr += MAXALIGN(mul_size(nbuckets, sizeof(int)));
+	SharedBufEntries = (BufferLookupEnt *) ptr;
+
+	if (found)
+		return;
 
 	/* assume no locking is needed yet */
+	SpinLockInit(&SharedBufTable->mutex);
 
-	/* BufferTag maps to Buffer */
-	info.keysize = sizeof(BufferTag);
-	info.entrysize = sizeof(BufferLookupEnt);
-	info.hash = tag_hash;
-	info.num_partitions = NUM_BUFFER_PARTITIONS;
+	for (i = 0; i < nbuckets; i++)
+		SharedBufBuckets[i] = -1;
 
-	SharedBufHash = ShmemInitHash("Shared Buffer Lookup Table",
-								  size, size,
-								  &info,
-								  HASH_ELEM | HASH_FUNCTION | HASH_PARTITION);
+	for (i = 0; i < nentries; i++)
+	{
+		CLEAR_BUFFERTAG(SharedBufEntries[i].key);
+		SharedBufEntries[i].id = 0;
+		SharedBufEntries[i].next = i + 1;
+	}
+	SharedBufEntries[nentries - 1].next = -1;
+	SharedBufTable->freeList = 0;
 }
 
 /*
@@ -80,31 +170,42 @@ InitBufTable(int size)
 uint32
 BufTableHashCode(BufferTag *tagPtr)
 {
-	return get_hash_value(SharedBufHash, (void *) tagPtr);
+	return tag_hash((void *) tagPtr, sizeof(BufferTag));
 }
 
 /*
  * BufTableLookup
  *		Lookup the given BufferTag; return buffer ID, or -1 if not found
  *
- * Caller must hold at least share lock on BufMappingLock for tag's partition
+ * The caller should hold at least share lock on BufMappingLock for tag's
+ * partition.  Without the lock, the result is only a hint: see notes at
+ * the top of the file.
  */
 int
 BufTableLookup(BufferTag *tagPtr, uint32 hashcode)
 {
-	BufferLookupEnt *result;
+	int			e;
+	int			steps = 0;
+
+	e = SharedBufBuckets[hashcode & (nbuckets - 1)];
+	while (e >= 0)
+	{
+		volatile BufferLookupEnt *ent = &SharedBufEntries[e];
 
-	result = (BufferLookupEnt *)
-		hash_search_with_hash_value(SharedBufHash,
-									(void *) tagPtr,
-									hashcode,
-									HASH_FIND,
-									NULL);
+		if (BUFFERTAGS_EQUAL(ent->key, *tagPtr))
+			return ent->id;
 
-	if (!result)
-		return -1;
+		/*
+		 * Chains can't loop while we hold the lock, but a concurrently
+		 * reused entry could send an unlocked reader around in circles.
+		 */
+		if (++steps >= nentries)
+			break;
 
-	return result->id;
+		e = ent->next;
+	}
+
+	return -1;
 }
 
 /*
@@ -120,23 +221,38 @@ BufTableLookup(BufferTag *tagPtr, uint32 hashcode)
 int
 BufTableInsert(BufferTag *tagPtr, uint32 hashcode, int buf_id)
 {
-	BufferLookupEnt *result;
-	bool		found;
+	volatile int *bucket = &SharedBufBuckets[hashcode & (nbuckets - 1)];
+	volatile BufferLookupEnt *ent;
+	int			e;
 
 	Assert(buf_id >= 0);		/* -1 is reserved for not-in-table */
 	Assert(tagPtr->blockNum != P_NEW);	/* invalid tag */
 
-	result = (BufferLookupEnt *)
-		hash_search_with_hash_value(SharedBufHash,
-									(void *) tagPtr,
-									hashcode,
-									HASH_ENTER,
-									&found);
+	for (e = *bucket; e >= 0; e = SharedBufEntries[e].next)
+	{
+		if (BUFFERTAGS_EQUAL(SharedBufEntries[e].key, *tagPtr))
+			return SharedBufEntries[e].id;
+	}
+
+	SpinLockAcquire(&SharedBufTable->mutex);
+	e = SharedBufTable->freeList;
+	if (e >= 0)
+		SharedBufTable->freeList = SharedBufEntries[e].next;
+	SpinLockRelease(&SharedBufTable->mutex);
 
-	if (found)					/* found something already in the table */
-		return result->id;
+	if (e < 0)					/* shouldn't happen */
+		elog(ERROR, "out of shared buffer lookup table entries");
 
-	result->id = buf_id;
+	/*
+	 * Fill in the entry before linking it in, so that unlocked readers don't
+	 * see it half-built.
+	 */
+	ent = &SharedBufEntries[e];
+	ent->key = *tagPtr;
+	ent->id = buf_id;
+	ent->next = *bucket;
+	pg_write_barrier();
+	*bucket = e;
 
 	return -1;
 }
@@ -150,15 +266,27 @@ BufTableInsert(BufferTag *tagPtr, uint32 hashcode, int buf_id)
 void
 BufTableDelete(BufferTag *tagPtr, uint32 hashcode)
 {
-	BufferLookupEnt *result;
+	volatile int *prevnext = &SharedBufBuckets[hashcode & (nbuckets - 1)];
+	int			e;
 
-	result = (BufferLookupEnt *)
-		hash_search_with_hash_value(SharedBufHash,
-									(void *) tagPtr,
-									hashcode,
-									HASH_REMOVE,
-									NULL);
+	for (e = *prevnext; e >= 0; e = *prevnext)
+	{
+		if (BUFFERTAGS_EQUAL(SharedBufEntries[e].key, *tagPtr))
+			break;
+		prevnext = &SharedBufEntries[e].next;
+	}
 
-	if (!result)				/* shouldn't happen */
+	if (e < 0)					/* shouldn't happen */
 		elog(ERROR, "shared buffer hash table corrupted");
+
+	/*
+	 * Unlink the entry.  A reader that is looking at it can still follow its
+	 * next link until it's reused.
+	 */
+	*prevnext = SharedBufEntries[e].next;
+
+	SpinLockAcquire(&SharedBufTable->mutex);
+	SharedBufEntries[e].next = SharedBufTable->freeList;
+	SharedBufTable->freeList = e;
+	SpinLockRelease(&SharedBufTable->mutex);
 }
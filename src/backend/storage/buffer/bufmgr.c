@@ -66,6 +66,13 @@
 
 #define DROP_RELS_BSEARCH_THRESHOLD		20
 
+/*
+ * Waiting for another backend's buffer header lock: spin this many times
+ * between 1ms sleeps, and give up after this many sleeps (about 2 minutes)
+ */
+#define BUF_HDR_SPINS_PER_DELAY		100
+#define BUF_HDR_NUM_DELAYS			120000
+
 /* GUC variables */
 bool		zero_damaged_pages = false;
 int			bgwriter_lru_maxpages = 100;
@@ -94,12 +101,15 @@ static Buffer ReadBuffer_common(SMgrRelation reln, char relpersistence,
 static bool PinBuffer(volatile BufferDesc *buf, BufferAccessStrategy strategy);
 static void PinBuffer_Locked(volatile BufferDesc *buf);
 static void UnpinBuffer(volatile BufferDesc *buf, bool fixOwner);
+#ifdef HAVE_PG_ATOMICS
+static uint32 WaitBufHdrUnlocked(volatile BufferDesc *buf);
+#endif
 static void BufferSync(int flags);
 static int	SyncOneBuffer(int buf_id, bool skip_recently_used);
 static void WaitIO(volatile BufferDesc *buf);
 static bool StartBufferIO(volatile BufferDesc *buf, bool forInput);
 static void TerminateBufferIO(volatile BufferDesc *buf, bool clear_dirty,
-				  int set_flag_bits);
+				  uint32 set_flag_bits);
 static void shared_buffer_write_error_callback(void *arg);
 static void local_buffer_write_error_callback(void *arg);
 static volatile BufferDesc *BufferAlloc(SMgrRelation smgr,
@@ -146,21 +156,21 @@ PrefetchBuffer(Relation reln, ForkNumber forkNum, BlockNumber blockNum)
 	{
 		BufferTag	newTag;		/* identity of requested block */
 		uint32		newHash;	/* hash value for newTag */
-		LWLockId	newPartitionLock;	/* buffer partition lock for it */
 		int			buf_id;
 
 		/* create a tag so we can lookup the buffer */
 		INIT_BUFFERTAG(newTag, reln->rd_smgr->smgr_rnode.node,
 					   forkNum, blockNum);
 
-		/* determine its hash code and partition lock ID */
+		/* determine its hash code */
 		newHash = BufTableHashCode(&newTag);
-		newPartitionLock = BufMappingPartitionLock(newHash);
 
-		/* see if the block is in the buffer pool already */
-		LWLockAcquire(newPartitionLock, LW_SHARED);
+		/*
+		 * See if the block is in the buffer pool already.  This is only a
+		 * hint, so there's no need for the mapping lock: the worst that can
+		 * happen is a needless or missed prefetch.
+		 */
 		buf_id = BufTableLookup(&newTag, newHash);
-		LWLockRelease(newPartitionLock);
 
 		/* If not in buffers, initiate prefetch */
 		if (buf_id < 0)
@@ -392,8 +402,8 @@ ReadBuffer_common(SMgrRelation smgr, char relpersistence, ForkNumber forkNum,
 		if (isLocalBuf)
 		{
 			/* Only need to adjust flags */
-			Assert(bufHdr->flags & BM_VALID);
-			bufHdr->flags &= ~BM_VALID;
+			Assert(bufHdr->state & BM_VALID);
+			bufHdr->state &= ~BM_VALID;
 		}
 		else
 		{
@@ -405,8 +415,8 @@ ReadBuffer_common(SMgrRelation smgr, char relpersistence, ForkNumber forkNum,
 			do
 			{
 				LockBufHdr(bufHdr);
-				Assert(bufHdr->flags & BM_VALID);
-				bufHdr->flags &= ~BM_VALID;
+				Assert(bufHdr->state & BM_VALID);
+				bufHdr->state &= ~BM_VALID;
 				UnlockBufHdr(bufHdr);
 			} while (!StartBufferIO(bufHdr, true));
 		}
@@ -424,7 +434,7 @@ ReadBuffer_common(SMgrRelation smgr, char relpersistence, ForkNumber forkNum,
 	 * it's not been recycled) but come right back here to try smgrextend
 	 * again.
 	 */
-	Assert(!(bufHdr->flags & BM_VALID));		/* spinlock not needed */
+	Assert(!(bufHdr->state & BM_VALID));		/* spinlock not needed */
 
 	bufBlock = isLocalBuf ? LocalBufHdrGetBlock(bufHdr) : BufHdrGetBlock(bufHdr);
 
@@ -486,7 +496,7 @@ ReadBuffer_common(SMgrRelation smgr, char relpersistence, ForkNumber forkNum,
 	if (isLocalBuf)
 	{
 		/* Only need to adjust flags */
-		bufHdr->flags |= BM_VALID;
+		bufHdr->state |= BM_VALID;
 	}
 	else
 	{
@@ -544,6 +554,7 @@ BufferAlloc(SMgrRelation smgr, char relpersistence, ForkNumber forkNum,
 	int			buf_id;
 	volatile BufferDesc *buf;
 	bool		valid;
+	bool		found;
 
 	/* create a tag so we can lookup the buffer */
 	INIT_BUFFERTAG(newTag, smgr->smgr_rnode.node, forkNum, blockNum);
@@ -552,23 +563,51 @@ BufferAlloc(SMgrRelation smgr, char relpersistence, ForkNumber forkNum,
 	newHash = BufTableHashCode(&newTag);
 	newPartitionLock = BufMappingPartitionLock(newHash);
 
-	/* see if the block is in the buffer pool already */
-	LWLockAcquire(newPartitionLock, LW_SHARED);
+	/*
+	 * See if the block is in the buffer pool already.  We first look without
+	 * the mapping lock.  The entry we find might be out of date by the time
+	 * we have pinned the buffer, but once it's pinned nobody can change its
+	 * tag, so if the tag is still ours we have the right buffer.  If not, or
+	 * if we didn't find the block at all, look again holding the lock.
+	 */
+	found = false;
 	buf_id = BufTableLookup(&newTag, newHash);
 	if (buf_id >= 0)
 	{
-		/*
-		 * Found it.  Now, pin the buffer so no one can steal it from the
-		 * buffer pool, and check to see if the correct data has been loaded
-		 * into the buffer.
-		 */
 		buf = &BufferDescriptors[buf_id];
 
 		valid = PinBuffer(buf, strategy);
 
+		if ((buf->state & BM_TAG_VALID) && BUFFERTAGS_EQUAL(buf->tag, newTag))
+			found = true;
+		else
+			UnpinBuffer(buf, true);
+	}
+
+	if (!found)
+	{
+		LWLockAcquire(newPartitionLock, LW_SHARED);
+		buf_id = BufTableLookup(&newTag, newHash);
+		if (buf_id >= 0)
+		{
+			/*
+			 * Found it.  Now, pin the buffer so no one can steal it from the
+			 * buffer pool, and check to see if the correct data has been
+			 * loaded into the buffer.
+			 */
+			buf = &BufferDescriptors[buf_id];
+
+			valid = PinBuffer(buf, strategy);
+
+			found = true;
+		}
+
 		/* Can release the mapping lock as soon as we've pinned it */
 		LWLockRelease(newPartitionLock);
+	}
 
+	if (found)
+	{
 		*foundPtr = TRUE;
 
 		if (!valid)
@@ -595,35 +634,24 @@ BufferAlloc(SMgrRelation smgr, char relpersistence, ForkNumber forkNum,
 
 	/*
 	 * Didn't find it in the buffer pool.  We'll have to initialize a new
-	 * buffer.	Remember to unlock the mapping lock while doing the work.
+	 * buffer.  Loop here in case we have to try another victim buffer.
 	 */
-	LWLockRelease(newPartitionLock);
-
-	/* Loop here in case we have to try another victim buffer */
 	for (;;)
 	{
-		bool		lock_held;
-
 		/*
 		 * Select a victim buffer.	The buffer is returned with its header
-		 * spinlock still held!  Also (in most cases) the BufFreelistLock is
-		 * still held, since it would be bad to hold the spinlock while
-		 * possibly waking up other processes.
+		 * spinlock still held!
 		 */
-		buf = StrategyGetBuffer(strategy, &lock_held);
+		buf = StrategyGetBuffer(strategy);
 
-		Assert(buf->refcount == 0);
+		Assert(BUF_STATE_GET_REFCOUNT(buf->state) == 0);
 
 		/* Must copy buffer flags while we still hold the spinlock */
-		oldFlags = buf->flags;
+		oldFlags = buf->state;
 
 		/* Pin the buffer and then release the buffer spinlock */
 		PinBuffer_Locked(buf);
 
-		/* Now it's safe to release the freelist lock */
-		if (lock_held)
-			LWLockRelease(BufFreelistLock);
-
 		/*
 		 * If the buffer was dirty, try to write it out.  There is a race
 		 * condition here, in that someone might dirty it after we released it
@@ -813,8 +841,8 @@ BufferAlloc(SMgrRelation smgr, char relpersistence, ForkNumber forkNum,
 		 * recycle this buffer; we must undo everything we've done and start
 		 * over with a new victim buffer.
 		 */
-		oldFlags = buf->flags;
-		if (buf->refcount == 1 && !(oldFlags & BM_DIRTY))
+		oldFlags = buf->state;
+		if (BUF_STATE_GET_REFCOUNT(oldFlags) == 1 && !(oldFlags & BM_DIRTY))
 			break;
 
 		UnlockBufHdr(buf);
@@ -835,12 +863,13 @@ BufferAlloc(SMgrRelation smgr, char relpersistence, ForkNumber forkNum,
 	 * 1 so that the buffer can survive one clock-sweep pass.)
 	 */
 	buf->tag = newTag;
-	buf->flags &= ~(BM_VALID | BM_DIRTY | BM_JUST_DIRTIED | BM_CHECKPOINT_NEEDED | BM_IO_ERROR | BM_PERMANENT);
+	buf->state &= ~(BM_VALID | BM_DIRTY | BM_JUST_DIRTIED |
+					BM_CHECKPOINT_NEEDED | BM_IO_ERROR | BM_PERMANENT);
 	if (relpersistence == RELPERSISTENCE_PERMANENT)
-		buf->flags |= BM_TAG_VALID | BM_PERMANENT;
+		buf->state |= BM_TAG_VALID | BM_PERMANENT;
 	else
-		buf->flags |= BM_TAG_VALID;
-	buf->usage_count = 1;
+		buf->state |= BM_TAG_VALID;
+	buf->state = (buf->state & ~BUF_USAGECOUNT_MASK) | BUF_USAGECOUNT_ONE;
 
 	UnlockBufHdr(buf);
 
@@ -932,7 +961,7 @@ retry:
 	 * yet done StartBufferIO, WaitIO will fall through and we'll effectively
 	 * be busy-looping here.)
 	 */
-	if (buf->refcount != 0)
+	if (BUF_STATE_GET_REFCOUNT(buf->state) != 0)
 	{
 		UnlockBufHdr(buf);
 		LWLockRelease(oldPartitionLock);
@@ -947,10 +976,9 @@ retry:
 	 * Clear out the buffer's tag and flags.  We must do this to ensure that
 	 * linear scans of the buffer array don't think the buffer is valid.
 	 */
-	oldFlags = buf->flags;
+	oldFlags = buf->state;
 	CLEAR_BUFFERTAG(buf->tag);
-	buf->flags = 0;
-	buf->usage_count = 0;
+	buf->state &= BM_LOCKED;	/* refcount is zero; keep the header lock */
 
 	UnlockBufHdr(buf);
 
@@ -1002,12 +1030,12 @@ MarkBufferDirty(Buffer buffer)
 
 	LockBufHdr(bufHdr);
 
-	Assert(bufHdr->refcount > 0);
+	Assert(BUF_STATE_GET_REFCOUNT(bufHdr->state) > 0);
 
 	/*
 	 * If the buffer was not dirty already, do vacuum accounting.
 	 */
-	if (!(bufHdr->flags & BM_DIRTY))
+	if (!(bufHdr->state & BM_DIRTY))
 	{
 		VacuumPageDirty++;
 		pgBufferUsage.shared_blks_dirtied++;
@@ -1015,7 +1043,7 @@ MarkBufferDirty(Buffer buffer)
 			VacuumCostBalance += VacuumCostPageDirty;
 	}
 
-	bufHdr->flags |= (BM_DIRTY | BM_JUST_DIRTIED);
+	bufHdr->state |= (BM_DIRTY | BM_JUST_DIRTIED);
 
 	UnlockBufHdr(bufHdr);
 }
@@ -1087,6 +1115,9 @@ ReleaseAndReadBuffer(Buffer buffer,
  *
  * Returns TRUE if buffer is BM_VALID, else FALSE.	This provision allows
  * some callers to avoid an extra spinlock cycle.
+ *
+ * Where atomic operations are available, we don't take the buffer header
+ * lock at all, see buf_internals.h.
  */
 static bool
 PinBuffer(volatile BufferDesc *buf, BufferAccessStrategy strategy)
@@ -1096,20 +1127,54 @@ PinBuffer(volatile BufferDesc *buf, BufferAccessStrategy strategy)
 
 	if (PrivateRefCount[b] == 0)
 	{
+#ifdef HAVE_PG_ATOMICS
+		uint32		oldstate;
+		uint32		newstate;
+
+		/*
+		 * Bump the refcount and usage count with a compare-and-swap, so we
+		 * don't need the header lock.  We only have to wait while somebody
+		 * else holds it.
+		 */
+		oldstate = buf->state;
+		for (;;)
+		{
+			if (oldstate & BM_LOCKED)
+				oldstate = WaitBufHdrUnlocked(buf);
+
+			newstate = oldstate + BUF_REFCOUNT_ONE;
+			if (strategy == NULL)
+			{
+				if (BUF_STATE_GET_USAGECOUNT(oldstate) < BM_MAX_USAGE_COUNT)
+					newstate += BUF_USAGECOUNT_ONE;
+			}
+			else
+			{
+				if (BUF_STATE_GET_USAGECOUNT(oldstate) == 0)
+					newstate += BUF_USAGECOUNT_ONE;
+			}
+
+			if (pg_atomic_compare_exchange(&buf->state, oldstate, newstate))
+				break;
+			oldstate = buf->state;
+		}
+		result = (newstate & BM_VALID) != 0;
+#else
 		LockBufHdr(buf);
-		buf->refcount++;
+		buf->state += BUF_REFCOUNT_ONE;
 		if (strategy == NULL)
 		{
-			if (buf->usage_count < BM_MAX_USAGE_COUNT)
-				buf->usage_count++;
+			if (BUF_STATE_GET_USAGECOUNT(buf->state) < BM_MAX_USAGE_COUNT)
+				buf->state += BUF_USAGECOUNT_ONE;
 		}
 		else
 		{
-			if (buf->usage_count == 0)
-				buf->usage_count = 1;
+			if (BUF_STATE_GET_USAGECOUNT(buf->state) == 0)
+				buf->state += BUF_USAGECOUNT_ONE;
 		}
-		result = (buf->flags & BM_VALID) != 0;
+		result = (buf->state & BM_VALID) != 0;
 		UnlockBufHdr(buf);
+#endif
 	}
 	else
 	{
@@ -1142,7 +1207,7 @@ PinBuffer_Locked(volatile BufferDesc *buf)
 	int			b = buf->buf_id;
 
 	if (PrivateRefCount[b] == 0)
-		buf->refcount++;
+		buf->state += BUF_REFCOUNT_ONE;
 	UnlockBufHdr(buf);
 	PrivateRefCount[b]++;
 	Assert(PrivateRefCount[b] > 0);
@@ -1171,24 +1236,51 @@ UnpinBuffer(volatile BufferDesc *buf, bool fixOwner)
 	PrivateRefCount[b]--;
 	if (PrivateRefCount[b] == 0)
 	{
+#ifdef HAVE_PG_ATOMICS
+		uint32		oldstate;
+		uint32		newstate;
+#endif
+
 		/* I'd better not still hold any locks on the buffer */
 		Assert(!LWLockHeldByMe(buf->content_lock));
 		Assert(!LWLockHeldByMe(buf->io_in_progress_lock));
 
+#ifdef HAVE_PG_ATOMICS
+		/* Decrement the shared reference count, as in PinBuffer */
+		oldstate = buf->state;
+		for (;;)
+		{
+			if (oldstate & BM_LOCKED)
+				oldstate = WaitBufHdrUnlocked(buf);
+
+			Assert(BUF_STATE_GET_REFCOUNT(oldstate) > 0);
+			newstate = oldstate - BUF_REFCOUNT_ONE;
+
+			if (pg_atomic_compare_exchange(&buf->state, oldstate, newstate))
+				break;
+			oldstate = buf->state;
+		}
+
+		/* We need the header lock to look at the waiter, if there is one */
+		if (!(newstate & BM_PIN_COUNT_WAITER))
+			return;
+		LockBufHdr(buf);
+#else
 		LockBufHdr(buf);
 
 		/* Decrement the shared reference count */
-		Assert(buf->refcount > 0);
-		buf->refcount--;
+		Assert(BUF_STATE_GET_REFCOUNT(buf->state) > 0);
+		buf->state -= BUF_REFCOUNT_ONE;
+#endif
 
 		/* Support LockBufferForCleanup() */
-		if ((buf->flags & BM_PIN_COUNT_WAITER) &&
-			buf->refcount == 1)
+		if ((buf->state & BM_PIN_COUNT_WAITER) &&
+			BUF_STATE_GET_REFCOUNT(buf->state) == 1)
 		{
 			/* we just released the last pin other than the waiter's */
 			int			wait_backend_pid = buf->wait_backend_pid;
 
-			buf->flags &= ~BM_PIN_COUNT_WAITER;
+			buf->state &= ~BM_PIN_COUNT_WAITER;
 			UnlockBufHdr(buf);
 			ProcSendSignal(wait_backend_pid);
 		}
@@ -1197,6 +1289,51 @@ UnpinBuffer(volatile BufferDesc *buf, bool fixOwner)
 	}
 }
 
+#ifdef HAVE_PG_ATOMICS
+
+/*
+ * LockBufHdr -- lock a shared buffer header, by setting BM_LOCKED in its
+ * state word.
+ */
+void
+LockBufHdr(volatile BufferDesc *desc)
+{
+	while (pg_atomic_fetch_or(&desc->state, BM_LOCKED) & BM_LOCKED)
+		(void) WaitBufHdrUnlocked(desc);
+}
+
+/*
+ * WaitBufHdrUnlocked -- wait until nobody holds the buffer header lock, and
+ * return the state word as it was then.
+ *
+ * The header lock is only ever held for a few instructions, so we spin like
+ * s_lock() does, sleeping now and then in case the holder isn't running.
+ */
+static uint32
+WaitBufHdrUnlocked(volatile BufferDesc *buf)
+{
+	uint32		state;
+	int			spins = 0;
+	int			delays = 0;
+
+	while ((state = buf->state) & BM_LOCKED)
+	{
+		SPIN_DELAY();
+		if (++spins >= BUF_HDR_SPINS_PER_DELAY)
+		{
+			if (++delays > BUF_HDR_NUM_DELAYS)
+				elog(PANIC, "stuck buffer header lock on buffer %d",
+					 buf->buf_id);
+			pg_usleep(1000L);
+			spins = 0;
+		}
+	}
+
+	return state;
+}
+
+#endif   /* HAVE_PG_ATOMICS */
+
 /*
  * BufferSync -- Write out all dirty buffers in the pool.
  *
@@ -1252,9 +1389,9 @@ BufferSync(int flags)
 		 */
 		LockBufHdr(bufHdr);
 
-		if ((bufHdr->flags & mask) == mask)
+		if ((bufHdr->state & mask) == mask)
 		{
-			bufHdr->flags |= BM_CHECKPOINT_NEEDED;
+			bufHdr->state |= BM_CHECKPOINT_NEEDED;
 			num_to_write++;
 		}
 
@@ -1293,7 +1430,7 @@ BufferSync(int flags)
 		 * write the buffer though we didn't need to.  It doesn't seem worth
 		 * guarding against this, though.
 		 */
-		if (bufHdr->flags & BM_CHECKPOINT_NEEDED)
+		if (bufHdr->state & BM_CHECKPOINT_NEEDED)
 		{
 			if (SyncOneBuffer(buf_id, false) & BUF_WRITTEN)
 			{
@@ -1665,7 +1802,8 @@ SyncOneBuffer(int buf_id, bool skip_recently_used)
 	 */
 	LockBufHdr(bufHdr);
 
-	if (bufHdr->refcount == 0 && bufHdr->usage_count == 0)
+	if (BUF_STATE_GET_REFCOUNT(bufHdr->state) == 0 &&
+		BUF_STATE_GET_USAGECOUNT(bufHdr->state) == 0)
 		result |= BUF_REUSABLE;
 	else if (skip_recently_used)
 	{
@@ -1674,7 +1812,7 @@ SyncOneBuffer(int buf_id, bool skip_recently_used)
 		return result;
 	}
 
-	if (!(bufHdr->flags & BM_VALID) || !(bufHdr->flags & BM_DIRTY))
+	if (!(bufHdr->state & BM_VALID) || !(bufHdr->state & BM_DIRTY))
 	{
 		/* It's clean, so nothing to do */
 		UnlockBufHdr(bufHdr);
@@ -1806,8 +1944,8 @@ PrintBufferLeakWarning(Buffer buffer)
 		 "buffer refcount leak: [%03d] "
 		 "(rel=%s, blockNum=%u, flags=0x%x, refcount=%u %d)",
 		 buffer, path,
-		 buf->tag.blockNum, buf->flags,
-		 buf->refcount, loccount);
+		 buf->tag.blockNum, buf->state & BUF_FLAG_MASK,
+		 BUF_STATE_GET_REFCOUNT(buf->state), loccount);
 	pfree(path);
 }
 
@@ -1953,7 +2091,7 @@ FlushBuffer(volatile BufferDesc *buf, SMgrRelation reln)
 	recptr = BufferGetLSN(buf);
 
 	/* To check if block content changes while flushing. - vadim 01/17/97 */
-	buf->flags &= ~BM_JUST_DIRTIED;
+	buf->state &= ~BM_JUST_DIRTIED;
 	UnlockBufHdr(buf);
 
 	/*
@@ -1973,7 +2111,7 @@ FlushBuffer(volatile BufferDesc *buf, SMgrRelation reln)
 	 * consequences.  To make sure that can't happen, skip the flush if the
 	 * buffer isn't permanent.
 	 */
-	if (buf->flags & BM_PERMANENT)
+	if (buf->state & BM_PERMANENT)
 		XLogFlush(recptr);
 
 	/*
@@ -2063,7 +2201,7 @@ BufferIsPermanent(Buffer buffer)
 	 * old value or the new value, but not random garbage.
 	 */
 	bufHdr = &BufferDescriptors[buffer - 1];
-	return (bufHdr->flags & BM_PERMANENT) != 0;
+	return (bufHdr->state & BM_PERMANENT) != 0;
 }
 
 /*
@@ -2331,8 +2469,8 @@ PrintBufferDescs(void)
 			 "blockNum=%u, flags=0x%x, refcount=%u %d)",
 			 i, buf->freeNext,
 		  relpathbackend(buf->tag.rnode, InvalidBackendId, buf->tag.forkNum),
-			 buf->tag.blockNum, buf->flags,
-			 buf->refcount, PrivateRefCount[i]);
+			 buf->tag.blockNum, buf->state & BUF_FLAG_MASK,
+			 BUF_STATE_GET_REFCOUNT(buf->state), PrivateRefCount[i]);
 	}
 }
 #endif
@@ -2354,8 +2492,8 @@ PrintPinnedBufs(void)
 				 "blockNum=%u, flags=0x%x, refcount=%u %d)",
 				 i, buf->freeNext,
 				 relpath(buf->tag.rnode, buf->tag.forkNum),
-				 buf->tag.blockNum, buf->flags,
-				 buf->refcount, PrivateRefCount[i]);
+				 buf->tag.blockNum, buf->state & BUF_FLAG_MASK,
+				 BUF_STATE_GET_REFCOUNT(buf->state), PrivateRefCount[i]);
 		}
 	}
 }
@@ -2395,7 +2533,7 @@ FlushRelationBuffers(Relation rel)
 		{
 			bufHdr = &LocalBufferDescriptors[i];
 			if (RelFileNodeEquals(bufHdr->tag.rnode, rel->rd_node) &&
-				(bufHdr->flags & BM_VALID) && (bufHdr->flags & BM_DIRTY))
+				(bufHdr->state & BM_VALID) && (bufHdr->state & BM_DIRTY))
 			{
 				ErrorContextCallback	errcallback;
 				Page					localpage;
@@ -2416,7 +2554,7 @@ FlushRelationBuffers(Relation rel)
 						  localpage,
 						  false);
 
-				bufHdr->flags &= ~(BM_DIRTY | BM_JUST_DIRTIED);
+				bufHdr->state &= ~(BM_DIRTY | BM_JUST_DIRTIED);
 
 				/* Pop the error context stack */
 				error_context_stack = errcallback.previous;
@@ -2442,7 +2580,7 @@ FlushRelationBuffers(Relation rel)
 
 		LockBufHdr(bufHdr);
 		if (RelFileNodeEquals(bufHdr->tag.rnode, rel->rd_node) &&
-			(bufHdr->flags & BM_VALID) && (bufHdr->flags & BM_DIRTY))
+			(bufHdr->state & BM_VALID) && (bufHdr->state & BM_DIRTY))
 		{
 			PinBuffer_Locked(bufHdr);
 			LWLockAcquire(bufHdr->content_lock, LW_SHARED);
@@ -2492,7 +2630,7 @@ FlushDatabaseBuffers(Oid dbid)
 
 		LockBufHdr(bufHdr);
 		if (bufHdr->tag.rnode.dbNode == dbid &&
-			(bufHdr->flags & BM_VALID) && (bufHdr->flags & BM_DIRTY))
+			(bufHdr->state & BM_VALID) && (bufHdr->state & BM_DIRTY))
 		{
 			PinBuffer_Locked(bufHdr);
 			LWLockAcquire(bufHdr->content_lock, LW_SHARED);
@@ -2613,7 +2751,7 @@ MarkBufferDirtyHint(Buffer buffer)
 	 * is only intended to be used in cases where failing to write out the data
 	 * would be harmless anyway, it doesn't really matter.
 	 */
-	if ((bufHdr->flags & (BM_DIRTY | BM_JUST_DIRTIED)) !=
+	if ((bufHdr->state & (BM_DIRTY | BM_JUST_DIRTIED)) !=
 		(BM_DIRTY | BM_JUST_DIRTIED))
 	{
 		XLogRecPtr	lsn = InvalidXLogRecPtr;
@@ -2631,7 +2769,7 @@ MarkBufferDirtyHint(Buffer buffer)
 		 * included when we call XLogInsert() since the value changes
 		 * dynamically.
 		 */
-		if (DataChecksumsEnabled() && (bufHdr->flags & BM_PERMANENT))
+		if (DataChecksumsEnabled() && (bufHdr->state & BM_PERMANENT))
 		{
 			/*
 			 * If we're in recovery we cannot dirty a page because of a hint.
@@ -2671,8 +2809,8 @@ MarkBufferDirtyHint(Buffer buffer)
 		}
 
 		LockBufHdr(bufHdr);
-		Assert(bufHdr->refcount > 0);
-		if (!(bufHdr->flags & BM_DIRTY))
+		Assert(BUF_STATE_GET_REFCOUNT(bufHdr->state) > 0);
+		if (!(bufHdr->state & BM_DIRTY))
 		{
 			dirtied = true;		/* Means "will be dirtied by this action" */
 
@@ -2692,7 +2830,7 @@ MarkBufferDirtyHint(Buffer buffer)
 			if (!XLogRecPtrIsInvalid(lsn))
 				PageSetLSN(page, lsn);
 		}
-		bufHdr->flags |= (BM_DIRTY | BM_JUST_DIRTIED);
+		bufHdr->state |= (BM_DIRTY | BM_JUST_DIRTIED);
 		UnlockBufHdr(bufHdr);
 
 		if (delayChkpt)
@@ -2729,9 +2867,9 @@ UnlockBuffers(void)
 		 * Don't complain if flag bit not set; it could have been reset but we
 		 * got a cancel/die interrupt before getting the signal.
 		 */
-		if ((buf->flags & BM_PIN_COUNT_WAITER) != 0 &&
+		if ((buf->state & BM_PIN_COUNT_WAITER) != 0 &&
 			buf->wait_backend_pid == MyProcPid)
-			buf->flags &= ~BM_PIN_COUNT_WAITER;
+			buf->state &= ~BM_PIN_COUNT_WAITER;
 
 		UnlockBufHdr(buf);
 
@@ -2828,22 +2966,22 @@ LockBufferForCleanup(Buffer buffer)
 		/* Try to acquire lock */
 		LockBuffer(buffer, BUFFER_LOCK_EXCLUSIVE);
 		LockBufHdr(bufHdr);
-		Assert(bufHdr->refcount > 0);
-		if (bufHdr->refcount == 1)
+		Assert(BUF_STATE_GET_REFCOUNT(bufHdr->state) > 0);
+		if (BUF_STATE_GET_REFCOUNT(bufHdr->state) == 1)
 		{
 			/* Successfully acquired exclusive lock with pincount 1 */
 			UnlockBufHdr(bufHdr);
 			return;
 		}
 		/* Failed, so mark myself as waiting for pincount 1 */
-		if (bufHdr->flags & BM_PIN_COUNT_WAITER)
+		if (bufHdr->state & BM_PIN_COUNT_WAITER)
 		{
 			UnlockBufHdr(bufHdr);
 			LockBuffer(buffer, BUFFER_LOCK_UNLOCK);
 			elog(ERROR, "multiple backends attempting to wait for pincount 1");
 		}
 		bufHdr->wait_backend_pid = MyProcPid;
-		bufHdr->flags |= BM_PIN_COUNT_WAITER;
+		bufHdr->state |= BM_PIN_COUNT_WAITER;
 		PinCountWaitBuf = bufHdr;
 		UnlockBufHdr(bufHdr);
 		LockBuffer(buffer, BUFFER_LOCK_UNLOCK);
@@ -2924,8 +3062,8 @@ ConditionalLockBufferForCleanup(Buffer buffer)
 
 	bufHdr = &BufferDescriptors[buffer - 1];
 	LockBufHdr(bufHdr);
-	Assert(bufHdr->refcount > 0);
-	if (bufHdr->refcount == 1)
+	Assert(BUF_STATE_GET_REFCOUNT(bufHdr->state) > 0);
+	if (BUF_STATE_GET_REFCOUNT(bufHdr->state) == 1)
 	{
 		/* Successfully acquired exclusive lock with pincount 1 */
 		UnlockBufHdr(bufHdr);
@@ -2971,7 +3109,7 @@ WaitIO(volatile BufferDesc *buf)
 		 * play it safe.
 		 */
 		LockBufHdr(buf);
-		sv_flags = buf->flags;
+		sv_flags = buf->state;
 		UnlockBufHdr(buf);
 		if (!(sv_flags & BM_IO_IN_PROGRESS))
 			break;
@@ -3013,7 +3151,7 @@ StartBufferIO(volatile BufferDesc *buf, bool forInput)
 
 		LockBufHdr(buf);
 
-		if (!(buf->flags & BM_IO_IN_PROGRESS))
+		if (!(buf->state & BM_IO_IN_PROGRESS))
 			break;
 
 		/*
@@ -3029,7 +3167,7 @@ StartBufferIO(volatile BufferDesc *buf, bool forInput)
 
 	/* Once we get here, there is definitely no I/O active on this buffer */
 
-	if (forInput ? (buf->flags & BM_VALID) : !(buf->flags & BM_DIRTY))
+	if (forInput ? (buf->state & BM_VALID) : !(buf->state & BM_DIRTY))
 	{
 		/* someone else already did the I/O */
 		UnlockBufHdr(buf);
@@ -3037,7 +3175,7 @@ StartBufferIO(volatile BufferDesc *buf, bool forInput)
 		return false;
 	}
 
-	buf->flags |= BM_IO_IN_PROGRESS;
+	buf->state |= BM_IO_IN_PROGRESS;
 
 	UnlockBufHdr(buf);
 
@@ -3066,17 +3204,17 @@ StartBufferIO(volatile BufferDesc *buf, bool forInput)
  */
 static void
 TerminateBufferIO(volatile BufferDesc *buf, bool clear_dirty,
-				  int set_flag_bits)
+				  uint32 set_flag_bits)
 {
 	Assert(buf == InProgressBuf);
 
 	LockBufHdr(buf);
 
-	Assert(buf->flags & BM_IO_IN_PROGRESS);
-	buf->flags &= ~(BM_IO_IN_PROGRESS | BM_IO_ERROR);
-	if (clear_dirty && !(buf->flags & BM_JUST_DIRTIED))
-		buf->flags &= ~(BM_DIRTY | BM_CHECKPOINT_NEEDED);
-	buf->flags |= set_flag_bits;
+	Assert(buf->state & BM_IO_IN_PROGRESS);
+	buf->state &= ~(BM_IO_IN_PROGRESS | BM_IO_ERROR);
+	if (clear_dirty && !(buf->state & BM_JUST_DIRTIED))
+		buf->state &= ~(BM_DIRTY | BM_CHECKPOINT_NEEDED);
+	buf->state |= set_flag_bits;
 
 	UnlockBufHdr(buf);
 
@@ -3110,19 +3248,19 @@ AbortBufferIO(void)
 		LWLockAcquire(buf->io_in_progress_lock, LW_EXCLUSIVE);
 
 		LockBufHdr(buf);
-		Assert(buf->flags & BM_IO_IN_PROGRESS);
+		Assert(buf->state & BM_IO_IN_PROGRESS);
 		if (IsForInput)
 		{
-			Assert(!(buf->flags & BM_DIRTY));
+			Assert(!(buf->state & BM_DIRTY));
 			/* We'd better not think buffer is valid yet */
-			Assert(!(buf->flags & BM_VALID));
+			Assert(!(buf->state & BM_VALID));
 			UnlockBufHdr(buf);
 		}
 		else
 		{
 			BufFlags	sv_flags;
 
-			sv_flags = buf->flags;
+			sv_flags = buf->state;
 			Assert(sv_flags & BM_DIRTY);
 			UnlockBufHdr(buf);
 			/* Issue notice if this is not the first failure... */
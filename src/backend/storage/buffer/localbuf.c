@@ -132,13 +132,13 @@ LocalBufferAlloc(SMgrRelation smgr, ForkNumber forkNum, BlockNumber blockNum,
 		/* this part is equivalent to PinBuffer for a shared buffer */
 		if (LocalRefCount[b] == 0)
 		{
-			if (bufHdr->usage_count < BM_MAX_USAGE_COUNT)
-				bufHdr->usage_count++;
+			if (BUF_STATE_GET_USAGECOUNT(bufHdr->state) < BM_MAX_USAGE_COUNT)
+				bufHdr->state += BUF_USAGECOUNT_ONE;
 		}
 		LocalRefCount[b]++;
 		ResourceOwnerRememberBuffer(CurrentResourceOwner,
 									BufferDescriptorGetBuffer(bufHdr));
-		if (bufHdr->flags & BM_VALID)
+		if (bufHdr->state & BM_VALID)
 			*foundPtr = TRUE;
 		else
 		{
@@ -170,9 +170,9 @@ LocalBufferAlloc(SMgrRelation smgr, ForkNumber forkNum, BlockNumber blockNum,
 
 		if (LocalRefCount[b] == 0)
 		{
-			if (bufHdr->usage_count > 0)
+			if (BUF_STATE_GET_USAGECOUNT(bufHdr->state) > 0)
 			{
-				bufHdr->usage_count--;
+				bufHdr->state -= BUF_USAGECOUNT_ONE;
 				trycounter = NLocBuffer;
 			}
 			else
@@ -194,7 +194,7 @@ LocalBufferAlloc(SMgrRelation smgr, ForkNumber forkNum, BlockNumber blockNum,
 	 * this buffer is not referenced but it might still be dirty. if that's
 	 * the case, write it out before reusing it!
 	 */
-	if (bufHdr->flags & BM_DIRTY)
+	if (bufHdr->state & BM_DIRTY)
 	{
 		SMgrRelation	oreln;
 		Page			localpage = (char *) LocalBufHdrGetBlock(bufHdr);
@@ -212,7 +212,7 @@ LocalBufferAlloc(SMgrRelation smgr, ForkNumber forkNum, BlockNumber blockNum,
 				  false);
 
 		/* Mark not-dirty now in case we error out below */
-		bufHdr->flags &= ~BM_DIRTY;
+		bufHdr->state &= ~BM_DIRTY;
 
 		pgBufferUsage.local_blks_written++;
 	}
@@ -229,7 +229,7 @@ LocalBufferAlloc(SMgrRelation smgr, ForkNumber forkNum, BlockNumber blockNum,
 	/*
 	 * Update the hash table: remove old entry, if any, and make new one.
 	 */
-	if (bufHdr->flags & BM_TAG_VALID)
+	if (bufHdr->state & BM_TAG_VALID)
 	{
 		hresult = (LocalBufferLookupEnt *)
 			hash_search(LocalBufHash, (void *) &bufHdr->tag,
@@ -238,7 +238,7 @@ LocalBufferAlloc(SMgrRelation smgr, ForkNumber forkNum, BlockNumber blockNum,
 			elog(ERROR, "local buffer hash table corrupted");
 		/* mark buffer invalid just in case hash insert fails */
 		CLEAR_BUFFERTAG(bufHdr->tag);
-		bufHdr->flags &= ~(BM_VALID | BM_TAG_VALID);
+		bufHdr->state &= ~(BM_VALID | BM_TAG_VALID);
 	}
 
 	hresult = (LocalBufferLookupEnt *)
@@ -251,9 +251,9 @@ LocalBufferAlloc(SMgrRelation smgr, ForkNumber forkNum, BlockNumber blockNum,
 	 * it's all ours now.
 	 */
 	bufHdr->tag = newTag;
-	bufHdr->flags &= ~(BM_VALID | BM_DIRTY | BM_JUST_DIRTIED | BM_IO_ERROR);
-	bufHdr->flags |= BM_TAG_VALID;
-	bufHdr->usage_count = 1;
+	bufHdr->state &= ~(BM_VALID | BM_DIRTY | BM_JUST_DIRTIED | BM_IO_ERROR);
+	bufHdr->state &= ~BUF_USAGECOUNT_MASK;
+	bufHdr->state |= BM_TAG_VALID | BUF_USAGECOUNT_ONE;
 
 	*foundPtr = FALSE;
 	return bufHdr;
@@ -281,10 +281,10 @@ MarkLocalBufferDirty(Buffer buffer)
 
 	bufHdr = &LocalBufferDescriptors[bufid];
 
-	if (!(bufHdr->flags & BM_DIRTY))
+	if (!(bufHdr->state & BM_DIRTY))
 		pgBufferUsage.local_blks_dirtied++;
 
-	bufHdr->flags |= BM_DIRTY;
+	bufHdr->state |= BM_DIRTY;
 }
 
 /*
@@ -309,7 +309,7 @@ DropRelFileNodeLocalBuffers(RelFileNode rnode, ForkNumber forkNum,
 		BufferDesc *bufHdr = &LocalBufferDescriptors[i];
 		LocalBufferLookupEnt *hresult;
 
-		if ((bufHdr->flags & BM_TAG_VALID) &&
+		if ((bufHdr->state & BM_TAG_VALID) &&
 			RelFileNodeEquals(bufHdr->tag.rnode, rnode) &&
 			bufHdr->tag.forkNum == forkNum &&
 			bufHdr->tag.blockNum >= firstDelBlock)
@@ -328,8 +328,7 @@ DropRelFileNodeLocalBuffers(RelFileNode rnode, ForkNumber forkNum,
 				elog(ERROR, "local buffer hash table corrupted");
 			/* Mark buffer invalid */
 			CLEAR_BUFFERTAG(bufHdr->tag);
-			bufHdr->flags = 0;
-			bufHdr->usage_count = 0;
+			bufHdr->state = 0;
 		}
 	}
 }
@@ -351,7 +350,7 @@ DropRelFileNodeAllLocalBuffers(RelFileNode rnode)
 		BufferDesc *bufHdr = &LocalBufferDescriptors[i];
 		LocalBufferLookupEnt *hresult;
 
-		if ((bufHdr->flags & BM_TAG_VALID) &&
+		if ((bufHdr->state & BM_TAG_VALID) &&
 			RelFileNodeEquals(bufHdr->tag.rnode, rnode))
 		{
 			if (LocalRefCount[i] != 0)
@@ -368,8 +367,7 @@ DropRelFileNodeAllLocalBuffers(RelFileNode rnode)
 				elog(ERROR, "local buffer hash table corrupted");
 			/* Mark buffer invalid */
 			CLEAR_BUFFERTAG(bufHdr->tag);
-			bufHdr->flags = 0;
-			bufHdr->usage_count = 0;
+			bufHdr->state = 0;
 		}
 	}
 }
@@ -475,10 +473,15 @@ GetLocalBufferStorage(void)
 		/* But not more than what we need for all remaining local bufs */
 		num_bufs = Min(num_bufs, NLocBuffer - total_bufs_allocated);
 		/* And don't overflow MaxAllocSize, either */
-		num_bufs = Min(num_bufs, MaxAllocSize / BLCKSZ);
-
-		cur_block = (char *) MemoryContextAlloc(LocalBufferContext,
-												num_bufs * BLCKSZ);
+		num_bufs = Min(num_bufs,
+					   (MaxAllocSize - ALIGNOF_DIRECT_IO_BUFFER) / BLCKSZ);
+
+		/* Align the buffers for direct I/O, like shared buffers */
+		cur_block = (char *)
+			TYPEALIGN(ALIGNOF_DIRECT_IO_BUFFER,
+					  MemoryContextAlloc(LocalBufferContext,
+										 num_bufs * BLCKSZ +
+										 ALIGNOF_DIRECT_IO_BUFFER));
 		next_buf_in_block = 0;
 		num_bufs_in_block = num_bufs;
 	}
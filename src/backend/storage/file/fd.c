@@ -111,6 +111,13 @@
  */
 int			max_files_per_process = 1000;
 
+/*
+ * GUC parameter: which files to open with O_DIRECT, bypassing the kernel's
+ * cache.  fd.c itself only passes the flag through; md.c and xlog.c decide
+ * when to ask for it.
+ */
+int			direct_io = DIRECT_IO_OFF;
+
 /*
  * Maximum number of file descriptors to open for either VFD entries or
  * AllocateFile/AllocateDir/OpenTransientFile operations.  This is initialized
@@ -118,6 +118,9 @@ typedef struct _MdfdVec
 
 static MemoryContext MdCxt;		/* context for all md.c allocations */
 
+/* extra open() flag for relation files */
+#define MD_DIRECT_FLAG	((direct_io & DIRECT_IO_DATA) ? PG_O_DIRECT : 0)
+
 
 /*
  * In some contexts (currently, standalone backends and the checkpointer)
@@ -185,6 +188,7 @@ static MdfdVec *_mdfd_openseg(SMgrRelation reln, ForkNumber forkno,
 			  BlockNumber segno, int oflags);
 static MdfdVec *_mdfd_getseg(SMgrRelation reln, ForkNumber forkno,
 			 BlockNumber blkno, bool skipFsync, ExtensionBehavior behavior);
+static char *_mdiobuffer(char *buffer);
 static BlockNumber _mdnblocks(SMgrRelation reln, ForkNumber forknum,
 		   MdfdVec *seg);
 
@@ -282,7 +286,9 @@ mdcreate(SMgrRelation reln, ForkNumber forkNum, bool isRedo)
 
 	path = relpath(reln->smgr_rnode, forkNum);
 
-	fd = PathNameOpenFile(path, O_RDWR | O_CREAT | O_EXCL | PG_BINARY, 0600);
+	fd = PathNameOpenFile(path,
+						  O_RDWR | O_CREAT | O_EXCL | PG_BINARY | MD_DIRECT_FLAG,
+						  0600);
 
 	if (fd < 0)
 	{
@@ -295,7 +301,7 @@ mdcreate(SMgrRelation reln, ForkNumber forkNum, bool isRedo)
 		 * already, even if isRedo is not set.	(See also mdopen)
 		 */
 		if (isRedo || IsBootstrapProcessingMode())
-			fd = PathNameOpenFile(path, O_RDWR | PG_BINARY, 0600);
+			fd = PathNameOpenFile(path, O_RDWR | PG_BINARY | MD_DIRECT_FLAG, 0600);
 		if (fd < 0)
 		{
 			/* be sure to report the error reported by create, not open */
@@ -477,6 +483,7 @@ mdextend(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
 	off_t		seekpos;
 	int			nbytes;
 	MdfdVec    *v;
+	char	   *iobuf;
 
 	/* This assert is too expensive to have on normally ... */
 #ifdef CHECK_WRITE_VS_EXTEND
@@ -516,7 +523,11 @@ mdextend(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
 				 errmsg("could not seek to block %u in file \"%s\": %m",
 						blocknum, FilePathName(v->mdfd_vfd))));
 
-	if ((nbytes = FileWrite(v->mdfd_vfd, buffer, BLCKSZ)) != BLCKSZ)
+	iobuf = _mdiobuffer(buffer);
+	if (iobuf != buffer)
+		memcpy(iobuf, buffer, BLCKSZ);
+
+	if ((nbytes = FileWrite(v->mdfd_vfd, iobuf, BLCKSZ)) != BLCKSZ)
 	{
 		if (nbytes < 0)
 			ereport(ERROR,
@@ -562,7 +573,7 @@ mdopen(SMgrRelation reln, ForkNumber forknum, ExtensionBehavior behavior)
 
 	path = relpath(reln->smgr_rnode, forknum);
 
-	fd = PathNameOpenFile(path, O_RDWR | PG_BINARY, 0600);
+	fd = PathNameOpenFile(path, O_RDWR | PG_BINARY | MD_DIRECT_FLAG, 0600);
 
 	if (fd < 0)
 	{
@@ -573,7 +584,9 @@ mdopen(SMgrRelation reln, ForkNumber forknum, ExtensionBehavior behavior)
 		 * substitute for mdcreate() in bootstrap mode only. (See mdcreate)
 		 */
 		if (IsBootstrapProcessingMode())
-			fd = PathNameOpenFile(path, O_RDWR | O_CREAT | O_EXCL | PG_BINARY, 0600);
+			fd = PathNameOpenFile(path,
+						  O_RDWR | O_CREAT | O_EXCL | PG_BINARY | MD_DIRECT_FLAG,
+						  0600);
 		if (fd < 0)
 		{
 			if (behavior == EXTENSION_RETURN_NULL &&
@@ -637,6 +650,10 @@ mdprefetch(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum)
 	off_t		seekpos;
 	MdfdVec    *v;
 
+	/* with direct I/O, a prefetch into the kernel's cache would be wasted */
+	if (direct_io & DIRECT_IO_DATA)
+		return;
+
 	v = _mdfd_getseg(reln, forknum, blocknum, false, EXTENSION_FAIL);
 
 	seekpos = (off_t) BLCKSZ *(blocknum % ((BlockNumber) RELSEG_SIZE));
@@ -658,6 +675,7 @@ mdread(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
 	off_t		seekpos;
 	int			nbytes;
 	MdfdVec    *v;
+	char	   *iobuf;
 
 	TRACE_POSTGRESQL_SMGR_MD_READ_START(forknum, blocknum,
 										reln->smgr_rnode.node.spcNode,
@@ -677,7 +695,12 @@ mdread(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
 				 errmsg("could not seek to block %u in file \"%s\": %m",
 						blocknum, FilePathName(v->mdfd_vfd))));
 
-	nbytes = FileRead(v->mdfd_vfd, buffer, BLCKSZ);
+	iobuf = _mdiobuffer(buffer);
+
+	nbytes = FileRead(v->mdfd_vfd, iobuf, BLCKSZ);
+
+	if (iobuf != buffer && nbytes > 0)
+		memcpy(buffer, iobuf, nbytes);
 
 	TRACE_POSTGRESQL_SMGR_MD_READ_DONE(forknum, blocknum,
 									   reln->smgr_rnode.node.spcNode,
@@ -728,6 +751,7 @@ mdwrite(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
 	off_t		seekpos;
 	int			nbytes;
 	MdfdVec    *v;
+	char	   *iobuf;
 
 	/* This assert is too expensive to have on normally ... */
 #ifdef CHECK_WRITE_VS_EXTEND
@@ -752,7 +776,11 @@ mdwrite(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
 				 errmsg("could not seek to block %u in file \"%s\": %m",
 						blocknum, FilePathName(v->mdfd_vfd))));
 
-	nbytes = FileWrite(v->mdfd_vfd, buffer, BLCKSZ);
+	iobuf = _mdiobuffer(buffer);
+	if (iobuf != buffer)
+		memcpy(iobuf, buffer, BLCKSZ);
+
+	nbytes = FileWrite(v->mdfd_vfd, iobuf, BLCKSZ);
 
 	TRACE_POSTGRESQL_SMGR_MD_WRITE_DONE(forknum, blocknum,
 										reln->smgr_rnode.node.spcNode,
@@ -1675,7 +1703,8 @@ _mdfd_openseg(SMgrRelation reln, ForkNumber forknum, BlockNumber segno,
 	fullpath = _mdfd_segpath(reln, forknum, segno);
 
 	/* open the file */
-	fd = PathNameOpenFile(fullpath, O_RDWR | PG_BINARY | oflags, 0600);
+	fd = PathNameOpenFile(fullpath, O_RDWR | PG_BINARY | MD_DIRECT_FLAG | oflags,
+						  0600);
 
 	pfree(fullpath);
 
@@ -1770,6 +1799,32 @@ _mdfd_getseg(SMgrRelation reln, ForkNumber forknum, BlockNumber blkno,
 	return v;
 }
 
+/*
+ * Return a buffer suitable for direct I/O of one block in place of "buffer"
+ *
+ * With direct I/O, the kernel transfers the data straight to or from the
+ * caller's memory, which must then be aligned.  Shared and local buffers
+ * always are, but some callers read and write pages in palloc'd memory; for
+ * those we use a buffer of our own, and the caller copies the data in or
+ * out.  Without direct I/O, any buffer will do and we return "buffer".
+ */
+static char *
+_mdiobuffer(char *buffer)
+{
+	static char *alignedbuf = NULL;
+
+	if (!(direct_io & DIRECT_IO_DATA) ||
+		(char *) TYPEALIGN(ALIGNOF_DIRECT_IO_BUFFER, buffer) == buffer)
+		return buffer;
+
+	if (alignedbuf == NULL)
+		alignedbuf = (char *)
+			TYPEALIGN(ALIGNOF_DIRECT_IO_BUFFER,
+					  MemoryContextAlloc(MdCxt,
+										 BLCKSZ + ALIGNOF_DIRECT_IO_BUFFER));
+	return alignedbuf;
+}
+
 /*
  * Get number of blocks present in a single disk file
  */
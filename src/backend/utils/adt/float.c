@@ -1856,6 +1856,64 @@ float8_accum(PG_FUNCTION_ARGS)
 	}
 }
 
+/*
+ * float8_combine
+ *
+ * Combines two transition arrays of float8_accum, float4_accum or
+ * float8_regr_accum, which hold only counts and sums.
+ */
+Datum
+float8_combine(PG_FUNCTION_ARGS)
+{
+	ArrayType  *transarray1 = PG_GETARG_ARRAYTYPE_P(0);
+	ArrayType  *transarray2 = PG_GETARG_ARRAYTYPE_P(1);
+	float8	   *transvalues1;
+	float8	   *transvalues2;
+	float8		newvalues[6];
+	int			n;
+	int			i;
+
+	if (ARR_NDIM(transarray1) != 1 ||
+		(ARR_DIMS(transarray1)[0] != 3 && ARR_DIMS(transarray1)[0] != 6))
+		elog(ERROR, "float8_combine: expected 3- or 6-element float8 array");
+	n = ARR_DIMS(transarray1)[0];
+	transvalues1 = check_float8_array(transarray1, "float8_combine", n);
+	transvalues2 = check_float8_array(transarray2, "float8_combine", n);
+
+	for (i = 0; i < n; i++)
+	{
+		newvalues[i] = transvalues1[i] + transvalues2[i];
+		CHECKFLOATVAL(newvalues[i],
+					  isinf(transvalues1[i]) || isinf(transvalues2[i]), true);
+	}
+
+	/*
+	 * If we're invoked as an aggregate, we can cheat and modify our first
+	 * parameter in-place to reduce palloc overhead. Otherwise we construct a
+	 * new array with the updated transition data and return it.
+	 */
+	if (AggCheckCallContext(fcinfo, NULL))
+	{
+		memcpy(transvalues1, newvalues, n * sizeof(float8));
+
+		PG_RETURN_ARRAYTYPE_P(transarray1);
+	}
+	else
+	{
+		Datum		transdatums[6];
+		ArrayType  *result;
+
+		for (i = 0; i < n; i++)
+			transdatums[i] = Float8GetDatumFast(newvalues[i]);
+
+		result = construct_array(transdatums, n,
+								 FLOAT8OID,
+								 sizeof(float8), FLOAT8PASSBYVAL, 'd');
+
+		PG_RETURN_ARRAYTYPE_P(result);
+	}
+}
+
 Datum
 float4_accum(PG_FUNCTION_ARGS)
 {
@@ -2566,6 +2566,43 @@ numeric_avg_accum(PG_FUNCTION_ARGS)
 	PG_RETURN_ARRAYTYPE_P(do_numeric_avg_accum(transarray, newval));
 }
 
+/*
+ * Combine two transition arrays of numeric_accum or numeric_avg_accum (or
+ * their integer variants), which hold only counts and sums.
+ */
+Datum
+numeric_combine(PG_FUNCTION_ARGS)
+{
+	ArrayType  *transarray1 = PG_GETARG_ARRAYTYPE_P(0);
+	ArrayType  *transarray2 = PG_GETARG_ARRAYTYPE_P(1);
+	Datum	   *transdatums1;
+	Datum	   *transdatums2;
+	int			ndatums1;
+	int			ndatums2;
+	int			i;
+	ArrayType  *result;
+
+	/* We assume the inputs are arrays of numeric */
+	deconstruct_array(transarray1,
+					  NUMERICOID, -1, false, 'i',
+					  &transdatums1, NULL, &ndatums1);
+	deconstruct_array(transarray2,
+					  NUMERICOID, -1, false, 'i',
+					  &transdatums2, NULL, &ndatums2);
+	if ((ndatums1 != 2 && ndatums1 != 3) || ndatums2 != ndatums1)
+		elog(ERROR, "expected 2- or 3-element numeric arrays");
+
+	for (i = 0; i < ndatums1; i++)
+		transdatums1[i] = DirectFunctionCall2(numeric_add,
+											  transdatums1[i],
+											  transdatums2[i]);
+
+	result = construct_array(transdatums1, ndatums1,
+							 NUMERICOID, -1, false, 'i');
+
+	PG_RETURN_ARRAYTYPE_P(result);
+}
+
 /*
  * Integer data types all use Numeric accumulators to share code and
  * avoid risk of overflow.	For int2 and int4 inputs, Numeric accumulation
@@ -3033,6 +3070,41 @@ int4_avg_accum(PG_FUNCTION_ARGS)
 	PG_RETURN_ARRAYTYPE_P(transarray);
 }
 
+/*
+ * Combine two transition arrays of int2_avg_accum or int4_avg_accum
+ */
+Datum
+int8_avg_combine(PG_FUNCTION_ARGS)
+{
+	ArrayType  *transarray1;
+	ArrayType  *transarray2 = PG_GETARG_ARRAYTYPE_P(1);
+	Int8TransTypeData *transdata1;
+	Int8TransTypeData *transdata2;
+
+	/*
+	 * If we're invoked as an aggregate, we can cheat and modify our first
+	 * parameter in-place to reduce palloc overhead. Otherwise we need to make
+	 * a copy of it before scribbling on it.
+	 */
+	if (AggCheckCallContext(fcinfo, NULL))
+		transarray1 = PG_GETARG_ARRAYTYPE_P(0);
+	else
+		transarray1 = PG_GETARG_ARRAYTYPE_P_COPY(0);
+
+	if (ARR_HASNULL(transarray1) ||
+		ARR_SIZE(transarray1) != ARR_OVERHEAD_NONULLS(1) + sizeof(Int8TransTypeData) ||
+		ARR_HASNULL(transarray2) ||
+		ARR_SIZE(transarray2) != ARR_OVERHEAD_NONULLS(1) + sizeof(Int8TransTypeData))
+		elog(ERROR, "expected 2-element int8 array");
+
+	transdata1 = (Int8TransTypeData *) ARR_DATA_PTR(transarray1);
+	transdata2 = (Int8TransTypeData *) ARR_DATA_PTR(transarray2);
+	transdata1->count += transdata2->count;
+	transdata1->sum += transdata2->sum;
+
+	PG_RETURN_ARRAYTYPE_P(transarray1);
+}
+
 Datum
 int8_avg(PG_FUNCTION_ARGS)
 {
@@ -89,6 +89,7 @@ static void AcquirePlannerLocks(List *stmt_list, bool acquire);
 static void ScanQueryForLocks(Query *parsetree, bool acquire);
 static bool ScanQueryWalker(Node *node, bool *acquire);
 static bool plan_list_is_transient(List *stmt_list);
+static void plan_list_set_jit_cacheable(List *stmt_list);
 static TupleDesc PlanCacheComputeResultDesc(List *stmt_list);
 static void PlanCacheRelCallback(Datum arg, Oid relid);
 static void PlanCacheFuncCallback(Datum arg, int cacheid, uint32 hashvalue);
@@ -1079,6 +1080,8 @@ GetCachedPlan(CachedPlanSource *plansource, ParamListInfo boundParams,
 				/* saved plans all live under CacheMemoryContext */
 				MemoryContextSetParent(plan->context, CacheMemoryContext);
 				plan->is_saved = true;
+				/* expected to be executed again, here and elsewhere */
+				plan_list_set_jit_cacheable(plan->stmt_list);
 			}
 			else
 			{
@@ -1563,6 +1566,28 @@ plan_list_is_transient(List *stmt_list)
 	return false;
 }
 
+/*
+ * plan_list_set_jit_cacheable: mark the plans in the list as ones whose JIT
+ * compiled code is worth keeping in the code cache.  We do that for generic
+ * plans of saved statements only; custom plans embed the parameter values
+ * of one execution, and unsaved statements don't live long.
+ */
+static void
+plan_list_set_jit_cacheable(List *stmt_list)
+{
+	ListCell   *lc;
+
+	foreach(lc, stmt_list)
+	{
+		PlannedStmt *plannedstmt = (PlannedStmt *) lfirst(lc);
+
+		if (!IsA(plannedstmt, PlannedStmt))
+			continue;			/* Ignore utility statements */
+
+		plannedstmt->jitCodeCacheable = true;
+	}
+}
+
 /*
  * PlanCacheComputeResultDesc: given a list of analyzed-and-rewritten Queries,
  * determine the result tupledesc it will produce.	Returns NULL if the
@@ -37,6 +37,8 @@
 #include "commands/variable.h"
 #include "commands/trigger.h"
 #include "funcapi.h"
+#include "executor/executor.h"
+#include "jit/jit.h"
 #include "libpq/auth.h"
 #include "libpq/be-fsstubs.h"
 #include "libpq/libpq.h"
@@ -55,6 +57,7 @@
 #include "postmaster/bgworker.h"
 #include "postmaster/bgwriter.h"
 #include "postmaster/postmaster.h"
+#include "postmaster/scanworker.h"
 #include "postmaster/syslogger.h"
 #include "postmaster/walwriter.h"
 #include "replication/syncrep.h"
@@ -191,6 +194,7 @@ static const char *show_tcp_keepalives_count(void);
 static bool check_maxconnections(int *newval, void **extra, GucSource source);
 static bool check_autovacuum_max_workers(int *newval, void **extra, GucSource source);
 static bool check_effective_io_concurrency(int *newval, void **extra, GucSource source);
+static bool check_direct_io(int *newval, void **extra, GucSource source);
 static void assign_effective_io_concurrency(int newval, void *extra);
 static void assign_pgstat_temp_directory(const char *newval, void *extra);
 static bool check_application_name(char **newval, void **extra, GucSource source);
@@ -378,6 +382,14 @@ static const struct config_enum_entry synchronous_commit_options[] = {
 	{NULL, 0, false}
 };
 
+static const struct config_enum_entry direct_io_options[] = {
+	{"off", DIRECT_IO_OFF, false},
+	{"data", DIRECT_IO_DATA, false},
+	{"wal", DIRECT_IO_WAL, false},
+	{"all", DIRECT_IO_ALL, false},
+	{NULL, 0, false}
+};
+
 /*
  * Options for enum values stored in other modules
  */
@@ -730,6 +742,15 @@ static struct config_bool ConfigureNamesBool[] =
 		true,
 		NULL, NULL, NULL
 	},
+	{
+		{"enable_memoize", PGC_USERSET, QUERY_TUNING_METHOD,
+			gettext_noop("Enables the planner's use of caching of parameterized inner scans."),
+			NULL
+		},
+		&enable_memoize,
+		true,
+		NULL, NULL, NULL
+	},
 	{
 		{"enable_nestloop", PGC_USERSET, QUERY_TUNING_METHOD,
 			gettext_noop("Enables the planner's use of nested-loop join plans."),
@@ -757,6 +778,51 @@ static struct config_bool ConfigureNamesBool[] =
 		true,
 		NULL, NULL, NULL
 	},
+	{
+		{"enable_incrementalsort", PGC_USERSET, QUERY_TUNING_METHOD,
+			gettext_noop("Enables the planner's use of incremental sort steps."),
+			NULL
+		},
+		&enable_incrementalsort,
+		true,
+		NULL, NULL, NULL
+	},
+	{
+		{"jit", PGC_USERSET, QUERY_TUNING_OTHER,
+			gettext_noop("Allow JIT compilation of expressions."),
+			gettext_noop("Only has an effect if the server was built with LLVM support.")
+		},
+		&jit_enabled,
+		false,
+		NULL, NULL, NULL
+	},
+	{
+		{"jit_tuple_deforming", PGC_USERSET, QUERY_TUNING_OTHER,
+			gettext_noop("Allow JIT compilation of tuple deforming."),
+			NULL
+		},
+		&jit_tuple_deforming,
+		true,
+		NULL, NULL, NULL
+	},
+	{
+		{"jit_code_cache", PGC_SUSET, QUERY_TUNING_OTHER,
+			gettext_noop("Shares JIT compiled code of prepared statements between sessions."),
+			NULL
+		},
+		&jit_code_cache,
+		false,
+		NULL, NULL, NULL
+	},
+	{
+		{"batch_execution", PGC_USERSET, QUERY_TUNING_OTHER,
+			gettext_noop("Allow passing rows from scans to aggregates in batches."),
+			NULL
+		},
+		&batch_execution,
+		true,
+		NULL, NULL, NULL
+	},
 	{
 		{"geqo", PGC_USERSET, QUERY_TUNING_GEQO,
 			gettext_noop("Enables genetic query optimization."),
@@ -2157,6 +2223,37 @@ static struct config_int ConfigureNamesInt[] =
 		check_effective_io_concurrency, assign_effective_io_concurrency, NULL
 	},
 
+	{
+		{"parallel_scan_workers", PGC_POSTMASTER, RESOURCES_ASYNCHRONOUS,
+			gettext_noop("Sets the number of background worker processes that help with sequential scans."),
+			NULL
+		},
+		&parallel_scan_workers,
+		0, 0, MAX_BACKENDS,
+		NULL, NULL, NULL
+	},
+
+	{
+		{"parallel_scan_degree", PGC_USERSET, RESOURCES_ASYNCHRONOUS,
+			gettext_noop("Sets the maximum number of scan workers a single sequential scan can use."),
+			gettext_noop("Zero disables parallel sequential scans.")
+		},
+		&parallel_scan_degree,
+		4, 0, MAX_BACKENDS,
+		NULL, NULL, NULL
+	},
+
+	{
+		{"parallel_hash_mem", PGC_POSTMASTER, RESOURCES_ASYNCHRONOUS,
+			gettext_noop("Sets the size of the shared memory scan workers build hash tables in."),
+			gettext_noop("Zero disables building hash tables with scan workers."),
+			GUC_UNIT_KB
+		},
+		&parallel_hash_mem,
+		65536, 0, MAX_KILOBYTES,
+		NULL, NULL, NULL
+	},
+
 	{
 		{"log_rotation_age", PGC_SIGHUP, LOGGING_WHERE,
 			gettext_noop("Automatic log file rotation will occur after N minutes."),
@@ -2469,6 +2566,33 @@ static struct config_real ConfigureNamesReal[] =
 		DEFAULT_CPU_OPERATOR_COST, 0, DBL_MAX,
 		NULL, NULL, NULL
 	},
+	{
+		{"jit_above_cost", PGC_USERSET, QUERY_TUNING_COST,
+			gettext_noop("Perform JIT compilation if query is more expensive."),
+			NULL
+		},
+		&jit_above_cost,
+		100000, 0, DBL_MAX,
+		NULL, NULL, NULL
+	},
+	{
+		{"jit_optimize_above_cost", PGC_USERSET, QUERY_TUNING_COST,
+			gettext_noop("Optimize JIT compiled code if query is more expensive."),
+			NULL
+		},
+		&jit_optimize_above_cost,
+		500000, 0, DBL_MAX,
+		NULL, NULL, NULL
+	},
+	{
+		{"jit_inline_above_cost", PGC_USERSET, QUERY_TUNING_COST,
+			gettext_noop("Inline builtin functions into JIT compiled code if query is more expensive."),
+			NULL
+		},
+		&jit_inline_above_cost,
+		500000, 0, DBL_MAX,
+		NULL, NULL, NULL
+	},
 
 	{
 		{"cursor_tuple_fraction", PGC_USERSET, QUERY_TUNING_OTHER,
@@ -3153,6 +3277,16 @@ static struct config_enum ConfigureNamesEnum[] =
 		NULL, NULL, NULL
 	},
 
+	{
+		{"direct_io", PGC_POSTMASTER, RESOURCES_DISK,
+			gettext_noop("Selects the files that are read and written bypassing the kernel's cache."),
+			gettext_noop("\"data\" is relation files, \"wal\" is WAL segments, and \"all\" is both.")
+		},
+		&direct_io,
+		DIRECT_IO_OFF, direct_io_options,
+		check_direct_io, NULL, NULL
+	},
+
 	{
 		{"default_transaction_isolation", PGC_USERSET, CLIENT_CONN_STATEMENT,
 			gettext_noop("Sets the transaction isolation level of each new transaction."),
@@ -8728,6 +8862,19 @@ assign_effective_io_concurrency(int newval, void *extra)
 #endif   /* USE_PREFETCH */
 }
 
+static bool
+check_direct_io(int *newval, void **extra, GucSource source)
+{
+#if PG_O_DIRECT == 0
+	if (*newval != DIRECT_IO_OFF)
+	{
+		GUC_check_errdetail("Direct I/O is not supported on this platform.");
+		return false;
+	}
+#endif
+	return true;
+}
+
 static void
 assign_pgstat_temp_directory(const char *newval, void *extra)
 {
@@ -157,15 +157,10 @@ bool		optimize_bounded_sort = true;
  * the heap was read from, or to hold the index of the next tuple pre-read
  * from the same tape in the case of pre-read entries.	tupindex goes unused
  * if the sort occurs entirely in memory.
+ *
+ * The struct itself is declared in tuplesort.h, for the benefit of JIT
+ * compiled comparators.
  */
-typedef struct
-{
-	void	   *tuple;			/* the tuple proper */
-	Datum		datum1;			/* value of first key column */
-	bool		isnull1;		/* is first key column NULL? */
-	int			tupindex;		/* see notes above */
-} SortTuple;
-
 
 /*
  * Possible states of a Tuplesort object.  These denote the states that
@@ -196,9 +191,6 @@ typedef enum
 #define TAPE_BUFFER_OVERHEAD		(BLCKSZ * 3)
 #define MERGE_BUFFER_SIZE			(BLCKSZ * 32)
 
-typedef int (*SortTupleComparator) (const SortTuple *a, const SortTuple *b,
-												Tuplesortstate *state);
-
 /*
  * Private state of a Tuplesort operation.
  */
@@ -229,6 +221,13 @@ struct Tuplesortstate
 	 */
 	SortTupleComparator comparetup;
 
+	/*
+	 * A comparator specialized for the sort keys, set up by
+	 * tuplesort_set_heap_comparator, or NULL.  It is installed as comparetup
+	 * while the sort runs in its original direction.
+	 */
+	SortTupleComparator compiledcomparetup;
+
 	/*
 	 * Function to copy a supplied input tuple into palloc'd space and set up
 	 * its SortTuple representation (ie, set tuple/datum1/isnull1).  Also,
@@ -888,6 +887,45 @@ tuplesort_set_bound(Tuplesortstate *state, int64 bound)
 	state->bound = (int) bound;
 }
 
+/*
+ * tuplesort_set_heap_comparator
+ *
+ *	Make a heap sort compare tuples with 'comparator', which must return
+ *	exactly what comparetup_heap would for the sort keys the sort was begun
+ *	with.  This is how JIT compiled comparators get used.
+ *
+ * Must be called before inserting any tuples.
+ */
+void
+tuplesort_set_heap_comparator(Tuplesortstate *state,
+							  SortTupleComparator comparator)
+{
+	/* Assert we're called before loading any tuples */
+	Assert(state->status == TSS_INITIAL);
+	Assert(state->memtupcount == 0);
+	Assert(state->comparetup == comparetup_heap);
+
+	state->comparetup = comparator;
+	state->compiledcomparetup = comparator;
+}
+
+/*
+ * tuplesort_heap_compare_key
+ *
+ *	Compare two non-null values of sort key 'keyno' of a heap sort, taking
+ *	the current sort direction into account.  Called by JIT compiled
+ *	comparators for the keys they don't compare inline.
+ */
+int
+tuplesort_heap_compare_key(Tuplesortstate *state, int keyno,
+						   Datum datum1, Datum datum2)
+{
+	Assert(keyno >= 0 && keyno < state->nKeys);
+
+	return ApplySortComparator(datum1, false, datum2, false,
+							   state->sortKeys + keyno);
+}
+
 /*
  * tuplesort_end
  *
@@ -2900,6 +2938,15 @@ reversedirection_heap(Tuplesortstate *state)
 		sortKey->ssup_reverse = !sortKey->ssup_reverse;
 		sortKey->ssup_nulls_first = !sortKey->ssup_nulls_first;
 	}
+
+	/* a compiled comparator only knows the original direction */
+	if (state->compiledcomparetup != NULL)
+	{
+		if (state->comparetup == comparetup_heap)
+			state->comparetup = state->compiledcomparetup;
+		else
+			state->comparetup = comparetup_heap;
+	}
 }
 
 
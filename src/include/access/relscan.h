@@ -19,8 +19,22 @@
 #include "access/htup_details.h"
 #include "access/itup.h"
 #include "access/tupdesc.h"
+#include "storage/spin.h"
 
 
+/*
+ * Shared state of a heap scan whose pages are divided among several
+ * processes, each running its own HeapScanDesc on top of it.  This lives in
+ * shared memory; see heap_beginscan_parallel.
+ */
+typedef struct ParallelHeapScanDescData
+{
+	Oid			phs_relid;		/* OID of relation to scan */
+	BlockNumber phs_nblocks;	/* # blocks in relation at start of scan */
+	slock_t		phs_mutex;		/* mutual exclusion for phs_cblock */
+	BlockNumber phs_cblock;		/* next block to hand out */
+}	ParallelHeapScanDescData;
+
 typedef struct HeapScanDescData
 {
 	/* scan parameters */
@@ -38,6 +52,7 @@ typedef struct HeapScanDescData
 	BlockNumber rs_startblock;	/* block # to start at */
 	BufferAccessStrategy rs_strategy;	/* access strategy for reads */
 	bool		rs_syncscan;	/* report location to syncscan logic? */
+	ParallelHeapScanDesc rs_parallel;	/* shared block counter, or NULL */
 
 	/* scan current state */
 	bool		rs_inited;		/* false = scan not init'd yet */
@@ -52,6 +67,15 @@ typedef struct HeapScanDescData
 	int			rs_mindex;		/* marked tuple's saved index */
 	int			rs_ntuples;		/* number of visible tuples on page */
 	OffsetNumber rs_vistuples[MaxHeapTuplesPerPage];	/* their offsets */
+
+	/* these fields only used in parallel scans */
+	BlockNumber rs_pnextblock;	/* next block of the claimed chunk */
+	BlockNumber rs_pendblock;	/* end (exclusive) of the claimed chunk */
+
+	/* these fields are used for prefetching pages ahead of the scan */
+	BlockNumber rs_prefetch_pos;	/* next page to prefetch, counted from
+									 * rs_startblock */
+	int			rs_prefetch_target;		/* current prefetch distance */
 }	HeapScanDescData;
 
 /*
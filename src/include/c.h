@@ -835,6 +835,19 @@ typedef NameData *Name;
 #endif
 
 
+/*
+ * Hint that the memory at the given address will be read soon, so that the
+ * CPU can start bringing it into cache.  This is only a hint: it never
+ * faults, even on a NULL or otherwise invalid address, and it compiles to
+ * nothing if the compiler doesn't know how to express it.
+ */
+#ifdef __GNUC__
+#define pg_prefetch(addr) __builtin_prefetch(addr)
+#else
+#define pg_prefetch(addr) ((void) 0)
+#endif
+
+
 /*
  * Function inlining support -- Allow modules to define functions that may be
  * inlined, if the compiler supports it.
@@ -32,6 +32,7 @@ typedef struct ExplainState
 	bool		analyze;		/* print actual times */
 	bool		costs;			/* print costs */
 	bool		buffers;		/* print buffer usage */
+	bool		jit;			/* print JIT compilation details */
 	bool		timing;			/* print timing */
 	ExplainFormat format;		/* output format */
 	/* other states */
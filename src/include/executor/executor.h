@@ -106,6 +106,20 @@ extern bool ExecSupportsMarkRestore(NodeTag plantype);
 extern bool ExecSupportsBackwardScan(Plan *node);
 extern bool ExecMaterializesOutput(NodeTag plantype);
 
+/*
+ * prototypes from functions in execBatch.c
+ */
+typedef struct BatchQual BatchQual;
+
+extern bool batch_execution;
+
+extern TupleBatch *ExecCreateTupleBatch(Bitmapset *attnos);
+extern int	ExecTupleBatchColumn(TupleBatch *batch, AttrNumber attno);
+extern void ExecTupleBatchAddRow(TupleBatch *batch, TupleTableSlot *slot);
+extern BatchQual *ExecInitBatchQual(ExprState *clause, Index scanrelid,
+				  Bitmapset **attnos);
+extern void ExecBatchQual(List *batchquals, TupleBatch *batch);
+
 /*
  * prototypes from functions in execCurrent.c
  */
@@ -148,6 +162,12 @@ extern TupleHashEntry FindTupleHashEntry(TupleHashTable hashtable,
 				   TupleTableSlot *slot,
 				   FmgrInfo *eqfunctions,
 				   FmgrInfo *hashfunctions);
+extern void RemoveTupleHashEntry(TupleHashTable hashtable,
+					 TupleHashEntry entry);
+extern TupleHashEntry ScanTupleHashTable(TupleHashIterator *iter);
+extern uint32 TupleHashTableHash(TupleHashTable hashtable,
+				   TupleTableSlot *slot,
+				   FmgrInfo *hashfunctions);
 
 /*
  * prototypes from functions in execJunk.c
@@ -235,12 +255,20 @@ extern Datum ExecEvalExprSwitchContext(ExprState *expression, ExprContext *econt
 						  bool *isNull, ExprDoneCond *isDone);
 extern ExprState *ExecInitExpr(Expr *node, PlanState *parent);
 extern ExprState *ExecPrepareExpr(Expr *node, EState *estate);
+extern void ExecInitFuncCache(FuncExprState *fcache, ExprContext *econtext);
 extern bool ExecQual(List *qual, ExprContext *econtext, bool resultForNull);
 extern int	ExecTargetListLength(List *targetlist);
 extern int	ExecCleanTargetListLength(List *targetlist);
 extern TupleTableSlot *ExecProject(ProjectionInfo *projInfo,
 			ExprDoneCond *isDone);
 
+/*
+ * prototypes from functions in execExprInterp.c
+ */
+extern void ExecBuildExprProgram(ExprState *state);
+extern Datum ExecInterpExpr(ExprState *state, ExprContext *econtext,
+			   bool *isNull, ExprDoneCond *isDone);
+
 /*
  * prototypes from functions in execScan.c
  */
@@ -54,6 +54,33 @@
  * inner batch file.  Subsequently, while reading either inner or outer batch
  * files, we might find tuples that no longer belong to the current batch;
  * if so, we just dump them out to the correct batch file.
+ *
+ * Increasing nbatch is no help if a batch is oversized because too many of
+ * its tuples share a hash value; once that has been found, further increases
+ * are disabled (growEnabled).  A batch that then overflows the hash table is
+ * processed in "chunks" instead, like a block nested loop: the inner tuples
+ * that don't fit go to a separate temp file, and after the outer tuples of
+ * the batch have been matched against the tuples in memory, the table is
+ * reloaded with the next chunk of that file and the outer tuples are scanned
+ * again.  The first pass over the outer tuples of the batch saves them in
+ * another temp file for the later passes.  Whether an outer tuple has found
+ * a match in any chunk is remembered in a bitmap indexed by its position in
+ * that file, so that outer-join fill and semijoin/antijoin decisions can be
+ * made correctly in the last chunk.
+ *
+ * If the inner relation is scanned with the help of scan workers (see
+ * postmaster/scanworker.c) and is expected to fit in a single batch, the
+ * workers can insert their tuples into the hash table themselves.  The
+ * table is then built in a shared memory arena instead of the batchCxt:
+ * the bucket array, and the tuples, which every participant allocates in
+ * SHARED_HASH_CHUNK_SIZE pieces of the arena.  A tuple is pushed onto its
+ * bucket's list with an atomic compare-and-swap, so inserting takes no lock.
+ * The table may grow to spaceAllowed in the arena; tuples that don't fit
+ * are passed on to the leader, which saves them in a temp file until all
+ * workers are done, and then inserts them the ordinary way.  That may
+ * increase nbatch, like any insertion, but tuples in the arena are never
+ * freed; only the arena as a whole is released, when the hash join moves
+ * on to the next batch or is shut down.
  * ----------------------------------------------------------------
  */
 
@@ -102,6 +129,70 @@ typedef struct HashSkewBucket
 #define SKEW_WORK_MEM_PERCENT  2
 #define SKEW_MIN_OUTER_FRACTION  0.01
 
+/*
+ * While the inner relation is hashed, the hash values of all its tuples are
+ * also added to a bloom filter.  Outer tuples whose hash value the filter
+ * rejects can't have a match, so they needn't be looked up in the hash table
+ * or saved in an outer batch file; in some cases, the outer scan can even
+ * discard them right away (see nodeHashjoin.c).  The filter is blocked: the
+ * BLOOM_NUM_BITS bits of a hash value all fall into one 64-bit word, so that
+ * a check costs a single cache miss at most.
+ *
+ * The filter is sized from the planner's estimate of the inner relation's
+ * size.  If that was far off, so that the filter ends up too full to be
+ * useful, it is not used at all.  Nor is it if it turns out to reject too
+ * few outer tuples to pay for the checks.
+ */
+#define BLOOM_BITS_PER_TUPLE	8
+#define BLOOM_NUM_BITS			3
+#define BLOOM_MIN_WORDS			64
+#define BLOOM_WORK_MEM_PERCENT	10
+#define BLOOM_SAMPLE_TUPLES		1000
+#define BLOOM_MIN_REJECT_FRACTION	0.05
+
+/*
+ * Once the hash table is bigger than the CPU caches, following a bucket's
+ * list costs a cache miss for the bucket header and another for each tuple.
+ * To overlap those misses with other work, we prefetch ahead:
+ *
+ * While building the table, a new tuple is linked into its bucket only
+ * HJ_PREFETCH_DISTANCE insertions after its bucket header was prefetched.
+ *
+ * While probing, outer tuples are read in groups of HJ_PREFETCH_DISTANCE.
+ * The bucket headers for the whole group are prefetched first, then the
+ * first tuples of those buckets, and only then is each tuple of the group
+ * probed in turn.  That means copying the outer tuples, so it's only done
+ * if the table takes at least HJ_PREFETCH_MIN_SPACE bytes.
+ */
+#define HJ_PREFETCH_DISTANCE	8
+#define HJ_PREFETCH_MIN_SPACE	(4 * 1024 * 1024L)
+
+/*
+ * Control block of a hash table built in shared memory, at the start of the
+ * arena.  Everything but the fields marked as changing is set up by the
+ * leader before any worker looks at it.
+ */
+typedef struct SharedHashJoinTableData
+{
+	Size		size;			/* size of the arena, including this */
+	Size		limit;			/* offset the tuples may use space up to */
+	int			nbuckets;		/* # buckets in the table */
+	int			log2_nbuckets;	/* its log2 */
+	bool		keepNulls;		/* true to store unmatchable NULL tuples */
+	int			nkeys;			/* # hash keys */
+	Oid		   *hashfuncs;		/* their inner hash functions, in the arena */
+	bool	   *hashStrict;		/* is each hash join operator strict? */
+	struct HashJoinTupleData **buckets; /* bucket array, in the arena */
+
+	/* these change while the table is built: */
+	volatile Size used;			/* offset of first unallocated byte */
+	volatile bool full;			/* a tuple didn't fit */
+	volatile Size workerTuples; /* # tuples inserted by workers */
+	volatile Size workerSpace;	/* space used by those */
+}	SharedHashJoinTableData;
+
+#define SHARED_HASH_CHUNK_SIZE	(32 * 1024)
+
 
 typedef struct HashJoinTableData
 {
@@ -114,6 +205,24 @@ typedef struct HashJoinTableData
 
 	bool		keepNulls;		/* true to store unmatchable NULL tuples */
 
+	/*
+	 * The shared memory arena of a table built with scan workers, or NULL.
+	 * While sharedBuild is true, workers may be inserting into the buckets
+	 * concurrently.  sharedChunk is the rest of this process's current piece
+	 * of the arena.  Tuples that didn't fit go to sharedOverflowFile.
+	 */
+	SharedHashJoinTable shared;
+	bool		sharedBuild;	/* are workers inserting into the table? */
+	char	   *sharedChunk;	/* where our next tuple goes */
+	Size		sharedChunkFree;	/* bytes left there */
+	BufFile    *sharedOverflowFile; /* tuples left for after the build */
+	double		workerTuples;	/* # tuples inserted by workers */
+
+	/* new tuples not yet linked into buckets; see ExecHashTableInsert */
+	struct HashJoinTupleData *pendingInserts[HJ_PREFETCH_DISTANCE];
+	int			nPendingInserts;	/* # of valid entries in pendingInserts */
+	int			nextPendingInsert;	/* where the next one goes */
+
 	bool		skewEnabled;	/* are we using skew optimization? */
 	HashSkewBucket **skewBucket;	/* hashtable of skew buckets */
 	int			skewBucketLen;	/* size of skewBucket array (a power of 2!) */
@@ -140,6 +249,21 @@ typedef struct HashJoinTableData
 	BufFile   **innerBatchFile; /* buffered virtual temp file per batch */
 	BufFile   **outerBatchFile; /* buffered virtual temp file per batch */
 
+	/*
+	 * State for processing an oversized batch in chunks.  chunkInnerFile is
+	 * NULL unless there are inner tuples of the current batch left to load.
+	 * The match bitmap is allocated in the hashCxt, only if it's needed.
+	 */
+	int			curchunk;		/* current chunk # of batch; 0 in 1st pass */
+	int			nchunkedBatches;	/* # of batches processed in chunks */
+	BufFile    *chunkInnerFile; /* inner tuples of batch not yet loaded */
+	long		chunkInnerTuples;	/* # of tuples left in chunkInnerFile */
+	BufFile    *chunkOuterFile; /* outer tuples of batch, for later chunks */
+	long		chunkOuterTuples;	/* # of tuples in chunkOuterFile */
+	long		chunkOuterRead; /* # of tuples reread in current chunk */
+	uint8	   *chunkOuterMatched;	/* bitmap of outer tuples having matched */
+	long		chunkOuterMatchedSize;	/* allocated size of bitmap, in bytes */
+
 	/*
 	 * Info about the datatype-specific hash functions for the datatypes being
 	 * hashed. These are arrays of the same length as the number of hash join
@@ -155,6 +279,12 @@ typedef struct HashJoinTableData
 	Size		spaceUsedSkew;	/* skew hash table's current space usage */
 	Size		spaceAllowedSkew;		/* upper limit for skew hashtable */
 
+	uint64	   *bloomFilter;	/* bloom filter over the inner hash values */
+	int			bloomShift;		/* 32 - log2(# of 64-bit words in filter) */
+	bool		bloomEnabled;	/* is the filter worth checking? */
+	double		bloomChecked;	/* # outer tuples checked against filter */
+	double		bloomRejected;	/* # outer tuples rejected by filter */
+
 	MemoryContext hashCxt;		/* context for whole-hash-join storage */
 	MemoryContext batchCxt;		/* context for this-batch-only storage */
 }	HashJoinTableData;
@@ -38,6 +38,7 @@ typedef enum InstrumentOption
 	INSTRUMENT_TIMER = 1 << 0,	/* needs timer (and row counts) */
 	INSTRUMENT_BUFFERS = 1 << 1,	/* needs buffer usage */
 	INSTRUMENT_ROWS = 1 << 2,	/* needs row count */
+	INSTRUMENT_JIT = 1 << 3,	/* needs JIT statistics of each node */
 	INSTRUMENT_ALL = 0x7FFFFFFF
 } InstrumentOption;
 
@@ -63,6 +64,25 @@ typedef struct Instrumentation
 	BufferUsage bufusage;		/* Total buffer usage */
 } Instrumentation;
 
+/* Parts of a plan node's work that were JIT compiled */
+#define JIT_NODE_FILTER			(1 << 0)
+#define JIT_NODE_JOIN_FILTER	(1 << 1)
+#define JIT_NODE_OUTPUT			(1 << 2)
+#define JIT_NODE_DEFORM			(1 << 3)
+#define JIT_NODE_AGGREGATE		(1 << 4)
+#define JIT_NODE_HASH			(1 << 5)
+#define JIT_NODE_SORT			(1 << 6)
+
+typedef struct JitNodeInstrumentation
+{
+	int			compiled;		/* JIT_NODE_* bits */
+	int			nexprs;			/* # of expressions offered to the JIT */
+	int			ncompiled_exprs;	/* # of those it compiled */
+	uint64		compiled_calls; /* # of calls of generated functions */
+	uint64		interpreted_calls;		/* # of evaluations generated code
+										 * left to the interpreter */
+} JitNodeInstrumentation;
+
 extern PGDLLIMPORT BufferUsage pgBufferUsage;
 
 extern Instrumentation *InstrAlloc(int n, int instrument_options);
@@ -15,6 +15,185 @@
 #define NODEAGG_H
 
 #include "nodes/execnodes.h"
+#include "utils/tuplesort.h"
+
+
+/*
+ * How the transition function of an aggregate is advanced over a batch of
+ * input rows in batch mode (see agg_retrieve_batch), if it can be
+ */
+typedef enum AggBatchTrans
+{
+	AGG_BATCH_NONE,				/* not supported */
+	AGG_BATCH_COUNT_STAR,		/* int8inc */
+	AGG_BATCH_COUNT,			/* int8inc_any */
+	AGG_BATCH_INT2_SUM,			/* int2_sum */
+	AGG_BATCH_INT4_SUM,			/* int4_sum */
+	AGG_BATCH_FLOAT8_SUM,		/* float8pl */
+	AGG_BATCH_INT2_MIN,			/* int2smaller */
+	AGG_BATCH_INT2_MAX,			/* int2larger */
+	AGG_BATCH_INT4_MIN,			/* int4smaller */
+	AGG_BATCH_INT4_MAX,			/* int4larger */
+	AGG_BATCH_INT8_MIN,			/* int8smaller */
+	AGG_BATCH_INT8_MAX,			/* int8larger */
+	AGG_BATCH_FLOAT8_MIN,		/* float8smaller */
+	AGG_BATCH_FLOAT8_MAX		/* float8larger */
+} AggBatchTrans;
+
+/*
+ * AggStatePerAggData - per-aggregate working state for the Agg scan
+ *
+ * This and AggStatePerGroupData are only exposed so that JIT compiled
+ * transition code (jit/llvmjit_agg.c) can address their fields; everything
+ * else should treat them as private to nodeAgg.c.
+ */
+typedef struct AggStatePerAggData
+{
+	/*
+	 * These values are set up during ExecInitAgg() and do not change
+	 * thereafter:
+	 */
+
+	/* Links to Aggref expr and state nodes this working state is for */
+	AggrefExprState *aggrefstate;
+	Aggref	   *aggref;
+
+	/* number of input arguments for aggregate function proper */
+	int			numArguments;
+
+	/* number of inputs including ORDER BY expressions */
+	int			numInputs;
+
+	/* Oids of transfer functions */
+	Oid			transfn_oid;
+	Oid			finalfn_oid;	/* may be InvalidOid */
+	Oid			combinefn_oid;	/* may be InvalidOid */
+
+	/*
+	 * fmgr lookup data for transfer functions --- only valid when
+	 * corresponding oid is not InvalidOid.  Note in particular that fn_strict
+	 * flags are kept here.
+	 */
+	FmgrInfo	transfn;
+	FmgrInfo	finalfn;
+	FmgrInfo	combinefn;
+
+	/* actual transition data type (the declared one may be polymorphic) */
+	Oid			transtype;
+
+	/* Input collation derived for aggregate */
+	Oid			aggCollation;
+
+	/* number of sorting columns */
+	int			numSortCols;
+
+	/* number of sorting columns to consider in DISTINCT comparisons */
+	/* (this is either zero or the same as numSortCols) */
+	int			numDistinctCols;
+
+	/* deconstructed sorting information (arrays of length numSortCols) */
+	AttrNumber *sortColIdx;
+	Oid		   *sortOperators;
+	Oid		   *sortCollations;
+	bool	   *sortNullsFirst;
+
+	/*
+	 * fmgr lookup data for input columns' equality operators --- only
+	 * set/used when aggregate has DISTINCT flag.  Note that these are in
+	 * order of sort column index, not parameter index.
+	 */
+	FmgrInfo   *equalfns;		/* array of length numDistinctCols */
+
+	/*
+	 * initial value from pg_aggregate entry
+	 */
+	Datum		initValue;
+	bool		initValueIsNull;
+
+	/*
+	 * We need the len and byval info for the agg's input, result, and
+	 * transition data types in order to know how to copy/delete values.
+	 *
+	 * Note that the info for the input type is used only when handling
+	 * DISTINCT aggs with just one argument, so there is only one input type.
+	 */
+	int16		inputtypeLen,
+				resulttypeLen,
+				transtypeLen;
+	bool		inputtypeByVal,
+				resulttypeByVal,
+				transtypeByVal;
+
+	/*
+	 * Stuff for evaluation of inputs.	We used to just use ExecEvalExpr, but
+	 * with the addition of ORDER BY we now need at least a slot for passing
+	 * data to the sort object, which requires a tupledesc, so we might as
+	 * well go whole hog and use ExecProject too.
+	 */
+	TupleDesc	evaldesc;		/* descriptor of input tuples */
+	ProjectionInfo *evalproj;	/* projection machinery */
+
+	/*
+	 * Slots for holding the evaluated input arguments.  These are set up
+	 * during ExecInitAgg() and then used for each input row.
+	 */
+	TupleTableSlot *evalslot;	/* current input tuple */
+	TupleTableSlot *uniqslot;	/* used for multi-column DISTINCT */
+
+	/*
+	 * In batch mode, how the transition function is applied to a batch, and
+	 * the batch column holding the argument (-1 if none).
+	 */
+	AggBatchTrans batchtrans;
+	int			batchcol;
+
+	/*
+	 * These values are working state that is initialized at the start of an
+	 * input tuple group and updated for each input tuple.
+	 *
+	 * For a simple (non DISTINCT/ORDER BY) aggregate, we just feed the input
+	 * values straight to the transition function.	If it's DISTINCT or
+	 * requires ORDER BY, we pass the input values into a Tuplesort object;
+	 * then at completion of the input tuple group, we scan the sorted values,
+	 * eliminate duplicates if needed, and run the transition function on the
+	 * rest.
+	 */
+
+	Tuplesortstate *sortstate;	/* sort object, if DISTINCT or ORDER BY */
+}	AggStatePerAggData;
+
+/*
+ * AggStatePerGroupData - per-aggregate-per-group working state
+ *
+ * These values are working state that is initialized at the start of
+ * an input tuple group and updated for each input tuple.
+ *
+ * In AGG_PLAIN and AGG_SORTED modes, we have a single array of these
+ * structs (pointed to by aggstate->pergroup); we re-use the array for
+ * each input group, if it's AGG_SORTED mode.  In AGG_HASHED mode, the
+ * hash table contains an array of these structs for each tuple group.
+ *
+ * Logically, the sortstate field belongs in this struct, but we do not
+ * keep it here for space reasons: we don't support DISTINCT aggregates
+ * in AGG_HASHED mode, so there's no reason to use up a pointer field
+ * in every entry of the hashtable.
+ */
+typedef struct AggStatePerGroupData
+{
+	Datum		transValue;		/* current transition value */
+	bool		transValueIsNull;
+
+	bool		noTransValue;	/* true if transValue not set yet */
+
+	/*
+	 * Note: noTransValue initially has the same value as transValueIsNull,
+	 * and if true both are cleared to false at the same time.	They are not
+	 * the same though: if transfn later returns a NULL, we want to keep that
+	 * NULL and not auto-replace it with a later input value. Only the first
+	 * non-NULL input will be auto-substituted.
+	 */
+} AggStatePerGroupData;
+
 
 extern AggState *ExecInitAgg(Agg *node, EState *estate, int eflags);
 extern TupleTableSlot *ExecAgg(AggState *node);
@@ -23,6 +202,15 @@ extern void ExecReScanAgg(AggState *node);
 
 extern Size hash_agg_entry_size(int numAggs);
 
+extern AggState *ExecInitPartialAgg(List *aggrefs, EState *estate);
+extern void ExecPartialAggAdvance(AggState *aggstate, TupleTableSlot *slot);
+extern HeapTuple ExecPartialAggGetStates(AggState *aggstate);
+
+extern void advance_transition_function(AggState *aggstate,
+							AggStatePerAgg peraggstate,
+							AggStatePerGroup pergroupstate,
+							FunctionCallInfoData *fcinfo);
+
 extern Datum aggregate_dummy(PG_FUNCTION_ARGS);
 
 #endif   /* NODEAGG_H */
@@ -28,6 +28,13 @@ extern void ExecHashTableDestroy(HashJoinTable hashtable);
 extern void ExecHashTableInsert(HashJoinTable hashtable,
 					TupleTableSlot *slot,
 					uint32 hashvalue);
+extern void ExecHashTableFlushInserts(HashJoinTable hashtable);
+extern bool ExecHashTableShare(HashJoinTable hashtable, int nkeys);
+extern bool ExecHashTableInsertShared(HashJoinTable hashtable,
+						  TupleTableSlot *slot,
+						  uint32 hashvalue);
+extern HashJoinTable ExecHashTableAttach(SharedHashJoinTable shared);
+extern void ExecHashTableDetach(HashJoinTable hashtable);
 extern bool ExecHashGetHashValue(HashJoinTable hashtable,
 					 ExprContext *econtext,
 					 List *hashkeys,
@@ -49,5 +56,6 @@ extern void ExecChooseHashTableSize(double ntuples, int tupwidth, bool useskew,
 						int *numbatches,
 						int *num_skew_mcvs);
 extern int	ExecHashGetSkewBucket(HashJoinTable hashtable, uint32 hashvalue);
+extern bool ExecHashBloomCheck(HashJoinTable hashtable, uint32 hashvalue);
 
 #endif   /* NODEHASH_H */
@@ -24,5 +24,8 @@ extern void ExecReScanHashJoin(HashJoinState *node);
 
 extern void ExecHashJoinSaveTuple(MinimalTuple tuple, uint32 hashvalue,
 					  BufFile **fileptr);
+extern TupleTableSlot *ExecHashJoinGetSavedTuple(BufFile *file,
+						  uint32 *hashvalue,
+						  TupleTableSlot *tupleSlot);
 
 #endif   /* NODEHASHJOIN_H */
@@ -22,5 +22,13 @@ extern void ExecEndSeqScan(SeqScanState *node);
 extern void ExecSeqMarkPos(SeqScanState *node);
 extern void ExecSeqRestrPos(SeqScanState *node);
 extern void ExecReScanSeqScan(SeqScanState *node);
+extern bool ExecSeqScanInitBatch(SeqScanState *node, Bitmapset *attnos);
+extern TupleBatch *ExecSeqScanBatch(SeqScanState *node);
+extern void ExecSeqScanInitPartialAgg(SeqScanState *node, List *aggrefs);
+extern HeapTuple ExecSeqScanGetPartialAgg(SeqScanState *node);
+extern void ExecSeqScanInitSharedHash(SeqScanState *node,
+						  HashJoinTable hashtable, List *hashkeys);
+extern void ExecSeqScanSetBloomFilter(SeqScanState *node,
+						  HashJoinTable hashtable, List *hashkeys);
 
 #endif   /* NODESEQSCAN_H */
@@ -108,8 +108,16 @@
  *
  * tts_slow/tts_off are saved state for slot_deform_tuple, and should not
  * be touched by any other code.
+ *
+ * tts_deform, if not NULL, is a routine specialized for the slot's tuple
+ * descriptor that slot_deform_tuple hands its work to; tts_deform_arg is
+ * for its private use.  Both are reset whenever the descriptor changes.
  *----------
  */
+struct TupleTableSlot;
+
+typedef void (*SlotDeformFunc) (struct TupleTableSlot *slot, int natts);
+
 typedef struct TupleTableSlot
 {
 	NodeTag		type;
@@ -127,6 +135,8 @@ typedef struct TupleTableSlot
 	MinimalTuple tts_mintuple;	/* minimal tuple, or NULL if none */
 	HeapTupleData tts_minhdr;	/* workspace for minimal-tuple-only case */
 	long		tts_off;		/* saved state for slot_deform_tuple */
+	SlotDeformFunc tts_deform;	/* specialized slot_deform_tuple, or NULL */
+	void	   *tts_deform_arg; /* private state of tts_deform */
 } TupleTableSlot;
 
 #define TTS_HAS_PHYSICAL_TUPLE(slot)  \
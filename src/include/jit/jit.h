@@ -0,0 +1,86 @@
+/*-------------------------------------------------------------------------
+ *
+ * jit.h
+ *	  Provider independent support for just-in-time compilation of
+ *	  executor code.
+ *
+ * Portions Copyright (c) 1996-2013, PostgreSQL Global Development Group
+ *
+ * src/include/jit/jit.h
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef JIT_H
+#define JIT_H
+
+#include "lib/ilist.h"
+#include "nodes/execnodes.h"
+#include "nodes/plannodes.h"
+#include "utils/resowner.h"
+
+
+/*
+ * Flag bits kept in EState->es_jit_flags, describing what kind of code
+ * generation was decided on for a query.
+ */
+#define PGJIT_NONE			0
+#define PGJIT_PERFORM		(1 << 0)	/* JIT is used for this query */
+#define PGJIT_OPT3			(1 << 1)	/* run the expensive optimizer */
+#define PGJIT_EXPR			(1 << 2)	/* compile quals and targetlists */
+#define PGJIT_DEFORM		(1 << 3)	/* generate tuple deforming code */
+#define PGJIT_CACHE			(1 << 4)	/* share code through the code cache */
+#define PGJIT_INLINE		(1 << 5)	/* inline builtins from bitcode */
+
+
+/*
+ * Time spent on and number of functions generated for the code of a
+ * JitContext.
+ */
+typedef struct JitInstrumentation
+{
+	int			created_functions;	/* # of functions generated */
+	instr_time	generation_counter;	/* time spent generating IR */
+	instr_time	optimization_counter;	/* time spent optimizing it */
+	instr_time	emission_counter;	/* time spent emitting machine code */
+} JitInstrumentation;
+
+/*
+ * A JitContext holds the code generated for one EState.  It is created
+ * lazily the first time something is compiled, and released either by
+ * FreeExecutorState() or, on error, by the release of the resource owner
+ * that was current when it was created.  Providers embed this struct as the
+ * first member of their own context struct.
+ */
+typedef struct JitContext
+{
+	int			flags;			/* PGJIT_* flags of the owning EState */
+	MemoryContext mcxt;			/* holds the context and its bookkeeping */
+	ResourceOwner resowner;		/* owner responsible for cleanup on error */
+	dlist_node	node;			/* link in the list of live contexts */
+	JitInstrumentation instr;	/* statistics of the code generated */
+
+	/* statistics of the plan node being compiled, if EXPLAIN wants them */
+	JitNodeInstrumentation *node_instr;
+} JitContext;
+
+
+/* GUC parameters */
+extern bool jit_enabled;
+extern double jit_above_cost;
+extern double jit_optimize_above_cost;
+extern double jit_inline_above_cost;
+extern bool jit_tuple_deforming;
+extern bool jit_code_cache;
+
+
+extern int	jit_flags_for_plan(PlannedStmt *plannedstmt);
+extern JitContext *jit_get_context(EState *estate);
+extern void jit_release_context(JitContext *context);
+extern void jit_compile_planstate(PlanState *planstate);
+
+/* jitcache.c */
+extern char *jit_cache_read(const char *key, Size *len);
+extern void jit_cache_write(const char *key, const char *data, Size len);
+extern void RemoveJitCodeCache(void);
+
+#endif   /* JIT_H */
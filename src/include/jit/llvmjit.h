@@ -0,0 +1,236 @@
+/*-------------------------------------------------------------------------
+ *
+ * llvmjit.h
+ *	  LLVM specific JIT infrastructure, shared between the files of the
+ *	  LLVM JIT provider.  Only to be included when building with LLVM.
+ *
+ * Portions Copyright (c) 1996-2013, PostgreSQL Global Development Group
+ *
+ * src/include/jit/llvmjit.h
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef LLVMJIT_H
+#define LLVMJIT_H
+
+#ifndef USE_LLVM
+#error "llvmjit.h should only be included by code dealing with llvm"
+#endif
+
+#include <llvm-c/Core.h>
+
+#include "jit/jit.h"
+
+
+typedef struct LLVMJitContext
+{
+	JitContext	base;
+
+	/* number of modules created so far, used to generate unique names */
+	int			module_generation;
+
+	/* module currently being filled, NULL if none */
+	LLVMModuleRef module;
+
+	/* expressions compiled into this context (see llvmjit_expr.c) */
+	List	   *compiled_exprs;
+
+	/* LLVMOrcResourceTrackerRef of each emitted module */
+	List	   *handles;
+
+	/* modules emitted through the code cache, and their functions' names */
+	List	   *cached_modules;
+	List	   *renamed_functions;
+} LLVMJitContext;
+
+
+/* type references, initialized by llvm_session_initialize() */
+extern LLVMContextRef llvm_context;
+extern LLVMTypeRef TypeSizeT;
+extern LLVMTypeRef TypeDatum;
+extern LLVMTypeRef TypeStorageBool;
+extern LLVMTypeRef TypeParamBool;
+extern LLVMTypeRef TypePtr;
+extern LLVMTypeRef TypeExprStateEvalFunc;
+
+
+/* llvmjit.c */
+extern LLVMJitContext *llvm_create_context(int jitFlags);
+extern void llvm_release_context(JitContext *context);
+extern LLVMModuleRef llvm_mutable_module(LLVMJitContext *context);
+extern char *llvm_expand_funcname(LLVMJitContext *context, const char *basename);
+extern void *llvm_get_function(LLVMJitContext *context, const char *funcname);
+extern LLVMValueRef llvm_get_decl(LLVMModuleRef mod, const char *name,
+			  LLVMTypeRef functype);
+extern LLVMValueRef llvm_get_global(LLVMModuleRef mod, const char *name,
+				LLVMTypeRef type);
+
+/* llvmjit_expr.c */
+extern bool llvm_compile_expr(LLVMJitContext *context, ExprState *state);
+extern void llvm_emit_expr(LLVMJitContext *context, LLVMBuilderRef b,
+			   LLVMValueRef v_econtext, ExprState *state, LLVMValueRef v_state,
+			   LLVMValueRef v_resvaluep, LLVMValueRef v_resnullp);
+extern bool llvm_emit_inline_op(LLVMJitContext *context, LLVMBuilderRef b,
+					Oid funcid, LLVMValueRef v_left, LLVMValueRef v_right,
+					LLVMValueRef v_resvaluep);
+
+/* llvmjit_agg.c */
+extern bool llvm_compile_agg(LLVMJitContext *context, AggState *aggstate);
+
+/* llvmjit_hash.c */
+extern bool llvm_compile_hashjoin(LLVMJitContext *context,
+					  HashJoinState *hjstate);
+
+/* llvmjit_sort.c */
+extern bool llvm_compile_sort(LLVMJitContext *context, SortState *sortstate);
+
+/* llvmjit_inline.c */
+extern LLVMValueRef llvm_inline_function_decl(LLVMModuleRef mod, Oid funcid);
+extern void llvm_inline(LLVMModuleRef mod);
+
+/* llvmjit_deform.c */
+extern bool llvm_compile_deform(LLVMJitContext *context, TupleTableSlot *slot);
+extern void llvm_emit_deform_tuple(LLVMBuilderRef b, TupleDesc desc, int natts,
+					   LLVMValueRef v_tupdata,
+					   LLVMValueRef v_values, LLVMValueRef v_isnull);
+
+/* error reporting routines called from generated code */
+extern void llvmjit_error_int4_out_of_range(void) __attribute__((noreturn));
+extern void llvmjit_error_int8_out_of_range(void) __attribute__((noreturn));
+extern void llvmjit_error_float8_overflow(void) __attribute__((noreturn));
+extern void llvmjit_error_float8_underflow(void) __attribute__((noreturn));
+
+
+/*
+ * Small helpers for emitting IR.  All pointers are handled as i8 *, and
+ * struct members are addressed by byte offset (obtained with offsetof() at
+ * compile time of the server), so that the generated code doesn't need
+ * LLVM type definitions of PostgreSQL's structs.
+ */
+
+static inline LLVMValueRef
+l_sizet_const(size_t i)
+{
+	return LLVMConstInt(TypeSizeT, i, false);
+}
+
+static inline LLVMValueRef
+l_int8_const(int8 i)
+{
+	return LLVMConstInt(LLVMInt8TypeInContext(llvm_context), i, false);
+}
+
+static inline LLVMValueRef
+l_int32_const(int32 i)
+{
+	return LLVMConstInt(LLVMInt32TypeInContext(llvm_context), i, false);
+}
+
+static inline LLVMValueRef
+l_datum_const(Datum d)
+{
+	return LLVMConstInt(TypeDatum, d, false);
+}
+
+/* address of the member at byte offset 'off' of the struct at 'ptr' */
+static inline LLVMValueRef
+l_member_addr(LLVMBuilderRef b, LLVMValueRef ptr, size_t off, LLVMTypeRef type)
+{
+	LLVMTypeRef i8 = LLVMInt8TypeInContext(llvm_context);
+	LLVMValueRef idx = l_sizet_const(off);
+	LLVMValueRef addr;
+
+	addr = LLVMBuildGEP2(b, i8, ptr, &idx, 1, "");
+	return LLVMBuildPointerCast(b, addr, LLVMPointerType(type, 0), "");
+}
+
+/* load a member of type 'type' at byte offset 'off' of the struct at 'ptr' */
+static inline LLVMValueRef
+l_load_member(LLVMBuilderRef b, LLVMValueRef ptr, size_t off,
+			  LLVMTypeRef type, const char *name)
+{
+	return LLVMBuildLoad2(b, type, l_member_addr(b, ptr, off, type), name);
+}
+
+/* store 'val' into the member at byte offset 'off' of the struct at 'ptr' */
+static inline void
+l_store_member(LLVMBuilderRef b, LLVMValueRef val, LLVMValueRef ptr, size_t off)
+{
+	LLVMBuildStore(b, val, l_member_addr(b, ptr, off, LLVMTypeOf(val)));
+}
+
+/* load a bool stored at 'v_nullp' as an i1 */
+static inline LLVMValueRef
+l_isnull(LLVMBuilderRef b, LLVMValueRef v_nullp)
+{
+	return LLVMBuildICmp(b, LLVMIntNE,
+						 LLVMBuildLoad2(b, TypeStorageBool, v_nullp, ""),
+						 l_int8_const(0), "");
+}
+
+/*
+ * Make 'v_context' the CurrentMemoryContext, returning the previous one, as
+ * MemoryContextSwitchTo() does.
+ */
+static inline LLVMValueRef
+l_mcxt_switch(LLVMModuleRef mod, LLVMBuilderRef b, LLVMValueRef v_context)
+{
+	LLVMValueRef v_curcontextp;
+	LLVMValueRef v_oldcontext;
+
+	v_curcontextp = llvm_get_global(mod, "CurrentMemoryContext", TypePtr);
+	v_oldcontext = LLVMBuildLoad2(b, TypePtr, v_curcontextp, "oldcontext");
+	LLVMBuildStore(b, v_context, v_curcontextp);
+
+	return v_oldcontext;
+}
+
+/*
+ * Emit code counting a call of generated code, or of the interpreter from
+ * generated code, in the JIT instrumentation of the plan node being
+ * compiled.  Nothing is emitted unless EXPLAIN asked for those statistics.
+ * The counter's address is embedded, which is why instrumented code is kept
+ * out of the code cache.
+ */
+static inline void
+l_count_call(LLVMJitContext *context, LLVMBuilderRef b, bool interpreted)
+{
+	JitNodeInstrumentation *instr = context->base.node_instr;
+	LLVMTypeRef i64 = LLVMInt64TypeInContext(llvm_context);
+	LLVMValueRef v_counterp;
+	uint64	   *counter;
+
+	if (instr == NULL)
+		return;
+
+	counter = interpreted ? &instr->interpreted_calls : &instr->compiled_calls;
+	v_counterp = LLVMConstIntToPtr(l_sizet_const((size_t) counter),
+								   LLVMPointerType(i64, 0));
+	LLVMBuildStore(b,
+				   LLVMBuildAdd(b, LLVMBuildLoad2(b, i64, v_counterp, ""),
+								LLVMConstInt(i64, 1, false), ""),
+				   v_counterp);
+}
+
+/* create an alloca in the entry block of the function being built */
+static inline LLVMValueRef
+l_entry_alloca(LLVMBuilderRef b, LLVMTypeRef type, const char *name)
+{
+	LLVMBasicBlockRef cur = LLVMGetInsertBlock(b);
+	LLVMValueRef fn = LLVMGetBasicBlockParent(cur);
+	LLVMBasicBlockRef entry = LLVMGetEntryBasicBlock(fn);
+	LLVMBuilderRef eb = LLVMCreateBuilderInContext(llvm_context);
+	LLVMValueRef first = LLVMGetFirstInstruction(entry);
+	LLVMValueRef v;
+
+	if (first)
+		LLVMPositionBuilderBefore(eb, first);
+	else
+		LLVMPositionBuilderAtEnd(eb, entry);
+	v = LLVMBuildAlloca(eb, type, name);
+	LLVMDisposeBuilder(eb);
+
+	return v;
+}
+
+#endif   /* LLVMJIT_H */
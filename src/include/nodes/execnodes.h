@@ -17,10 +17,12 @@
 #include "access/genam.h"
 #include "access/heapam.h"
 #include "executor/instrument.h"
+#include "lib/ilist.h"
 #include "nodes/params.h"
 #include "nodes/plannodes.h"
 #include "utils/reltrigger.h"
 #include "utils/sortsupport.h"
+#include "utils/tuplesort.h"
 #include "utils/tuplestore.h"
 
 
@@ -403,6 +405,13 @@ typedef struct EState
 	HeapTuple  *es_epqTuple;	/* array of EPQ substitute tuples */
 	bool	   *es_epqTupleSet; /* true if EPQ tuple is provided */
 	bool	   *es_epqScanDone; /* true if EPQ tuple has been fetched */
+
+	/*
+	 * JIT compilation: es_jit_flags holds the PGJIT_* flags decided on for
+	 * the query, es_jit_context the code generated so far (NULL if none).
+	 */
+	int			es_jit_flags;
+	struct JitContext *es_jit_context;
 } EState;
 
 
@@ -455,15 +464,23 @@ typedef struct ExecAuxRowMark
  *
  * All-in-memory tuple hash tables are used for a number of purposes.
  *
+ * The table is an open-addressing hash table with linear probing.  Each
+ * bucket holds the hash value of its entry next to a pointer to the entry,
+ * so that probing past entries of other groups normally touches nothing
+ * but the bucket array.
+ *
+ * RemoveTupleHashEntry() deletes an entry by backward-shift deletion: the
+ * entries that follow it in its probe run are moved back into the emptied
+ * bucket where they may, so lookups never need tombstones.  The space of a
+ * removed entry goes on a free list, linked through the firstTuple fields,
+ * and is reused by the next entry created.
+ *
  * Note: tab_hash_funcs are for the key datatype(s) stored in the table,
  * and tab_eq_funcs are non-cross-type equality operators for those types.
  * Normally these are the only functions used, but FindTupleHashEntry()
  * supports searching a hashtable using cross-data-type hashing.  For that,
  * the caller must supply hash functions for the LHS datatype as well as
- * the cross-type equality operators to use.  in_hash_funcs and cur_eq_funcs
- * are set to point to the caller's function arrays while doing such a search.
- * During LookupTupleHashEntry(), they point to tab_hash_funcs and
- * tab_eq_funcs respectively.
+ * the cross-type equality operators to use.
  * ----------------------------------------------------------------
  */
 typedef struct TupleHashEntryData *TupleHashEntry;
@@ -476,9 +493,18 @@ typedef struct TupleHashEntryData
 	/* there may be additional data beyond the end of this struct */
 } TupleHashEntryData;			/* VARIABLE LENGTH STRUCT */
 
+typedef struct TupleHashBucketData
+{
+	uint32		hash;			/* hash value of the entry */
+	TupleHashEntry entry;		/* the entry, or NULL if bucket is empty */
+} TupleHashBucketData;
+
 typedef struct TupleHashTableData
 {
-	HTAB	   *hashtab;		/* underlying dynahash table */
+	TupleHashBucketData *buckets;	/* array of nbuckets buckets */
+	uint32		nbuckets;		/* size of buckets array, a power of 2 */
+	uint32		nentries;		/* number of entries in the table */
+	uint32		growthreshold;	/* enlarge the table beyond this many */
 	int			numCols;		/* number of columns in lookup key */
 	AttrNumber *keyColIdx;		/* attr numbers of key columns */
 	FmgrInfo   *tab_hash_funcs; /* hash functions for table datatype(s) */
@@ -486,31 +512,30 @@ typedef struct TupleHashTableData
 	MemoryContext tablecxt;		/* memory context containing table */
 	MemoryContext tempcxt;		/* context for function evaluations */
 	Size		entrysize;		/* actual size to make each hash entry */
+	char	   *freeentries;	/* space for entries yet to be created */
+	int			nfreeentries;	/* number of entries fitting there */
+	TupleHashEntry freelist;	/* removed entries, for reuse */
 	TupleTableSlot *tableslot;	/* slot for referencing table entries */
-	/* The following fields are set transiently for each table search: */
-	TupleTableSlot *inputslot;	/* current input tuple's slot */
-	FmgrInfo   *in_hash_funcs;	/* hash functions for input datatype(s) */
-	FmgrInfo   *cur_eq_funcs;	/* equality functions for input vs. table */
 }	TupleHashTableData;
 
-typedef HASH_SEQ_STATUS TupleHashIterator;
+typedef struct TupleHashIterator
+{
+	TupleHashTable hashtable;	/* table being scanned */
+	uint32		curbucket;		/* next bucket to look at */
+} TupleHashIterator;
 
 /*
  * Use InitTupleHashIterator/TermTupleHashIterator for a read/write scan.
  * Use ResetTupleHashIterator if the table can be frozen (in this case no
- * explicit scan termination is needed).
+ * explicit scan termination is needed).  No entries may be added to the
+ * table while a scan is in progress, as that could rearrange the buckets.
  */
 #define InitTupleHashIterator(htable, iter) \
-	hash_seq_init(iter, (htable)->hashtab)
+	((iter)->hashtable = (htable), (iter)->curbucket = 0)
 #define TermTupleHashIterator(iter) \
-	hash_seq_term(iter)
+	((void) 0)
 #define ResetTupleHashIterator(htable, iter) \
-	do { \
-		hash_freeze((htable)->hashtab); \
-		hash_seq_init(iter, (htable)->hashtab); \
-	} while (0)
-#define ScanTupleHashTable(iter) \
-	((TupleHashEntry) hash_seq_search(iter))
+	InitTupleHashIterator(htable, iter)
 
 
 /* ----------------------------------------------------------------
@@ -535,6 +560,10 @@ typedef HASH_SEQ_STATUS TupleHashIterator;
  *
  * To save on dispatch overhead, each ExprState node contains a function
  * pointer to the routine to execute to evaluate the node.
+ *
+ * The root of an ExprState tree may additionally have been lowered into a
+ * flat program of steps (see execExprInterp.c), in which case its evalfunc
+ * is ExecInterpExpr.  The tree below it stays valid either way.
  * ----------------
  */
 
@@ -550,6 +579,7 @@ struct ExprState
 	NodeTag		type;
 	Expr	   *expr;			/* associated Expr node */
 	ExprStateEvalFunc evalfunc; /* routine to run to execute node */
+	struct ExprProgram *program;	/* flattened form, or NULL if none */
 };
 
 /* ----------------
@@ -985,6 +1015,7 @@ typedef struct PlanState
 								 * top-level plan */
 
 	Instrumentation *instrument;	/* Optional runtime stats for this node */
+	JitNodeInstrumentation *jit_instrument;		/* Optional JIT stats */
 
 	/*
 	 * Common structural data for all Plan types.  These links to subsidiary
@@ -1196,11 +1227,77 @@ typedef struct ScanState
 	TupleTableSlot *ss_ScanTupleSlot;
 } ScanState;
 
-/*
- * SeqScan uses a bare ScanState as its state node, since it needs
- * no additional fields.
- */
-typedef ScanState SeqScanState;
+/* ----------------
+ *	 TupleBatch information
+ *
+ *		In batch mode (see executor/execBatch.c), a scan hands rows to its
+ *		parent in batches instead of one at a time.  A batch holds the values
+ *		of some columns of up to maxrows rows, stored column-wise, and a
+ *		selection vector listing the rows that satisfy the scan's quals.
+ *		For columns of pass-by-reference types only the null flags are
+ *		valid, since the rows' buffers are not kept pinned.
+ *
+ *		ncols			number of columns
+ *		attnos			scan tuple attribute number of each column
+ *		maxattno		largest of attnos
+ *		maxrows			number of rows the batch has room for
+ *		nrows			number of rows stored
+ *		values			values[col][row] is the value of a column in a row
+ *		isnull			isnull[col][row] is its null flag
+ *		nsel			number of rows satisfying the quals
+ *		sel				their row numbers, in ascending order
+ * ----------------
+ */
+typedef struct TupleBatch
+{
+	int			ncols;
+	AttrNumber *attnos;
+	AttrNumber	maxattno;
+	int			maxrows;
+	int			nrows;
+	Datum	  **values;
+	bool	  **isnull;
+	int			nsel;
+	int		   *sel;
+} TupleBatch;
+
+/* ----------------
+ *	 SeqScanState information
+ *
+ *		batch			batch being returned in batch mode, else NULL
+ *		batchquals		quals evaluated over whole batches (BatchQuals)
+ *		rowquals		other quals, evaluated for each row (ExprStates)
+ *		parallelOK		scan may be run with the help of scan workers
+ *		started			first tuple has been fetched
+ *		workers			scan workers helping with the scan, else NULL
+ *		leaderQual		quals for the tuples we scan ourselves, while
+ *						ps.qual is NIL because workers check their own
+ *		leaderDone		our own part of a parallel scan is done
+ *		partialAggs		aggregates (Aggrefs) the workers compute over their
+ *						tuples instead of returning them, else NIL
+ *		sharedHashKeys	inner hash keys (Exprs) of the shared hash table
+ *						the workers insert their tuples into, else NIL
+ *		bloomTable		hash join table whose bloom filter our tuples are
+ *						checked against, else NULL
+ *		bloomKeys		the join's outer hash keys, evaluated over our tuples
+ * ----------------
+ */
+typedef struct SeqScanState
+{
+	ScanState	ss;				/* its first field is NodeTag */
+	TupleBatch *batch;
+	List	   *batchquals;
+	List	   *rowquals;
+	bool		parallelOK;
+	bool		started;
+	struct ScanWorkerGroup *workers;
+	List	   *leaderQual;
+	bool		leaderDone;
+	List	   *partialAggs;
+	List	   *sharedHashKeys;
+	struct HashJoinTableData *bloomTable;
+	List	   *bloomKeys;
+} SeqScanState;
 
 /*
  * These structs store information about index quals that don't have simple
@@ -1577,6 +1674,13 @@ typedef struct MergeJoinState
  *								tuple, or NULL if starting search
  *								(hj_CurXXX variables are undefined if
  *								OuterTupleSlot is empty!)
+ *		hj_CurOuterTupleNo		position of current outer tuple among those
+ *								of a batch processed in chunks, or -1
+ *		hj_OuterGroup			copies of outer tuples read ahead of the
+ *								current one, to prefetch their buckets
+ *		hj_OuterGroupHashValues	their hash values
+ *		hj_OuterGroupSize		number of tuples in hj_OuterGroup
+ *		hj_OuterGroupNext		index of next one to return
  *		hj_OuterTupleSlot		tuple slot for outer tuples
  *		hj_HashTupleSlot		tuple slot for inner (hashed) tuples
  *		hj_NullOuterTupleSlot	prepared null tuple for right/full outer joins
@@ -1585,12 +1689,25 @@ typedef struct MergeJoinState
  *		hj_JoinState			current state of ExecHashJoin state machine
  *		hj_MatchedOuter			true if found a join match for current outer
  *		hj_OuterNotEmpty		true if outer relation known not empty
+ *		hj_OuterScanKeys		outer hash keys as evaluated by the outer
+ *								seqscan, if it may check the bloom filter
+ *		hj_BloomPushedDown		true if the outer seqscan checks the filter
  * ----------------
  */
 
 /* these structs are defined in executor/hashjoin.h: */
 typedef struct HashJoinTupleData *HashJoinTuple;
 typedef struct HashJoinTableData *HashJoinTable;
+typedef struct SharedHashJoinTableData *SharedHashJoinTable;
+
+/* signatures of JIT compiled hash join code, see jit/llvmjit_hash.c */
+struct HashJoinState;
+typedef bool (*ExecHashValueFunc) (PlanState *node, HashJoinTable hashtable,
+											   ExprContext *econtext,
+											   bool keep_nulls,
+											   uint32 *hashvalue);
+typedef bool (*ExecHashMatchFunc) (struct HashJoinState *hjstate,
+											   ExprContext *econtext);
 
 typedef struct HashJoinState
 {
@@ -1604,6 +1721,11 @@ typedef struct HashJoinState
 	int			hj_CurBucketNo;
 	int			hj_CurSkewBucketNo;
 	HashJoinTuple hj_CurTuple;
+	long		hj_CurOuterTupleNo;
+	MinimalTuple *hj_OuterGroup;
+	uint32	   *hj_OuterGroupHashValues;
+	int			hj_OuterGroupSize;
+	int			hj_OuterGroupNext;
 	TupleTableSlot *hj_OuterTupleSlot;
 	TupleTableSlot *hj_HashTupleSlot;
 	TupleTableSlot *hj_NullOuterTupleSlot;
@@ -1612,6 +1734,12 @@ typedef struct HashJoinState
 	int			hj_JoinState;
 	bool		hj_MatchedOuter;
 	bool		hj_OuterNotEmpty;
+	List	   *hj_OuterScanKeys;		/* outer hash keys for outer scan */
+	bool		hj_BloomPushedDown;		/* outer scan checks bloom filter */
+	/* JIT compiled code, if any (see jit/llvmjit_hash.c): */
+	ExecHashValueFunc hj_OuterHashValueFunc;	/* hashes outer tuples */
+	ExecHashMatchFunc hj_MatchFunc;		/* evaluates hashclauses */
+	void	   *hj_JitArg;		/* private data of the above */
 } HashJoinState;
 
 
@@ -1637,6 +1765,41 @@ typedef struct MaterialState
 	Tuplestorestate *tuplestorestate;
 } MaterialState;
 
+/* ----------------
+ *	 MemoizeState information
+ *
+ *		memoize nodes cache the output of their subplan for each set of
+ *		values of the cache keys, see nodeMemoize.c.
+ * ----------------
+ */
+struct MemoizeEntry;					/* private in nodeMemoize.c */
+struct MemoizeTuple;
+
+typedef struct MemoizeState
+{
+	ScanState	ss;				/* its first field is NodeTag */
+	int			mstatus;		/* state of the ExecMemoize state machine */
+	int			nkeys;			/* number of cache keys */
+	List	   *param_exprs;	/* ExprStates of the cache keys */
+	Bitmapset  *keyparamids;	/* IDs of the Params the keys depend on */
+	TupleTableSlot *probeslot;	/* key values of the current scan */
+	FmgrInfo   *eqfunctions;	/* equality functions for the keys */
+	FmgrInfo   *hashfunctions;	/* hash functions for the keys */
+	MemoryContext tableContext; /* memory holding the cache */
+	TupleHashTable hashtable;	/* cache entries, by key */
+	dlist_head	lru_list;		/* cache entries, least recently used first */
+	struct MemoizeEntry *entry; /* entry of the current scan, if any */
+	struct MemoizeTuple *last_tuple;	/* last tuple returned from entry */
+	Size		mem_used;		/* memory the cache takes up */
+	Size		mem_limit;		/* ... and may take up */
+	/* statistics for EXPLAIN ANALYZE */
+	long		cache_hits;		/* scans answered from the cache */
+	long		cache_misses;	/* scans that had to run the subplan */
+	long		cache_evictions;	/* entries evicted to make room */
+	long		cache_overflows;	/* scans too big to cache */
+	Size		mem_peak;		/* peak of mem_used */
+} MemoizeState;
+
 /* ----------------
  *	 SortState information
  * ----------------
@@ -1651,8 +1814,37 @@ typedef struct SortState
 	bool		bounded_Done;	/* value of bounded we did the sort with */
 	int64		bound_Done;		/* value of bound we did the sort with */
 	void	   *tuplesortstate; /* private state of tuplesort.c */
+	/* returns a JIT compiled comparator, if any (see jit/llvmjit_sort.c): */
+	SortTupleComparator (*getcomparator) (struct SortState *node);
+	void	   *getcomparator_arg;	/* private data of getcomparator */
 } SortState;
 
+/* ----------------
+ *	 IncrementalSortState information
+ *
+ *		The input is sorted in batches of whole groups of tuples that are
+ *		equal in the presorted columns.  groupPivot holds the first tuple
+ *		of the last group read into the current batch, and nextTuple the
+ *		tuple that started the next batch, if any.
+ * ----------------
+ */
+typedef struct IncrementalSortState
+{
+	ScanState	ss;				/* its first field is NodeTag */
+	bool		bounded;		/* is the result set bounded? */
+	int64		bound;			/* if bounded, how many tuples are needed */
+	int64		bound_Done;		/* # tuples returned so far */
+	FmgrInfo   *eqfunctions;	/* equality fns for the presorted columns */
+	bool		outerDone;		/* has the input been read completely? */
+	TupleTableSlot *groupPivot; /* first tuple of the current group */
+	TupleTableSlot *nextTuple;	/* first tuple of the next batch, or empty */
+	void	   *tuplesortstate; /* private state of tuplesort.c */
+	/* for EXPLAIN ANALYZE: */
+	long		nbatches;		/* # batches sorted */
+	long		maxSpace;		/* space used by the largest batch, in kB */
+	const char *maxSpaceType;	/* "Memory" or "Disk" */
+} IncrementalSortState;
+
 /* ---------------------
  *	GroupState information
  * -------------------------
@@ -1676,10 +1868,15 @@ typedef struct GroupState
  *	expressions and run the aggregate transition functions.
  * -------------------------
  */
-/* these structs are private in nodeAgg.c: */
+/* these structs are defined in executor/nodeAgg.h: */
 typedef struct AggStatePerAggData *AggStatePerAgg;
 typedef struct AggStatePerGroupData *AggStatePerGroup;
 
+/* signature of a compiled replacement for advance_aggregates() */
+struct AggState;
+typedef void (*AggAdvanceFunc) (struct AggState *aggstate,
+											 AggStatePerGroup pergroup);
+
 typedef struct AggState
 {
 	ScanState	ss;				/* its first field is NodeTag */
@@ -1700,6 +1897,23 @@ typedef struct AggState
 	List	   *hash_needed;	/* list of columns needed in hash table */
 	bool		table_filled;	/* hash table filled yet? */
 	TupleHashIterator hashiter; /* for iterating through hash table */
+	/* these fields are used in AGG_HASHED mode when work_mem runs out: */
+	Size		hash_mem;		/* approx. space used by the hash table */
+	Size		hash_mem_peak;	/* maximum of hash_mem, for EXPLAIN */
+	Size		hash_entrysize; /* estimated space of a group, w/o its tuple */
+	bool		hash_full;		/* no new groups are added to the table */
+	int			hash_depth;		/* partitioning level of the current pass */
+	int			hash_npartitions;	/* number of spill files per pass */
+	struct BufFile **hash_spill;	/* spill files of the current pass */
+	List	   *hash_batches;	/* spilled tuples yet to aggregate */
+	int			hash_nbatches;	/* number of batches aggregated so far */
+	TupleTableSlot *hash_spillslot;		/* for reading spilled tuples */
+	/* JIT compiled per-input-row work, if any (see jit/llvmjit_agg.c): */
+	AggAdvanceFunc advance_func;	/* replaces advance_aggregates() */
+	void	   *advance_arg;	/* private data of advance_func */
+	bool		batch_mode;		/* input read in batches (AGG_PLAIN only) */
+	/* this is used when scan workers aggregate part of the input: */
+	TupleDesc	partial_desc;	/* descriptor of their transition states */
 } AggState;
 
 /* ----------------
@@ -1794,6 +2008,9 @@ typedef struct HashState
 	HashJoinTable hashtable;	/* hash table for the hashjoin */
 	List	   *hashkeys;		/* list of ExprState nodes */
 	/* hashkeys is same as parent's hj_InnerHashKeys */
+	/* JIT compiled replacement for ExecHashGetHashValue(), if any: */
+	ExecHashValueFunc hashvaluefunc;
+	void	   *hashvaluearg;	/* private data of hashvaluefunc */
 } HashState;
 
 /* ----------------
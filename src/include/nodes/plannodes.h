@@ -47,6 +47,8 @@ typedef struct PlannedStmt
 
 	bool		transientPlan;	/* redo plan when TransactionXmin changes? */
 
+	bool		jitCodeCacheable;	/* share JIT code with other backends? */
+
 	struct Plan *planTree;		/* tree of Plan nodes */
 
 	List	   *rtable;			/* list of RangeTblEntry nodes */
@@ -576,6 +578,24 @@ typedef struct Material
 	Plan		plan;
 } Material;
 
+/* ----------------
+ *		memoize node
+ *
+ * Caches the tuples its subplan returns for each distinct set of values of
+ * the cache keys, which are expressions over the parameters the subplan is
+ * rescanned with.  Used on the inner side of a parameterized nestloop.
+ * ----------------
+ */
+typedef struct Memoize
+{
+	Plan		plan;
+	int			numKeys;		/* number of cache keys */
+	Oid		   *hashOperators;	/* hashable equality operators of the keys */
+	List	   *param_exprs;	/* the cache keys */
+	uint32		est_entries;	/* expected number of cache entries, or 0 */
+	Bitmapset  *keyparamids;	/* IDs of the Params the keys depend on */
+} Memoize;
+
 /* ----------------
  *		sort node
  * ----------------
@@ -590,6 +610,20 @@ typedef struct Sort
 	bool	   *nullsFirst;		/* NULLS FIRST/LAST directions */
 } Sort;
 
+/* ----------------
+ *		incremental sort node
+ *
+ * The input is already sorted on the first presortedCols sort columns, so
+ * only runs of tuples that are equal in those need to be sorted, on all
+ * the columns.
+ * ----------------
+ */
+typedef struct IncrementalSort
+{
+	Sort		sort;
+	int			presortedCols;	/* number of presorted leading columns */
+} IncrementalSort;
+
 /* ---------------
  *	 group node -
  *		Used for queries with GROUP BY (but no aggregates) specified.
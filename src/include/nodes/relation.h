@@ -223,6 +223,8 @@ typedef struct PlannerInfo
 
 	double		tuple_fraction; /* tuple_fraction passed to query_planner */
 	double		limit_tuples;	/* limit_tuples passed to query_planner */
+	bool		incremental_sort;	/* true if an Incremental Sort may do the
+									 * ORDER BY sort; set by query_planner */
 
 	bool		hasInheritedTarget;		/* true if parse->resultRelation is an
 										 * inheritance child rel */
@@ -923,6 +925,24 @@ typedef struct MaterialPath
 	Path	   *subpath;
 } MaterialPath;
 
+/*
+ * MemoizePath represents use of a Memoize plan node, i.e., caching of the
+ * output of a parameterized subpath for each set of parameter values.  It
+ * goes on the inner side of a nestloop whose outer side repeats the same
+ * join keys, so that rescans for keys seen before are answered from the
+ * cache.  param_exprs are the outer-side expressions the subpath is
+ * parameterized by, and calls is the number of rescans expected.
+ */
+typedef struct MemoizePath
+{
+	Path		path;
+	Path	   *subpath;
+	List	   *hash_operators;	/* hashable equality operators, as OIDs */
+	List	   *param_exprs;	/* cache keys */
+	double		calls;			/* expected number of rescans */
+	uint32		est_entries;	/* expected number of cache entries, or 0 */
+} MemoizePath;
+
 /*
  * UniquePath represents elimination of distinct rows from the output of
  * its subpath.
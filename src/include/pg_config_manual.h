@@ -103,6 +103,13 @@
  */
 #define ALIGNOF_BUFFER	32
 
+/*
+ * Alignment of the buffers that relation data is read into and written from
+ * with direct I/O (see the direct_io parameter).  4kB is enough for the
+ * filesystems and devices we know of.  BLCKSZ must be a multiple of it.
+ */
+#define ALIGNOF_DIRECT_IO_BUFFER	4096
+
 /*
  * Disable UNIX sockets for certain operating systems.
  */
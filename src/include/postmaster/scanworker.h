@@ -0,0 +1,59 @@
+/*-------------------------------------------------------------------------
+ *
+ * scanworker.h
+ *	  background workers that help a backend with a sequential scan
+ *
+ *
+ * Portions Copyright (c) 1996-2013, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ * src/include/postmaster/scanworker.h
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef SCANWORKER_H
+#define SCANWORKER_H
+
+#include "access/heapam.h"
+#include "nodes/pg_list.h"
+
+
+/* GUC variables */
+extern int	parallel_scan_workers;
+extern int	parallel_scan_degree;
+extern int	parallel_hash_mem;
+
+/*
+ * State a backend keeps for the scan workers it is using.  The backend
+ * (the "leader") scans the relation alongside the workers; the page counter
+ * they all take pages from is *pscan.
+ */
+typedef struct ScanWorkerGroup
+{
+	int			nworkers;		/* number of workers in the group */
+	int		   *slotnos;		/* their slots in shared memory */
+	uint64	   *readpos;		/* bytes read from each worker's queue */
+	uint64	   *headpos;		/* bytes known to be in each queue */
+	uint64	   *tailpos;		/* read position last reported to worker */
+	bool	   *finished;		/* worker is done and its queue is empty */
+	int			nactive;		/* number of workers not finished */
+	int			current;		/* worker we're reading tuples from */
+	ParallelHeapScanDesc pscan; /* shared page counter */
+	HeapTupleData tuple;		/* last tuple returned */
+	double		nfiltered;		/* tuples removed by quals in the workers */
+} ScanWorkerGroup;
+
+extern Size ScanWorkerShmemSize(void);
+extern void ScanWorkerShmemInit(void);
+extern void ScanWorkerRegister(void);
+
+extern ScanWorkerGroup *ScanWorkersStart(Relation relation,
+				 Snapshot snapshot, List *quals, List *aggs,
+				 List *hashkeys, List *hashtlist, int nworkers);
+extern HeapTuple ScanWorkersGetTuple(ScanWorkerGroup *group, bool wait);
+extern void ScanWorkersFinish(ScanWorkerGroup *group);
+extern void *ScanWorkersGetHashArena(Size *size);
+extern void ScanWorkersReleaseHashArena(void);
+extern void AtEOXact_ScanWorkers(bool isCommit);
+
+#endif   /* SCANWORKER_H */
@@ -0,0 +1,55 @@
+/*-------------------------------------------------------------------------
+ *
+ * atomics.h
+ *	  Atomic operations on shared memory.
+ *
+ * These let several processes update a word of shared memory without a
+ * lock.  They are only available if HAVE_PG_ATOMICS is defined; code using
+ * them must have a fallback, typically a spinlock, for other platforms.
+ *
+ * The operations work on int-sized and pointer-sized variables.  They all
+ * act as full memory barriers.
+ *
+ *
+ * Portions Copyright (c) 1996-2013, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ * src/include/storage/atomics.h
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef ATOMICS_H
+#define ATOMICS_H
+
+/*
+ * HAVE_GCC_INT_ATOMICS only promises __sync_lock_test_and_set, which is all
+ * the spinlock code needs; compare-and-swap and the fetch-and-op builtins are
+ * probed for separately, since some targets have the former but not these.
+ */
+#if defined(HAVE_GCC_INT_CAS) && !defined(__INTEL_COMPILER)
+
+#define HAVE_PG_ATOMICS 1
+
+/*
+ * If *ptr equals oldval, set it to newval.  Returns true if it did.
+ */
+#define pg_atomic_compare_exchange(ptr, oldval, newval) \
+	__sync_bool_compare_and_swap((ptr), (oldval), (newval))
+
+/*
+ * Add to *ptr, returning the value it had before.
+ */
+#define pg_atomic_fetch_add(ptr, add) \
+	__sync_fetch_and_add((ptr), (add))
+
+/*
+ * Set or clear bits of *ptr, returning the value it had before.
+ */
+#define pg_atomic_fetch_or(ptr, bits) \
+	__sync_fetch_and_or((ptr), (bits))
+#define pg_atomic_fetch_and(ptr, bits) \
+	__sync_fetch_and_and((ptr), (bits))
+
+#endif   /* HAVE_GCC_INT_CAS */
+
+#endif   /* ATOMICS_H */
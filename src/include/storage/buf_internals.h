@@ -15,6 +15,7 @@
 #ifndef BUFMGR_INTERNALS_H
 #define BUFMGR_INTERNALS_H
 
+#include "storage/atomics.h"
 #include "storage/buf.h"
 #include "storage/latch.h"
 #include "storage/lwlock.h"
@@ -24,24 +25,47 @@
 #include "utils/relcache.h"
 
 
+/*
+ * A buffer's state is a single 32-bit word holding its refcount, usage
+ * count and flags, so that it can be updated with one atomic operation:
+ *
+ * - 18 bits refcount
+ * - 4 bits usage count
+ * - 10 bits of flags
+ *
+ * The refcount is bounded by the number of backends (see MAX_BACKENDS), as
+ * each holds at most one shared pin on a buffer.
+ */
+#define BUF_REFCOUNT_ONE		1
+#define BUF_REFCOUNT_MASK		((1U << 18) - 1)
+#define BUF_USAGECOUNT_SHIFT	18
+#define BUF_USAGECOUNT_ONE		(1U << BUF_USAGECOUNT_SHIFT)
+#define BUF_USAGECOUNT_MASK		(0xFU << BUF_USAGECOUNT_SHIFT)
+#define BUF_FLAG_MASK			0xFFC00000U
+
+#define BUF_STATE_GET_REFCOUNT(state) ((state) & BUF_REFCOUNT_MASK)
+#define BUF_STATE_GET_USAGECOUNT(state) \
+	(((state) & BUF_USAGECOUNT_MASK) >> BUF_USAGECOUNT_SHIFT)
+
 /*
  * Flags for buffer descriptors
  *
  * Note: TAG_VALID essentially means that there is a buffer hashtable
  * entry associated with the buffer's tag.
  */
-#define BM_DIRTY				(1 << 0)		/* data needs writing */
-#define BM_VALID				(1 << 1)		/* data is valid */
-#define BM_TAG_VALID			(1 << 2)		/* tag is assigned */
-#define BM_IO_IN_PROGRESS		(1 << 3)		/* read or write in progress */
-#define BM_IO_ERROR				(1 << 4)		/* previous I/O failed */
-#define BM_JUST_DIRTIED			(1 << 5)		/* dirtied since write started */
-#define BM_PIN_COUNT_WAITER		(1 << 6)		/* have waiter for sole pin */
-#define BM_CHECKPOINT_NEEDED	(1 << 7)		/* must write for checkpoint */
-#define BM_PERMANENT			(1 << 8)		/* permanent relation (not
+#define BM_LOCKED				(1U << 22)		/* buffer header is locked */
+#define BM_DIRTY				(1U << 23)		/* data needs writing */
+#define BM_VALID				(1U << 24)		/* data is valid */
+#define BM_TAG_VALID			(1U << 25)		/* tag is assigned */
+#define BM_IO_IN_PROGRESS		(1U << 26)		/* read or write in progress */
+#define BM_IO_ERROR				(1U << 27)		/* previous I/O failed */
+#define BM_JUST_DIRTIED			(1U << 28)		/* dirtied since write started */
+#define BM_PIN_COUNT_WAITER		(1U << 29)		/* have waiter for sole pin */
+#define BM_CHECKPOINT_NEEDED	(1U << 30)		/* must write for checkpoint */
+#define BM_PERMANENT			(1U << 31)		/* permanent relation (not
 												 * unlogged) */
 
-typedef bits16 BufFlags;
+typedef uint32 BufFlags;
 
 /*
  * The maximum allowed value of usage_count represents a tradeoff between
@@ -99,27 +123,35 @@ typedef struct buftag
  * The shared buffer mapping table is partitioned to reduce contention.
  * To determine which partition lock a given tag requires, compute the tag's
  * hash code with BufTableHashCode(), then apply BufMappingPartitionLock().
- * NB: NUM_BUFFER_PARTITIONS must be a power of 2!
+ * The number of partitions in use, NumBufferPartitions, depends on the
+ * size of the buffer pool; it's a power of 2, at most NUM_BUFFER_PARTITIONS.
  */
 #define BufTableHashPartition(hashcode) \
-	((hashcode) % NUM_BUFFER_PARTITIONS)
+	((hashcode) & (NumBufferPartitions - 1))
 #define BufMappingPartitionLock(hashcode) \
 	((LWLockId) (FirstBufMappingLock + BufTableHashPartition(hashcode)))
 
 /*
  *	BufferDesc -- shared descriptor/state data for a single shared buffer.
  *
- * Note: buf_hdr_lock must be held to examine or change the tag, flags,
- * usage_count, refcount, or wait_backend_pid fields.  buf_id field never
- * changes after initialization, so does not need locking.	freeNext is
- * protected by the BufFreelistLock not buf_hdr_lock.  The LWLocks can take
- * care of themselves.	The buf_hdr_lock is *not* used to control access to
- * the data in the buffer!
+ * Note: the buffer header lock must be held to examine or change the tag,
+ * state, or wait_backend_pid fields.  buf_id field never changes after
+ * initialization, so does not need locking.  freeNext is protected by the
+ * buffer strategy spinlock (see freelist.c), not the header lock.  The
+ * LWLocks can take care of themselves.  The header lock is *not* used to
+ * control access to the data in the buffer!
+ *
+ * Where atomic operations are available (HAVE_PG_ATOMICS), the header lock
+ * is the BM_LOCKED bit of the state word rather than a spinlock of its own.
+ * That lets PinBuffer and UnpinBuffer change the refcount and usage count
+ * with a compare-and-swap of the state word instead of taking the lock;
+ * they only retry, without changing anything, while BM_LOCKED is set.  So
+ * anyone holding the header lock can still modify the state word directly.
  *
  * An exception is that if we have the buffer pinned, its tag can't change
- * underneath us, so we can examine the tag without locking the spinlock.
+ * underneath us, so we can examine the tag without locking the header.
  * Also, in places we do one-time reads of the flags without bothering to
- * lock the spinlock; this is generally for situations where we don't expect
+ * lock the header; this is generally for situations where we don't expect
  * the flag bit being tested to be changing.
  *
  * We can't physically remove items from a disk page if another backend has
@@ -134,12 +166,13 @@ typedef struct buftag
 typedef struct sbufdesc
 {
 	BufferTag	tag;			/* ID of page contained in buffer */
-	BufFlags	flags;			/* see bit definitions above */
-	uint16		usage_count;	/* usage counter for clock sweep code */
-	unsigned	refcount;		/* # of backends holding pins on buffer */
+	uint32		state;			/* refcount, usage count and flags; see
+								 * bit definitions above */
 	int			wait_backend_pid;		/* backend PID of pin-count waiter */
 
+#ifndef HAVE_PG_ATOMICS
 	slock_t		buf_hdr_lock;	/* protects the above fields */
+#endif
 
 	int			buf_id;			/* buffer's index number (from 0) */
 	int			freeNext;		/* link in freelist chain */
@@ -158,7 +191,7 @@ typedef struct sbufdesc
 #define FREENEXT_NOT_IN_LIST	(-2)
 
 /*
- * Macros for acquiring/releasing a shared buffer header's spinlock.
+ * Macros for acquiring/releasing a shared buffer header's lock.
  * Do not apply these to local buffers!
  *
  * Note: as a general coding rule, if you are using these then you probably
@@ -166,8 +199,14 @@ typedef struct sbufdesc
  * ensure that the compiler doesn't rearrange accesses to the header to
  * occur before or after the spinlock is acquired/released.
  */
+#ifdef HAVE_PG_ATOMICS
+extern void LockBufHdr(volatile BufferDesc *desc);
+#define UnlockBufHdr(bufHdr) \
+	((void) pg_atomic_fetch_and(&(bufHdr)->state, ~BM_LOCKED))
+#else
 #define LockBufHdr(bufHdr)		SpinLockAcquire(&(bufHdr)->buf_hdr_lock)
 #define UnlockBufHdr(bufHdr)	SpinLockRelease(&(bufHdr)->buf_hdr_lock)
+#endif
 
 
 /* in buf_init.c */
@@ -182,8 +221,7 @@ extern BufferDesc *LocalBufferDescriptors;
  */
 
 /* freelist.c */
-extern volatile BufferDesc *StrategyGetBuffer(BufferAccessStrategy strategy,
-				  bool *lock_held);
+extern volatile BufferDesc *StrategyGetBuffer(BufferAccessStrategy strategy);
 extern void StrategyFreeBuffer(volatile BufferDesc *buf);
 extern bool StrategyRejectBuffer(BufferAccessStrategy strategy,
 					 volatile BufferDesc *buf);
@@ -195,8 +233,10 @@ extern Size StrategyShmemSize(void);
 extern void StrategyInitialize(bool init);
 
 /* buf_table.c */
-extern Size BufTableShmemSize(int size);
-extern void InitBufTable(int size);
+extern PGDLLIMPORT int NumBufferPartitions;
+
+extern Size BufTableShmemSize(void);
+extern void InitBufTable(void);
 extern uint32 BufTableHashCode(BufferTag *tagPtr);
 extern int	BufTableLookup(BufferTag *tagPtr, uint32 hashcode);
 extern int	BufTableInsert(BufferTag *tagPtr, uint32 hashcode, int buf_id);
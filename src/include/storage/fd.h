@@ -51,8 +51,18 @@ typedef char *FileName;
 typedef int File;
 
 
-/* GUC parameter */
+/*
+ * Possible values of direct_io: which files to bypass the kernel's cache for.
+ * These are bits, so "all" is both of the others.
+ */
+#define DIRECT_IO_OFF	0
+#define DIRECT_IO_DATA	0x01		/* relation files */
+#define DIRECT_IO_WAL	0x02		/* WAL segments */
+#define DIRECT_IO_ALL	(DIRECT_IO_DATA | DIRECT_IO_WAL)
+
+/* GUC parameters */
 extern int	max_files_per_process;
+extern int	direct_io;
 
 /*
  * This is private to fd.c, but exported for save/restore_backend_variables()
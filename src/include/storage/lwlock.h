@@ -20,8 +20,11 @@
  * this file include lock.h or bufmgr.h would be backwards.
  */
 
-/* Number of partitions of the shared buffer mapping hashtable */
-#define NUM_BUFFER_PARTITIONS  16
+/*
+ * Maximum number of partitions of the shared buffer mapping hashtable;
+ * the number actually used depends on shared_buffers (see buf_table.c)
+ */
+#define NUM_BUFFER_PARTITIONS  128
 
 /* Number of partitions the shared lock tables are divided into */
 #define LOG2_NUM_LOCK_PARTITIONS  4
@@ -46,7 +49,7 @@
  */
 typedef enum LWLockId
 {
-	BufFreelistLock,
+	UnusedLWLock0,				/* was BufFreelistLock */
 	ShmemIndexLock,
 	OidGenLock,
 	XidGenLock,
@@ -36,4 +36,6 @@ extern const FmgrBuiltin fmgr_builtins[];
 
 extern const int fmgr_nbuiltins;	/* number of entries in table */
 
+extern const FmgrBuiltin *fmgr_isbuiltin(Oid id);
+
 #endif   /* FMGRTAB_H */
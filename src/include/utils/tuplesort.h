@@ -31,6 +31,22 @@
  */
 typedef struct Tuplesortstate Tuplesortstate;
 
+/*
+ * The representation of a tuple being sorted; see tuplesort.c.  It is only
+ * exposed, together with the signature of the functions comparing two of
+ * them, so that JIT compiled comparators can be plugged into heap sorts.
+ */
+typedef struct SortTuple
+{
+	void	   *tuple;			/* the tuple proper */
+	Datum		datum1;			/* value of first key column */
+	bool		isnull1;		/* is first key column NULL? */
+	int			tupindex;		/* see notes in tuplesort.c */
+} SortTuple;
+
+typedef int (*SortTupleComparator) (const SortTuple *a, const SortTuple *b,
+												Tuplesortstate *state);
+
 /*
  * We provide multiple interfaces to what is essentially the same code,
  * since different callers have different data to be sorted and want to
@@ -80,6 +96,10 @@ extern Tuplesortstate *tuplesort_begin_datum(Oid datumType,
 					  int workMem, bool randomAccess);
 
 extern void tuplesort_set_bound(Tuplesortstate *state, int64 bound);
+extern void tuplesort_set_heap_comparator(Tuplesortstate *state,
+							  SortTupleComparator comparator);
+extern int tuplesort_heap_compare_key(Tuplesortstate *state, int keyno,
+						   Datum datum1, Datum datum2);
 
 extern void tuplesort_puttupleslot(Tuplesortstate *state,
 					   TupleTableSlot *slot);
@@ -442,3 +442,80 @@ select string_agg(v, NULL) from bytea_test_table;
 select string_agg(v, decode('ee', 'hex')) from bytea_test_table;
 
 drop table bytea_test_table;
+
+-- batch execution of plain aggregates over a sequential scan
+create temp table batch_tbl as
+  select i as a, (i % 7)::int2 as b, i::float8 / 4 as c, i::int8 * 1000000000 as d
+  from generate_series(1, 3000) i;
+insert into batch_tbl values (null, null, 'NaN', null);
+
+select count(*), count(b), sum(a), sum(b), min(a), max(a), min(d), max(d),
+       sum(c), min(c), max(c)
+  from batch_tbl where a > 1000 and b <> 3;
+select count(*), count(a), sum(b), min(b), max(b), min(c), max(c)
+  from batch_tbl where c > 700 and 2900 >= a;
+select count(*), count(a), max(c), min(c) from batch_tbl where c > 700;
+select count(*), max(a) from batch_tbl where a > 5000;
+select count(*), sum(a), max(c) from batch_tbl having count(*) > 3000;
+-- a qual that can't be evaluated in batches is checked per row first
+select count(*), sum(a) from batch_tbl where a % 2 = 0 and a < 101;
+
+set batch_execution = off;
+select count(*), count(b), sum(a), sum(b), min(a), max(a), min(d), max(d),
+       sum(c), min(c), max(c)
+  from batch_tbl where a > 1000 and b <> 3;
+select count(*), count(a), sum(b), min(b), max(b), min(c), max(c)
+  from batch_tbl where c > 700 and 2900 >= a;
+reset batch_execution;
+
+drop table batch_tbl;
+
+-- hashed aggregation whose groups outgrow work_mem spills to temp files;
+-- the planner can't tell how many groups there are, so it expects the hash
+-- table to fit
+begin;
+set local work_mem = '64kB';
+explain (costs off)
+  select g % 10000 as g, count(*) as c, sum(g) as s
+  from generate_series(0, 49999) g group by g % 10000;
+-- 10000 groups take far more than 64kB, so there is more than one batch;
+-- hide the numbers that depend on how the groups happen to be split
+create function explain_hagg(query text) returns setof text
+language plpgsql as
+$$
+declare
+    ln text;
+begin
+    for ln in
+        execute format('explain (analyze, costs off, timing off) %s', query)
+    loop
+        if ln like 'Total runtime:%' then
+            continue;
+        end if;
+        ln := regexp_replace(ln, 'actual rows=\d+ loops=\d+', 'actual rows=N loops=N');
+        ln := regexp_replace(ln, 'Batches: 1  ', 'Batches: One  ');
+        ln := regexp_replace(ln, 'Batches: \d+', 'Batches: N');
+        ln := regexp_replace(ln, 'Memory Usage: \d+kB', 'Memory Usage: NkB');
+        return next ln;
+    end loop;
+end;
+$$;
+select explain_hagg('
+  select g % 10000 as g, count(*) as c, sum(g) as s
+  from generate_series(0, 49999) g group by g % 10000');
+create temp table hagg_spill as
+  select g % 10000 as g, count(*) as c, sum(g) as s
+  from generate_series(0, 49999) g group by g % 10000;
+select count(*), sum(c), sum(s), min(c), max(c), count(distinct g)
+  from hagg_spill;
+-- the groups must come out the same as with sorted aggregation
+set local enable_hashagg = off;
+explain (costs off)
+  select g % 10000 as g, count(*) as c, sum(g) as s
+  from generate_series(0, 49999) g group by g % 10000;
+create temp table hagg_sorted as
+  select g % 10000 as g, count(*) as c, sum(g) as s
+  from generate_series(0, 49999) g group by g % 10000;
+select count(*) from hagg_spill h full join hagg_sorted s using (g)
+  where h.c is distinct from s.c or h.s is distinct from s.s;
+rollback;
@@ -5,7 +5,7 @@
 -- all functions CREATEd
 CREATE AGGREGATE newavg (
    sfunc = int4_avg_accum, basetype = int4, stype = _int8,
-   finalfunc = int8_avg,
+   finalfunc = int8_avg, combinefunc = int8_avg_combine,
    initcond1 = '{0,0}'
 );
 
@@ -23,7 +23,13 @@ CREATE AGGREGATE newsum (
 -- zero-argument aggregate
 CREATE AGGREGATE newcnt (*) (
    sfunc = int8inc, stype = int8,
-   initcond = '0'
+   combinefunc = int8pl, initcond = '0'
+);
+
+-- combine function must return the transition type
+CREATE AGGREGATE newcnt_bad (*) (
+   sfunc = int8inc, stype = int8,
+   combinefunc = int8eq, initcond = '0'
 );
 
 -- old-style spelling of same
@@ -0,0 +1,47 @@
+--
+-- INCREMENTAL SORT
+--
+-- Test sorting input that is already sorted on a leading part of the keys
+--
+
+CREATE TABLE incsort_tbl (a int, b int);
+-- groups of 10, with b out of order within each group
+INSERT INTO incsort_tbl SELECT i / 10, (i * 7) % 10 FROM generate_series(0, 399) i;
+-- one group bigger than a batch
+INSERT INTO incsort_tbl SELECT 40, i FROM generate_series(99, 0, -1) i;
+CREATE INDEX incsort_tbl_a_idx ON incsort_tbl (a);
+ANALYZE incsort_tbl;
+
+-- make the index scan the only way to read the table in order of a
+SET enable_seqscan = off;
+
+EXPLAIN (COSTS OFF)
+SELECT a, b FROM incsort_tbl ORDER BY a, b;
+
+-- batches end at the first group boundary after 32 tuples, so the first
+-- ones hold a = 0..3, a = 4..7 and so on, and a = 40 is a batch of its own
+SELECT a, b FROM incsort_tbl ORDER BY a, b OFFSET 36 LIMIT 8;
+SELECT a, b FROM incsort_tbl ORDER BY a, b OFFSET 395 LIMIT 10;
+
+-- the whole result is in order
+SELECT count(*), md5(string_agg(a || ':' || b, ','))
+  FROM (SELECT a, b FROM incsort_tbl ORDER BY a, b) s;
+
+-- a LIMIT is passed down as a bound on each batch's sort
+EXPLAIN (COSTS OFF)
+SELECT a, b FROM incsort_tbl ORDER BY a, b LIMIT 5;
+SELECT a, b FROM incsort_tbl ORDER BY a, b LIMIT 5;
+SELECT a, b FROM incsort_tbl ORDER BY a DESC, b LIMIT 5;
+
+-- without incremental sort, the index isn't useful and we sort everything
+SET enable_incrementalsort = off;
+
+EXPLAIN (COSTS OFF)
+SELECT a, b FROM incsort_tbl ORDER BY a, b LIMIT 5;
+SELECT count(*), md5(string_agg(a || ':' || b, ','))
+  FROM (SELECT a, b FROM incsort_tbl ORDER BY a, b) s;
+
+RESET enable_incrementalsort;
+RESET enable_seqscan;
+
+DROP TABLE incsort_tbl;
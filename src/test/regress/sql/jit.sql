@@ -0,0 +1,195 @@
+--
+-- JIT compilation of expressions
+--
+-- With jit_above_cost = 0 every query is compiled if the server was built
+-- with LLVM support.  Either way the results must match the interpreter's.
+--
+CREATE TABLE jittest (i4 int4, i2 int2, i8 int8, f8 float8, b bool);
+INSERT INTO jittest VALUES
+  (1, 1, 1, 1.5, true),
+  (-2, 2, 4000000000, 'NaN', false),
+  (NULL, 3, NULL, 'Infinity', NULL),
+  (2147483647, -32768, '-9223372036854775808', '-Infinity', true),
+  (0, 0, 0, 0, false);
+
+SET jit = on;
+SET jit_above_cost = 0;
+
+-- comparisons, boolean logic and null tests
+SELECT i2, i4 < i2 AS lt, i8 >= i4 AS ge, f8 > 1 AS fgt, f8 = f8 AS feq,
+       b AND i4 > 0 AS band, b OR i4 IS NULL AS bor, NOT b AS nb
+  FROM jittest ORDER BY i2;
+
+-- arithmetic
+SELECT i2, i4 + i2 AS sum, i4 * i2 AS prod, i8 * 2 - i8 AS i8, f8 * 2 + 1 AS f8
+  FROM jittest WHERE i2 >= 0 ORDER BY i2;
+
+-- other function calls, strict and not
+SELECT i2, concat(i4, '/', b) AS c, int4larger(i4, i2) AS larger, abs(i8) AS abs
+  FROM jittest WHERE i2 > -32768 ORDER BY i2;
+
+-- overflow is detected as usual
+SELECT i4 + 1 FROM jittest WHERE i2 = -32768;
+SELECT i8 - 1 FROM jittest WHERE i2 = -32768;
+SELECT f8 * '1e308'::float8 * 2 FROM jittest WHERE i2 = 1;
+SELECT f8 * '1e-308'::float8 * '1e-300'::float8 FROM jittest WHERE i2 = 1;
+
+-- errors must not leave generated code behind
+BEGIN;
+SAVEPOINT s;
+SELECT i4 * 2 FROM jittest WHERE i2 < 0;
+ROLLBACK TO s;
+SELECT count(*) FROM jittest WHERE i4 + i2 > 0;
+COMMIT;
+
+-- the optimizing compiler gives the same results
+SET jit_optimize_above_cost = 0;
+SELECT i2, i4 < i2 AS lt, i8 >= i4 AS ge, f8 > 1 AS fgt, f8 = f8 AS feq,
+       b AND i4 > 0 AS band, b OR i4 IS NULL AS bor, NOT b AS nb
+  FROM jittest ORDER BY i2;
+SELECT i2, i4 + i2 AS sum, i4 * i2 AS prod, i8 * 2 - i8 AS i8, f8 * 2 + 1 AS f8
+  FROM jittest WHERE i2 >= 0 ORDER BY i2;
+
+RESET jit_optimize_above_cost;
+
+-- tuple deforming: NOT NULL and nullable, fixed and variable width columns,
+-- and rows stored before a column was added
+CREATE TABLE jitdeform (a int4 NOT NULL, b text, c int8 NOT NULL, d int2,
+                        e text NOT NULL, f float8);
+INSERT INTO jitdeform VALUES
+  (1, 'one', 10, 1, 'x', 1.5),
+  (2, NULL, 20, NULL, repeat('y', 200), NULL),
+  (3, repeat('z', 3), 30, 3, '', 3.5);
+ALTER TABLE jitdeform ADD COLUMN g int4;
+INSERT INTO jitdeform VALUES (4, 'four', 40, 4, 'w', NULL, 44);
+SELECT a, b, c, d, length(e) AS e, f, g FROM jitdeform ORDER BY a;
+SELECT a, g FROM jitdeform WHERE d IS NULL OR g > 0 ORDER BY a;
+SET jit_tuple_deforming = off;
+SELECT a, b, c, d, length(e) AS e, f, g FROM jitdeform ORDER BY a;
+RESET jit_tuple_deforming;
+DROP TABLE jitdeform;
+
+-- aggregates: transition functions evaluated inline and through fmgr,
+-- strict and not, with plain, sorted and hashed grouping
+CREATE TABLE jitagg AS
+  SELECT g % 3 AS grp, NULLIF(g, 5) AS i4, (g * 100)::int2 AS i2,
+         g * 10000000000 AS i8, g / 4::float8 AS f8, g::text AS t
+    FROM generate_series(1, 10) g;
+SELECT count(*), count(i4), sum(i4), sum(i2), sum(i8), sum(f8),
+       min(i4), max(i4), min(i8), max(f8), avg(i4)
+  FROM jitagg;
+SELECT count(*), count(i4), sum(i4), max(i4), sum(f8) FROM jitagg
+  WHERE i4 IS NULL;
+SELECT grp, count(*), count(i4), sum(i4), min(i4), max(i4), sum(f8), max(i8)
+  FROM jitagg GROUP BY grp ORDER BY grp;
+SET enable_hashagg = off;
+SELECT grp, count(*), count(i4), sum(i4), min(i4), max(i4), sum(f8), max(i8)
+  FROM jitagg GROUP BY grp ORDER BY grp;
+RESET enable_hashagg;
+-- argument expressions
+SELECT sum(i4 * 2 + i2), max(f8 * 2), min(CASE WHEN grp = 1 THEN i4 END)
+  FROM jitagg;
+-- DISTINCT and ORDER BY are left to the interpreter
+SELECT grp, count(DISTINCT i4 % 2) AS parities,
+       string_agg(t, ',' ORDER BY t DESC) AS ts
+  FROM jitagg GROUP BY grp ORDER BY grp;
+-- overflow in a transition function is detected as usual
+SELECT sum(f8 * 5e307::float8) FROM jitagg;
+DROP TABLE jitagg;
+
+-- hash joins: keys hashed inline and through fmgr, NULL keys, cross-type
+-- and multi-column keys, and outer joins keeping NULL keys
+CREATE TABLE jithash_o AS
+  SELECT g AS id, (g % 4)::int2 AS k2,
+         CASE WHEN g % 5 = 0 THEN NULL ELSE g % 7 END AS k4,
+         (g % 6) * 10000000000 AS k8, 'v' || g % 3 AS t
+    FROM generate_series(1, 12) g;
+CREATE TABLE jithash_i AS
+  SELECT g AS id, (g % 3)::int2 AS k2,
+         CASE WHEN g % 4 = 0 THEN NULL ELSE g % 5 END AS k4,
+         (g % 4) * 10000000000 AS k8, 'v' || g % 2 AS t
+    FROM generate_series(1, 8) g;
+SET enable_mergejoin = off;
+SET enable_nestloop = off;
+SELECT count(*), sum(o.id), sum(i.id)
+  FROM jithash_o o JOIN jithash_i i ON o.k4 = i.k4;
+SELECT count(*), sum(o.id), sum(i.id)
+  FROM jithash_o o JOIN jithash_i i ON o.k8 = i.k8;
+SELECT o.id, i.id, o.t, o.k2
+  FROM jithash_o o JOIN jithash_i i ON o.t = i.t AND o.k2 = i.k2
+  ORDER BY 1, 2;
+SELECT count(*), sum(o.id), sum(i.id)
+  FROM jithash_o o JOIN jithash_i i ON o.k2 = i.k4;
+SELECT o.id, i.id
+  FROM jithash_o o JOIN jithash_i i ON o.id + 1 = i.id * 2
+  ORDER BY 1, 2;
+SELECT count(*), count(i.id), sum(o.id), sum(i.id)
+  FROM jithash_o o LEFT JOIN jithash_i i ON o.k4 = i.k4;
+SELECT count(*), count(o.id), count(i.id)
+  FROM jithash_o o FULL JOIN jithash_i i ON o.k4 = i.k4;
+RESET enable_mergejoin;
+RESET enable_nestloop;
+DROP TABLE jithash_o, jithash_i;
+
+-- sorts on several keys: directions, NULL ordering, bounded sorts and the
+-- sorts below a merge join
+CREATE TABLE jitsort AS
+  SELECT g AS id, g % 3 AS a,
+         CASE WHEN g % 4 = 0 THEN NULL ELSE (g % 5) * 10000000000 END AS b,
+         'x' || g % 2 AS t
+    FROM generate_series(1, 12) g;
+SELECT a, b, t, id FROM jitsort ORDER BY a, b DESC, t, id;
+SELECT a, b, id FROM jitsort ORDER BY b NULLS FIRST, a DESC, id;
+SELECT t, b, id FROM jitsort ORDER BY t DESC, b NULLS FIRST, id LIMIT 5;
+SET enable_hashjoin = off;
+SET enable_nestloop = off;
+SELECT count(*), sum(x.id + y.id)
+  FROM jitsort x JOIN jitsort y ON x.a = y.a AND x.t = y.t;
+RESET enable_hashjoin;
+RESET enable_nestloop;
+DROP TABLE jitsort;
+
+-- generic plans of prepared statements share their code through the cache
+SET jit_code_cache = on;
+PREPARE jitcache(int) AS
+  SELECT count(*), sum(i4 + $1) AS s4, sum(i8 * 2) AS s8
+    FROM jittest WHERE i2 >= $1;
+EXECUTE jitcache(0);
+EXECUTE jitcache(0);
+EXECUTE jitcache(0);
+EXECUTE jitcache(0);
+EXECUTE jitcache(0);
+EXECUTE jitcache(0);
+EXECUTE jitcache(1);
+DEALLOCATE jitcache;
+RESET jit_code_cache;
+
+-- EXPLAIN's JIT details are only collected when executing
+EXPLAIN (JIT) SELECT 1;
+-- what was compiled for each node, and a summary of the query's code; how
+-- often generated code runs and how many functions it's split into are
+-- implementation details, so hide those
+CREATE FUNCTION explain_jit(query text) RETURNS SETOF text
+LANGUAGE plpgsql AS
+$$
+DECLARE
+    ln text;
+BEGIN
+    FOR ln IN
+        EXECUTE format('EXPLAIN (ANALYZE, JIT, COSTS OFF, TIMING OFF) %s', query)
+    LOOP
+        IF ln LIKE 'Total runtime:%' THEN
+            CONTINUE;
+        END IF;
+        ln := regexp_replace(ln, 'compiled=\d+ interpreted=\d+', 'compiled=N interpreted=N');
+        ln := regexp_replace(ln, 'Functions: \d+', 'Functions: N');
+        RETURN NEXT ln;
+    END LOOP;
+END;
+$$;
+SELECT explain_jit('SELECT i4 + i2 AS s, i8 * 2 AS d FROM jittest WHERE i2 >= 0');
+DROP FUNCTION explain_jit(text);
+
+RESET jit_above_cost;
+RESET jit;
+DROP TABLE jittest;
@@ -999,3 +999,105 @@ select f1,g from int4_tbl a right join lateral generate_series(0, a.f1) g on tru
 select f1,g from int4_tbl a full join lateral generate_series(0, a.f1) g on true;
 -- LATERAL can be used to put an aggregate into the FROM clause of its query
 select 1 from tenk1 a, lateral (select max(a.unique1) from int4_tbl b) ss;
+
+-- hash joins most of whose outer tuples are rejected by the bloom filter
+-- over the inner hash keys, with one batch and with several
+begin;
+set local enable_mergejoin = off;
+set local enable_nestloop = off;
+create temp table bloom_inner as
+  select unique1 * 3 as k from tenk1 where unique1 < 4000;
+analyze bloom_inner;
+select count(*) from tenk1 a join bloom_inner b on a.unique1 = b.k;
+select count(*) from tenk1 a left join bloom_inner b on a.unique1 = b.k
+  where b.k is null;
+select count(*) from tenk1 a
+  where exists (select 1 from bloom_inner b where b.k = a.unique1);
+select count(*) from tenk1 a
+  where not exists (select 1 from bloom_inner b where b.k = a.unique1);
+select count(*), count(a.unique1), count(b.k)
+  from tenk1 a full join bloom_inner b on a.unique1 = b.k;
+set local work_mem = '64kB';
+select count(*) from tenk1 a join bloom_inner b on a.unique1 = b.k;
+select count(*) from tenk1 a left join bloom_inner b on a.unique1 = b.k
+  where b.k is null;
+select count(*) from tenk1 a
+  where exists (select 1 from bloom_inner b where b.k = a.unique1);
+select count(*) from tenk1 a
+  where not exists (select 1 from bloom_inner b where b.k = a.unique1);
+select count(*), count(a.unique1), count(b.k)
+  from tenk1 a full join bloom_inner b on a.unique1 = b.k;
+rollback;
+
+-- hash joins whose inner side has too many duplicates of one key to fit in
+-- work_mem, so that the batch holding them must be processed in chunks
+begin;
+set local enable_mergejoin = off;
+set local enable_nestloop = off;
+set local work_mem = '64kB';
+create temp table skew_inner as
+  select 1 as k from generate_series(1, 5000)
+  union all select g from generate_series(2, 1000) g
+  union all select g from generate_series(2001, 2100) g;
+analyze skew_inner;
+select count(*) from tenk1 a join skew_inner b on a.unique1 % 2000 = b.k;
+select count(*) from tenk1 a left join skew_inner b on a.unique1 % 2000 = b.k
+  where b.k is null;
+select count(*) from tenk1 a
+  where exists (select 1 from skew_inner b where b.k = a.unique1 % 2000);
+select count(*) from tenk1 a
+  where not exists (select 1 from skew_inner b where b.k = a.unique1 % 2000);
+select count(*), count(a.unique1), count(b.k)
+  from tenk1 a full join skew_inner b on a.unique1 % 2000 = b.k;
+rollback;
+
+-- nested loops whose inner index scans are rescanned with the same keys
+-- many times, which a Memoize node can answer from its cache
+begin;
+set local enable_hashjoin = off;
+set local enable_mergejoin = off;
+explain (costs off)
+select count(*), sum(b.unique2) from tenk1 a join tenk1 b on b.unique1 = a.hundred
+  where a.twothousand < 100;
+select count(*), sum(b.unique2) from tenk1 a join tenk1 b on b.unique1 = a.hundred
+  where a.twothousand < 100;
+explain (costs off)
+select count(*), count(b.unique1) from tenk1 a
+  left join tenk1 b on b.unique1 = a.hundred + 9950
+  where a.twothousand < 100;
+select count(*), count(b.unique1) from tenk1 a
+  left join tenk1 b on b.unique1 = a.hundred + 9950
+  where a.twothousand < 100;
+-- with a small work_mem, only a couple of the inner scans' results fit in
+-- the cache, so entries must be evicted to make room; hide the numbers
+-- that depend on memory allocation details
+create function explain_memoize(query text) returns setof text
+language plpgsql as
+$$
+declare
+    ln text;
+begin
+    for ln in
+        execute format('explain (analyze, costs off, timing off) %s', query)
+    loop
+        if ln like 'Total runtime:%' then
+            continue;
+        end if;
+        ln := regexp_replace(ln, 'actual rows=\d+ loops=\d+', 'actual rows=N loops=N');
+        ln := regexp_replace(ln, 'Rows Removed by Filter: \d+', 'Rows Removed by Filter: N');
+        ln := regexp_replace(ln, 'Evictions: 0', 'Evictions: Zero');
+        ln := regexp_replace(ln, '(Hits|Misses|Evictions|Overflows): \d+', '\1: N', 'g');
+        ln := regexp_replace(ln, 'Memory Usage: \d+kB', 'Memory Usage: NkB');
+        return next ln;
+    end loop;
+end;
+$$;
+set local work_mem = '64kB';
+select explain_memoize('
+select count(*), sum(length(b.stringu1 || b.stringu2)) from tenk1 a
+  join tenk1 b on b.hundred = a.ten
+  where a.twothousand < 100');
+select count(*), sum(length(b.stringu1 || b.stringu2)) from tenk1 a
+  join tenk1 b on b.hundred = a.ten
+  where a.twothousand < 100;
+rollback;
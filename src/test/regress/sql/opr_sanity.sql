@@ -621,6 +621,19 @@ WHERE a.aggfnoid = p.oid AND
      OR pfn.pronargs != 1
      OR NOT binary_coercible(a.aggtranstype, pfn.proargtypes[0]));
 
+-- Cross-check combinefn (if present) against its entry in pg_proc.
+-- It must combine two transition states into one.
+
+SELECT a.aggfnoid::oid, p.proname, pcf.oid, pcf.proname
+FROM pg_aggregate AS a, pg_proc AS p, pg_proc AS pcf
+WHERE a.aggfnoid = p.oid AND
+    a.aggcombinefn = pcf.oid AND
+    (pcf.proretset
+     OR pcf.pronargs != 2
+     OR NOT physically_coercible(pcf.prorettype, a.aggtranstype)
+     OR NOT physically_coercible(a.aggtranstype, pcf.proargtypes[0])
+     OR NOT physically_coercible(a.aggtranstype, pcf.proargtypes[1]));
+
 -- If transfn is strict then either initval should be non-NULL, or
 -- input type should match transtype so that the first non-null input
 -- can be assigned as the state value.